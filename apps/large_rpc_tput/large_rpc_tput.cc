@@ -128,16 +128,28 @@ void app_cont_func(void *_context, void *_tag)
   send_req(c, msgbuf_idx);
 }
 
+// Return the physical ports used by a thread: all of the NUMA node's ports
+// with multi_port, otherwise one port chosen round-robin
+std::vector<uint8_t> get_thread_ports(size_t thread_id)
+{
+  std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
+  erpc::rt_assert(port_vec.size() > 0);
+  if (!FLAGS_multi_port)
+    return {static_cast<uint8_t>(port_vec.at(thread_id % port_vec.size()))};
+
+  std::vector<uint8_t> phy_ports;
+  for (size_t port : port_vec)
+    phy_ports.push_back(static_cast<uint8_t>(port));
+  return phy_ports;
+}
+
 void server_func(size_t thread_id, erpc::Nexus *nexus)
 {
   ServerContext c;
   c.thread_id_ = thread_id;
-  std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
-  erpc::rt_assert(port_vec.size() > 0);
-  uint8_t phy_port = port_vec.at(thread_id % port_vec.size());
-  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c),
-                                  static_cast<uint8_t>(thread_id),
-                                  basic_sm_handler, phy_port);
+  erpc::Rpc<erpc::CTransport> rpc(
+      nexus, static_cast<void *>(&c), static_cast<uint8_t>(thread_id),
+      basic_sm_handler, get_thread_ports(thread_id));
   rpc.retry_connect_on_invalid_rpc_id_ = true;
   if (erpc::kTesting)
     rpc.fault_inject_set_pkt_drop_prob_st(FLAGS_drop_prob);
@@ -165,13 +177,9 @@ void client_func(size_t thread_id, erpc::Nexus *nexus)
   AppContext c;
   c.thread_id_ = thread_id;
 
-  std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
-  erpc::rt_assert(port_vec.size() > 0);
-  uint8_t phy_port = port_vec.at(thread_id % port_vec.size());
-
-  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c),
-                                  static_cast<uint8_t>(thread_id),
-                                  basic_sm_handler, phy_port);
+  erpc::Rpc<erpc::CTransport> rpc(
+      nexus, static_cast<void *>(&c), static_cast<uint8_t>(thread_id),
+      basic_sm_handler, get_thread_ports(thread_id));
   rpc.retry_connect_on_invalid_rpc_id_ = true;
   if (erpc::kTesting)
     rpc.fault_inject_set_pkt_drop_prob_st(FLAGS_drop_prob);
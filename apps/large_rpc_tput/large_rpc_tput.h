@@ -26,6 +26,7 @@ DEFINE_double(drop_prob, 0, "Packet drop probability");
 DEFINE_string(profile, "", "Experiment profile to use");
 DEFINE_double(throttle, 0, "Throttle flows to incast receiver?");
 DEFINE_double(throttle_fraction, 1, "Fraction of fair share to throttle to.");
+DEFINE_bool(multi_port, false, "Spread each thread's sessions over all ports");
 
 struct app_stats_t
 {
@@ -22,6 +22,12 @@ void ctrl_c_handler(int) { ctrl_c_pressed = 1; }
 
 DEFINE_uint64(num_server_processes, 1, "Number of server processes");
 DEFINE_uint64(resp_size, 64, "Size of the server's RPC response in bytes");
+DEFINE_uint64(idle_iters, 0,
+              "Idle event loop iterations before the server backs off. "
+              "0 disables idle backoff.");
+DEFINE_uint64(think_us, 0,
+              "Client think time between requests in microseconds, which "
+              "lets the server go idle");
 
 class ServerContext : public BasicAppContext
 {
@@ -37,6 +43,8 @@ class ClientContext : public BasicAppContext
 
 public:
   size_t start_tsc_;
+  size_t next_req_tsc_ = 0; // With think time, when to send the next request
+  bool req_pending_ = false; // True iff a request is waiting for think time
   size_t req_size_; // Between kAppMinReqSize and kAppMaxReqSize
   erpc::MsgBuffer req_msgbuf_, resp_msgbuf_;
   hdr_histogram *latency_hist_;
@@ -76,6 +84,7 @@ void server_func(erpc::Nexus *nexus)
   erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), 0 /* tid */,
                                   basic_sm_handler, phy_port);
   rpc.set_pre_resp_msgbuf_size(FLAGS_resp_size);
+  rpc.set_idle_backoff(FLAGS_idle_iters);
   c.rpc_ = &rpc;
 
   while (true)
@@ -83,6 +92,15 @@ void server_func(erpc::Nexus *nexus)
     rpc.run_event_loop(1000);
     if (ctrl_c_pressed == 1)
       break;
+
+    if (FLAGS_idle_iters > 0)
+    {
+      printf("Latency: Server idle pauses %zu, blocks %zu, wakeups %zu\n",
+             rpc.idle_stats_.num_pauses_, rpc.idle_stats_.num_blocks_,
+             rpc.idle_stats_.num_wakeups_);
+      rpc.idle_stats_ = {};
+      fflush(stdout);
+    }
   }
 }
 
@@ -152,7 +170,44 @@ void app_cont_func(void *_context, void *)
                    static_cast<int64_t>(req_lat_us * kAppLatFac));
   c->latency_samples_++;
 
-  send_req(*c);
+  if (FLAGS_think_us == 0)
+  {
+    send_req(*c);
+  }
+  else
+  {
+    c->req_pending_ = true;
+    c->next_req_tsc_ = erpc::rdtsc() + erpc::us_to_cycles(
+                                           FLAGS_think_us,
+                                           c->rpc_->get_freq_ghz());
+  }
+}
+
+/// Run the client's event loop for \p timeout_ms, sending requests after
+/// their think time
+void run_client_event_loop(ClientContext &c, size_t timeout_ms)
+{
+  if (FLAGS_think_us == 0)
+  {
+    c.rpc_->run_event_loop(timeout_ms);
+    return;
+  }
+
+  const size_t end_tsc =
+      erpc::rdtsc() + erpc::ms_to_cycles(timeout_ms, c.rpc_->get_freq_ghz());
+  while (true)
+  {
+    c.rpc_->run_event_loop_once();
+    const size_t now = erpc::rdtsc();
+    if (c.req_pending_ && now >= c.next_req_tsc_)
+    {
+      c.req_pending_ = false;
+      send_req(c);
+    }
+
+    if (now >= end_tsc)
+      break;
+  }
 }
 
 void client_func(erpc::Nexus *nexus)
@@ -184,7 +239,7 @@ void client_func(erpc::Nexus *nexus)
   send_req(c);
   for (size_t i = 0; i < FLAGS_test_ms; i += 1000)
   {
-    rpc.run_event_loop(kAppEvLoopMs); // 1 second
+    run_client_event_loop(c, kAppEvLoopMs); // 1 second
     if (ctrl_c_pressed == 1)
       break;
 
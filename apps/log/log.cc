@@ -1,6 +1,5 @@
 #include "log.h"
 #include <gflags/gflags.h>
-#include <libpmem.h>
 #include <cstring>
 #include "../apps_common.h"
 #include "rpc.h"
@@ -9,167 +8,493 @@
 #include "util/pmem.h"
 #include "util/virt2phy.h"
 
-DEFINE_uint64(num_proc_0_threads, 0, "Threads in process with ID = 0");
-DEFINE_uint64(num_proc_other_threads, 0, "Threads in process with ID != 0");
-DEFINE_uint64(concurrency, 0, "Concurrent requests per client thread");
+// Process 0 is the sequencer. Processes 1 to num_storage_servers are storage
+// servers, and the remaining processes are clients.
+DEFINE_uint64(num_storage_servers, 0, "Number of storage server processes");
+DEFINE_uint64(num_storage_threads, 0, "Threads (stripes) per storage server");
+DEFINE_uint64(num_client_threads, 0, "Threads per client process");
+DEFINE_uint64(concurrency, 0, "Concurrent append batches per client thread");
+DEFINE_uint64(append_batch_size, 0, "Log entries per client append batch");
+DEFINE_uint64(tail_read_percent, 0, "Percentage of batches followed by a "
+                                    "tail read");
 DEFINE_uint64(min_log_entry_size, 0, "Min size of log entries sent by client");
 DEFINE_uint64(max_log_entry_size, 0, "Size of log entries sent by client");
 DEFINE_uint64(prints_per_log_entry_size, 0, "Prints before switching size");
-DEFINE_uint64(use_rotating, 0, "Use rotating counter for log");
+DEFINE_string(storage_type, "pmem", "Storage for stripes: pmem or file");
+DEFINE_string(file_dir, "/tmp", "Directory for stripe files");
+DEFINE_uint64(file_mb, 1024, "Size of each stripe's file in MB");
 
-static constexpr size_t kAppReqType = 1;
 static constexpr size_t kAppEvLoopMs = 1000; // Duration of event loop
 static constexpr bool kAppVerbose = false;
 static constexpr const char *kAppPmemFile = "/dev/dax0.0";
-static constexpr size_t kAppMaxConcurrency = 32; // Outstanding reqs per thread
+static constexpr size_t kAppMaxConcurrency = 32; // Outstanding batches/thread
 static constexpr size_t kAppPmemFileSize = GB(4);
 
-class ServerContext : public BasicAppContext
+size_t get_num_stripes()
+{
+  return FLAGS_num_storage_servers * FLAGS_num_storage_threads;
+}
+
+// The sequencer's tail is soft state: after a sequencer failure, a new
+// sequencer can recover the tail by querying the stripes.
+class SequencerContext : public BasicAppContext
 {
 public:
-  Log log;
+  size_t tail = 0;
+  size_t num_reqs_completed = 0;
+  size_t num_positions_issued = 0;
+};
 
-  // The server prints rate statistics along with a log entry size. Although
-  // the clients switch their log entry size nearly in sync, a server
-  // measurement epoch may receive log entries of different sizes. The fields
-  // below mark those epochs in stdout in which all log entries were of the same
-  // size.
-  size_t first_log_entry_size;   // Size of first log entry in measurement epoch
-  bool all_first_log_entry_size; // True iff all sizeof log entries = first
+class StorageContext : public BasicAppContext
+{
+public:
+  Stripe *stripe;
+  size_t stripe_idx;
 
-  size_t num_reqs_completed;
+  // Responses that wait for the stripe's next group commit
+  std::vector<std::pair<erpc::ReqHandle *, erpc::MsgBuffer *>> pending_resps;
+
+  size_t num_appends = 0;       // Entries appended
+  size_t num_reads = 0;         // Entries read
+  size_t num_group_commits = 0; // Syncs that committed at least one append
+};
+
+// Per-batch state at a client. A batch gets positions from the sequencer,
+// sends one append request per stripe that it touches, and optionally reads
+// the log's tail after all stripes acknowledge.
+class BatchSlot
+{
+public:
+  size_t start_pos;
+  size_t stripes_pending; // Append requests without a response
+
+  erpc::MsgBuffer seq_req_msgbuf, seq_resp_msgbuf;
+  erpc::MsgBuffer read_req_msgbuf, read_resp_msgbuf;
+  std::vector<erpc::MsgBuffer> append_req_msgbuf, append_resp_msgbuf;
 };
 
 // Per-thread application context
 class ClientContext : public BasicAppContext
 {
 public:
-  size_t num_reqs_completed = 0;
+  size_t num_entries_appended = 0;
+  size_t num_tail_reads = 0;
+  size_t num_holes = 0; // Tail reads of positions not yet written
   size_t cur_log_entry_size = 0;
 
-  erpc::MsgBuffer req_msgbuf[kAppMaxConcurrency];
-  erpc::MsgBuffer resp_msgbuf[kAppMaxConcurrency];
+  BatchSlot slots[kAppMaxConcurrency];
 };
 
-void app_cont_func(void *, void *); // Forward declaration
+// Return the number of bytes that an entry of data size \p size takes in an
+// append request
+size_t get_append_entry_size(size_t size)
+{
+  return sizeof(entry_hdr_t) + erpc::round_up<8>(size);
+}
+
+// Return the preallocated response MsgBuffer resized to \p resp_size if it
+// fits in one packet, else a new dynamic response MsgBuffer
+erpc::MsgBuffer *get_resp_msgbuf(BasicAppContext *c,
+                                 erpc::ReqHandle *req_handle, size_t resp_size)
+{
+  if (resp_size <= erpc::Rpc<erpc::CTransport>::get_max_data_per_pkt())
+  {
+    erpc::Rpc<erpc::CTransport>::resize_msg_buffer(
+        &req_handle->pre_resp_msgbuf_, resp_size);
+    return &req_handle->pre_resp_msgbuf_;
+  }
+
+  req_handle->dyn_resp_msgbuf_ = c->rpc_->alloc_msg_buffer_or_die(resp_size);
+  return &req_handle->dyn_resp_msgbuf_;
+}
 
-void req_handler(erpc::ReqHandle *req_handle, void *_context)
+void seq_req_handler(erpc::ReqHandle *req_handle, void *_context)
 {
-  auto *c = static_cast<ServerContext *>(_context);
+  auto *c = static_cast<SequencerContext *>(_context);
+  const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  assert(req_msgbuf->get_data_size() == sizeof(seq_req_t));
+  auto *seq_req = reinterpret_cast<seq_req_t *>(req_msgbuf->buf_);
+
+  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_,
+                                                 sizeof(seq_resp_t));
+  auto *seq_resp =
+      reinterpret_cast<seq_resp_t *>(req_handle->pre_resp_msgbuf_.buf_);
+  seq_resp->start_pos = c->tail;
+  c->tail += seq_req->num_positions;
 
+  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+  c->num_reqs_completed++;
+  c->num_positions_issued += seq_req->num_positions;
+}
+
+void append_req_handler(erpc::ReqHandle *req_handle, void *_context)
+{
+  auto *c = static_cast<StorageContext *>(_context);
   const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
-  _unused(req_msgbuf);
-  size_t log_entry_size = req_msgbuf->get_data_size();
+  const auto *append_req = reinterpret_cast<append_req_t *>(req_msgbuf->buf_);
+  const size_t num_entries = append_req->num_entries;
 
-  if (unlikely(c->first_log_entry_size == SIZE_MAX))
-  {
-    c->first_log_entry_size = log_entry_size;
-  }
+  erpc::MsgBuffer *resp_msgbuf =
+      get_resp_msgbuf(c, req_handle, num_entries * sizeof(EntryStatus));
+  auto *status_arr = reinterpret_cast<EntryStatus *>(resp_msgbuf->buf_);
 
-  if (unlikely(log_entry_size != c->first_log_entry_size))
+  const uint8_t *cur = req_msgbuf->buf_ + sizeof(append_req_t);
+  const size_t num_stripes = get_num_stripes();
+  for (size_t i = 0; i < num_entries; i++)
   {
-    c->all_first_log_entry_size = false;
+    const auto *hdr = reinterpret_cast<const entry_hdr_t *>(cur);
+    assert(hdr->position % num_stripes == c->stripe_idx);
+
+    status_arr[i] = c->stripe->append(hdr->position / num_stripes, *hdr,
+                                      cur + sizeof(entry_hdr_t));
+    cur += get_append_entry_size(hdr->size);
   }
+  assert(cur <= req_msgbuf->buf_ + req_msgbuf->get_data_size());
+
+  // Respond after the group commit at the end of this event loop iteration
+  c->pending_resps.emplace_back(req_handle, resp_msgbuf);
+  c->num_appends += num_entries;
+}
 
-  if (FLAGS_use_rotating == 1)
+void read_req_handler(erpc::ReqHandle *req_handle, void *_context)
+{
+  auto *c = static_cast<StorageContext *>(_context);
+  const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  assert(req_msgbuf->get_data_size() == sizeof(read_req_t));
+  const size_t position =
+      reinterpret_cast<read_req_t *>(req_msgbuf->buf_)->position;
+
+  erpc::MsgBuffer *resp_msgbuf = get_resp_msgbuf(
+      c, req_handle, sizeof(read_resp_t) + FLAGS_max_log_entry_size);
+  auto *read_resp = reinterpret_cast<read_resp_t *>(resp_msgbuf->buf_);
+
+  read_resp->size = 0;
+  read_resp->status = c->stripe->read(
+      position, position / get_num_stripes(),
+      resp_msgbuf->buf_ + sizeof(read_resp_t), read_resp->size);
+  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(
+      resp_msgbuf, sizeof(read_resp_t) + read_resp->size);
+  c->num_reads++;
+
+  // Don't expose entries that are not durable yet
+  if (c->stripe->has_unsynced())
   {
-    c->log.append_rotating(req_msgbuf->buf_, req_msgbuf->get_data_size());
+    c->pending_resps.emplace_back(req_handle, resp_msgbuf);
   }
   else
   {
-    c->log.append_naive(req_msgbuf->buf_, req_msgbuf->get_data_size());
+    c->rpc_->enqueue_response(req_handle, resp_msgbuf);
   }
+}
 
-  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_,
-                                                 sizeof(size_t));
-  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
-  c->num_reqs_completed++;
+// Commit the appends from this event loop iteration, and send the responses
+// that waited for them
+void group_commit(StorageContext *c)
+{
+  if (c->pending_resps.empty())
+    return;
+
+  if (c->stripe->has_unsynced())
+    c->num_group_commits++;
+  c->stripe->sync();
+
+  for (auto &pending_resp : c->pending_resps)
+  {
+    c->rpc_->enqueue_response(pending_resp.first, pending_resp.second);
+  }
+  c->pending_resps.clear();
 }
 
-// The function executed by each client thread in the cluster
-void server_func(size_t thread_id, erpc::Nexus *nexus, uint8_t *pbuf)
+// The function executed by the sequencer thread
+void sequencer_func(erpc::Nexus *nexus)
 {
   std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
   uint8_t phy_port = port_vec.at(0);
 
-  ServerContext c;
-  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), thread_id,
+  SequencerContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), 0,
                                   basic_sm_handler, phy_port);
-
   c.rpc_ = &rpc;
-  c.thread_id_ = thread_id;
-  c.log = Log(pbuf, kAppPmemFileSize);
 
   while (true)
   {
-    c.first_log_entry_size = SIZE_MAX;
-    c.all_first_log_entry_size = true;
-
     rpc.run_event_loop(kAppEvLoopMs);
 
     double sec = rpc.sec_since_creation();
-    printf(
-        "log server (rotating: %s): Thread %zu, "
-        "[first_log_entry_size %zu, all_first_log_entry_size = %s], "
-        "rate %.2f M/s\n",
-        FLAGS_use_rotating == 1 ? "yes" : "no", c.thread_id_,
-        c.first_log_entry_size, c.all_first_log_entry_size ? "yes" : "no",
-        c.num_reqs_completed / (1000000.0 * sec));
+    printf("log sequencer: tail %zu, rate %.2f M reqs/s, %.2f M positions/s\n",
+           c.tail, c.num_reqs_completed / (1000000.0 * sec),
+           c.num_positions_issued / (1000000.0 * sec));
 
     c.num_reqs_completed = 0;
+    c.num_positions_issued = 0;
   }
 }
 
-// Send a request using this MsgBuffer
-void send_req(ClientContext *c, size_t msgbuf_idx)
+// The function executed by each storage server thread. Each thread stores
+// one stripe.
+void storage_func(size_t thread_id, erpc::Nexus *nexus, uint8_t *pbuf)
 {
-  erpc::MsgBuffer &req_msgbuf = c->req_msgbuf[msgbuf_idx];
-  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_msgbuf,
-                                                 c->cur_log_entry_size);
+  std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
+  uint8_t phy_port = port_vec.at(thread_id % port_vec.size());
+
+  StorageContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c),
+                                  static_cast<uint8_t>(thread_id),
+                                  basic_sm_handler, phy_port);
+  c.rpc_ = &rpc;
+  c.thread_id_ = thread_id;
+  c.stripe_idx =
+      (FLAGS_process_id - 1) * FLAGS_num_storage_threads + thread_id;
 
-  if (kAppVerbose)
+  const StorageType storage_type =
+      storage_type_from_string(FLAGS_storage_type);
+  if (storage_type == StorageType::kPmem)
   {
-    printf("log: Thread %zu sending request using msgbuf_idx %zu.\n",
-           c->thread_id_, msgbuf_idx);
+    const size_t region_size = kAppPmemFileSize / FLAGS_num_storage_threads;
+    c.stripe = new Stripe(storage_type, &pbuf[thread_id * region_size], "",
+                          region_size, FLAGS_max_log_entry_size);
   }
+  else
+  {
+    const std::string file = FLAGS_file_dir + "/log_stripe_" +
+                             std::to_string(c.stripe_idx);
+    c.stripe = new Stripe(storage_type, nullptr, file, MB(FLAGS_file_mb),
+                          FLAGS_max_log_entry_size);
+  }
+
+  while (true)
+  {
+    const size_t start_tsc = erpc::rdtsc();
+    const size_t ev_loop_cycles =
+        erpc::ms_to_cycles(kAppEvLoopMs, rpc.get_freq_ghz());
+    while (erpc::rdtsc() - start_tsc < ev_loop_cycles)
+    {
+      rpc.run_event_loop_once();
+      group_commit(&c);
+    }
 
-  c->rpc_->enqueue_request(c->session_num_vec_[0], kAppReqType, &req_msgbuf,
-                           &c->resp_msgbuf[msgbuf_idx], app_cont_func,
-                           reinterpret_cast<void *>(msgbuf_idx));
+    double sec = rpc.sec_since_creation();
+    printf(
+        "log storage: Thread %zu (stripe %zu), append rate %.2f M/s, "
+        "read rate %.2f M/s, %.2f appends/group commit\n",
+        c.thread_id_, c.stripe_idx, c.num_appends / (1000000.0 * sec),
+        c.num_reads / (1000000.0 * sec),
+        c.num_appends / std::max(1.0, c.num_group_commits * 1.0));
+
+    c.num_appends = 0;
+    c.num_reads = 0;
+    c.num_group_commits = 0;
+  }
 }
 
-void app_cont_func(void *_context, void *_tag)
+void seq_cont(void *, void *);    // Forward declaration
+void append_cont(void *, void *); // Forward declaration
+void tail_cont(void *, void *);   // Forward declaration
+void read_cont(void *, void *);   // Forward declaration
+
+// Start a new batch in this slot by requesting positions from the sequencer
+void send_batch(ClientContext *c, size_t slot_i)
+{
+  BatchSlot &slot = c->slots[slot_i];
+  auto *seq_req = reinterpret_cast<seq_req_t *>(slot.seq_req_msgbuf.buf_);
+  seq_req->num_positions = FLAGS_append_batch_size;
+
+  c->rpc_->enqueue_request(
+      c->session_num_vec_[0], static_cast<uint8_t>(ReqType::kSeqReq),
+      &slot.seq_req_msgbuf, &slot.seq_resp_msgbuf, seq_cont,
+      reinterpret_cast<void *>(slot_i));
+}
+
+// Write the batch's entries directly to the stripes, with one append request
+// per stripe
+void seq_cont(void *_context, void *_tag)
 {
   auto *c = static_cast<ClientContext *>(_context);
-  auto msgbuf_idx = reinterpret_cast<size_t>(_tag);
+  const auto slot_i = reinterpret_cast<size_t>(_tag);
+  BatchSlot &slot = c->slots[slot_i];
+  erpc::rt_assert(slot.seq_resp_msgbuf.get_data_size() > 0,
+                  "Sequencer RPC failed");
 
-  if (kAppVerbose)
-    printf("log: Received resp for msgbuf %zu.\n", msgbuf_idx);
+  slot.start_pos =
+      reinterpret_cast<seq_resp_t *>(slot.seq_resp_msgbuf.buf_)->start_pos;
 
-  c->num_reqs_completed++;
-  send_req(c, msgbuf_idx);
+  const size_t num_stripes = get_num_stripes();
+  for (size_t s = 0; s < num_stripes; s++)
+  {
+    auto *append_req =
+        reinterpret_cast<append_req_t *>(slot.append_req_msgbuf[s].buf_);
+    append_req->num_entries = 0;
+  }
+
+  // Format the entries. The first bytes of each entry hold its position.
+  const size_t entry_size = get_append_entry_size(c->cur_log_entry_size);
+  for (size_t i = 0; i < FLAGS_append_batch_size; i++)
+  {
+    const size_t position = slot.start_pos + i;
+    erpc::MsgBuffer &req_msgbuf =
+        slot.append_req_msgbuf[position % num_stripes];
+    auto *append_req = reinterpret_cast<append_req_t *>(req_msgbuf.buf_);
+
+    uint8_t *cur = req_msgbuf.buf_ + sizeof(append_req_t) +
+                   append_req->num_entries * entry_size;
+    auto *hdr = reinterpret_cast<entry_hdr_t *>(cur);
+    hdr->position = position;
+    hdr->size = c->cur_log_entry_size;
+    memcpy(cur + sizeof(entry_hdr_t), &position,
+           std::min(sizeof(size_t), c->cur_log_entry_size));
+
+    append_req->num_entries++;
+  }
+
+  slot.stripes_pending = 0;
+  for (size_t s = 0; s < num_stripes; s++)
+  {
+    erpc::MsgBuffer &req_msgbuf = slot.append_req_msgbuf[s];
+    const size_t num_entries =
+        reinterpret_cast<append_req_t *>(req_msgbuf.buf_)->num_entries;
+    if (num_entries == 0)
+      continue;
+
+    erpc::Rpc<erpc::CTransport>::resize_msg_buffer(
+        &req_msgbuf, sizeof(append_req_t) + num_entries * entry_size);
+
+    if (kAppVerbose)
+    {
+      printf("log: Thread %zu sending %zu entries to stripe %zu.\n",
+             c->thread_id_, num_entries, s);
+    }
+
+    c->rpc_->enqueue_request(
+        c->session_num_vec_[1 + s], static_cast<uint8_t>(ReqType::kAppendReq),
+        &req_msgbuf, &slot.append_resp_msgbuf[s], append_cont,
+        reinterpret_cast<void *>(slot_i * num_stripes + s));
+    slot.stripes_pending++;
+  }
 }
 
-void client_connect_sessions(BasicAppContext *c)
+void append_cont(void *_context, void *_tag)
 {
-  // All non-zero processes create one session to process #0
-  if (FLAGS_process_id == 0)
+  auto *c = static_cast<ClientContext *>(_context);
+  const size_t num_stripes = get_num_stripes();
+  const size_t slot_i = reinterpret_cast<size_t>(_tag) / num_stripes;
+  const size_t stripe_idx = reinterpret_cast<size_t>(_tag) % num_stripes;
+  BatchSlot &slot = c->slots[slot_i];
+
+  const erpc::MsgBuffer &resp_msgbuf = slot.append_resp_msgbuf[stripe_idx];
+  erpc::rt_assert(resp_msgbuf.get_data_size() > 0, "Append RPC failed");
+
+  // Positions from the sequencer are unique, so appends can't conflict
+  const auto *status_arr = reinterpret_cast<EntryStatus *>(resp_msgbuf.buf_);
+  for (size_t i = 0; i < resp_msgbuf.get_data_size(); i++)
+  {
+    erpc::rt_assert(status_arr[i] == EntryStatus::kOk, "Append failed");
+  }
+
+  slot.stripes_pending--;
+  if (slot.stripes_pending > 0)
     return;
 
-  size_t global_thread_id =
-      FLAGS_process_id * FLAGS_num_proc_other_threads + c->thread_id_;
-  size_t rem_tid = global_thread_id % FLAGS_num_proc_0_threads;
+  c->num_entries_appended += FLAGS_append_batch_size;
+  if (c->fastrand_.next_u32() % 100 < FLAGS_tail_read_percent)
+  {
+    // Query the tail from the sequencer
+    reinterpret_cast<seq_req_t *>(slot.seq_req_msgbuf.buf_)->num_positions = 0;
+    c->rpc_->enqueue_request(
+        c->session_num_vec_[0], static_cast<uint8_t>(ReqType::kSeqReq),
+        &slot.seq_req_msgbuf, &slot.seq_resp_msgbuf, tail_cont,
+        reinterpret_cast<void *>(slot_i));
+    return;
+  }
 
-  c->session_num_vec_.resize(1);
+  send_batch(c, slot_i);
+}
 
-  printf("log: Thread %zu: Creating session to proc 0, thread %zu.\n",
-         c->thread_id_, rem_tid);
+// Read the last entry before the tail
+void tail_cont(void *_context, void *_tag)
+{
+  auto *c = static_cast<ClientContext *>(_context);
+  const auto slot_i = reinterpret_cast<size_t>(_tag);
+  BatchSlot &slot = c->slots[slot_i];
+  erpc::rt_assert(slot.seq_resp_msgbuf.get_data_size() > 0,
+                  "Sequencer RPC failed");
+
+  const size_t tail =
+      reinterpret_cast<seq_resp_t *>(slot.seq_resp_msgbuf.buf_)->start_pos;
+  assert(tail > 0); // This client's batch was appended before the tail query
+
+  const size_t position = tail - 1;
+  reinterpret_cast<read_req_t *>(slot.read_req_msgbuf.buf_)->position =
+      position;
+  c->rpc_->enqueue_request(
+      c->session_num_vec_[1 + position % get_num_stripes()],
+      static_cast<uint8_t>(ReqType::kReadReq), &slot.read_req_msgbuf,
+      &slot.read_resp_msgbuf, read_cont, reinterpret_cast<void *>(slot_i));
+}
+
+void read_cont(void *_context, void *_tag)
+{
+  auto *c = static_cast<ClientContext *>(_context);
+  const auto slot_i = reinterpret_cast<size_t>(_tag);
+  BatchSlot &slot = c->slots[slot_i];
+  erpc::rt_assert(slot.read_resp_msgbuf.get_data_size() > 0,
+                  "Read RPC failed");
 
+  const auto *read_resp =
+      reinterpret_cast<read_resp_t *>(slot.read_resp_msgbuf.buf_);
+  const size_t position =
+      reinterpret_cast<read_req_t *>(slot.read_req_msgbuf.buf_)->position;
+
+  switch (read_resp->status)
+  {
+  case EntryStatus::kOk:
+  {
+    // Check the position stamped in the entry by its writer
+    size_t stamped_pos = 0;
+    memcpy(&stamped_pos, slot.read_resp_msgbuf.buf_ + sizeof(read_resp_t),
+           std::min(sizeof(size_t), read_resp->size));
+    erpc::rt_assert(read_resp->size < sizeof(size_t) ||
+                        stamped_pos == position,
+                    "Tail read returned an incorrect entry");
+    break;
+  }
+  case EntryStatus::kUnwritten:
+    // Another client has the position but hasn't written it yet
+    c->num_holes++;
+    break;
+  default:
+    erpc::rt_assert(false, "Tail read failed");
+  }
+
+  c->num_tail_reads++;
+  send_batch(c, slot_i);
+}
+
+void client_connect_sessions(BasicAppContext *c)
+{
+  const size_t num_stripes = get_num_stripes();
+  c->session_num_vec_.resize(1 + num_stripes);
+
+  // Session 0 is to the sequencer
+  printf("log: Thread %zu: Creating session to sequencer.\n", c->thread_id_);
   c->session_num_vec_[0] =
-      c->rpc_->create_session(erpc::get_uri_for_process(0), rem_tid);
+      c->rpc_->create_session(erpc::get_uri_for_process(0), 0);
   erpc::rt_assert(c->session_num_vec_[0] >= 0, "create_session() failed");
 
-  while (c->num_sm_resps_ != 1)
+  // Session 1 + s is to stripe s
+  for (size_t s = 0; s < num_stripes; s++)
+  {
+    const size_t proc = 1 + s / FLAGS_num_storage_threads;
+    const size_t rem_tid = s % FLAGS_num_storage_threads;
+    printf("log: Thread %zu: Creating session to proc %zu, thread %zu.\n",
+           c->thread_id_, proc, rem_tid);
+
+    c->session_num_vec_[1 + s] = c->rpc_->create_session(
+        erpc::get_uri_for_process(proc), static_cast<uint8_t>(rem_tid));
+    erpc::rt_assert(c->session_num_vec_[1 + s] >= 0,
+                    "create_session() failed");
+  }
+
+  while (c->num_sm_resps_ != 1 + num_stripes)
   {
     c->rpc_->run_event_loop(200); // 200 milliseconds
   }
@@ -193,44 +518,59 @@ void client_func(size_t thread_id, erpc::Nexus *nexus)
   c.cur_log_entry_size = FLAGS_min_log_entry_size;
 
   client_connect_sessions(&c);
-
-  if (c.session_num_vec_.size() > 0)
-  {
-    printf("log: Thread %zu: All sessions connected.\n", thread_id);
-  }
-  else
-  {
-    printf("log: Thread %zu: No sessions created.\n", thread_id);
-  }
+  printf("log: Thread %zu: All sessions connected.\n", thread_id);
+
+  // A stripe gets at most this many entries from one batch
+  const size_t num_stripes = get_num_stripes();
+  const size_t max_stripe_entries =
+      (FLAGS_append_batch_size + num_stripes - 1) / num_stripes;
+  const size_t max_append_req_size =
+      sizeof(append_req_t) +
+      max_stripe_entries * get_append_entry_size(FLAGS_max_log_entry_size);
+  erpc::rt_assert(max_append_req_size <= rpc.get_max_msg_size(),
+                  "Append batch too large");
 
   for (size_t i = 0; i < FLAGS_concurrency; i++)
   {
-    c.req_msgbuf[i] = c.rpc_->alloc_msg_buffer_or_die(FLAGS_max_log_entry_size);
-    memset(c.req_msgbuf[i].buf_, i + 1, FLAGS_max_log_entry_size);
-
-    c.resp_msgbuf[i] = c.rpc_->alloc_msg_buffer_or_die(sizeof(size_t));
+    BatchSlot &slot = c.slots[i];
+    slot.seq_req_msgbuf = rpc.alloc_msg_buffer_or_die(sizeof(seq_req_t));
+    slot.seq_resp_msgbuf = rpc.alloc_msg_buffer_or_die(sizeof(seq_resp_t));
+    slot.read_req_msgbuf = rpc.alloc_msg_buffer_or_die(sizeof(read_req_t));
+    slot.read_resp_msgbuf = rpc.alloc_msg_buffer_or_die(
+        sizeof(read_resp_t) + FLAGS_max_log_entry_size);
+
+    for (size_t s = 0; s < num_stripes; s++)
+    {
+      erpc::MsgBuffer req_msgbuf =
+          rpc.alloc_msg_buffer_or_die(max_append_req_size);
+      memset(req_msgbuf.buf_, static_cast<int>(i + 1), max_append_req_size);
+      slot.append_req_msgbuf.push_back(req_msgbuf);
+      slot.append_resp_msgbuf.push_back(rpc.alloc_msg_buffer_or_die(
+          max_stripe_entries * sizeof(EntryStatus)));
+    }
   }
 
-  for (size_t msgbuf_idx = 0; msgbuf_idx < FLAGS_concurrency; msgbuf_idx++)
+  for (size_t slot_i = 0; slot_i < FLAGS_concurrency; slot_i++)
   {
-    send_req(&c, msgbuf_idx);
+    send_batch(&c, slot_i);
   }
 
   size_t num_prints = 0;
   for (size_t i = 0; i < FLAGS_test_ms; i += kAppEvLoopMs)
   {
     rpc.run_event_loop(kAppEvLoopMs);
-    if (c.session_num_vec_.size() == 0)
-      continue; // No stats to print
 
     double sec = rpc.sec_since_creation();
     printf(
-        "Thread %zu, log entry size %zu: rate %.2f M/s. "
-        "Credits %zu (best = 32).\n",
+        "Thread %zu, log entry size %zu: append rate %.2f M/s, "
+        "tail reads %zu (%zu holes). Credits %zu (best = 32).\n",
         c.thread_id_, c.cur_log_entry_size,
-        c.num_reqs_completed / (1000000.0 * sec), erpc::kSessionCredits);
+        c.num_entries_appended / (1000000.0 * sec), c.num_tail_reads,
+        c.num_holes, erpc::kSessionCredits);
 
-    c.num_reqs_completed = 0;
+    c.num_entries_appended = 0;
+    c.num_tail_reads = 0;
+    c.num_holes = 0;
 
     num_prints++;
     if (num_prints == FLAGS_prints_per_log_entry_size)
@@ -254,31 +594,54 @@ int main(int argc, char **argv)
   gflags::ParseCommandLineFlags(&argc, &argv, true);
   erpc::rt_assert(FLAGS_concurrency <= kAppMaxConcurrency, "Invalid conc");
   erpc::rt_assert(FLAGS_process_id < FLAGS_num_processes, "Invalid process ID");
+  erpc::rt_assert(FLAGS_num_storage_servers > 0 &&
+                      FLAGS_num_storage_threads > 0,
+                  "Need at least one stripe");
+  erpc::rt_assert(FLAGS_num_processes > 1 + FLAGS_num_storage_servers,
+                  "Need at least one client process");
+  erpc::rt_assert(FLAGS_append_batch_size > 0, "Invalid append batch size");
+  erpc::rt_assert(FLAGS_tail_read_percent <= 100, "Invalid tail read percent");
+  erpc::rt_assert(FLAGS_min_log_entry_size > 0 &&
+                      FLAGS_min_log_entry_size <= FLAGS_max_log_entry_size,
+                  "Invalid log entry sizes");
 
   erpc::Nexus nexus(erpc::get_uri_for_process(FLAGS_process_id),
                     FLAGS_numa_node, 0);
-  nexus.register_req_func(kAppReqType, req_handler);
+  nexus.register_req_func(static_cast<uint8_t>(ReqType::kSeqReq),
+                          seq_req_handler);
+  nexus.register_req_func(static_cast<uint8_t>(ReqType::kAppendReq),
+                          append_req_handler);
+  nexus.register_req_func(static_cast<uint8_t>(ReqType::kReadReq),
+                          read_req_handler);
 
-  size_t num_threads = FLAGS_process_id == 0 ? 1 : FLAGS_num_proc_other_threads;
-  std::vector<std::thread> threads(num_threads);
+  std::vector<std::thread> threads;
 
   if (FLAGS_process_id == 0)
   {
-    printf("Server: Mapping pmem file");
-    uint8_t *pbuf = erpc::map_devdax_file(kAppPmemFile, kAppPmemFileSize);
-    printf("Server: Done.\n");
+    threads.emplace_back(sequencer_func, &nexus);
+    erpc::bind_to_core(threads[0], FLAGS_numa_node, 0);
+  }
+  else if (FLAGS_process_id <= FLAGS_num_storage_servers)
+  {
+    uint8_t *pbuf = nullptr;
+    if (storage_type_from_string(FLAGS_storage_type) == StorageType::kPmem)
+    {
+      printf("Storage server: Mapping pmem file...\n");
+      pbuf = erpc::map_devdax_file(kAppPmemFile, kAppPmemFileSize);
+      printf("Storage server: Done.\n");
+    }
 
-    for (size_t i = 0; i < num_threads; i++)
+    for (size_t i = 0; i < FLAGS_num_storage_threads; i++)
     {
-      threads[i] = std::thread(server_func, i, &nexus, pbuf);
+      threads.emplace_back(storage_func, i, &nexus, pbuf);
       erpc::bind_to_core(threads[i], FLAGS_numa_node, i);
     }
   }
   else
   {
-    for (size_t i = 0; i < num_threads; i++)
+    for (size_t i = 0; i < FLAGS_num_client_threads; i++)
     {
-      threads[i] = std::thread(client_func, i, &nexus);
+      threads.emplace_back(client_func, i, &nexus);
       erpc::bind_to_core(threads[i], FLAGS_numa_node, i);
     }
   }
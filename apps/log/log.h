@@ -1,176 +1,247 @@
 #pragma once
 
 #include <assert.h>
-#include <libpmem.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <algorithm>
+#include <string>
+#include <vector>
 #include "../apps_common.h"
 
-class Counter
+#ifdef LOG_USE_PMEM
+#include <libpmem.h>
+#else
+// Dummy versions of libpmem functions, to avoid #ifdef LOG_USE_PMEM
+// everywhere. Only StorageType::kFile works without libpmem.
+static void *pmem_memcpy_nodrain(void *, const void *, size_t)
 {
-public:
-  static constexpr size_t kNumBuffers = 16;
-  static constexpr size_t kBufferSize = 256;
+  erpc::rt_assert(false, "pmem not supported");
+  return nullptr;
+}
+static void pmem_drain() {}
+#endif
+
+// The shared log is striped over the threads of the storage servers. Log
+// position p is stored at stripe (p % num_stripes), at local index
+// (p / num_stripes) in that stripe.
+enum class ReqType : uint8_t
+{
+  kSeqReq = 1, // Get positions from the sequencer
+  kAppendReq,  // Write a batch of entries to one stripe
+  kReadReq     // Read one entry from a stripe
+};
+
+enum class EntryStatus : uint8_t
+{
+  kOk,
+  kWritten,   // Append to a position that was already written
+  kUnwritten, // Read from a position that was not written yet (a hole)
+  kTrimmed    // Position's slot was reused by a later position
+};
+
+// kSeqReq request format. The sequencer returns num_positions consecutive
+// positions. A request for zero positions returns the current tail.
+struct seq_req_t
+{
+  size_t num_positions;
+};
+
+struct seq_resp_t
+{
+  size_t start_pos; // The first position handed out, or the tail
+};
+
+// An entry in an append request, and the header of a stored entry. The entry's
+// data follows the header, padded to 8 bytes in append requests.
+struct entry_hdr_t
+{
+  size_t position;
+  size_t size; // Bytes of data
+};
+
+// kAppendReq request format: [append_req_t, entry_hdr_t, data, ...]. The
+// response contains one EntryStatus per entry, in the same order.
+struct append_req_t
+{
+  size_t num_entries;
+};
+
+// kReadReq request format
+struct read_req_t
+{
+  size_t position;
+};
+
+// kReadReq response format: [read_resp_t, data]. Only kOk responses have data.
+struct read_resp_t
+{
+  EntryStatus status;
+  size_t size;
+};
+
+enum class StorageType
+{
+  kPmem,
+  kFile
+};
 
+static StorageType storage_type_from_string(std::string str)
+{
+  if (str == "pmem")
+    return StorageType::kPmem;
+  erpc::rt_assert(str == "file", "Invalid storage type " + str);
+  return StorageType::kFile;
+}
+
+/// One stripe of the shared log, stored in fixed-size slots on a pmem region
+/// or in a regular file. Writes are not durable until sync(), so the server
+/// commits a group of appends with one pmem_drain() or fdatasync().
+class Stripe
+{
+public:
   /**
-   * @brief Construct a counter
+   * @brief Construct a stripe
    *
-   * @param pbuf The start address of the counter on persistent memory
+   * @param pbuf The start address of the stripe's pmem region. Unused for
+   * file storage.
    *
-   * @param create_new If true, the counter is reset to zero. If false, the
-   * counter is initialized using the prior pmem contents.
+   * @param file The stripe's file. Unused for pmem storage.
+   *
+   * @param size Bytes of pmem or file space for the stripe
+   *
+   * @param max_entry_size The largest entry that can be appended
    */
-  Counter(uint8_t *pbuf, bool create_new) : ctr_base_addr(pbuf)
+  Stripe(StorageType type, uint8_t *pbuf, std::string file, size_t size,
+         size_t max_entry_size)
+      : type(type), pbuf(pbuf),
+        slot_size(erpc::round_up<64>(sizeof(entry_hdr_t) + max_entry_size))
   {
-    if (create_new)
-    {
-      pmem_memset_persist(pbuf, 0, kNumBuffers * kBufferSize);
-    }
-    else
+    num_slots = size / slot_size;
+    erpc::rt_assert(num_slots > 0, "Stripe too small");
+    slot_pos.assign(num_slots, SIZE_MAX);
+
+    if (type == StorageType::kFile)
     {
-      size_t cur_max = 0;   // Maximum value among the counters
-      size_t cur_max_i = 0; // Index of the maximum value
-      for (size_t i = 0; i < kNumBuffers; i++)
-      {
-        size_t *counter_i = reinterpret_cast<size_t *>(&pbuf[i * kBufferSize]);
-        if (*counter_i > cur_max)
-        {
-          cur_max = *counter_i;
-          cur_max_i = i;
-        }
-      }
-
-      v_value = cur_max;
-      buffer_idx = (cur_max_i + 1) % kNumBuffers;
+      fd = open(file.c_str(), O_RDWR | O_CREAT, 0666);
+      erpc::rt_assert(fd >= 0, "open() failed for " + file + ": " +
+                                   std::string(strerror(errno)));
+
+      // Allocate the file's blocks up front so that appends don't allocate
+      int ret = posix_fallocate(fd, 0, static_cast<off_t>(size));
+      erpc::rt_assert(ret == 0, "posix_fallocate() failed for " + file);
     }
   }
 
-  Counter() {}
-
-  /// The amount of contiguous pmem needed for this counter
-  static size_t get_reqd_space()
+  ~Stripe()
   {
-    return erpc::round_up<256>(kNumBuffers * kBufferSize);
+    if (type == StorageType::kFile)
+      close(fd);
   }
 
-  // Increment by always writing to the same location
-  inline void increment_naive(size_t increment)
+  /// Write an entry at local index local_idx. The entry is durable after the
+  /// next sync().
+  EntryStatus append(size_t local_idx, const entry_hdr_t &hdr,
+                     const uint8_t *data)
   {
-    v_value += increment;
-    pmem_memcpy_persist(&ctr_base_addr[0], &v_value, sizeof(v_value));
-  }
+    const size_t slot = local_idx % num_slots;
+    if (slot_pos[slot] == hdr.position)
+      return EntryStatus::kWritten; // Positions are write-once
+    if (slot_pos[slot] != SIZE_MAX && slot_pos[slot] > hdr.position)
+      return EntryStatus::kTrimmed;
+
+    const size_t off = slot * slot_size;
+    if (type == StorageType::kPmem)
+    {
+      pmem_memcpy_nodrain(&pbuf[off], &hdr, sizeof(entry_hdr_t));
+      pmem_memcpy_nodrain(&pbuf[off + sizeof(entry_hdr_t)], data, hdr.size);
+    }
+    else
+    {
+      file_write(off, &hdr, sizeof(entry_hdr_t));
+      file_write(off + sizeof(entry_hdr_t), data, hdr.size);
+    }
 
-  // Increment by writing to rotating locations, but don't do full-cacheline
-  // writes
-  inline void increment_rotate(size_t increment)
-  {
-    v_value += increment;
-    pmem_memcpy_persist(&ctr_base_addr[buffer_idx * kBufferSize], &v_value,
-                        sizeof(v_value));
-    buffer_idx = (buffer_idx + 1) % kNumBuffers;
+    slot_pos[slot] = hdr.position;
+    num_unsynced++;
+    return EntryStatus::kOk;
   }
 
-  size_t v_value = 0; // Volatile value of the counter
-
-  size_t buffer_idx = 0;
-  uint8_t *ctr_base_addr = nullptr; // Starting address of the counter on pmem
-};
-
-class Log
-{
-public:
-  // Assume pmem_file_size is large enough for any one write
-  Log(uint8_t *pbuf, size_t pmem_file_size)
-      : pmem_file_size(pmem_file_size), pbuf(pbuf)
+  /// Read the entry at position at local index local_idx into buf. Return the
+  /// status, and fill size if the status is kOk.
+  EntryStatus read(size_t position, size_t local_idx, uint8_t *buf,
+                   size_t &size) const
   {
-    ctr = Counter(pbuf, true /* create_new */);
-    cur_write_offset = Counter::get_reqd_space();
-  }
+    const size_t slot = local_idx % num_slots;
+    if (slot_pos[slot] == SIZE_MAX || slot_pos[slot] < position)
+      return EntryStatus::kUnwritten;
+    if (slot_pos[slot] > position)
+      return EntryStatus::kTrimmed;
+
+    entry_hdr_t hdr;
+    const size_t off = slot * slot_size;
+    if (type == StorageType::kPmem)
+    {
+      memcpy(&hdr, &pbuf[off], sizeof(entry_hdr_t));
+      memcpy(buf, &pbuf[off + sizeof(entry_hdr_t)], hdr.size);
+    }
+    else
+    {
+      file_read(off, &hdr, sizeof(entry_hdr_t));
+      file_read(off + sizeof(entry_hdr_t), buf, hdr.size);
+    }
 
-  Log() {}
+    assert(hdr.position == position);
+    size = hdr.size;
+    return EntryStatus::kOk;
+  }
 
-  // Append with naive counter incrementing
-  void append_naive(uint8_t *data, size_t data_size)
+  /// Make all appends since the last sync durable (group commit)
+  void sync()
   {
-    pmem_memcpy_persist(&pbuf[cur_write_offset], data, data_size);
-    ctr.increment_naive(data_size);
+    if (num_unsynced == 0)
+      return;
 
-    cur_write_offset += data_size;
-    if (cur_write_offset + data_size > pmem_file_size)
+    if (type == StorageType::kPmem)
     {
-      cur_write_offset = Counter::get_reqd_space();
+      pmem_drain();
     }
+    else
+    {
+      erpc::rt_assert(fdatasync(fd) == 0, "fdatasync() failed");
+    }
+
+    num_unsynced = 0;
   }
 
-  // Append with rotating counter incrementing
-  void append_rotating(uint8_t *data, size_t data_size)
+  bool has_unsynced() const { return num_unsynced > 0; }
+
+private:
+  void file_write(size_t off, const void *buf, size_t len)
   {
-    pmem_memcpy_persist(&pbuf[cur_write_offset], data, data_size);
-    ctr.increment_rotate(data_size);
+    ssize_t ret = pwrite(fd, buf, len, static_cast<off_t>(off));
+    erpc::rt_assert(ret == static_cast<ssize_t>(len), "Stripe write failed");
+  }
 
-    cur_write_offset += data_size;
-    if (cur_write_offset + data_size > pmem_file_size)
-    {
-      cur_write_offset = Counter::get_reqd_space();
-    }
+  void file_read(size_t off, void *buf, size_t len) const
+  {
+    ssize_t ret = pread(fd, buf, len, static_cast<off_t>(off));
+    erpc::rt_assert(ret == static_cast<ssize_t>(len), "Stripe read failed");
   }
 
-  size_t pmem_file_size;
-  uint8_t *pbuf;
-  size_t cur_write_offset = 0;
-  Counter ctr;
-};
+  const StorageType type;
+  uint8_t *pbuf = nullptr;
+  int fd = -1;
+
+  const size_t slot_size; // Bytes per slot, including the entry header
+  size_t num_slots;
 
-// void local_log_bench(uint8_t *pbuf, size_t pmem_file_size) {
-//   // Amount of data appended to the log in on iteration
-//   static constexpr size_t kMaxLogDataSize = 4096;
-//   static constexpr size_t kNumIters = 1000000;
-
-//   uint8_t source[kMaxLogDataSize] = {0};
-
-//   printf("Local log benchmark...\n");
-//   printf("write_bytes naive_GBps rotating_GBps\n");
-
-//   // Sweep over write sizes
-//   for (size_t write_sz = 64; write_sz <= kMaxLogDataSize; write_sz *= 2) {
-//     double naive_GBps, rotating_GBps;
-
-//     {
-//       // Naive log
-//       Log log(pbuf, pmem_file_size);
-//       struct timespec bench_start;
-//       clock_gettime(CLOCK_REALTIME, &bench_start);
-
-//       for (size_t i = 0; i < kNumIters; i++) {
-//         // Modify the source
-//         for (size_t j = 0; j < write_sz / 64; j += 64) source[j]++;
-//         log.append_naive(source, write_sz);
-//       }
-
-//       double bench_seconds = erpc::sec_since(bench_start);
-//       naive_GBps = kNumIters * write_sz / (bench_seconds * GB(1));
-//     }
-
-//     {
-//       // Rotating log
-//       Log log(pbuf, pmem_file_size);
-//       struct timespec bench_start;
-//       clock_gettime(CLOCK_REALTIME, &bench_start);
-
-//       for (size_t i = 0; i < kNumIters; i++) {
-//         // Modify the source
-//         for (size_t j = 0; j < write_sz / 64; j += 64) source[j]++;
-//         log.append_rotating(source, write_sz);
-//       }
-
-//       double bench_seconds = erpc::sec_since(bench_start);
-//       rotating_GBps = kNumIters * write_sz / (bench_seconds * GB(1));
-//     }
-
-//     printf("%zu %.2f %.2f\n", write_sz, naive_GBps, rotating_GBps);
-//   }
-
-//   printf("...done!\n");
-// }
+  // The position stored in each slot, or SIZE_MAX if the slot is empty. This
+  // is volatile, so a restarted server starts with an empty stripe.
+  std::vector<size_t> slot_pos;
+
+  size_t num_unsynced = 0; // Appends since the last sync
+};
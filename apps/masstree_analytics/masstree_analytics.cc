@@ -7,13 +7,19 @@
 void app_cont_func(void *, void *);  // Forward declaration
 
 static constexpr bool kAppVerbose = false;
+static constexpr size_t kAppKeyStride = 8192;  // Distance between key indices
 
 // Generate the key for this key index
 void key_gen(size_t index, uint8_t *key) {
   static_assert(MtIndex::kKeySize >= 2 * sizeof(uint64_t), "");
   auto *key_64 = reinterpret_cast<uint64_t *>(key);
   key_64[0] = 10;
-  key_64[1] = index * 8192;
+  key_64[1] = index * kAppKeyStride;
+}
+
+/// Return the index of a key generated by key_gen()
+size_t key_index(const uint8_t *key) {
+  return reinterpret_cast<const uint64_t *>(key)[1] / kAppKeyStride;
 }
 
 /// Return the pre-known quantity stored in each 32-bit chunk of the value for
@@ -65,45 +71,222 @@ void point_req_handler(erpc::ReqHandle *req_handle, void *_context) {
   c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
 }
 
-void range_req_handler(erpc::ReqHandle *req_handle, void *_context) {
+void multi_get_req_handler(erpc::ReqHandle *req_handle, void *_context) {
   auto *c = static_cast<AppContext *>(_context);
 
-  // Range request handler runs in a background thread
+  // Handler for multi-get requests runs in a foreground thread
   const size_t etid = c->rpc_->get_etid();
-  assert(etid < FLAGS_num_server_bg_threads);
+  assert(etid >= FLAGS_num_server_bg_threads &&
+         etid < FLAGS_num_server_bg_threads + FLAGS_num_server_fg_threads);
 
-  if (kAppVerbose) {
-    printf("main: Handling range request in eRPC thread %zu.\n", etid);
+  const auto *req_msgbuf = req_handle->get_req_msgbuf();
+  auto *req = reinterpret_cast<const wire_multi_get_req_t *>(req_msgbuf->buf_);
+  assert(req->req_type == kAppMultiGetReqType);
+  const size_t num_keys = req->num_keys;
+  assert(num_keys >= 1 && num_keys <= MtIndex::kMaxMultiGetKeys);
+  assert(req_msgbuf->get_data_size() ==
+         wire_multi_get_req_t::get_size(num_keys));
+
+  // Use the preallocated response if the results fit in one packet
+  const size_t resp_size = wire_multi_get_resp_t::get_size(num_keys);
+  erpc::MsgBuffer *resp_msgbuf = &req_handle->pre_resp_msgbuf_;
+  if (resp_size <= erpc::Rpc<erpc::CTransport>::get_max_data_per_pkt()) {
+    erpc::Rpc<erpc::CTransport>::resize_msg_buffer(resp_msgbuf, resp_size);
+  } else {
+    resp_msgbuf = &req_handle->dyn_resp_msgbuf_;
+    *resp_msgbuf = c->rpc_->alloc_msg_buffer_or_die(resp_size);
+  }
+
+  auto *resp = reinterpret_cast<wire_multi_get_resp_t *>(resp_msgbuf->buf_);
+  resp->num_keys = num_keys;
+
+  if (kBypassMasstree) {
+    // Send a garbage response
+    c->rpc_->enqueue_response(req_handle, resp_msgbuf);
+    return;
   }
 
   MtIndex *mti = c->server.mt_index;
   threadinfo_t *ti = c->server.ti_arr[etid];
   assert(mti != nullptr && ti != nullptr);
 
+  // mti->multi_get() modifies the keys
+  uint8_t key_copy_arr[MtIndex::kMaxMultiGetKeys][MtIndex::kKeySize];
+  uint8_t *key_ptr_arr[MtIndex::kMaxMultiGetKeys];
+  uint8_t *value_ptr_arr[MtIndex::kMaxMultiGetKeys];
+  bool found_arr[MtIndex::kMaxMultiGetKeys];
+  for (size_t i = 0; i < num_keys; i++) {
+    memcpy(key_copy_arr[i], req->key_arr[i], MtIndex::kKeySize);
+    key_ptr_arr[i] = key_copy_arr[i];
+    value_ptr_arr[i] = resp->result_arr[i].value;
+  }
+
+  mti->multi_get(key_ptr_arr, value_ptr_arr, found_arr, num_keys, ti);
+  for (size_t i = 0; i < num_keys; i++) {
+    resp->result_arr[i].resp_type =
+        found_arr[i] ? RespType::kFound : RespType::kNotFound;
+  }
+
+  c->rpc_->enqueue_response(req_handle, resp_msgbuf);
+}
+
+void snapshot_req_handler(erpc::ReqHandle *req_handle, void *_context) {
+  auto *c = static_cast<AppContext *>(_context);
+
+  const auto *req_msgbuf = req_handle->get_req_msgbuf();
+  assert(req_msgbuf->get_data_size() == sizeof(wire_snapshot_req_t));
+  auto *req = reinterpret_cast<const wire_snapshot_req_t *>(req_msgbuf->buf_);
+  assert(req->req_type == kAppSnapshotReqType);
+
+  const MtSnapshot *snapshot = c->server.snapshot;
+  const size_t file_size = snapshot == nullptr ? 0 : snapshot->get_size();
+  const size_t offset = std::min(req->offset, file_size);
+  const size_t num_bytes =
+      std::min(std::min(req->max_bytes, kAppSnapshotChunkSize),
+               file_size - offset);
+
+  erpc::MsgBuffer &resp_msgbuf = req_handle->dyn_resp_msgbuf_;
+  resp_msgbuf = c->rpc_->alloc_msg_buffer_or_die(
+      sizeof(wire_snapshot_resp_t) + num_bytes);
+
+  auto *resp = reinterpret_cast<wire_snapshot_resp_t *>(resp_msgbuf.buf_);
+  resp->file_size = file_size;
+  if (num_bytes > 0) memcpy(resp + 1, snapshot->get_buf() + offset, num_bytes);
+
+  c->rpc_->enqueue_response(req_handle, &resp_msgbuf);
+}
+
+// Send the response for a range request whose scan has completed
+void respond_range_scan(AppContext *c, RangeScanJob *job) {
+  auto *req_handle = static_cast<erpc::ReqHandle *>(job->owner);
+  const auto *req = reinterpret_cast<const wire_req_t *>(
+      req_handle->get_req_msgbuf()->buf_);
+
+  if (!job->collect_pairs) {
+    erpc::Rpc<erpc::CTransport>::resize_msg_buffer(
+        &req_handle->pre_resp_msgbuf_, sizeof(wire_resp_t));
+    auto *resp =
+        reinterpret_cast<wire_resp_t *>(req_handle->pre_resp_msgbuf_.buf_);
+    resp->resp_type = RespType::kFound;
+    resp->range_count = job->get_sum();
+
+    c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+    delete job;
+    return;
+  }
+
+  // Return a chunk with the scanned pairs, in key order
+  const size_t num_pairs = job->get_num_keys();
+  erpc::MsgBuffer &resp_msgbuf = req_handle->dyn_resp_msgbuf_;
+  resp_msgbuf = c->rpc_->alloc_msg_buffer_or_die(
+      wire_range_chunk_t::get_size(num_pairs));
+
+  auto *chunk = reinterpret_cast<wire_range_chunk_t *>(resp_msgbuf.buf_);
+  chunk->resp_type = RespType::kFound;
+  chunk->num_pairs = num_pairs;
+
+  size_t chunk_range = 0;  // Key indices covered by this chunk
+  kv_pair_t *pair_arr = chunk->get_pairs();
+  for (const RangeScanJob::Part &part : job->parts) {
+    memcpy(pair_arr, part.pairs.data(), part.num_keys * sizeof(kv_pair_t));
+    pair_arr += part.num_keys;
+    chunk_range += part.max_keys;
+  }
+
+  chunk->remaining = req->range_req.range - chunk_range;
+  memcpy(chunk->next_key, job->parts.back().end_key, MtIndex::kKeySize);
+
+  c->rpc_->enqueue_response(req_handle, &resp_msgbuf);
+  delete job;
+}
+
+void range_req_handler(erpc::ReqHandle *req_handle, void *_context) {
+  auto *c = static_cast<AppContext *>(_context);
+  RangeScanEngine *scan_engine = c->server.scan_engine;
+
+  // With a scan engine, the range request handler runs in a foreground thread
+  // and only partitions the scan. Otherwise it scans in a background thread,
+  // if there are any.
+  const size_t etid = c->rpc_->get_etid();
+  assert(scan_engine != nullptr || FLAGS_num_server_bg_threads == 0 ||
+         etid < FLAGS_num_server_bg_threads);
+
+  if (kAppVerbose) {
+    printf("main: Handling range request in eRPC thread %zu.\n", etid);
+  }
+
   const auto *req_msgbuf = req_handle->get_req_msgbuf();
   assert(req_msgbuf->get_data_size() == sizeof(wire_req_t));
 
   auto *req = reinterpret_cast<const wire_req_t *>(req_msgbuf->buf_);
   assert(req->req_type == kAppRangeReqType);
-  uint8_t key_copy[MtIndex::kKeySize];  // mti->sum_in_range() modifies key
-  memcpy(key_copy, req->point_req.key, MtIndex::kKeySize);
 
-  const size_t count = mti->sum_in_range(key_copy, req->range_req.range, ti);
+  // Split the key indices covered by this request (or by its first chunk)
+  // into partitions of at least scan_partition_keys keys
+  const size_t start_index = key_index(req->range_req.key);
+  size_t scan_range = req->range_req.range;
+  if (req->range_req.return_kv) {
+    scan_range = std::min(scan_range, kAppMaxRangeChunkPairs);
+  }
 
-  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_,
-                                                 sizeof(wire_resp_t));
-  auto *resp =
-      reinterpret_cast<wire_resp_t *>(req_handle->pre_resp_msgbuf_.buf_);
-  resp->resp_type = RespType::kFound;
-  resp->range_count = count;
+  size_t num_parts = 1;
+  if (scan_engine != nullptr) {
+    const size_t partition_keys = std::max(FLAGS_scan_partition_keys, 1ul);
+    num_parts = (scan_range + partition_keys - 1) / partition_keys;
+    num_parts = std::min(num_parts, FLAGS_num_server_scan_threads);
+    num_parts = std::max(num_parts, 1ul);
+  }
 
-  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+  auto *job = new RangeScanJob(num_parts, req->range_req.return_kv,
+                               static_cast<void *>(req_handle));
+  for (size_t i = 0; i < num_parts; i++) {
+    const size_t lo = start_index + i * scan_range / num_parts;
+    const size_t hi = start_index + (i + 1) * scan_range / num_parts;
+
+    RangeScanJob::Part &part = job->parts[i];
+    key_gen(lo, part.start_key);
+    key_gen(hi, part.end_key);
+    part.max_keys = hi - lo;
+  }
+
+  if (scan_engine != nullptr) {
+    // The response is sent when the foreground thread polls the completed job
+    scan_engine->submit(job, &c->server.scan_done_queue);
+    return;
+  }
+
+  MtIndex *mti = c->server.mt_index;
+  threadinfo_t *ti = c->server.ti_arr[etid];
+  assert(mti != nullptr && ti != nullptr);
+
+  RangeScanEngine::scan_part(mti, &job->parts[0], ti);
+  respond_range_scan(c, job);
+}
+
+// Send a multi-get request for random keys using this MsgBuffer
+void send_multi_get_req(AppContext *c, size_t msgbuf_idx) {
+  erpc::MsgBuffer &req_msgbuf = c->client.window_[msgbuf_idx].req_msgbuf_;
+  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(
+      &req_msgbuf, wire_multi_get_req_t::get_size(FLAGS_multi_get_keys));
+
+  auto *req = reinterpret_cast<wire_multi_get_req_t *>(req_msgbuf.buf_);
+  req->req_type = kAppMultiGetReqType;
+  req->num_keys = FLAGS_multi_get_keys;
+  for (size_t i = 0; i < FLAGS_multi_get_keys; i++) {
+    key_gen(c->fastrand_.next_u32() % FLAGS_num_keys, req->key_arr[i]);
+  }
+
+  c->client.window_[msgbuf_idx].req_ts_ = erpc::rdtsc();
+  c->rpc_->enqueue_request(0, kAppMultiGetReqType, &req_msgbuf,
+                           &c->client.window_[msgbuf_idx].resp_msgbuf_,
+                           app_cont_func, reinterpret_cast<void *>(msgbuf_idx));
 }
 
 // Send one request using this MsgBuffer
 void send_req(AppContext *c, size_t msgbuf_idx) {
   erpc::MsgBuffer &req_msgbuf = c->client.window_[msgbuf_idx].req_msgbuf_;
-  assert(req_msgbuf.get_data_size() == sizeof(wire_req_t));
+  erpc::Rpc<erpc::CTransport>::resize_msg_buffer(&req_msgbuf,
+                                                 sizeof(wire_req_t));
 
   // Generate a random request
   wire_req_t req;
@@ -114,6 +297,10 @@ void send_req(AppContext *c, size_t msgbuf_idx) {
     // Generate a range request
     req.req_type = kAppRangeReqType;
     req.range_req.range = FLAGS_range_size;
+    req.range_req.return_kv = FLAGS_range_return_kv;
+  } else if (FLAGS_multi_get_keys > 1) {
+    send_multi_get_req(c, msgbuf_idx);  // Batch point requests in a multi-get
+    return;
   } else {
     req.req_type = kAppPointReqType;  // Generate a point request
   }
@@ -133,6 +320,52 @@ void send_req(AppContext *c, size_t msgbuf_idx) {
                            app_cont_func, reinterpret_cast<void *>(msgbuf_idx));
 }
 
+// Request the next chunk of a range request that returns key-value pairs
+void send_range_continuation(AppContext *c, size_t msgbuf_idx,
+                             const wire_range_chunk_t *chunk) {
+  erpc::MsgBuffer &req_msgbuf = c->client.window_[msgbuf_idx].req_msgbuf_;
+  auto *req = reinterpret_cast<wire_req_t *>(req_msgbuf.buf_);
+  memcpy(req->range_req.key, chunk->next_key, MtIndex::kKeySize);
+  req->range_req.range = chunk->remaining;
+
+  c->rpc_->enqueue_request(0, kAppRangeReqType, &req_msgbuf,
+                           &c->client.window_[msgbuf_idx].resp_msgbuf_,
+                           app_cont_func, reinterpret_cast<void *>(msgbuf_idx));
+}
+
+// Check the values in a multi-get response
+void check_multi_get_resp(const wire_multi_get_req_t *req,
+                          const wire_multi_get_resp_t *resp) {
+  for (size_t i = 0; i < req->num_keys; i++) {
+    const auto seed = static_cast<uint32_t>(key_index(req->key_arr[i]));
+    const uint32_t recvd_value =
+        *reinterpret_cast<const uint32_t *>(resp->result_arr[i].value);
+    if (resp->result_arr[i].resp_type != RespType::kFound ||
+        recvd_value != get_value32_for_seed(seed)) {
+      fprintf(stderr,
+              "main: Multi-get value mismatch. Req seed = %u, recvd_value "
+              "(first four bytes = %u)\n",
+              seed, recvd_value);
+    }
+  }
+}
+
+// Check the values in a range response chunk
+void check_range_chunk(const wire_range_chunk_t *chunk) {
+  const kv_pair_t *pair_arr = chunk->get_pairs();
+  for (size_t i = 0; i < chunk->num_pairs; i++) {
+    const auto seed = static_cast<uint32_t>(key_index(pair_arr[i].key));
+    const uint32_t recvd_value =
+        *reinterpret_cast<const uint32_t *>(pair_arr[i].value);
+    if (recvd_value != get_value32_for_seed(seed)) {
+      fprintf(stderr,
+              "main: Range value mismatch. Key index = %u, recvd_value (first "
+              "four bytes = %u)\n",
+              seed, recvd_value);
+    }
+  }
+}
+
 void app_cont_func(void *_context, void *_msgbuf_idx) {
   auto *c = static_cast<AppContext *>(_context);
   const auto msgbuf_idx = reinterpret_cast<size_t>(_msgbuf_idx);
@@ -141,20 +374,46 @@ void app_cont_func(void *_context, void *_msgbuf_idx) {
   }
 
   const auto &resp_msgbuf = c->client.window_[msgbuf_idx].resp_msgbuf_;
-  erpc::rt_assert(resp_msgbuf.get_data_size() == sizeof(wire_resp_t),
-                  "Invalid response size");
+  const auto *req = reinterpret_cast<wire_req_t *>(
+      c->client.window_[msgbuf_idx].req_msgbuf_.buf_);
+  assert(req->req_type == kAppPointReqType ||
+         req->req_type == kAppRangeReqType ||
+         req->req_type == kAppMultiGetReqType);
+
+  if (req->req_type == kAppMultiGetReqType) {
+    const auto *mg_req = reinterpret_cast<const wire_multi_get_req_t *>(req);
+    erpc::rt_assert(resp_msgbuf.get_data_size() ==
+                        wire_multi_get_resp_t::get_size(mg_req->num_keys),
+                    "Invalid multi-get response size");
+    check_multi_get_resp(
+        mg_req,
+        reinterpret_cast<const wire_multi_get_resp_t *>(resp_msgbuf.buf_));
+  } else if (req->req_type == kAppRangeReqType && req->range_req.return_kv) {
+    const auto *chunk =
+        reinterpret_cast<const wire_range_chunk_t *>(resp_msgbuf.buf_);
+    erpc::rt_assert(resp_msgbuf.get_data_size() ==
+                        wire_range_chunk_t::get_size(chunk->num_pairs),
+                    "Invalid range chunk size");
+    check_range_chunk(chunk);
+
+    if (chunk->remaining > 0) {
+      send_range_continuation(c, msgbuf_idx, chunk);
+      return;  // Latency is measured until the last chunk
+    }
+  } else {
+    erpc::rt_assert(resp_msgbuf.get_data_size() == sizeof(wire_resp_t),
+                    "Invalid response size");
+  }
 
   const double usec =
       erpc::to_usec(erpc::rdtsc() - c->client.window_[msgbuf_idx].req_ts_,
                     c->rpc_->get_freq_ghz());
   assert(usec >= 0);
 
-  const auto *req = reinterpret_cast<wire_req_t *>(
-      c->client.window_[msgbuf_idx].req_msgbuf_.buf_);
-  assert(req->req_type == kAppPointReqType ||
-         req->req_type == kAppRangeReqType);
-
-  if (req->req_type == kAppPointReqType) {
+  if (req->req_type == kAppMultiGetReqType) {
+    // Multi-gets replace point requests, so they share the latency stats
+    c->client.point_latency.update(static_cast<size_t>(usec * 10.0));
+  } else if (req->req_type == kAppPointReqType) {
     c->client.point_latency.update(static_cast<size_t>(usec * 10.0));  // < 1us
 
     // Check the value
@@ -178,6 +437,62 @@ void app_cont_func(void *_context, void *_msgbuf_idx) {
   send_req(c, msgbuf_idx);
 }
 
+void snapshot_cont_func(void *_context, void *) {
+  static_cast<AppContext *>(_context)->client.snapshot_resp_rcvd = true;
+}
+
+/// Fetch the server's snapshot file over eRPC, one chunk at a time. Another
+/// server can then start from the fetched file with --snapshot_restore.
+void fetch_snapshot(AppContext *c, const std::string &path) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  erpc::rt_assert(fd >= 0, "open() failed for " + path);
+
+  erpc::MsgBuffer req_msgbuf =
+      c->rpc_->alloc_msg_buffer_or_die(sizeof(wire_snapshot_req_t));
+  erpc::MsgBuffer resp_msgbuf = c->rpc_->alloc_msg_buffer_or_die(
+      sizeof(wire_snapshot_resp_t) + kAppSnapshotChunkSize);
+
+  erpc::ChronoTimer timer;
+  size_t offset = 0, file_size = SIZE_MAX;
+  while (offset < file_size) {
+    auto *req = reinterpret_cast<wire_snapshot_req_t *>(req_msgbuf.buf_);
+    req->req_type = kAppSnapshotReqType;
+    req->offset = offset;
+    req->max_bytes = kAppSnapshotChunkSize;
+
+    c->client.snapshot_resp_rcvd = false;
+    c->rpc_->enqueue_request(0, kAppSnapshotReqType, &req_msgbuf,
+                             &resp_msgbuf, snapshot_cont_func, nullptr);
+    while (!c->client.snapshot_resp_rcvd) {
+      c->rpc_->run_event_loop_once();
+      if (ctrl_c_pressed == 1) break;
+    }
+    if (!c->client.snapshot_resp_rcvd) break;
+
+    const auto *resp =
+        reinterpret_cast<const wire_snapshot_resp_t *>(resp_msgbuf.buf_);
+    const size_t num_bytes =
+        resp_msgbuf.get_data_size() - sizeof(wire_snapshot_resp_t);
+    file_size = resp->file_size;
+    erpc::rt_assert(file_size > 0, "Server has no snapshot");
+    erpc::rt_assert(num_bytes > 0 || offset == file_size, "Empty chunk");
+
+    const ssize_t ret =
+        pwrite(fd, resp + 1, num_bytes, static_cast<off_t>(offset));
+    erpc::rt_assert(ret == static_cast<ssize_t>(num_bytes), "pwrite() failed");
+    offset += num_bytes;
+  }
+
+  erpc::rt_assert(fsync(fd) == 0, "fsync() failed for " + path);
+  close(fd);
+  c->rpc_->free_msg_buffer(req_msgbuf);
+  c->rpc_->free_msg_buffer(resp_msgbuf);
+
+  const double seconds = timer.get_us() / 1e6;
+  printf("main: Fetched %zu bytes of snapshot to %s. %.2f GB/s.\n", offset,
+         path.c_str(), offset / (seconds * GB(1)));
+}
+
 void client_print_stats(AppContext &c) {
   const double seconds = c.client.tput_timer.get_us() / 1e6;
   const double tput_mrps = c.client.num_resps_tot / (seconds * 1000000);
@@ -250,6 +565,10 @@ void client_thread_func(size_t thread_id, app_stats_t *app_stats,
   fprintf(stderr, "main: Thread %zu: Connected. Sending requests.\n",
           thread_id);
 
+  if (thread_id == 0 && !FLAGS_snapshot_fetch_file.empty()) {
+    fetch_snapshot(&c, FLAGS_snapshot_fetch_file);
+  }
+
   alloc_req_resp_msg_buffers(&c);
   c.client.tput_timer.reset();
   for (size_t i = 0; i < FLAGS_req_window; i++) send_req(&c, i);
@@ -262,11 +581,14 @@ void client_thread_func(size_t thread_id, app_stats_t *app_stats,
 }
 
 void server_thread_func(size_t thread_id, erpc::Nexus *nexus, MtIndex *mti,
-                        threadinfo_t **ti_arr) {
+                        threadinfo_t **ti_arr, RangeScanEngine *scan_engine,
+                        const MtSnapshot *snapshot) {
   AppContext c;
   c.thread_id_ = thread_id;
   c.server.mt_index = mti;
   c.server.ti_arr = ti_arr;
+  c.server.scan_engine = scan_engine;
+  c.server.snapshot = snapshot;
 
   std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
   erpc::rt_assert(port_vec.size() > 0);
@@ -276,7 +598,19 @@ void server_thread_func(size_t thread_id, erpc::Nexus *nexus, MtIndex *mti,
                                   static_cast<uint8_t>(thread_id),
                                   basic_sm_handler, phy_port);
   c.rpc_ = &rpc;
-  while (ctrl_c_pressed == 0) rpc.run_event_loop(200);
+
+  if (c.server.scan_engine == nullptr) {
+    while (ctrl_c_pressed == 0) rpc.run_event_loop(200);
+    return;
+  }
+
+  // Respond to range requests whose parallel scans have completed
+  while (ctrl_c_pressed == 0) {
+    rpc.run_event_loop_once();
+    while (c.server.scan_done_queue.size_ > 0) {
+      respond_range_scan(&c, c.server.scan_done_queue.unlocked_pop());
+    }
+  }
 }
 
 /**
@@ -345,8 +679,11 @@ int main(int argc, char **argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
   erpc::rt_assert(FLAGS_req_window <= kAppMaxReqWindow, "Invalid req window");
   erpc::rt_assert(FLAGS_range_req_percent <= 100, "Invalid range req percent");
+  erpc::rt_assert(FLAGS_multi_get_keys >= 1 &&
+                      FLAGS_multi_get_keys <= MtIndex::kMaxMultiGetKeys,
+                  "Invalid multi-get keys");
 
-  if (FLAGS_num_server_bg_threads == 0) {
+  if (FLAGS_num_server_bg_threads == 0 && FLAGS_num_server_scan_threads == 0) {
     printf(
         "main: Warning: No background threads. "
         "Range queries will run in foreground.\n");
@@ -368,8 +705,16 @@ int main(int argc, char **argv) {
       ti_arr[i] = threadinfo::make(threadinfo::TI_PROCESS, i);
     }
 
-    // Populate the tree in parallel to reduce initialization time
-    {
+    // Restore the tree from a snapshot, or populate it in parallel to reduce
+    // initialization time
+    MtSnapshot snapshot;
+    if (FLAGS_snapshot_restore) {
+      erpc::rt_assert(snapshot.map(FLAGS_snapshot_file),
+                      "No valid snapshot in " + FLAGS_snapshot_file);
+      printf("main: Restoring %zu keys from snapshot using %zu threads\n",
+             snapshot.get_num_pairs(), FLAGS_num_population_threads);
+      snapshot.restore(&mti, ti_arr, FLAGS_num_population_threads);
+    } else {
       printf("main: Populating masstree with %zu keys from %zu cores\n",
              FLAGS_num_keys, FLAGS_num_population_threads);
 
@@ -397,6 +742,22 @@ int main(int argc, char **argv) {
       }
       for (size_t i = 0; i < FLAGS_num_population_threads; i++)
         populate_thread_arr[i].join();
+
+      if (!FLAGS_snapshot_file.empty()) {
+        printf("main: Writing snapshot to %s\n", FLAGS_snapshot_file.c_str());
+
+        // One partition per population thread
+        const size_t num_parts = FLAGS_num_population_threads;
+        std::vector<std::vector<uint8_t>> bound_key_arr(
+            num_parts + 1, std::vector<uint8_t>(MtIndex::kKeySize));
+        for (size_t i = 0; i <= num_parts; i++) {
+          key_gen(i * FLAGS_num_keys / num_parts, bound_key_arr[i].data());
+        }
+
+        MtSnapshot::write(&mti, ti_arr, bound_key_arr, FLAGS_snapshot_file);
+        erpc::rt_assert(snapshot.map(FLAGS_snapshot_file),
+                        "Failed to map written snapshot");
+      }
     }
 
     // eRPC stuff
@@ -405,21 +766,46 @@ int main(int argc, char **argv) {
 
     nexus.register_req_func(kAppPointReqType, point_req_handler,
                             erpc::ReqFuncType::kForeground);
+    nexus.register_req_func(kAppMultiGetReqType, multi_get_req_handler,
+                            erpc::ReqFuncType::kForeground);
+
+    // Copying snapshot chunks is slow, so keep it off foreground threads
+    nexus.register_req_func(kAppSnapshotReqType, snapshot_req_handler,
+                            FLAGS_num_server_bg_threads > 0
+                                ? erpc::ReqFuncType::kBackground
+                                : erpc::ReqFuncType::kForeground);
+
+    // With parallel range scans, the foreground handler only dispatches scans
+    // to the scan threads, so point requests aren't stalled
+    RangeScanEngine *scan_engine = nullptr;
+    if (FLAGS_num_server_scan_threads > 0) {
+      const size_t num_erpc_threads =
+          FLAGS_num_server_bg_threads + FLAGS_num_server_fg_threads;
+      erpc::rt_assert(
+          num_erpc_threads + FLAGS_num_server_scan_threads <= num_cores,
+          "Too many scan threads");
+      scan_engine = new RangeScanEngine(
+          &mti, &ti_arr[num_erpc_threads], FLAGS_num_server_scan_threads,
+          FLAGS_numa_node, FLAGS_num_server_fg_threads);
+    }
 
-    auto range_handler_type = FLAGS_num_server_bg_threads > 0
-                                  ? erpc::ReqFuncType::kBackground
-                                  : erpc::ReqFuncType::kForeground;
+    auto range_handler_type =
+        FLAGS_num_server_bg_threads > 0 && scan_engine == nullptr
+            ? erpc::ReqFuncType::kBackground
+            : erpc::ReqFuncType::kForeground;
     nexus.register_req_func(kAppRangeReqType, range_req_handler,
                             range_handler_type);
 
     std::vector<std::thread> thread_arr(FLAGS_num_server_fg_threads);
     for (size_t i = 0; i < FLAGS_num_server_fg_threads; i++) {
       thread_arr[i] = std::thread(server_thread_func, i, &nexus, &mti,
-                                  static_cast<threadinfo_t **>(ti_arr));
+                                  static_cast<threadinfo_t **>(ti_arr),
+                                  scan_engine, &snapshot);
       erpc::bind_to_core(thread_arr[i], FLAGS_numa_node, i);
     }
 
     for (auto &thread : thread_arr) thread.join();
+    delete scan_engine;
     delete[] ti_arr;
   } else {
     erpc::rt_assert(FLAGS_process_id > 0, "Invalid process ID");
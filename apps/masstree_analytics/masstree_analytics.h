@@ -5,15 +5,26 @@
 #include <signal.h>
 #include "../apps_common.h"
 #include "mt_index_api.h"
+#include "range_scan.h"
 #include "rpc.h"
+#include "snapshot.h"
 #include "util/latency.h"
 #include "util/numautils.h"
 #include "util/timer.h"
 
 static constexpr size_t kAppPointReqType = 1;
 static constexpr size_t kAppRangeReqType = 2;
+static constexpr size_t kAppMultiGetReqType = 3;
+static constexpr size_t kAppSnapshotReqType = 4;
 static constexpr size_t kAppEvLoopMs = 500;
 
+// Max key-value pairs per range response chunk. Longer ranges are streamed
+// back as multiple chunks.
+static constexpr size_t kAppMaxRangeChunkPairs = 1024;
+
+// Max bytes of the server's snapshot file per snapshot response
+static constexpr size_t kAppSnapshotChunkSize = MB(1);
+
 // Workload params
 static constexpr bool kBypassMasstree = false;  // Bypass Masstree?
 static constexpr size_t kAppMaxReqWindow = 16;  // Max pending reqs per client
@@ -32,6 +43,15 @@ DEFINE_uint64(req_window, 0, "Outstanding requests per client thread");
 DEFINE_uint64(num_keys, 0, "Number of keys in the server's Masstree");
 DEFINE_uint64(range_size, 0, "Size of range to scan");
 DEFINE_uint64(range_req_percent, 0, "Percentage of range scans");
+DEFINE_uint64(num_server_scan_threads, 0,
+              "Number of server threads for parallel range scans");
+DEFINE_uint64(scan_partition_keys, 0, "Min keys per range scan partition");
+DEFINE_bool(range_return_kv, false, "Return key-value pairs for range scans");
+DEFINE_uint64(multi_get_keys, 1, "Keys per point request. >1 uses multi-gets.");
+DEFINE_string(snapshot_file, "", "Server's Masstree snapshot file");
+DEFINE_bool(snapshot_restore, false, "Restore the server from snapshot_file");
+DEFINE_string(snapshot_fetch_file, "",
+              "If set, a client fetches the server's snapshot to this file");
 
 // Return true iff this machine is the one server
 bool is_server() { return FLAGS_process_id == 0; }
@@ -45,7 +65,8 @@ struct wire_req_t {
 
     struct {
       uint8_t key[MtIndex::kKeySize];
-      size_t range;  // The max number of keys after key to sum up
+      size_t range;    // The max number of keys after key to sum up
+      bool return_kv;  // Return the key-value pairs instead of the sum
     } range_req;
   };
 
@@ -90,6 +111,64 @@ struct wire_resp_t {
   }
 };
 
+/// A multi-get request for num_keys keys. Only the first num_keys keys are
+/// sent.
+struct wire_multi_get_req_t {
+  size_t req_type;  // kAppMultiGetReqType. Must be first, as in wire_req_t.
+  size_t num_keys;
+  uint8_t key_arr[MtIndex::kMaxMultiGetKeys][MtIndex::kKeySize];
+
+  static size_t get_size(size_t num_keys) {
+    return offsetof(wire_multi_get_req_t, key_arr) +
+           num_keys * MtIndex::kKeySize;
+  }
+};
+
+/// The response to a multi-get request, with one result per requested key
+struct wire_multi_get_resp_t {
+  size_t num_keys;
+  struct {
+    RespType resp_type;
+    uint8_t value[MtIndex::kValueSize];
+  } result_arr[MtIndex::kMaxMultiGetKeys];
+
+  static size_t get_size(size_t num_keys) {
+    return offsetof(wire_multi_get_resp_t, result_arr) +
+           num_keys * sizeof(result_arr[0]);
+  }
+};
+
+/// A request for up to max_bytes bytes of the server's snapshot file, starting
+/// at offset. The response is a wire_snapshot_resp_t followed by the bytes.
+struct wire_snapshot_req_t {
+  size_t req_type;  // kAppSnapshotReqType. Must be first, as in wire_req_t.
+  size_t offset;
+  size_t max_bytes;
+};
+
+struct wire_snapshot_resp_t {
+  size_t file_size;  // Size of the snapshot file, or zero if there is none
+};
+
+/// A response chunk for range requests with return_kv set. The chunk's
+/// key-value pairs follow this header. If more keys remain in the range, the
+/// client requests them with a new range request starting at next_key.
+struct wire_range_chunk_t {
+  RespType resp_type;
+  size_t num_pairs;  // Number of key-value pairs in this chunk
+  size_t remaining;  // Number of keys in the range after this chunk
+  uint8_t next_key[MtIndex::kKeySize];
+
+  static size_t get_size(size_t num_pairs) {
+    return sizeof(wire_range_chunk_t) + num_pairs * sizeof(kv_pair_t);
+  }
+
+  kv_pair_t *get_pairs() { return reinterpret_cast<kv_pair_t *>(this + 1); }
+  const kv_pair_t *get_pairs() const {
+    return reinterpret_cast<const kv_pair_t *>(this + 1);
+  }
+};
+
 struct app_stats_t {
   double mrps;       // Point request rate
   double lat_us_50;  // Point request median latency
@@ -125,6 +204,10 @@ class AppContext : public BasicAppContext {
   struct {
     MtIndex *mt_index = nullptr;      // The shared Masstree index
     threadinfo_t **ti_arr = nullptr;  // Thread info array, indexed by eRPC TID
+
+    RangeScanEngine *scan_engine = nullptr;  // Parallel range scan workers
+    erpc::MtQueue<RangeScanJob *> scan_done_queue;  // Completed scan jobs
+    const MtSnapshot *snapshot = nullptr;  // The mapped snapshot, if any
   } server;
 
   struct {
@@ -143,17 +226,31 @@ class AppContext : public BasicAppContext {
 
     erpc::FastRand fast_rand;
     size_t num_resps_tot = 0;  // Total responses received (range & point reqs)
+    bool snapshot_resp_rcvd = false;  // Set by the snapshot continuation
   } client;
 };
 
 // Allocate request and response MsgBuffers
 void alloc_req_resp_msg_buffers(AppContext *c) {
+  size_t max_req_size = sizeof(wire_req_t);
+  size_t max_resp_size = sizeof(wire_resp_t);
+  if (FLAGS_range_return_kv) {
+    max_resp_size = std::max(
+        max_resp_size, wire_range_chunk_t::get_size(kAppMaxRangeChunkPairs));
+  }
+  if (FLAGS_multi_get_keys > 1) {
+    max_req_size = std::max(
+        max_req_size, wire_multi_get_req_t::get_size(FLAGS_multi_get_keys));
+    max_resp_size = std::max(
+        max_resp_size, wire_multi_get_resp_t::get_size(FLAGS_multi_get_keys));
+  }
+
   for (size_t msgbuf_idx = 0; msgbuf_idx < FLAGS_req_window; msgbuf_idx++) {
     c->client.window_[msgbuf_idx].req_msgbuf_ =
-        c->rpc_->alloc_msg_buffer_or_die(sizeof(wire_req_t));
+        c->rpc_->alloc_msg_buffer_or_die(max_req_size);
 
     c->client.window_[msgbuf_idx].resp_msgbuf_ =
-        c->rpc_->alloc_msg_buffer_or_die(sizeof(wire_resp_t));
+        c->rpc_->alloc_msg_buffer_or_die(max_resp_size);
   }
 }
 
@@ -24,6 +24,9 @@ class MtIndex {
   static constexpr size_t kValueSize = 68;  /// Index value size in bytes
   static_assert(sizeof(MtIndex::kValueSize) % sizeof(uint32_t) == 0, "");
 
+  static constexpr size_t kMaxMultiGetKeys = 16;  /// Max keys per multi_get()
+  static constexpr size_t kMaxPrefetchSteps = 32;  /// Max nodes per key
+
   MtIndex() {}
   ~MtIndex() {}
 
@@ -32,7 +35,7 @@ class MtIndex {
     table_->initialize(*ti);
   }
 
-  inline void swap_endian(uint8_t *key) {
+  static inline void swap_endian(uint8_t *key) {
     auto *key_64 = reinterpret_cast<uint64_t *>(key);
     for (size_t i = 0; i < kKeySize / sizeof(uint64_t); i++) {
       key_64[i] = __bswap_64(key_64[i]);
@@ -72,38 +75,166 @@ class MtIndex {
     return found;
   }
 
-  // An object with callbacks passed to table.scan()
+  /// Get the values for \p num_keys keys, and fill in \p found_arr. Return the
+  /// number of keys found.
+  ///
+  /// The lookups are interleaved so that their cache misses overlap. First,
+  /// all keys descend the tree in lockstep, one node per key per step, and
+  /// each step prefetches the keys' next nodes. This descent is unsynchronized
+  /// and only warms the cache. The validated lookups then run over the cached
+  /// paths, and the values are copied after all of their prefetches issue.
+  ///
+  /// This modifies the keys.
+  size_t multi_get(uint8_t **key_arr, uint8_t **value_arr, bool *found_arr,
+                   size_t num_keys, threadinfo_t *ti) {
+    assert(num_keys <= kMaxMultiGetKeys);
+
+    for (size_t i = 0; i < num_keys; i++) swap_endian(key_arr[i]);
+    prefetch_descend(key_arr, num_keys);
+
+    const row_type *row_arr[kMaxMultiGetKeys];
+    for (size_t i = 0; i < num_keys; i++) {
+      Str key_str(reinterpret_cast<const char *>(key_arr[i]), kKeySize);
+      Masstree::default_table::unlocked_cursor_type lp(table_->table(),
+                                                       key_str);
+      found_arr[i] = lp.find_unlocked(*ti);  // This prefetches the value
+      row_arr[i] = found_arr[i] ? lp.value() : nullptr;
+    }
+
+    size_t num_found = 0;
+    for (size_t i = 0; i < num_keys; i++) {
+      if (!found_arr[i]) continue;
+      memcpy(value_arr[i], row_arr[i]->col(0).s, kValueSize);
+      num_found++;
+    }
+
+    return num_found;
+  }
+
+  // An object with callbacks passed to table.scan(). Calls visit(key, value)
+  // for up to range keys before end_key (big-endian, or nullptr to scan
+  // without an upper bound).
+  template <typename Visitor>
   struct scanner_t {
-    scanner_t(size_t range) : range_(range), range_sum_(0) {}
+    scanner_t(size_t range, const uint8_t *end_key, Visitor &visit)
+        : range_(range), end_key_(end_key), visit_(visit) {}
 
     template <typename SS2, typename K2>
     void visit_leaf(const SS2 &, const K2 &, threadinfo_t &) {}
 
-    bool visit_value(Str, const row_type *row, threadinfo_t &) {
-      const size_t value = *reinterpret_cast<const size_t *>(row->col(0).s);
-      range_sum_ += value;
+    bool visit_value(Str key, const row_type *row, threadinfo_t &) {
+      if (end_key_ != nullptr && memcmp(key.s, end_key_, kKeySize) >= 0) {
+        return false;
+      }
+
+      visit_(reinterpret_cast<const uint8_t *>(key.s),
+             reinterpret_cast<const uint8_t *>(row->col(0).s));
+      num_visited_++;
       range_--;
       return range_ > 0;
     }
 
     size_t range_;
-    size_t range_sum_;
+    const uint8_t *end_key_;
+    Visitor &visit_;
+    size_t num_visited_ = 0;
   };
 
-  /// Return the sum of the values (first eight bytes per value) of \p range
-  /// keys including and after \p cur_key
-  size_t sum_in_range(uint8_t *cur_key, size_t range, threadinfo_t *ti) {
+  /// Call visit(key, value) for up to \p range keys including and after \p
+  /// cur_key, and strictly before \p end_key if it's non-null. The key passed
+  /// to visit() is big-endian. Return the number of keys visited.
+  ///
+  /// This modifies both cur_key and end_key.
+  template <typename Visitor>
+  size_t scan(uint8_t *cur_key, uint8_t *end_key, size_t range,
+              Visitor &&visit, threadinfo_t *ti) {
     if (range == 0) return 0;
 
     swap_endian(cur_key);
-    Str cur_key_str(reinterpret_cast<const char *>(&cur_key), sizeof(size_t));
+    if (end_key != nullptr) swap_endian(end_key);
+    Str cur_key_str(reinterpret_cast<const char *>(cur_key), kKeySize);
 
-    scanner_t scanner(range);
+    scanner_t<Visitor> scanner(range, end_key, visit);
     table_->table().scan(cur_key_str, true, scanner, *ti);
-    return scanner.range_sum_;
+    return scanner.num_visited_;
+  }
+
+  /// Return the sum of the values (first eight bytes per value) of \p range
+  /// keys including and after \p cur_key
+  size_t sum_in_range(uint8_t *cur_key, size_t range, threadinfo_t *ti) {
+    size_t range_sum = 0;
+    scan(cur_key, nullptr, range,
+         [&range_sum](const uint8_t *, const uint8_t *value) {
+           range_sum += *reinterpret_cast<const size_t *>(value);
+         },
+         ti);
+    return range_sum;
   }
 
  private:
+  typedef Masstree::default_table::parameters_type mt_params_t;
+  typedef Masstree::node_base<mt_params_t> mt_node_t;
+  typedef Masstree::internode<mt_params_t> mt_internode_t;
+  typedef Masstree::leaf<mt_params_t> mt_leaf_t;
+
+  /// Walk the tree for the big-endian keys in \p key_arr in lockstep, and
+  /// prefetch the nodes on their paths. Concurrent writers can make the walk
+  /// end early or stray, which affects only what's prefetched.
+  void prefetch_descend(uint8_t **key_arr, size_t num_keys) const {
+    mt_internode_t::key_type ka_arr[kMaxMultiGetKeys];
+    const mt_node_t *node_arr[kMaxMultiGetKeys];
+    for (size_t i = 0; i < num_keys; i++) {
+      ka_arr[i] = mt_internode_t::key_type(
+          Str(reinterpret_cast<const char *>(key_arr[i]), kKeySize));
+      node_arr[i] = table_->table().root();
+    }
+
+    size_t num_active = num_keys;
+    for (size_t step = 0; step < kMaxPrefetchSteps && num_active > 0; step++) {
+      num_active = 0;
+      for (size_t i = 0; i < num_keys; i++) {
+        if (node_arr[i] == nullptr) continue;
+        node_arr[i] = prefetch_next_node(node_arr[i], ka_arr[i]);
+        if (node_arr[i] != nullptr) num_active++;
+      }
+    }
+  }
+
+  /// Return the node after \p n on \p ka's path after prefetching it, or
+  /// nullptr if the path ends at n
+  static const mt_node_t *prefetch_next_node(const mt_node_t *n,
+                                             mt_internode_t::key_type &ka) {
+    const mt_node_t *next = nullptr;
+
+    if (!n->isleaf()) {
+      auto *in = static_cast<const mt_internode_t *>(n);
+      next = in->child_[mt_internode_t::bound_type::upper(ka, *in)];
+    } else {
+      // Find ka's slice in the leaf. If it points to the next trie layer,
+      // continue at the layer's root. Otherwise prefetch the value.
+      auto *leaf = static_cast<const mt_leaf_t *>(n);
+      const mt_leaf_t::permuter_type perm = leaf->permutation();
+      for (int i = 0; i < perm.size(); i++) {
+        const int p = perm[i];
+        if (leaf->ikey0_[p] != ka.ikey()) continue;
+
+        if (leaf->is_layer(p) && ka.has_suffix()) {
+          ka.shift();
+          next = leaf->lv_[p].layer();
+          while (next != nullptr && !next->is_root()) {
+            next = next->maybe_parent();
+          }
+        } else {
+          leaf->lv_[p].prefetch(leaf->keylenx_[p]);
+        }
+        break;
+      }
+    }
+
+    if (next != nullptr) next->prefetch_full();
+    return next;
+  }
+
   Masstree::default_table *table_;
   query<row_type> q_[1];
   loginfo::query_times qtimes_;
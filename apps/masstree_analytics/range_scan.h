@@ -0,0 +1,155 @@
+#ifndef RANGE_SCAN_H
+#define RANGE_SCAN_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "mt_index_api.h"
+#include "util/mt_queue.h"
+#include "util/numautils.h"
+
+/// A key-value pair returned by a range scan. Keys are in host byte order.
+struct kv_pair_t {
+  uint8_t key[MtIndex::kKeySize];
+  uint8_t value[MtIndex::kValueSize];
+};
+
+/// A range scan split into parts by key-space partition. Parts are scanned in
+/// parallel by the workers of a RangeScanEngine, and the job is pushed to the
+/// submitter's done queue when its last part completes.
+class RangeScanJob {
+ public:
+  /// One partition of the scanned key space: Up to max_keys keys including
+  /// and after start_key, and strictly before end_key
+  struct Part {
+    RangeScanJob *job;
+    uint8_t start_key[MtIndex::kKeySize];
+    uint8_t end_key[MtIndex::kKeySize];
+    size_t max_keys;
+
+    // Partial results
+    size_t num_keys = 0;           // Number of keys scanned
+    size_t sum = 0;                // Sum of the first eight bytes of values
+    std::vector<kv_pair_t> pairs;  // Scanned pairs, if job->collect_pairs
+  };
+
+  RangeScanJob(size_t num_parts, bool collect_pairs, void *owner)
+      : parts(num_parts), collect_pairs(collect_pairs), owner(owner) {
+    for (Part &part : parts) part.job = this;
+  }
+
+  /// Return the sum over all parts. Valid after the job completes.
+  size_t get_sum() const {
+    size_t sum = 0;
+    for (const Part &part : parts) sum += part.sum;
+    return sum;
+  }
+
+  /// Return the number of keys scanned by all parts. Valid after the job
+  /// completes.
+  size_t get_num_keys() const {
+    size_t num_keys = 0;
+    for (const Part &part : parts) num_keys += part.num_keys;
+    return num_keys;
+  }
+
+  std::vector<Part> parts;   // Parts are in key order
+  const bool collect_pairs;  // Return the scanned pairs, not just the sum
+  void *owner;               // Opaque submitter state, e.g., the ReqHandle
+  std::atomic<size_t> num_parts_pending;
+  erpc::MtQueue<RangeScanJob *> *done_queue = nullptr;
+};
+
+/// A pool of worker threads that scan the parts of RangeScanJobs. Jobs can be
+/// submitted from multiple threads. Each worker has its own queue, so that
+/// every queue has one consumer.
+class RangeScanEngine {
+ public:
+  /**
+   * @brief Launch the scan workers
+   *
+   * @param mti The Masstree index
+   * @param ti_arr Masstree threadinfo for each worker
+   * @param num_workers Number of worker threads
+   * @param numa_node The NUMA node to run the workers on
+   * @param first_core NUMA-local index of the first core for the workers
+   */
+  RangeScanEngine(MtIndex *mti, threadinfo_t **ti_arr, size_t num_workers,
+                  size_t numa_node, size_t first_core)
+      : mti_(mti),
+        ti_arr_(ti_arr),
+        num_workers_(num_workers),
+        queue_arr_(new erpc::MtQueue<RangeScanJob::Part *>[num_workers]) {
+    erpc::rt_assert(num_workers > 0, "Range scan engine needs workers");
+    for (size_t i = 0; i < num_workers; i++) {
+      thread_arr_.emplace_back(&RangeScanEngine::worker_func, this, i);
+      erpc::bind_to_core(thread_arr_[i], numa_node, first_core + i);
+    }
+  }
+
+  ~RangeScanEngine() {
+    stop_ = true;
+    for (auto &thread : thread_arr_) thread.join();
+    delete[] queue_arr_;
+  }
+
+  /// Scan all parts of \p job in parallel. When the job completes, it's pushed
+  /// to \p done_queue.
+  void submit(RangeScanJob *job, erpc::MtQueue<RangeScanJob *> *done_queue) {
+    job->done_queue = done_queue;
+    job->num_parts_pending = job->parts.size();
+    for (RangeScanJob::Part &part : job->parts) {
+      const size_t worker_i = next_worker_++ % num_workers_;
+      queue_arr_[worker_i].unlocked_push(&part);
+    }
+  }
+
+  /// Scan one part of a job in the caller's thread
+  static void scan_part(MtIndex *mti, RangeScanJob::Part *part,
+                        threadinfo_t *ti) {
+    // mti->scan() modifies the keys
+    uint8_t start_key[MtIndex::kKeySize], end_key[MtIndex::kKeySize];
+    memcpy(start_key, part->start_key, MtIndex::kKeySize);
+    memcpy(end_key, part->end_key, MtIndex::kKeySize);
+
+    if (part->job->collect_pairs) part->pairs.reserve(part->max_keys);
+
+    part->num_keys = mti->scan(
+        start_key, end_key, part->max_keys,
+        [part](const uint8_t *key, const uint8_t *value) {
+          part->sum += *reinterpret_cast<const size_t *>(value);
+          if (!part->job->collect_pairs) return;
+
+          part->pairs.emplace_back();
+          kv_pair_t &pair = part->pairs.back();
+          memcpy(pair.key, key, MtIndex::kKeySize);
+          MtIndex::swap_endian(pair.key);
+          memcpy(pair.value, value, MtIndex::kValueSize);
+        },
+        ti);
+  }
+
+ private:
+  void worker_func(size_t worker_i) {
+    erpc::MtQueue<RangeScanJob::Part *> &queue = queue_arr_[worker_i];
+    while (!stop_) {
+      if (queue.size_ == 0) continue;
+
+      RangeScanJob::Part *part = queue.unlocked_pop();
+      RangeScanJob *job = part->job;
+      scan_part(mti_, part, ti_arr_[worker_i]);
+      if (--job->num_parts_pending == 0) job->done_queue->unlocked_push(job);
+    }
+  }
+
+  MtIndex *mti_;
+  threadinfo_t **ti_arr_;
+  const size_t num_workers_;
+  erpc::MtQueue<RangeScanJob::Part *> *queue_arr_;  // One queue per worker
+  std::vector<std::thread> thread_arr_;
+  std::atomic<size_t> next_worker_{0};
+  volatile bool stop_ = false;
+};
+
+#endif  // RANGE_SCAN_H
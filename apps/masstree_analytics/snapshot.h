@@ -0,0 +1,202 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "mt_index_api.h"
+#include "range_scan.h"
+
+/// A memory-mappable snapshot of an MtIndex: a header followed by all
+/// key-value pairs in key order. Snapshots are written and restored in
+/// parallel, with one thread per key-space partition.
+///
+/// The snapshot is consistent if the index has no concurrent writers, as in
+/// masstree_analytics where the index is read-only after population. Masstree
+/// rows own their values, so restoring bulk-loads the pairs in key order
+/// instead of pointing the index into the mapping.
+class MtSnapshot {
+ public:
+  static constexpr uint64_t kMagic = 0x4d54534e41505348;  // "MTSNAPSH"
+
+  struct hdr_t {
+    uint64_t magic;  // Written last, so partial snapshots are invalid
+    uint64_t key_size;
+    uint64_t value_size;
+    uint64_t num_pairs;
+  };
+
+  ~MtSnapshot() { unmap(); }
+
+  /**
+   * @brief Write a snapshot of an index to a file
+   *
+   * @param mti The index
+   * @param ti_arr Masstree threadinfo for each writer thread
+   * @param bound_key_arr Partition i covers keys from bound_key_arr[i]
+   * (inclusive) to bound_key_arr[i + 1] (exclusive). The partitions must
+   * cover all keys in the index. One thread is used per partition.
+   * @param path The snapshot file
+   */
+  static void write(MtIndex *mti, threadinfo_t **ti_arr,
+                    const std::vector<std::vector<uint8_t>> &bound_key_arr,
+                    const std::string &path) {
+    erpc::rt_assert(bound_key_arr.size() >= 2, "Need at least one partition");
+    const size_t num_parts = bound_key_arr.size() - 1;
+
+    // Pass 1: Count the keys in each partition to find its offset in the file
+    std::vector<size_t> count_arr(num_parts);
+    run_parallel(num_parts, [&](size_t i) {
+      count_arr[i] = scan_part(mti, ti_arr[i], bound_key_arr, i,
+                               [](const uint8_t *, const uint8_t *) {});
+    });
+
+    std::vector<size_t> offset_arr(num_parts + 1, 0);
+    for (size_t i = 0; i < num_parts; i++) {
+      offset_arr[i + 1] = offset_arr[i] + count_arr[i];
+    }
+    const size_t num_pairs = offset_arr[num_parts];
+    const size_t file_size = get_file_size(num_pairs);
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    erpc::rt_assert(fd >= 0, "open() failed for " + path);
+    erpc::rt_assert(ftruncate(fd, static_cast<off_t>(file_size)) == 0,
+                    "ftruncate() failed for " + path);
+
+    void *buf =
+        mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    erpc::rt_assert(buf != MAP_FAILED, "mmap() failed for " + path);
+    auto *hdr = static_cast<hdr_t *>(buf);
+    auto *pair_arr = reinterpret_cast<kv_pair_t *>(hdr + 1);
+
+    // Pass 2: Copy each partition's pairs to its range in the file
+    run_parallel(num_parts, [&](size_t i) {
+      kv_pair_t *out = &pair_arr[offset_arr[i]];
+      size_t num_copied = scan_part(
+          mti, ti_arr[i], bound_key_arr, i,
+          [&out](const uint8_t *key, const uint8_t *value) {
+            memcpy(out->key, key, MtIndex::kKeySize);
+            MtIndex::swap_endian(out->key);
+            memcpy(out->value, value, MtIndex::kValueSize);
+            out++;
+          });
+      erpc::rt_assert(num_copied == count_arr[i],
+                      "Index modified while writing snapshot");
+    });
+
+    hdr->key_size = MtIndex::kKeySize;
+    hdr->value_size = MtIndex::kValueSize;
+    hdr->num_pairs = num_pairs;
+    erpc::rt_assert(msync(buf, file_size, MS_SYNC) == 0, "msync() failed");
+    hdr->magic = kMagic;
+    erpc::rt_assert(msync(buf, sizeof(hdr_t), MS_SYNC) == 0, "msync() failed");
+
+    munmap(buf, file_size);
+    close(fd);
+  }
+
+  /// Map the snapshot in \p path read-only. Return false if the file does not
+  /// exist or does not contain a complete snapshot of a compatible index.
+  bool map(const std::string &path) {
+    unmap();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    erpc::rt_assert(fstat(fd, &st) == 0, "fstat() failed for " + path);
+    const size_t file_size = static_cast<size_t>(st.st_size);
+    if (file_size < sizeof(hdr_t)) {
+      close(fd);
+      return false;
+    }
+
+    void *buf = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    erpc::rt_assert(buf != MAP_FAILED, "mmap() failed for " + path);
+
+    base_ = static_cast<uint8_t *>(buf);
+    size_ = file_size;
+
+    const hdr_t *hdr = get_hdr();
+    if (hdr->magic != kMagic || hdr->key_size != MtIndex::kKeySize ||
+        hdr->value_size != MtIndex::kValueSize ||
+        get_file_size(hdr->num_pairs) != file_size) {
+      unmap();
+      return false;
+    }
+
+    return true;
+  }
+
+  void unmap() {
+    if (base_ == nullptr) return;
+    munmap(base_, size_);
+    base_ = nullptr;
+    size_ = 0;
+  }
+
+  /// Insert all pairs in the mapped snapshot into \p mti. Thread i inserts
+  /// the i-th contiguous slice of the pairs, so each thread inserts in key
+  /// order.
+  void restore(MtIndex *mti, threadinfo_t **ti_arr, size_t num_threads) const {
+    assert(base_ != nullptr);
+    const size_t num_pairs = get_hdr()->num_pairs;
+    const kv_pair_t *pair_arr = get_pairs();
+
+    run_parallel(num_threads, [&](size_t i) {
+      const size_t lo = i * num_pairs / num_threads;
+      const size_t hi = (i + 1) * num_pairs / num_threads;
+      for (size_t j = lo; j < hi; j++) {
+        kv_pair_t pair = pair_arr[j];  // mti->put() modifies the key
+        mti->put(pair.key, pair.value, ti_arr[i]);
+      }
+    });
+  }
+
+  /// Return the number of pairs in the mapped snapshot
+  size_t get_num_pairs() const { return get_hdr()->num_pairs; }
+
+  /// Return the mapped snapshot file, e.g., to stream it to a peer
+  const uint8_t *get_buf() const { return base_; }
+  size_t get_size() const { return size_; }
+
+  static size_t get_file_size(size_t num_pairs) {
+    return sizeof(hdr_t) + num_pairs * sizeof(kv_pair_t);
+  }
+
+ private:
+  const hdr_t *get_hdr() const { return reinterpret_cast<hdr_t *>(base_); }
+  const kv_pair_t *get_pairs() const {
+    return reinterpret_cast<const kv_pair_t *>(get_hdr() + 1);
+  }
+
+  /// Run func(i) for i in [0, n) in n threads, and wait for all of them
+  template <typename F>
+  static void run_parallel(size_t n, F func) {
+    std::vector<std::thread> thread_arr;
+    for (size_t i = 0; i < n; i++) thread_arr.emplace_back(func, i);
+    for (auto &thread : thread_arr) thread.join();
+  }
+
+  /// Visit the keys in partition i, and return the number of keys visited
+  template <typename Visitor>
+  static size_t scan_part(MtIndex *mti, threadinfo_t *ti,
+                          const std::vector<std::vector<uint8_t>> &bound_arr,
+                          size_t i, Visitor &&visit) {
+    // mti->scan() modifies the keys
+    std::vector<uint8_t> start_key = bound_arr[i];
+    std::vector<uint8_t> end_key = bound_arr[i + 1];
+    return mti->scan(start_key.data(), end_key.data(), SIZE_MAX, visit, ti);
+  }
+
+  uint8_t *base_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif  // SNAPSHOT_H
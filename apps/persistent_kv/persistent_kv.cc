@@ -25,7 +25,20 @@ static constexpr size_t kAppMaxKeyReqType = 2;
 // Maximum requests processed by server before issuing a response
 static constexpr size_t kAppMaxServerBatch = 16;
 
+// Maximum request batches whose redo log entries share one flush
+static constexpr size_t kAppMaxGroupBatches =
+    pmica::kNumRedoLogEntries / kAppMaxServerBatch;
+static constexpr size_t kAppMaxGroupReqs =
+    kAppMaxGroupBatches * kAppMaxServerBatch;
+
+// Maximum hash table bucket splits per call to resize_step()
+static constexpr size_t kAppResizeSplitsPerStep = 4;
+
 DEFINE_string(pmem_file, "/dev/dax12.0", "Persistent memory file path");
+DEFINE_string(storage, "pmem", "Table storage (pmem: DAX device, file: mmap)");
+DEFINE_uint64(group_commit_batches, 1, "Max batches per redo log flush");
+DEFINE_uint64(max_table_growth, 1, "Max online growth factor of the table");
+DEFINE_bool(recover, false, "Restart from the tables in the pmem file");
 DEFINE_double(total_keys_mi, 1.0, "Total keys at server, in millions");
 DEFINE_uint64(num_server_threads, 1, "Number of threads at the server machine");
 DEFINE_uint64(num_client_threads, 1, "Number of threads per client machine");
@@ -89,9 +102,17 @@ class ServerContext : public BasicAppContext {
   Value *val_ptr_arr[kAppMaxServerBatch];
   size_t keyhash_arr[kAppMaxServerBatch];
 
+  // Group commit info for batches that are executed, but whose responses are
+  // held until their SETs are committed by one redo log flush
+  size_t num_batches_in_group = 0;
+  size_t num_reqs_in_group = 0;
+  erpc::ReqHandle *group_req_handle_arr[kAppMaxGroupReqs];
+  bool group_is_set_arr[kAppMaxGroupReqs];
+
   struct {
-    size_t num_resps_tot = 0;    // Total responses sent
-    size_t num_drain_batch = 0;  // Number of calls to drain_batch()
+    size_t num_resps_tot = 0;     // Total responses sent
+    size_t num_drain_batch = 0;   // Number of calls to drain_batch()
+    size_t num_group_commit = 0;  // Number of calls to group_commit()
   } stats;
 
   void reset_stats() { memset(&stats, 0, sizeof(stats)); }
@@ -134,39 +155,73 @@ class ClientContext : public BasicAppContext {
   ~ClientContext() {}
 };
 
-// Do hash table operations and send responses for all requests in the batch.
-// This must reset num_reqs_in_batch.
+// Commit the SETs of all batches in the group with one redo log flush, and send
+// responses for all requests in the group. This must reset the group.
+inline void group_commit(ServerContext *c) {
+  if (c->num_reqs_in_group == 0) return;
+
+  bool set_success_arr[kAppMaxGroupReqs];
+  c->hashmap->group_commit(set_success_arr);
+
+  size_t set_i = 0;  // Index of the next SET in logging order
+  for (size_t i = 0; i < c->num_reqs_in_group; i++) {
+    erpc::ReqHandle *req_handle = c->group_req_handle_arr[i];
+    erpc::MsgBuffer &resp = req_handle->pre_resp_msgbuf;
+
+    if (c->group_is_set_arr[i]) {
+      c->rpc->resize_msg_buffer(&resp, sizeof(Result));
+      *reinterpret_cast<Result *>(resp.buf) =
+          set_success_arr[set_i] ? Result::kSetSuccess : Result::kSetFail;
+      set_i++;
+    }
+
+    c->rpc->enqueue_response(req_handle, &resp);
+  }
+
+  c->stats.num_resps_tot += c->num_reqs_in_group;
+  c->stats.num_group_commit++;
+
+  c->num_reqs_in_group = 0;
+  c->num_batches_in_group = 0;
+}
+
+// Do hash table operations for all requests in the batch, and add the batch to
+// the current commit group. This must reset num_reqs_in_batch. Table growth is
+// amortized over request batches, so it cannot be starved by a busy server.
+// Resizing with uncommitted SETs is safe since the log records their keyhash.
 inline void drain_batch(ServerContext *c) {
   assert(c->num_reqs_in_batch > 0);
+
+  // Make room in the redo log if this batch has too many SETs
+  if (!c->hashmap->can_log(c->num_reqs_in_batch)) group_commit(c);
+
   bool success_arr[kAppMaxServerBatch];
-  c->hashmap->batch_op_drain_helper(
+  c->hashmap->batch_op_nocommit(
       c->is_set_arr, c->keyhash_arr, const_cast<const Key **>(c->key_ptr_arr),
       c->val_ptr_arr, success_arr, c->num_reqs_in_batch);
 
   for (size_t i = 0; i < c->num_reqs_in_batch; i++) {
     erpc::ReqHandle *req_handle = c->req_handle_arr[i];
-    erpc::MsgBuffer &resp = req_handle->pre_resp_msgbuf;
 
-    if (c->is_set_arr[i]) {
-      // SET request
+    if (!c->is_set_arr[i] && !success_arr[i]) {
+      // GET request that failed
+      erpc::MsgBuffer &resp = req_handle->pre_resp_msgbuf;
       c->rpc->resize_msg_buffer(&resp, sizeof(Result));
-      *reinterpret_cast<Result *>(resp.buf) =
-          success_arr[i] ? Result::kSetSuccess : Result::kSetFail;
-    } else {
-      // GET request
-      if (!success_arr[i]) {
-        c->rpc->resize_msg_buffer(&resp, sizeof(Result));
-        *reinterpret_cast<Result *>(resp.buf) = Result::kGetFail;
-      }
+      *reinterpret_cast<Result *>(resp.buf) = Result::kGetFail;
     }
 
-    c->rpc->enqueue_response(req_handle, &resp);
+    c->group_req_handle_arr[c->num_reqs_in_group] = req_handle;
+    c->group_is_set_arr[c->num_reqs_in_group] = c->is_set_arr[i];
+    c->num_reqs_in_group++;
   }
 
-  c->stats.num_resps_tot += c->num_reqs_in_batch;
   c->stats.num_drain_batch++;
-
   c->num_reqs_in_batch = 0;
+
+  c->num_batches_in_group++;
+  if (c->num_batches_in_group == FLAGS_group_commit_batches) group_commit(c);
+
+  c->hashmap->resize_step(kAppResizeSplitsPerStep);
 }
 
 void max_key_req_handler(erpc::ReqHandle *req_handle, void *_context) {
@@ -220,35 +275,49 @@ void kv_req_handler(erpc::ReqHandle *req_handle, void *_context) {
   if (c->num_reqs_in_batch == kAppMaxServerBatch) drain_batch(c);
 }
 
-// Populate the partition for this server and set c.max_key
+// Populate the partition for this server and set c.max_key. This uses group
+// commit to flush the redo log once per kNumRedoLogEntries keys.
 void populate(ServerContext &c) {
+  static constexpr size_t kBatchesPerCommit =
+      pmica::kNumRedoLogEntries / pmica::kMaxBatchSize;
+
   bool is_set_arr[pmica::kMaxBatchSize];
   Key key_arr[pmica::kMaxBatchSize];
   Value val_arr[pmica::kMaxBatchSize];
   Key *key_ptr_arr[pmica::kMaxBatchSize];
   Value *val_ptr_arr[pmica::kMaxBatchSize];
-  bool success_arr[pmica::kMaxBatchSize];
+  size_t keyhash_arr[pmica::kMaxBatchSize];
+  bool success_arr[pmica::kMaxBatchSize];  // Unused, since there are no GETs
+  bool set_success_arr[pmica::kNumRedoLogEntries];
 
   size_t num_success = 0;
 
   for (size_t i = 0; i < pmica::kMaxBatchSize; i++) {
     key_ptr_arr[i] = &key_arr[i];
     val_ptr_arr[i] = &val_arr[i];
+    is_set_arr[i] = true;
   }
 
   const size_t num_keys_to_insert =
-      erpc::round_up<pmica::kMaxBatchSize>(c.key_cap_per_partition);
+      erpc::round_up<pmica::kNumRedoLogEntries>(c.key_cap_per_partition);
   size_t progress_console_lim = num_keys_to_insert / 10;
 
-  for (size_t i = 1; i <= num_keys_to_insert; i += pmica::kMaxBatchSize) {
-    for (size_t j = 0; j < pmica::kMaxBatchSize; j++) {
-      is_set_arr[j] = true;
-      key_arr[j].key_frag[0] = i + j;
-      val_arr[j].val_frag[0] = i + j;
+  for (size_t i = 1; i <= num_keys_to_insert; i += pmica::kNumRedoLogEntries) {
+    for (size_t b = 0; b < kBatchesPerCommit; b++) {
+      for (size_t j = 0; j < pmica::kMaxBatchSize; j++) {
+        size_t key = i + b * pmica::kMaxBatchSize + j;
+        key_arr[j].key_frag[0] = key;
+        val_arr[j].val_frag[0] = key;
+        keyhash_arr[j] = HashMap::get_hash(&key_arr[j]);
+      }
+
+      c.hashmap->batch_op_nocommit(
+          is_set_arr, keyhash_arr, const_cast<const Key **>(key_ptr_arr),
+          val_ptr_arr, success_arr, pmica::kMaxBatchSize);
     }
 
-    c.hashmap->batch_op_drain(is_set_arr, const_cast<const Key **>(key_ptr_arr),
-                              val_ptr_arr, success_arr, pmica::kMaxBatchSize);
+    c.hashmap->group_commit(set_success_arr);
+    c.hashmap->resize_step(kAppResizeSplitsPerStep);
 
     if (i >= progress_console_lim) {
       printf("thread %zu: %.2f percent done\n", c.thread_id,
@@ -256,9 +325,9 @@ void populate(ServerContext &c) {
       progress_console_lim += num_keys_to_insert / 10;
     }
 
-    for (size_t j = 0; j < pmica::kMaxBatchSize; j++) {
-      num_success += success_arr[j];
-      if (!success_arr[j]) {
+    for (size_t j = 0; j < pmica::kNumRedoLogEntries; j++) {
+      num_success += set_success_arr[j];
+      if (!set_success_arr[j]) {
         printf("thread %zu: populate() failed at key %zu of %zu keys\n",
                c.thread_id, i + j, num_keys_to_insert);
         c.max_key = num_success;
@@ -278,14 +347,24 @@ void server_func(erpc::Nexus *nexus, size_t thread_id) {
   c.key_cap_per_partition =
       FLAGS_total_keys_mi * MB(1) / FLAGS_num_server_threads;
 
-  const size_t bytes_per_parition =
-      HashMap::get_required_bytes(c.key_cap_per_partition, kAppMicaOverhead);
+  const size_t bytes_per_parition = HashMap::get_required_bytes(
+      c.key_cap_per_partition, kAppMicaOverhead, FLAGS_max_table_growth);
   c.hashmap = new HashMap(FLAGS_pmem_file, thread_id * bytes_per_parition,
-                          c.key_cap_per_partition, kAppMicaOverhead);
-
-  populate(c);
-  printf("thread %zu: populate() inserted %zu keys. occupancy = %.2f\n",
-         thread_id, c.max_key, c.max_key * 1.0 / c.hashmap->get_key_capacity());
+                          c.key_cap_per_partition, kAppMicaOverhead,
+                          pmica::Storage::type_from_string(FLAGS_storage),
+                          FLAGS_max_table_growth, FLAGS_recover);
+
+  if (FLAGS_recover) {
+    // populate() inserts keys 1 to max_key, so no need to redo it
+    c.max_key = c.hashmap->get_num_keys();
+    printf("thread %zu: recovered %zu keys. occupancy = %.2f\n", thread_id,
+           c.max_key, c.max_key * 1.0 / c.hashmap->get_key_capacity());
+  } else {
+    populate(c);
+    printf("thread %zu: populate() inserted %zu keys. occupancy = %.2f\n",
+           thread_id, c.max_key,
+           c.max_key * 1.0 / c.hashmap->get_key_capacity());
+  }
 
   erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c), thread_id,
                                   basic_sm_handler, port_vec.at(0));
@@ -303,15 +382,20 @@ void server_func(erpc::Nexus *nexus, size_t thread_id) {
 
       // If no new requests were received in this iteration of the event loop,
       // and we have responses to send, send them now.
-      if (c.num_reqs_tot == num_reqs_tot_start && c.num_reqs_in_batch > 0) {
-        drain_batch(&c);
+      if (c.num_reqs_tot == num_reqs_tot_start) {
+        if (c.num_reqs_in_batch > 0) drain_batch(&c);
+        group_commit(&c);
+
+        // Also grow the table in idle event loop iterations
+        c.hashmap->resize_step(kAppResizeSplitsPerStep);
       }
     }
 
     const double seconds = erpc::to_sec(erpc::rdtsc() - start_tsc, freq_ghz);
-    printf("thread %zu: %.2f M/s. avg batch = %.2f\n", thread_id,
-           c.stats.num_resps_tot / (seconds * Mi(1)),
-           c.stats.num_resps_tot * 1.0 / c.stats.num_drain_batch);
+    printf("thread %zu: %.2f M/s. avg batch = %.2f, batches/commit = %.2f\n",
+           thread_id, c.stats.num_resps_tot / (seconds * Mi(1)),
+           c.stats.num_resps_tot * 1.0 / c.stats.num_drain_batch,
+           c.stats.num_drain_batch * 1.0 / c.stats.num_group_commit);
 
     c.reset_stats();
 
@@ -496,6 +580,11 @@ int main(int argc, char **argv) {
 
   erpc::rt_assert(FLAGS_numa_node <= 1, "Invalid NUMA node");
   erpc::rt_assert(FLAGS_window_size <= kAppMaxWindowSize, "Window too large");
+  erpc::rt_assert(FLAGS_group_commit_batches >= 1 &&
+                      FLAGS_group_commit_batches <= kAppMaxGroupBatches,
+                  "Invalid group commit batches");
+  erpc::rt_assert(erpc::is_power_of_two(FLAGS_max_table_growth),
+                  "Table growth must be a power of two");
 
   erpc::Nexus nexus(erpc::get_uri_for_process(FLAGS_process_id),
                     FLAGS_numa_node, 0);
@@ -7,11 +7,20 @@
 
 #include <assert.h>
 #include <city.h>
-#include <libpmem.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#ifdef PMICA_USE_PMEM
+#include <libpmem.h>
+#endif
+
 namespace pmica {
 
 static constexpr size_t kSlotsPerBucket = 5;
@@ -19,11 +28,180 @@ static constexpr size_t kMaxBatchSize = 16;
 static constexpr size_t kNumRedoLogEntries = kMaxBatchSize * 8;
 static constexpr bool kPMicaVerbose = false;
 
+// Online resizing: Grow the table if the fraction of occupied slots in regular
+// buckets exceeds kResizeLoadFactor, or if fewer than 1/kResizeExtraBucketsFrac
+// of the extra buckets are free.
+static constexpr double kResizeLoadFactor = 0.5;
+static constexpr size_t kResizeExtraBucketsFrac = 2;
+
 /// Check a condition at runtime. If the condition is false, throw exception.
 static inline void rt_assert(bool condition, std::string throw_str) {
   if (!condition) throw std::runtime_error(throw_str);
 }
 
+#ifndef PMICA_USE_PMEM
+// Dummy versions of libpmem functions, to avoid #ifdef PMICA_USE_PMEM
+// everywhere. Only Storage::Type::kFile works without libpmem.
+static void* pmem_map_file(const char*, size_t, int, uint32_t, size_t*, int*) {
+  rt_assert(false, "pmem not supported");
+  return nullptr;
+}
+static int pmem_unmap(void*, size_t) { return -1; }
+static void* pmem_memcpy_nodrain(void*, const void*, size_t) { return nullptr; }
+static void* pmem_memcpy_persist(void*, const void*, size_t) { return nullptr; }
+static void* pmem_memset_nodrain(void*, int, size_t) { return nullptr; }
+static void* pmem_memset_persist(void*, int, size_t) { return nullptr; }
+static void pmem_drain() {}
+#endif
+
+/// The persistence primitives used by the hash table. A table placed on a DAX
+/// device uses libpmem. A table placed in a regular file (e.g., on an NVMe
+/// SSD) is mmap-ed, and its dirty pages are flushed with msync() or
+/// fdatasync() on drain.
+class Storage {
+ public:
+  enum class Type { kPmem, kFile };
+
+  /// In file mode, a drain flushes the whole file with fdatasync() instead of
+  /// msync()-ing the dirty range if the dirty range is larger than this
+  static constexpr size_t kFileSyncAllThresh = 64 * 1024 * 1024;
+
+  Storage(Type type) : type(type) {}
+
+  static Type type_from_string(std::string str) {
+    if (str == "pmem") return Type::kPmem;
+    rt_assert(str == "file", "Invalid storage type " + str);
+    return Type::kFile;
+  }
+
+  // Map \p file, which must be at least \p min_len bytes. This modifies only
+  // _mapped_len.
+  uint8_t* map(std::string file, size_t min_len, size_t& _mapped_len) {
+    if (type == Type::kPmem) {
+      int is_pmem;
+      base = reinterpret_cast<uint8_t*>(pmem_map_file(
+          file.c_str(), 0 /* length */, 0 /* flags */, 0666, &_mapped_len,
+          &is_pmem));
+      rt_assert(base != nullptr, "pmem_map_file() failed for " + file);
+      rt_assert(is_pmem == 1, "File is not pmem");
+      mapped_len = _mapped_len;
+      return base;
+    }
+
+    fd = open(file.c_str(), O_RDWR | O_CREAT, 0666);
+    rt_assert(fd >= 0, "open() failed for " + file + ": " + strerror(errno));
+
+    // Unlike ftruncate(), this never shrinks the file, so threads that place
+    // their tables at different offsets in one file can call this concurrently
+    int ret = posix_fallocate(fd, 0, static_cast<off_t>(min_len));
+    rt_assert(ret == 0, "posix_fallocate() failed for " + file);
+
+    struct stat st;
+    rt_assert(fstat(fd, &st) == 0, "fstat() failed for " + file);
+    _mapped_len = static_cast<size_t>(st.st_size);
+
+    void* buf = mmap(nullptr, _mapped_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+    rt_assert(buf != MAP_FAILED, "mmap() failed for " + file);
+
+    base = reinterpret_cast<uint8_t*>(buf);
+    mapped_len = _mapped_len;
+    return base;
+  }
+
+  void unmap() {
+    if (base == nullptr) return;
+    if (type == Type::kPmem) {
+      pmem_unmap(base, mapped_len);
+    } else {
+      drain();
+      munmap(base, mapped_len);
+      close(fd);
+    }
+    base = nullptr;
+  }
+
+  /// Copy to the mapping without waiting for the copy to become persistent
+  inline void memcpy_nodrain(void* dst, const void* src, size_t len) {
+    if (type == Type::kPmem) {
+      pmem_memcpy_nodrain(dst, src, len);
+      return;
+    }
+    memcpy(dst, src, len);
+    mark_dirty(dst, len);
+  }
+
+  /// Fill the mapping without waiting for the writes to become persistent
+  inline void memset_nodrain(void* dst, int c, size_t len) {
+    if (type == Type::kPmem) {
+      pmem_memset_nodrain(dst, c, len);
+      return;
+    }
+    memset(dst, c, len);
+    mark_dirty(dst, len);
+  }
+
+  /// Wait until all preceding nodrain copies are persistent
+  inline void drain() {
+    if (type == Type::kPmem) {
+      pmem_drain();
+      return;
+    }
+    if (dirty_lo == SIZE_MAX) return;
+
+    if (dirty_hi - dirty_lo > kFileSyncAllThresh) {
+      rt_assert(fdatasync(fd) == 0, "fdatasync() failed");
+    } else {
+      // msync() requires a page-aligned start address
+      size_t page_sz = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      size_t lo = dirty_lo & ~(page_sz - 1);
+      rt_assert(msync(base + lo, dirty_hi - lo, MS_SYNC) == 0,
+                "msync() failed");
+    }
+
+    dirty_lo = SIZE_MAX;
+    dirty_hi = 0;
+  }
+
+  inline void memcpy_persist(void* dst, const void* src, size_t len) {
+    if (type == Type::kPmem) {
+      pmem_memcpy_persist(dst, src, len);
+      return;
+    }
+    memcpy_nodrain(dst, src, len);
+    drain();
+  }
+
+  inline void memset_persist(void* dst, int c, size_t len) {
+    if (type == Type::kPmem) {
+      pmem_memset_persist(dst, c, len);
+      return;
+    }
+    memset(dst, c, len);
+    mark_dirty(dst, len);
+    drain();
+  }
+
+  const Type type;
+
+ private:
+  // Extend the range of the file to flush on the next drain
+  inline void mark_dirty(const void* dst, size_t len) {
+    size_t off = static_cast<size_t>(reinterpret_cast<const uint8_t*>(dst) -
+                                     base);
+    if (off < dirty_lo) dirty_lo = off;
+    if (off + len > dirty_hi) dirty_hi = off + len;
+  }
+
+  uint8_t* base = nullptr;  // Start of the mapping
+  size_t mapped_len = 0;    // Length of the mapping
+  int fd = -1;              // The mapped file, in file mode
+
+  // The dirty byte range [dirty_lo, dirty_hi) of the file, in file mode
+  size_t dirty_lo = SIZE_MAX;
+  size_t dirty_hi = 0;
+};
+
 // Aligns 64b input parameter to the next power of 2
 static uint64_t rte_align64pow2(uint64_t v) {
   v--;
@@ -69,8 +247,8 @@ class HashMap {
     Slot slot_arr[kSlotsPerBucket];
   };
 
-  // A redo log entry is committed iff its sequence number is less than or equal
-  // to the committed_seq_num.
+  // A redo log entry is committed iff its sequence number is less than the
+  // committed_seq_num.
   class RedoLogEntry {
    public:
     size_t seq_num;  // Sequence number of this entry. Zero is invalid.
@@ -88,17 +266,17 @@ class HashMap {
    public:
     RedoLogEntry entries[kNumRedoLogEntries];
     size_t committed_seq_num;
+
+    // The number of regular buckets that are in use. Online resizing commits
+    // each bucket split by atomically incrementing this.
+    size_t num_active_buckets;
   };
 
   // Initialize the persistent buffer for this hash table. This modifies only
   // mapped_len.
-  uint8_t* map_pbuf(size_t& _mapped_len) const {
-    int is_pmem;
-    uint8_t* pbuf = reinterpret_cast<uint8_t*>(
-        pmem_map_file(pmem_file.c_str(), 0 /* length */, 0 /* flags */, 0666,
-                      &_mapped_len, &is_pmem));
-
-    rt_assert(pbuf != nullptr, "pmem_map_file() failed for " + pmem_file);
+  uint8_t* map_pbuf(size_t& _mapped_len) {
+    uint8_t* pbuf =
+        storage.map(pmem_file, file_offset + reqd_space, _mapped_len);
     rt_assert(reinterpret_cast<size_t>(pbuf) % 256 == 0, "pbuf not aligned");
 
     if (mapped_len - file_offset < reqd_space) {
@@ -108,7 +286,6 @@ class HashMap {
               reqd_space * 1.0 / (1ull << 30), num_total_buckets,
               sizeof(Bucket), mapped_len * 1.0 / (1ull << 30));
     }
-    rt_assert(is_pmem == 1, "File is not pmem");
 
     return pbuf + file_offset;
   }
@@ -116,9 +293,20 @@ class HashMap {
   // Allocate a hash table with space for \p num_keys keys, and chain overflow
   // room for \p overhead_fraction of the keys
   //
-  // The hash table is stored in pmem_file at \p file_offset
+  // The hash table is stored in pmem_file at \p file_offset. With
+  // Storage::Type::kFile, pmem_file can be a regular file, which is created or
+  // extended if needed.
+  //
+  // If \p max_growth (a power of two) is larger than one, space is reserved
+  // for the table to grow online to max_growth times its initial number of
+  // regular buckets. See resize_step().
+  //
+  // If \p recover is true, the table is restarted from the existing contents
+  // of pmem_file, which must have been created with the same parameters.
   HashMap(std::string pmem_file, size_t file_offset, size_t num_requested_keys,
-          double overhead_fraction)
+          double overhead_fraction,
+          Storage::Type storage_type = Storage::Type::kPmem,
+          size_t max_growth = 1, bool recover = false)
       : pmem_file(pmem_file),
         file_offset(file_offset),
         num_requested_keys(num_requested_keys),
@@ -126,21 +314,27 @@ class HashMap {
         num_regular_buckets(
             rte_align64pow2(num_requested_keys / kSlotsPerBucket)),
         num_extra_buckets(num_regular_buckets * overhead_fraction),
-        num_total_buckets(num_regular_buckets + num_extra_buckets),
-        reqd_space(get_required_bytes(num_requested_keys, overhead_fraction)),
-        invalid_key(get_invalid_key()) {
+        max_regular_buckets(num_regular_buckets * max_growth),
+        num_total_buckets(max_regular_buckets + num_extra_buckets),
+        reqd_space(get_required_bytes(num_requested_keys, overhead_fraction,
+                                      max_growth)),
+        invalid_key(get_invalid_key()),
+        storage(storage_type) {
     rt_assert(num_requested_keys >= kSlotsPerBucket, ">=1 buckets needed");
     rt_assert(file_offset % 256 == 0, "Unaligned file offset");
+    rt_assert(is_power_of_two(max_growth), "Growth must be a power of two");
 
-    printf("Space required = %.4f GB, key capacity = %.4f M. Bkt size = %zu\n",
+    num_active_buckets = num_regular_buckets;
+    level_buckets = num_regular_buckets;
+    num_keys = 0;
+
+    printf("Space required = %.4f GB, key capacity = %.4f M (max %.4f M). "
+           "Bkt size = %zu\n",
            reqd_space * 1.0 / (1ull << 30), get_key_capacity() / 1000000.0,
-           sizeof(Bucket));
+           num_total_buckets * kSlotsPerBucket / 1000000.0, sizeof(Bucket));
 
     pbuf = map_pbuf(mapped_len);
-
-    // Set the committed seq num, and all redo log entry seq nums to zero.
     redo_log = reinterpret_cast<RedoLog*>(pbuf);
-    pmem_memset_persist(redo_log, 0, sizeof(RedoLog));
 
     // Initialize buckets
     size_t bucket_offset = roundup<256>(sizeof(RedoLog));
@@ -148,10 +342,19 @@ class HashMap {
 
     // extra_buckets_[0] is the actually the last regular bucket. extra_buckets_
     // is indexed starting from one, so the last regular bucket is never used
-    // as an extra bucket.
+    // as an extra bucket. The extra buckets are placed after the space
+    // reserved for growing the regular buckets.
     extra_buckets_ =
         reinterpret_cast<Bucket*>(reinterpret_cast<uint8_t*>(buckets_) +
-                                  ((num_regular_buckets - 1) * sizeof(Bucket)));
+                                  ((max_regular_buckets - 1) * sizeof(Bucket)));
+
+    if (recover) {
+      recover_table();
+      return;
+    }
+
+    // Set the committed seq num, and all redo log entry seq nums to zero.
+    storage.memset_persist(redo_log, 0, sizeof(RedoLog));
 
     // Initialize the free list of extra buckets
     printf("Initializing extra buckets freelist (%zu buckets)\n",
@@ -164,19 +367,94 @@ class HashMap {
     reset();
   }
 
+  // Restart from the table in the storage file. Only the volatile state (the
+  // linear hashing state, the extra bucket free list, and the key count) is
+  // rebuilt from the buckets, after replaying committed redo log entries and
+  // finishing an interrupted bucket split.
+  void recover_table() {
+    num_active_buckets = redo_log->num_active_buckets;
+    rt_assert(num_active_buckets >= num_regular_buckets &&
+                  num_active_buckets <= max_regular_buckets,
+              "Storage file has a different or no table");
+    level_buckets = get_level_buckets(num_active_buckets);
+
+    // A crash during a bucket split's cleanup can leave stale copies of the
+    // moved items in the split bucket's chain
+    if (num_active_buckets > num_regular_buckets) {
+      const size_t new_index = num_active_buckets - 1;
+      const size_t split_level = get_level_buckets(new_index);
+      clean_split_chain(new_index - split_level, new_index,
+                        2 * split_level - 1);
+    }
+
+    // Rebuild the extra bucket free list from the chains in use
+    std::vector<bool> in_use(num_extra_buckets + 1, false);
+    num_keys = 0;
+    for (size_t i = 0; i < num_active_buckets; i++) {
+      const Bucket* bucket = &buckets_[i];
+      while (true) {
+        for (size_t j = 0; j < kSlotsPerBucket; j++) {
+          if (bucket->slot_arr[j].key != invalid_key) num_keys++;
+        }
+
+        const size_t next_index = bucket->next_extra_bucket_idx;
+        if (next_index == 0) break;
+        rt_assert(next_index <= num_extra_buckets && !in_use[next_index],
+                  "Corrupt extra bucket chain");
+        in_use[next_index] = true;
+        bucket = &extra_buckets_[next_index];
+      }
+    }
+
+    extra_bucket_free_list.clear();
+    for (size_t i = num_extra_buckets; i >= 1; i--) {
+      if (in_use[i]) continue;
+
+      // Buckets allocated from the free list must be empty
+      storage.memset_nodrain(&extra_buckets_[i], 0, sizeof(Bucket));
+      extra_bucket_free_list.push_back(i);
+    }
+    storage.drain();
+
+    // Replay committed redo log entries in order. SETs are idempotent, and any
+    // SET missing from the log is older than all entries in the log.
+    const size_t committed_seq_num = redo_log->committed_seq_num;
+    const size_t first_seq_num = committed_seq_num > kNumRedoLogEntries
+                                     ? committed_seq_num - kNumRedoLogEntries
+                                     : 1;
+    size_t num_replayed = 0;
+    for (size_t seq = first_seq_num; seq < committed_seq_num; seq++) {
+      const RedoLogEntry& rle = redo_log->entries[seq % kNumRedoLogEntries];
+      if (rle.seq_num != seq) continue;
+      set_nodrain(&rle.key, &rle.value);
+      num_replayed++;
+    }
+    storage.drain();
+
+    cur_sequence_number = committed_seq_num > 0 ? committed_seq_num : 1;
+
+    printf("Recovered hash table with %zu keys, %zu active buckets, and %zu "
+           "free extra buckets. Replayed %zu redo log entries.\n",
+           num_keys, num_active_buckets, extra_bucket_free_list.size(),
+           num_replayed);
+  }
+
   ~HashMap() {
-    if (pbuf != nullptr) pmem_unmap(pbuf - file_offset, mapped_len);
+    if (pbuf != nullptr) storage.unmap();
   }
 
   /// Return the total bytes required for a table with \p num_requested_keys
-  /// keys and \p overhead_fraction extra buckets. The returned space includes
-  /// redo log. The returned space is aligned to 256 bytes.
+  /// keys, \p overhead_fraction extra buckets, and room to grow by \p
+  /// max_growth. The returned space includes redo log. The returned space is
+  /// aligned to 256 bytes.
   static size_t get_required_bytes(size_t num_requested_keys,
-                                   double overhead_fraction) {
+                                   double overhead_fraction,
+                                   size_t max_growth = 1) {
     size_t num_regular_buckets =
         rte_align64pow2(num_requested_keys / kSlotsPerBucket);
     size_t num_extra_buckets = num_regular_buckets * overhead_fraction;
-    size_t num_total_buckets = num_regular_buckets + num_extra_buckets;
+    size_t num_total_buckets =
+        num_regular_buckets * max_growth + num_extra_buckets;
 
     size_t tot_size = sizeof(RedoLog) + num_total_buckets * sizeof(Bucket);
     return roundup<256>(tot_size);
@@ -202,10 +480,11 @@ class HashMap {
     return *reinterpret_cast<const size_t*>(v);
   }
 
-  // Initialize the contents of both regular and extra buckets
+  // Initialize the contents of both regular and extra buckets. Regular buckets
+  // reserved for growth are initialized when they are split into.
   void reset() {
-    double GB_to_memset =
-        num_total_buckets * sizeof(Bucket) * 1.0 / (1ull << 30);
+    double GB_to_memset = (num_regular_buckets + num_extra_buckets) *
+                          sizeof(Bucket) * 1.0 / (1ull << 30);
     printf("Resetting hash table. This might take a while (~ %.1f seconds)\n",
            GB_to_memset / 3.0);
 
@@ -213,13 +492,32 @@ class HashMap {
     //  * bucket.slot[i].key = invalid_key;
     //  * bucket.next_extra_bucket_idx = 0;
     // pmem_memset_persist() uses SIMD, so it's faster
-    pmem_memset_persist(&buckets_[0], 0, num_total_buckets * sizeof(Bucket));
+    storage.memset_persist(&buckets_[0], 0,
+                           num_regular_buckets * sizeof(Bucket));
+    storage.memset_persist(&extra_buckets_[1], 0,
+                           num_extra_buckets * sizeof(Bucket));
+
+    num_active_buckets = num_regular_buckets;
+    level_buckets = num_regular_buckets;
+    num_keys = 0;
+    storage.memcpy_persist(&redo_log->num_active_buckets, &num_active_buckets,
+                           sizeof(size_t));
+  }
+
+  // Linear hashing: Regular buckets below the split index in this round have
+  // already been split, so they are addressed with one more hash bit.
+  inline size_t get_bucket_index(uint64_t key_hash) const {
+    size_t bucket_index = key_hash & (level_buckets - 1);
+    if (bucket_index < num_active_buckets - level_buckets) {
+      bucket_index = key_hash & (2 * level_buckets - 1);
+    }
+    return bucket_index;
   }
 
   void prefetch(uint64_t key_hash) const {
     if (!opts.prefetch) return;
 
-    size_t bucket_index = key_hash & (num_regular_buckets - 1);
+    size_t bucket_index = get_bucket_index(key_hash);
     const Bucket* bucket = &buckets_[bucket_index];
 
     // Prefetching two cache lines seems to works best
@@ -258,6 +556,7 @@ class HashMap {
   void batch_op_drain_helper(bool* is_set, size_t* keyhash_arr,
                              const Key** key_arr, Value** value_arr,
                              bool* success_arr, size_t n) {
+    assert(num_uncommitted == 0);  // Don't mix with group commits
     bool all_gets = true;
     for (size_t i = 0; i < n; i++) {
       if (is_set[i]) {
@@ -265,18 +564,19 @@ class HashMap {
         RedoLogEntry v_rle(cur_sequence_number, key_arr[i], value_arr[i]);
 
         // Drain all pending writes to the table when we reuse log entries
-        if (cur_sequence_number % kNumRedoLogEntries == 0) pmem_drain();
+        if (cur_sequence_number % kNumRedoLogEntries == 0) storage.drain();
 
         RedoLogEntry& p_rle =
             redo_log->entries[cur_sequence_number % kNumRedoLogEntries];
 
         if (opts.redo_batch) {
           // We will write to the committed sequence number later
-          pmem_memcpy_nodrain(&p_rle, &v_rle, sizeof(v_rle));
+          storage.memcpy_nodrain(&p_rle, &v_rle, sizeof(v_rle));
         } else {
-          pmem_memcpy_persist(&p_rle, &v_rle, sizeof(v_rle));
-          pmem_memcpy_persist(&redo_log->committed_seq_num,
-                              &cur_sequence_number, sizeof(size_t));
+          storage.memcpy_persist(&p_rle, &v_rle, sizeof(v_rle));
+          const size_t committed_seq_num = cur_sequence_number + 1;
+          storage.memcpy_persist(&redo_log->committed_seq_num,
+                                 &committed_seq_num, sizeof(size_t));
         }
 
         cur_sequence_number++;  // Just the in-memory copy
@@ -285,9 +585,9 @@ class HashMap {
 
     if (opts.redo_batch && !all_gets) {
       // This is needed only if redo log batching is enabled
-      pmem_drain();  // Block until the redo log entries are persistent
-      pmem_memcpy_persist(&redo_log->committed_seq_num, &cur_sequence_number,
-                          sizeof(size_t));
+      storage.drain();  // Block until the redo log entries are persistent
+      storage.memcpy_persist(&redo_log->committed_seq_num,
+                             &cur_sequence_number, sizeof(size_t));
     }
 
     for (size_t i = 0; i < n; i++) {
@@ -317,6 +617,72 @@ class HashMap {
                           n);
   }
 
+  // Return true iff \p num_sets more SETs fit in the redo log before the next
+  // group_commit()
+  bool can_log(size_t num_sets) const {
+    return num_uncommitted + num_sets <= kNumRedoLogEntries;
+  }
+
+  // Group commit, part one: append the SETs in a batch to the redo log without
+  // making them persistent, and execute the GETs. Unlike batch_op_drain(), this
+  // lets many batches share one redo log flush in group_commit().
+  //
+  // success_arr is filled in only for GETs. GETs do not observe SETs that are
+  // not yet committed. The caller must ensure that the batch's SETs fit in the
+  // redo log using can_log(). This version assumes that the caller has already
+  // issued prefetches.
+  void batch_op_nocommit(bool* is_set, size_t* keyhash_arr,
+                         const Key** key_arr, Value** value_arr,
+                         bool* success_arr, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      if (!is_set[i]) {
+        success_arr[i] = get(keyhash_arr[i], key_arr[i], value_arr[i]);
+        continue;
+      }
+
+      // An uncommitted entry is never overwritten
+      assert(num_uncommitted < kNumRedoLogEntries);
+      RedoLogEntry v_rle(cur_sequence_number, key_arr[i], value_arr[i]);
+
+      // Drain all pending writes to the table when we reuse log entries
+      if (cur_sequence_number % kNumRedoLogEntries == 0) storage.drain();
+
+      RedoLogEntry& p_rle =
+          redo_log->entries[cur_sequence_number % kNumRedoLogEntries];
+      storage.memcpy_nodrain(&p_rle, &v_rle, sizeof(v_rle));
+
+      uncommitted_keyhash_arr[num_uncommitted] = keyhash_arr[i];
+      num_uncommitted++;
+      cur_sequence_number++;  // Just the in-memory copy
+    }
+  }
+
+  // Group commit, part two: make all SETs logged by batch_op_nocommit() since
+  // the last group commit persistent with one flush, and apply them to the
+  // table. set_success_arr[i] is filled in with the result of the i-th logged
+  // SET. Return the number of SETs committed.
+  size_t group_commit(bool* set_success_arr) {
+    if (num_uncommitted == 0) return 0;
+
+    storage.drain();  // Block until the redo log entries are persistent
+    storage.memcpy_persist(&redo_log->committed_seq_num, &cur_sequence_number,
+                           sizeof(size_t));
+
+    // The log entries contain the keys and values, so the caller's request
+    // buffers need not live until the commit
+    const size_t first_seq_num = cur_sequence_number - num_uncommitted;
+    for (size_t i = 0; i < num_uncommitted; i++) {
+      const RedoLogEntry& rle =
+          redo_log->entries[(first_seq_num + i) % kNumRedoLogEntries];
+      set_success_arr[i] =
+          set_nodrain(uncommitted_keyhash_arr[i], &rle.key, &rle.value);
+    }
+
+    size_t ret = num_uncommitted;
+    num_uncommitted = 0;
+    return ret;
+  }
+
   bool get(const Key* key, Value* out_value) const {
     assert(*key != invalid_key);
     return get(get_hash(key), key, out_value);
@@ -325,7 +691,7 @@ class HashMap {
   bool get(uint64_t key_hash, const Key* key, Value* out_value) const {
     assert(*key != invalid_key);
 
-    size_t bucket_index = key_hash & (num_regular_buckets - 1);
+    size_t bucket_index = get_bucket_index(key_hash);
     Bucket* bucket = &buckets_[bucket_index];
 
     Bucket* located_bucket;
@@ -353,8 +719,8 @@ class HashMap {
     }
 
     // This is an eight-byte operation, so no need in redo log
-    pmem_memcpy_persist(&bucket->next_extra_bucket_idx, &extra_bucket_index,
-                        sizeof(extra_bucket_index));
+    storage.memcpy_persist(&bucket->next_extra_bucket_idx,
+                           &extra_bucket_index, sizeof(extra_bucket_index));
     return true;
   }
 
@@ -403,7 +769,7 @@ class HashMap {
              extra_bucket_free_list.size());
     }
 
-    size_t bucket_index = key_hash & (num_regular_buckets - 1);
+    size_t bucket_index = get_bucket_index(key_hash);
     Bucket* bucket = &buckets_[bucket_index];
     Bucket* located_bucket;
     size_t item_index = find_item_index(bucket, key, &located_bucket);
@@ -420,6 +786,7 @@ class HashMap {
         }
         return false;
       }
+      num_keys++;
     }
 
     if (kPMicaVerbose) {
@@ -430,28 +797,191 @@ class HashMap {
 
     Slot s(*key, *value);
     if (opts.async_drain) {
-      pmem_memcpy_nodrain(&located_bucket->slot_arr[item_index], &s, sizeof(s));
+      storage.memcpy_nodrain(&located_bucket->slot_arr[item_index], &s,
+                             sizeof(s));
     } else {
-      pmem_memcpy_persist(&located_bucket->slot_arr[item_index], &s, sizeof(s));
+      storage.memcpy_persist(&located_bucket->slot_arr[item_index], &s,
+                             sizeof(s));
     }
 
     return true;
   }
 
-  // Return the number of keys that can be stored in this table
+  // Return the number of keys in this table
+  size_t get_num_keys() const { return num_keys; }
+
+  // Return the number of keys that can be stored in this table without growing
   size_t get_key_capacity() const {
-    return num_total_buckets * kSlotsPerBucket;
+    return (num_active_buckets + num_extra_buckets) * kSlotsPerBucket;
   };
 
+  // Return true iff the table should grow, and it has room to grow
+  bool needs_resize() const {
+    if (num_active_buckets == max_regular_buckets) return false;
+    const size_t active_slots = num_active_buckets * kSlotsPerBucket;
+    return num_keys > kResizeLoadFactor * active_slots ||
+           extra_bucket_free_list.size() <
+               num_extra_buckets / kResizeExtraBucketsFrac;
+  }
+
+  // Grow the table by splitting up to \p max_splits regular buckets if needed.
+  // Callers amortize resizing by calling this with a small \p max_splits
+  // between request batches. Return the number of buckets split.
+  size_t resize_step(size_t max_splits) {
+    size_t num_splits = 0;
+    while (num_splits < max_splits && needs_resize()) {
+      if (!split_one_bucket()) break;
+      num_splits++;
+    }
+    return num_splits;
+  }
+
+  // Split the next regular bucket in linear hashing order, moving its items
+  // that have the next hash bit set to a new regular bucket. Return false if
+  // there are not enough free extra buckets for the new bucket's chain.
+  //
+  // The split is crash-consistent without the redo log:
+  //  1. Write the new bucket's chain. It is unreachable until step 2.
+  //  2. Commit the split by atomically persisting num_active_buckets. After
+  //     this, lookups for the moved items use the new bucket.
+  //  3. Invalidate the moved items in the old chain, and free the chain's
+  //     trailing extra buckets that became empty.
+  // A crash after step 2 can leave unreachable stale copies of moved items in
+  // the old chain. recover_table() removes them by redoing step 3 for the
+  // bucket split last, which is idempotent.
+  bool split_one_bucket() {
+    if (num_active_buckets == max_regular_buckets) return false;
+
+    const size_t split_index = num_active_buckets - level_buckets;
+    const size_t new_index = num_active_buckets;
+    const size_t new_mask = 2 * level_buckets - 1;
+
+    // Collect the old chain, and the items that move to the new bucket
+    split_chain.clear();
+    split_moved_slots.clear();
+    split_chain.push_back(&buckets_[split_index]);
+    while (true) {
+      Bucket* bucket = split_chain.back();
+      for (size_t i = 0; i < kSlotsPerBucket; i++) {
+        const Slot& slot = bucket->slot_arr[i];
+        if (slot.key == invalid_key) continue;
+        if ((get_hash(&slot.key) & new_mask) == new_index) {
+          split_moved_slots.push_back(slot);
+        }
+      }
+
+      if (bucket->next_extra_bucket_idx == 0) break;
+      split_chain.push_back(&extra_buckets_[bucket->next_extra_bucket_idx]);
+    }
+
+    size_t num_new_chain_buckets =
+        (split_moved_slots.size() + kSlotsPerBucket - 1) / kSlotsPerBucket;
+    if (num_new_chain_buckets == 0) num_new_chain_buckets = 1;
+    if (extra_bucket_free_list.size() < num_new_chain_buckets - 1) return false;
+
+    if (kPMicaVerbose) {
+      printf("split bucket %zu into %zu. moving %zu of %zu-bucket chain\n",
+             split_index, new_index, split_moved_slots.size(),
+             split_chain.size());
+    }
+
+    // Step 1: Write the new bucket's chain
+    Bucket* dst_bucket = &buckets_[new_index];
+    size_t num_copied = 0;
+    for (size_t b = 0; b < num_new_chain_buckets; b++) {
+      Bucket v_bucket;
+      memset(static_cast<void*>(&v_bucket), 0, sizeof(Bucket));
+      for (size_t i = 0; i < kSlotsPerBucket; i++) {
+        if (num_copied == split_moved_slots.size()) break;
+        v_bucket.slot_arr[i] = split_moved_slots[num_copied++];
+      }
+
+      if (b + 1 < num_new_chain_buckets) {
+        v_bucket.next_extra_bucket_idx = extra_bucket_free_list.back();
+        extra_bucket_free_list.pop_back();
+      }
+
+      storage.memcpy_nodrain(dst_bucket, &v_bucket, sizeof(Bucket));
+      dst_bucket = &extra_buckets_[v_bucket.next_extra_bucket_idx];
+    }
+    storage.drain();
+
+    // Step 2: Commit the split
+    num_active_buckets++;
+    storage.memcpy_persist(&redo_log->num_active_buckets, &num_active_buckets,
+                           sizeof(size_t));
+    if (num_active_buckets == 2 * level_buckets) level_buckets *= 2;
+
+    // Step 3: Clean up the old chain
+    clean_split_chain(split_index, new_index, new_mask);
+
+    return true;
+  }
+
+  // Invalidate the items in bucket split_index's chain that belong to
+  // bucket new_index with hash mask new_mask, and free the chain's trailing
+  // extra buckets that became empty
+  void clean_split_chain(size_t split_index, size_t new_index,
+                         size_t new_mask) {
+    split_chain.clear();
+    split_chain.push_back(&buckets_[split_index]);
+    while (split_chain.back()->next_extra_bucket_idx != 0) {
+      split_chain.push_back(
+          &extra_buckets_[split_chain.back()->next_extra_bucket_idx]);
+    }
+
+    size_t last_nonempty = 0;  // Index in split_chain of last non-empty bucket
+    for (size_t b = 0; b < split_chain.size(); b++) {
+      Bucket* bucket = split_chain[b];
+      for (size_t i = 0; i < kSlotsPerBucket; i++) {
+        Slot& slot = bucket->slot_arr[i];
+        if (slot.key == invalid_key) continue;
+        if ((get_hash(&slot.key) & new_mask) == new_index) {
+          storage.memcpy_nodrain(&slot.key, &invalid_key, sizeof(Key));
+        } else {
+          last_nonempty = b;
+        }
+      }
+    }
+
+    if (last_nonempty + 1 < split_chain.size()) {
+      // Unlink the empty tail first. Freed buckets must have no successor.
+      Bucket* last_bucket = split_chain[last_nonempty];
+      size_t extra_bucket_index = last_bucket->next_extra_bucket_idx;
+      const size_t zero = 0;
+      storage.memcpy_nodrain(&last_bucket->next_extra_bucket_idx, &zero,
+                             sizeof(size_t));
+
+      for (size_t b = last_nonempty + 1; b < split_chain.size(); b++) {
+        Bucket* bucket = split_chain[b];
+        size_t next_index = bucket->next_extra_bucket_idx;
+        storage.memcpy_nodrain(&bucket->next_extra_bucket_idx, &zero,
+                               sizeof(size_t));
+        extra_bucket_free_list.push_back(extra_bucket_index);
+        extra_bucket_index = next_index;
+      }
+    }
+    storage.drain();
+  }
+
+  // Return the linear hashing round size for a table with num_active
+  // regular buckets: the largest num_regular_buckets * 2^k <= num_active
+  size_t get_level_buckets(size_t num_active) const {
+    size_t level = num_regular_buckets;
+    while (level * 2 <= num_active) level *= 2;
+    return level;
+  }
+
   // Constructor args
   const std::string pmem_file;      // Name of the pmem file
   const size_t file_offset;         // Offset in file where the table is placed
   const size_t num_requested_keys;  // User's requested key capacity
   const double overhead_fraction;   // User's requested key capacity
 
-  const size_t num_regular_buckets;  // Power-of-two number of main buckets
+  const size_t num_regular_buckets;  // Initial power-of-two main buckets
   const size_t num_extra_buckets;    // num_regular_buckets * overhead_fraction
-  const size_t num_total_buckets;    // Sum of regular and extra buckets
+  const size_t max_regular_buckets;  // num_regular_buckets * max_growth
+  const size_t num_total_buckets;    // Sum of max regular and extra buckets
   const size_t reqd_space;           // Total bytes needed for the table
   const Key invalid_key;
 
@@ -463,11 +993,29 @@ class HashMap {
 
   std::vector<size_t> extra_bucket_free_list;
 
+  // Linear hashing state. Buckets [0, num_active_buckets) are in use. The
+  // current round splits buckets [0, level_buckets) into
+  // [level_buckets, 2 * level_buckets).
+  size_t num_active_buckets;
+  size_t level_buckets;
+  size_t num_keys;  // Number of keys in the table
+
+  // Scratch space for split_one_bucket(), kept to avoid allocations
+  std::vector<Bucket*> split_chain;
+  std::vector<Slot> split_moved_slots;
+
+  Storage storage;  // Persistence primitives for pmem or a regular file
+
   uint8_t* pbuf;      // The pmem buffer for this table
-  size_t mapped_len;  // The length mapped by libpmem
+  size_t mapped_len;  // The length of the mapped file
   RedoLog* redo_log;
   size_t cur_sequence_number = 1;
 
+  // Group commit: SETs that are in the redo log, but not yet committed or
+  // applied to the table. Their keys and values are read back from the log.
+  size_t num_uncommitted = 0;
+  size_t uncommitted_keyhash_arr[kNumRedoLogEntries];
+
   struct {
     bool prefetch = true;     // Software prefetching
     bool redo_batch = true;   // Redo log batching
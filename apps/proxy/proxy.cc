@@ -0,0 +1,486 @@
+/**
+ * @file proxy.cc
+ * @brief A load-balancing L7 proxy. Clients send requests to proxy threads,
+ * which pick a backend thread per request and relay the request and response
+ * with Rpc::forward_request().
+ *
+ * Processes [0, num_backend_processes) are backends, the next
+ * num_proxy_processes processes are proxies, and the rest are clients.
+ */
+#include <gflags/gflags.h>
+#include <signal.h>
+#include <cstring>
+#include "../apps_common.h"
+#include "rpc.h"
+#include "util/autorun_helpers.h"
+#include "util/latency.h"
+#include "util/numautils.h"
+
+static constexpr size_t kAppEvLoopMs = 1000; // Duration of event loop
+static constexpr bool kAppVerbose = false;   // Print debug info on datapath
+static constexpr uint8_t kAppReqType = 1;    // Client-to-proxy request type
+static constexpr uint8_t kAppBackendReqType = 2; // Proxy-to-backend type
+static constexpr size_t kAppMaxConcurrency = 128; // Outstanding reqs/thread
+static constexpr double kAppEwmaAlpha = 0.1; // Weight of a new latency sample
+
+// Precision factor for latency measurement
+static constexpr double kAppLatFac = 10.0;
+
+volatile sig_atomic_t ctrl_c_pressed = 0;
+void ctrl_c_handler(int) { ctrl_c_pressed = 1; }
+
+DEFINE_uint64(num_backend_processes, 1, "Number of backend processes");
+DEFINE_uint64(num_backend_threads, 1, "Threads per backend process");
+DEFINE_string(backend_work_us, "0",
+              "Per-request service time of each backend process in "
+              "microseconds, CSV. Missing entries are zero.");
+DEFINE_uint64(num_proxy_processes, 1, "Number of proxy processes");
+DEFINE_uint64(num_proxy_threads, 1, "Threads per proxy process");
+DEFINE_string(lb_policy, "p2c", "Backend selection: p2c or ewma");
+DEFINE_uint64(num_client_threads, 1, "Threads per client process");
+DEFINE_uint64(concurrency, 1, "Concurrent requests per client thread");
+DEFINE_uint64(req_size, 64, "Request size in bytes");
+DEFINE_uint64(resp_size, 64, "Response size in bytes");
+
+size_t get_num_backends()
+{
+  return FLAGS_num_backend_processes * FLAGS_num_backend_threads;
+}
+
+class BackendContext : public BasicAppContext
+{
+public:
+  size_t work_cycles;  // Busy-wait cycles per request
+  size_t num_reqs = 0; // Requests served in this measurement epoch
+};
+
+// A proxy thread's view of one backend thread
+class BackendInfo
+{
+public:
+  size_t num_outstanding = 0; // Requests forwarded but not yet completed
+  double ewma_us = 0.0;       // Moving average of the response latency
+  size_t num_reqs = 0;        // Requests forwarded in this measurement epoch
+  bool dead = false;          // True after the backend's session is reset
+};
+
+// Per-request state at a proxy, passed to forward_request() as the tag
+struct fwd_tag_t
+{
+  size_t backend_idx;
+  size_t start_tsc;
+};
+
+class ProxyContext : public BasicAppContext
+{
+public:
+  bool use_ewma;
+  std::vector<BackendInfo> backends; // Indexed like session_num_vec_
+  size_t num_live_backends = 0;      // Backends that are not dead
+  AppMemPool<fwd_tag_t> fwd_tag_pool;
+  size_t num_reqs = 0;
+
+  // The load metric for power-of-two-choices. With the EWMA policy, the
+  // latency average is scaled by the backend's outstanding requests, so that
+  // requests that have not completed yet count too.
+  double get_cost(size_t backend_idx) const
+  {
+    const BackendInfo &b = backends[backend_idx];
+    if (!use_ewma)
+      return b.num_outstanding;
+    return b.ewma_us * (b.num_outstanding + 1);
+  }
+
+  // Return a random backend that is not dead. Dead backends are rare, so
+  // rejection sampling is cheap.
+  size_t pick_live_backend()
+  {
+    size_t b;
+    do
+    {
+      b = fastrand_.next_u32() % backends.size();
+    } while (unlikely(backends[b].dead));
+    return b;
+  }
+
+  // Pick the less loaded of two distinct random live backends. There must be
+  // at least one live backend.
+  size_t pick_backend()
+  {
+    const size_t b1 = pick_live_backend();
+    if (num_live_backends == 1)
+      return b1;
+
+    size_t b2 = pick_live_backend();
+    while (b2 == b1)
+      b2 = pick_live_backend();
+
+    return get_cost(b1) <= get_cost(b2) ? b1 : b2;
+  }
+};
+
+class ClientContext : public BasicAppContext
+{
+public:
+  size_t num_resps = 0;
+  erpc::Latency latency;
+
+  size_t start_tsc[kAppMaxConcurrency];
+  erpc::MsgBuffer req_msgbuf[kAppMaxConcurrency];
+  erpc::MsgBuffer resp_msgbuf[kAppMaxConcurrency];
+};
+
+void backend_req_handler(erpc::ReqHandle *req_handle, void *_context)
+{
+  auto *c = static_cast<BackendContext *>(_context);
+
+  if (c->work_cycles > 0)
+  {
+    const size_t start_tsc = erpc::rdtsc();
+    while (erpc::rdtsc() - start_tsc < c->work_cycles)
+    {
+      // Emulate request processing
+    }
+  }
+
+  erpc::MsgBuffer *resp_msgbuf = &req_handle->pre_resp_msgbuf_;
+  if (FLAGS_resp_size <= erpc::Rpc<erpc::CTransport>::get_max_data_per_pkt())
+  {
+    erpc::Rpc<erpc::CTransport>::resize_msg_buffer(resp_msgbuf,
+                                                   FLAGS_resp_size);
+  }
+  else
+  {
+    resp_msgbuf = &req_handle->dyn_resp_msgbuf_;
+    *resp_msgbuf = c->rpc_->alloc_msg_buffer_or_die(FLAGS_resp_size);
+  }
+
+  c->rpc_->enqueue_response(req_handle, resp_msgbuf);
+  c->num_reqs++;
+}
+
+void proxy_fwd_cont(void *, void *); // Forward declaration
+
+void proxy_req_handler(erpc::ReqHandle *req_handle, void *_context)
+{
+  auto *c = static_cast<ProxyContext *>(_context);
+  if (unlikely(c->num_live_backends == 0))
+  {
+    // Clients may connect before this thread connects to the backends, and
+    // all backends may fail. An empty response makes the client retry.
+    erpc::Rpc<erpc::CTransport>::resize_msg_buffer(
+        &req_handle->pre_resp_msgbuf_, 0);
+    c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+    return;
+  }
+
+  const size_t backend_idx = c->pick_backend();
+
+  fwd_tag_t *fwd_tag = c->fwd_tag_pool.alloc();
+  fwd_tag->backend_idx = backend_idx;
+  fwd_tag->start_tsc = erpc::rdtsc();
+
+  c->backends[backend_idx].num_outstanding++;
+  c->backends[backend_idx].num_reqs++;
+
+  if (kAppVerbose)
+  {
+    printf("proxy: Thread %zu forwarding request to backend %zu.\n",
+           c->thread_id_, backend_idx);
+  }
+
+  // The request and the backend's response are relayed without copies
+  c->rpc_->forward_request(req_handle, c->session_num_vec_[backend_idx],
+                           kAppBackendReqType, proxy_fwd_cont, fwd_tag);
+}
+
+// Invoked after the backend's response is relayed to the client
+void proxy_fwd_cont(void *_context, void *_tag)
+{
+  auto *c = static_cast<ProxyContext *>(_context);
+  auto *fwd_tag = static_cast<fwd_tag_t *>(_tag);
+  BackendInfo &b = c->backends[fwd_tag->backend_idx];
+
+  // A failed request gets an empty response quickly, so its latency would
+  // make the failed backend look fast
+  const int session_num = c->session_num_vec_[fwd_tag->backend_idx];
+  if (likely(c->rpc_->is_connected(session_num)))
+  {
+    const double lat_us = erpc::to_usec(erpc::rdtsc() - fwd_tag->start_tsc,
+                                        c->rpc_->get_freq_ghz());
+    b.ewma_us = b.ewma_us == 0.0
+                    ? lat_us
+                    : kAppEwmaAlpha * lat_us + (1 - kAppEwmaAlpha) * b.ewma_us;
+  }
+  b.num_outstanding--;
+
+  c->fwd_tag_pool.free(fwd_tag);
+  c->num_reqs++;
+}
+
+// Session management handler for proxy threads. A backend whose session is
+// reset, e.g., because the backend failed, is not picked again.
+void proxy_sm_handler(int session_num, erpc::SmEventType sm_event_type,
+                      erpc::SmErrType sm_err_type, void *_context)
+{
+  auto *c = static_cast<ProxyContext *>(_context);
+  if (c->backends.empty())
+  {
+    // Still connecting to the backends
+    basic_sm_handler(session_num, sm_event_type, sm_err_type, _context);
+    return;
+  }
+
+  erpc::rt_assert(sm_event_type == erpc::SmEventType::kDisconnected,
+                  "Received unexpected SM event.");
+
+  for (size_t i = 0; i < c->session_num_vec_.size(); i++)
+  {
+    if (c->session_num_vec_[i] != session_num || c->backends[i].dead)
+      continue;
+
+    c->backends[i].dead = true;
+    c->num_live_backends--;
+    fprintf(stderr,
+            "proxy: Thread %zu lost backend %zu (%s). %zu backends left.\n",
+            c->thread_id_, i, erpc::sm_err_type_str(sm_err_type).c_str(),
+            c->num_live_backends);
+  }
+}
+
+// Create sessions from this thread to all threads of the given processes, and
+// wait for them to connect
+void connect_sessions(BasicAppContext &c, size_t first_process,
+                      size_t num_processes, size_t threads_per_process)
+{
+  for (size_t p = first_process; p < first_process + num_processes; p++)
+  {
+    const std::string uri = erpc::get_uri_for_process(p);
+    for (size_t t = 0; t < threads_per_process; t++)
+    {
+      if (FLAGS_sm_verbose == 1)
+      {
+        printf("Process %zu, thread %zu: Creating session to %s, "
+               "thread %zu.\n",
+               FLAGS_process_id, c.thread_id_, uri.c_str(), t);
+      }
+
+      const int session_num =
+          c.rpc_->create_session(uri, static_cast<uint8_t>(t));
+      erpc::rt_assert(session_num >= 0, "Failed to create session");
+      c.session_num_vec_.push_back(session_num);
+    }
+  }
+
+  while (c.num_sm_resps_ != c.session_num_vec_.size())
+  {
+    c.rpc_->run_event_loop(kAppEvLoopMs);
+    if (unlikely(ctrl_c_pressed == 1))
+      return;
+  }
+}
+
+void backend_func(size_t thread_id, erpc::Nexus *nexus)
+{
+  std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
+  erpc::rt_assert(port_vec.size() > 0);
+  uint8_t phy_port = port_vec.at(thread_id % port_vec.size());
+
+  BackendContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c),
+                                  static_cast<uint8_t>(thread_id),
+                                  basic_sm_handler, phy_port);
+  c.rpc_ = &rpc;
+  c.thread_id_ = thread_id;
+
+  // Backends may be heterogeneous
+  std::vector<std::string> work_vec = erpc::split(FLAGS_backend_work_us, ',');
+  const double work_us = FLAGS_process_id < work_vec.size()
+                             ? std::stod(work_vec[FLAGS_process_id])
+                             : 0.0;
+  c.work_cycles = erpc::us_to_cycles(work_us, rpc.get_freq_ghz());
+
+  while (ctrl_c_pressed == 0)
+  {
+    rpc.run_event_loop(kAppEvLoopMs);
+    printf("proxy backend: Process %zu, thread %zu, work %.1f us: "
+           "rate %.2f M/s\n",
+           FLAGS_process_id, thread_id, work_us,
+           c.num_reqs / (kAppEvLoopMs * 1000.0));
+    c.num_reqs = 0;
+  }
+}
+
+void proxy_func(size_t thread_id, erpc::Nexus *nexus)
+{
+  std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
+  erpc::rt_assert(port_vec.size() > 0);
+  uint8_t phy_port = port_vec.at(thread_id % port_vec.size());
+
+  ProxyContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c),
+                                  static_cast<uint8_t>(thread_id),
+                                  proxy_sm_handler, phy_port);
+  rpc.retry_connect_on_invalid_rpc_id_ = true;
+  c.rpc_ = &rpc;
+  c.thread_id_ = thread_id;
+  c.use_ewma = FLAGS_lb_policy == "ewma";
+
+  // Every proxy thread has a session to every backend thread
+  connect_sessions(c, 0, FLAGS_num_backend_processes,
+                   FLAGS_num_backend_threads);
+  c.backends.resize(c.session_num_vec_.size());
+  c.num_live_backends = c.backends.size(); // Start forwarding
+  printf("proxy: Thread %zu connected to %zu backends.\n", thread_id,
+         c.backends.size());
+
+  while (ctrl_c_pressed == 0)
+  {
+    rpc.run_event_loop(kAppEvLoopMs);
+
+    std::string share_str;
+    for (size_t i = 0; i < c.backends.size(); i++)
+    {
+      BackendInfo &b = c.backends[i];
+      const double share =
+          b.num_reqs * 100.0 / std::max(c.num_reqs, static_cast<size_t>(1));
+      share_str += std::to_string(static_cast<size_t>(share)) + "%";
+      if (b.dead)
+        share_str += "/dead";
+      if (c.use_ewma)
+      {
+        share_str +=
+            "/" + std::to_string(static_cast<size_t>(b.ewma_us)) + "us";
+      }
+      share_str += i + 1 < c.backends.size() ? " " : "";
+      b.num_reqs = 0;
+    }
+
+    printf("proxy: Thread %zu (%s): rate %.2f M/s. Backend shares [%s]\n",
+           thread_id, FLAGS_lb_policy.c_str(),
+           c.num_reqs / (kAppEvLoopMs * 1000.0), share_str.c_str());
+    c.num_reqs = 0;
+  }
+}
+
+void client_cont(void *, void *); // Forward declaration
+
+void send_req(ClientContext &c, size_t slot_i)
+{
+  c.start_tsc[slot_i] = erpc::rdtsc();
+  c.rpc_->enqueue_request(c.fast_get_rand_session_num(), kAppReqType,
+                          &c.req_msgbuf[slot_i], &c.resp_msgbuf[slot_i],
+                          client_cont, reinterpret_cast<void *>(slot_i));
+}
+
+void client_cont(void *_context, void *_tag)
+{
+  auto *c = static_cast<ClientContext *>(_context);
+  const auto slot_i = reinterpret_cast<size_t>(_tag);
+
+  // The proxy sends an empty response if it's not connected to the backends
+  // yet, or if the backend failed
+  if (unlikely(c->resp_msgbuf[slot_i].get_data_size() == 0))
+  {
+    send_req(*c, slot_i);
+    return;
+  }
+
+  erpc::rt_assert(c->resp_msgbuf[slot_i].get_data_size() == FLAGS_resp_size,
+                  "Invalid response size");
+
+  const double lat_us = erpc::to_usec(erpc::rdtsc() - c->start_tsc[slot_i],
+                                      c->rpc_->get_freq_ghz());
+  c->latency.update(static_cast<size_t>(lat_us * kAppLatFac));
+  c->num_resps++;
+
+  send_req(*c, slot_i);
+}
+
+void client_func(size_t thread_id, erpc::Nexus *nexus)
+{
+  std::vector<size_t> port_vec = flags_get_numa_ports(FLAGS_numa_node);
+  erpc::rt_assert(port_vec.size() > 0);
+  uint8_t phy_port = port_vec.at(thread_id % port_vec.size());
+
+  ClientContext c;
+  erpc::Rpc<erpc::CTransport> rpc(nexus, static_cast<void *>(&c),
+                                  static_cast<uint8_t>(thread_id),
+                                  basic_sm_handler, phy_port);
+  rpc.retry_connect_on_invalid_rpc_id_ = true;
+  c.rpc_ = &rpc;
+  c.thread_id_ = thread_id;
+
+  // Requests are spread uniformly over all proxy threads
+  connect_sessions(c, FLAGS_num_backend_processes, FLAGS_num_proxy_processes,
+                   FLAGS_num_proxy_threads);
+  printf("proxy client: Thread %zu connected to %zu proxy threads.\n",
+         thread_id, c.session_num_vec_.size());
+
+  for (size_t i = 0; i < FLAGS_concurrency; i++)
+  {
+    c.req_msgbuf[i] = rpc.alloc_msg_buffer_or_die(FLAGS_req_size);
+    c.resp_msgbuf[i] = rpc.alloc_msg_buffer_or_die(FLAGS_resp_size);
+    memset(c.req_msgbuf[i].buf_, static_cast<int>(i), FLAGS_req_size);
+    send_req(c, i);
+  }
+
+  for (size_t i = 0; i < FLAGS_test_ms; i += kAppEvLoopMs)
+  {
+    rpc.run_event_loop(kAppEvLoopMs);
+    if (ctrl_c_pressed == 1)
+      break;
+
+    printf("proxy client: Thread %zu: rate %.2f M/s, latency "
+           "{%.1f 50, %.1f 99, %.1f 99.9} us\n",
+           thread_id, c.num_resps / (kAppEvLoopMs * 1000.0),
+           c.latency.perc(.50) / kAppLatFac, c.latency.perc(.99) / kAppLatFac,
+           c.latency.perc(.999) / kAppLatFac);
+
+    c.num_resps = 0;
+    c.latency.reset();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  signal(SIGINT, ctrl_c_handler);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  erpc::rt_assert(FLAGS_numa_node <= 1, "Invalid NUMA node");
+  erpc::rt_assert(FLAGS_process_id < FLAGS_num_processes, "Invalid process ID");
+  erpc::rt_assert(FLAGS_num_processes >
+                      FLAGS_num_backend_processes + FLAGS_num_proxy_processes,
+                  "Need at least one client process");
+  erpc::rt_assert(get_num_backends() > 0, "Need at least one backend");
+  erpc::rt_assert(FLAGS_lb_policy == "p2c" || FLAGS_lb_policy == "ewma",
+                  "Invalid load balancing policy");
+  erpc::rt_assert(FLAGS_concurrency <= kAppMaxConcurrency, "Invalid conc");
+
+  erpc::Nexus nexus(erpc::get_uri_for_process(FLAGS_process_id),
+                    FLAGS_numa_node, 0);
+  nexus.register_req_func(kAppReqType, proxy_req_handler);
+  nexus.register_req_func(kAppBackendReqType, backend_req_handler);
+
+  std::vector<std::thread> threads;
+  if (FLAGS_process_id < FLAGS_num_backend_processes)
+  {
+    for (size_t i = 0; i < FLAGS_num_backend_threads; i++)
+      threads.emplace_back(backend_func, i, &nexus);
+  }
+  else if (FLAGS_process_id <
+           FLAGS_num_backend_processes + FLAGS_num_proxy_processes)
+  {
+    for (size_t i = 0; i < FLAGS_num_proxy_threads; i++)
+      threads.emplace_back(proxy_func, i, &nexus);
+  }
+  else
+  {
+    for (size_t i = 0; i < FLAGS_num_client_threads; i++)
+      threads.emplace_back(client_func, i, &nexus);
+  }
+
+  for (size_t i = 0; i < threads.size(); i++)
+    erpc::bind_to_core(threads[i], FLAGS_numa_node, i);
+  for (auto &thread : threads)
+    thread.join();
+}
@@ -9,18 +9,20 @@
 // With eRPC, there is currently no way for an RPC server to access connection
 // data for a request, so the client's Raft node ID is included in the request.
 struct app_appendentries_t {
+  size_t group_id;
   int node_id;  // Node ID of the sender
   msg_appendentries_t msg_ae;
   // If ae.n_entries > 0, the msg_entry_t structs are serialized here. Each
   // msg_entry_t struct's buf is placed immediately after the struct.
 
   // Serialize the ingredients of an app_appendentries_t into a network buffer
-  static void serialize(erpc::MsgBuffer &req_msgbuf, int node_id,
-                        msg_appendentries_t *msg_ae) {
+  static void serialize(erpc::MsgBuffer &req_msgbuf, size_t group_id,
+                        int node_id, msg_appendentries_t *msg_ae) {
     uint8_t *buf = req_msgbuf.buf_;
     auto *srlz = reinterpret_cast<app_appendentries_t *>(req_msgbuf.buf_);
 
     // Copy the whole-message header
+    srlz->group_id = group_id;
     srlz->node_id = node_id;
     srlz->msg_ae = *msg_ae;
     srlz->msg_ae.entries = nullptr;  // Was local pointer
@@ -89,8 +91,10 @@ struct app_appendentries_t {
 // appendentries request format is like so:
 // node ID, msg_appendentries_t, [{size, buf}]
 void appendentries_handler(erpc::ReqHandle *req_handle, void *_context) {
-  auto *c = static_cast<AppContext *>(_context);
   const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  AppContext *c = get_group_context(
+      _context,
+      reinterpret_cast<app_appendentries_t *>(req_msgbuf->buf_)->group_id);
 
   if (kAppTimeEnt) c->server.time_ents.emplace_back(TimeEntType::kRecvAeReq);
 
@@ -121,29 +125,96 @@ void appendentries_handler(erpc::ReqHandle *req_handle, void *_context) {
       reinterpret_cast<msg_appendentries_response_t *>(resp_msgbuf.buf_));
   erpc::rt_assert(e == 0, "raft_recv_appendentries failed");
 
+  // Entries that we already had were not appended, e.g., if a pipelined
+  // request was resent. Return their buffers to the pool.
+  for (size_t i = 0; i < static_cast<size_t>(msg_ae.n_entries); i++) {
+    raft_entry_t *ety = raft_get_entry_from_idx(
+        c->server.raft, msg_ae.prev_log_idx + 1 + static_cast<raft_index_t>(i));
+    if (ety == nullptr || ety->data.buf != msg_ae.entries[i].data.buf) {
+      c->server.log_entry_appdata_pool.free(
+          static_cast<client_req_t *>(msg_ae.entries[i].data.buf));
+    }
+  }
+
   if (msg_ae.entries != static_msg_entry_arr) delete[] msg_ae.entries;
 
+  // With a file-backed log, respond after the appended entries are durable
+  if (c->server.file_log != nullptr) {
+    c->server.unflushed_ae_resps.push_back(req_handle);
+    return;
+  }
+
   if (kAppTimeEnt) c->server.time_ents.emplace_back(TimeEntType::kSendAeResp);
   c->rpc->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
 }
 
+// Group commit for the file-backed log: Write the entries appended in this
+// event loop iteration with one flush, and then send the appendentries
+// responses that waited for them. Responses to the leader claim all entries
+// in our log, so this must be called before sending any appendentries or
+// requestvote response.
+void flush_raft_log(AppContext *c) {
+  if (c->server.file_log == nullptr) return;
+  c->server.file_log->flush();
+
+  for (erpc::ReqHandle *req_handle : c->server.unflushed_ae_resps) {
+    if (kAppTimeEnt) c->server.time_ents.emplace_back(TimeEntType::kSendAeResp);
+    c->rpc->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+  }
+  c->server.unflushed_ae_resps.clear();
+}
+
 void appendentries_cont(void *, void *);  // Fwd decl
 
-// Raft callback for sending appendentries message
+// Raft callback for sending appendentries message.
+//
+// willemt/raft advances a follower's next index only when a response arrives,
+// so it asks us to resend entries that are already in flight. We pipeline
+// appendentries by skipping the entries that are already in flight and
+// sending only the newer entries, with up to kAppMaxAeInflight requests
+// outstanding per follower.
 static int smr_raft_send_appendentries_cb(raft_server_t *, void *,
                                           raft_node_t *node,
-                                          msg_appendentries_t *msg_ae) {
+                                          msg_appendentries_t *_msg_ae) {
   auto *conn = static_cast<connection_t *>(raft_node_get_udata(node));
   AppContext *c = conn->c;
 
-  bool is_keepalive = (msg_ae->n_entries == 0);
-  if (kAppVerbose) {
-    printf("smr: Sending appendentries (%s) to node %s [%s].\n",
-           is_keepalive ? "keepalive" : "non-keepalive",
-           node_id_to_name_map[raft_node_get_id(node)].c_str(),
-           erpc::get_formatted_time().c_str());
+  // A batch is being appended. It's sent after the whole batch is in the log.
+  if (c->server.defer_ae_send) return 0;
+
+  msg_appendentries_t msg_ae_copy = *_msg_ae;
+  msg_appendentries_t *msg_ae = &msg_ae_copy;
+
+  if (conn->ae_term != msg_ae->term) {
+    conn->ae_term = msg_ae->term;
+    conn->ae_last_sent_idx = 0;
+  }
+
+  if (msg_ae->n_entries > 0 && conn->ae_last_sent_idx > msg_ae->prev_log_idx) {
+    const int n_inflight = static_cast<int>(std::min(
+        static_cast<raft_index_t>(msg_ae->n_entries),
+        conn->ae_last_sent_idx - msg_ae->prev_log_idx));
+    if (n_inflight == msg_ae->n_entries) {
+      if (!c->server.force_ae_send) return 0;
+      msg_ae->n_entries = 0;  // Send a heartbeat
+    } else {
+      msg_ae->prev_log_idx += n_inflight;
+      msg_ae->prev_log_term = msg_ae->entries[n_inflight - 1].term;
+      msg_ae->entries += n_inflight;
+      msg_ae->n_entries -= n_inflight;
+    }
   }
 
+  // If the pipeline is full, the entries are sent when a response arrives
+  if (msg_ae->n_entries > 0 && conn->ae_num_inflight >= kAppMaxAeInflight) {
+    if (!c->server.force_ae_send) return 0;
+
+    // Send a heartbeat for an entry that the follower has
+    msg_ae_copy = *_msg_ae;
+    msg_ae->n_entries = 0;
+  }
+  msg_ae->n_entries = std::min(msg_ae->n_entries, kAppMaxAeEntries);
+
   if (!c->rpc->is_connected(conn->session_num)) {
     if (kAppVerbose) {
       printf("smr: Cannot send ae req on session %d.\n", conn->session_num);
@@ -151,8 +222,26 @@ static int smr_raft_send_appendentries_cb(raft_server_t *, void *,
     return 0;
   }
 
-  // Compute the request size. Keepalive appendentries requests do not have
-  // a buffer, but they have an unused msg_entry_t (???).
+  if (msg_ae->n_entries == 0) {
+    // Heartbeats are sent in this thread's heartbeat batch for the follower
+    app_heartbeat_t heartbeat;
+    heartbeat.group_id = c->server.group_id;
+    heartbeat.node_id = c->server.node_id;
+    heartbeat.msg_ae = *msg_ae;
+    heartbeat.msg_ae.entries = nullptr;  // Was local pointer
+    c->server.thread->heartbeat_batch_vec[conn->session_idx].push_back(
+        heartbeat);
+    conn->ae_num_inflight++;
+    return 0;
+  }
+
+  if (kAppVerbose) {
+    printf("smr: Sending appendentries to node %s [%s].\n",
+           node_id_to_name_map[raft_node_get_id(node)].c_str(),
+           erpc::get_formatted_time().c_str());
+  }
+
+  // Compute the request size
   size_t req_size = sizeof(app_appendentries_t);
   for (size_t i = 0; i < static_cast<size_t>(msg_ae->n_entries); i++) {
     assert(msg_ae->entries[i].data.len == sizeof(client_req_t));
@@ -167,42 +256,79 @@ static int smr_raft_send_appendentries_cb(raft_server_t *, void *,
   rrt->resp_msgbuf =
       c->rpc->alloc_msg_buffer_or_die(sizeof(msg_appendentries_response_t));
   rrt->node = node;
+  rrt->send_tsc = erpc::rdtsc();
 
-  app_appendentries_t::serialize(rrt->req_msgbuf, c->server.node_id, msg_ae);
+  app_appendentries_t::serialize(rrt->req_msgbuf, c->server.group_id,
+                                 c->server.node_id, msg_ae);
 
   if (kAppTimeEnt) c->server.time_ents.emplace_back(TimeEntType::kSendAeReq);
   c->rpc->enqueue_request(conn->session_num,
                           static_cast<uint8_t>(ReqType::kAppendEntries),
                           &rrt->req_msgbuf, &rrt->resp_msgbuf,
                           appendentries_cont, reinterpret_cast<void *>(rrt));
+
+  conn->ae_num_inflight++;
+  conn->ae_last_sent_idx = msg_ae->prev_log_idx + msg_ae->n_entries;
   return 0;
 }
 
-void appendentries_cont(void *_context, void *_tag) {
-  auto *c = static_cast<AppContext *>(_context);
-  if (kAppTimeEnt) c->server.time_ents.emplace_back(TimeEntType::kRecvAeResp);
-  auto *rrt = reinterpret_cast<raft_req_tag_t *>(_tag);
+// Process the response to an appendentries request or heartbeat sent to
+// \p node at \p send_tsc. \p ae_resp is nullptr if the RPC failed.
+void process_appendentries_resp(AppContext *c, raft_node_t *node,
+                                uint64_t send_tsc,
+                                msg_appendentries_response_t *ae_resp) {
+  // This must be done before processing the response, which may send more
+  // entries to this follower
+  auto *conn = static_cast<connection_t *>(raft_node_get_udata(node));
+  assert(conn->ae_num_inflight > 0);
+  conn->ae_num_inflight--;
 
-  if (likely(rrt->resp_msgbuf.get_data_size() > 0)) {
+  if (likely(ae_resp != nullptr)) {
     // The RPC was successful
     if (kAppVerbose) {
       printf("smr: Received appendentries response from node %s [%s].\n",
-             node_id_to_name_map[raft_node_get_id(rrt->node)].c_str(),
+             node_id_to_name_map[raft_node_get_id(node)].c_str(),
              erpc::get_formatted_time().c_str());
     }
 
-    int e = raft_recv_appendentries_response(
-        c->server.raft, rrt->node,
-        reinterpret_cast<msg_appendentries_response_t *>(
-            rrt->resp_msgbuf.buf_));
+    // On a log mismatch, willemt/raft retries from an earlier entry, so entries
+    // sent after this request must not be skipped anymore
+    if (ae_resp->success == 0) conn->ae_last_sent_idx = 0;
+
+    // Any response in our term means that the follower accepted us as the
+    // leader when it received the request, which extends our lease
+    if (raft_is_leader(c->server.raft) &&
+        ae_resp->term == raft_get_current_term(c->server.raft)) {
+      if (conn->lease_ack_term != ae_resp->term) conn->lease_ack_tsc = 0;
+      conn->lease_ack_tsc = std::max(conn->lease_ack_tsc, send_tsc);
+      conn->lease_ack_term = ae_resp->term;
+    }
+
+    int e = raft_recv_appendentries_response(c->server.raft, node, ae_resp);
     erpc::rt_assert(e == 0 || e == RAFT_ERR_NOT_LEADER,
                     "raft_recv_appendentries_response error");
   } else {
-    // The RPC failed. Fall through and call raft_periodic() again.
+    // The RPC failed. Fall through and call raft_periodic() again, which
+    // resends all unacknowledged entries.
+    conn->ae_last_sent_idx = 0;
     printf("smr: Appendentries RPC to node %s failed to complete [%s].\n",
-           node_id_to_name_map[raft_node_get_id(rrt->node)].c_str(),
+           node_id_to_name_map[raft_node_get_id(node)].c_str(),
            erpc::get_formatted_time().c_str());
   }
+}
+
+void appendentries_cont(void *, void *_tag) {
+  auto *rrt = reinterpret_cast<raft_req_tag_t *>(_tag);
+  auto *conn = static_cast<connection_t *>(raft_node_get_udata(rrt->node));
+  AppContext *c = conn->c;
+  if (kAppTimeEnt) c->server.time_ents.emplace_back(TimeEntType::kRecvAeResp);
+
+  const bool success = rrt->resp_msgbuf.get_data_size() > 0;
+  process_appendentries_resp(
+      c, rrt->node, rrt->send_tsc,
+      success ? reinterpret_cast<msg_appendentries_response_t *>(
+                    rrt->resp_msgbuf.buf_)
+              : nullptr);
 
   c->rpc->free_msg_buffer(rrt->req_msgbuf);
   c->rpc->free_msg_buffer(rrt->resp_msgbuf);
@@ -6,19 +6,29 @@
 #pragma once
 #include "smr.h"
 
-// Change the leader to a different Raft server that we are connected to
-void change_leader_to_any(AppContext *c) {
-  size_t cur_leader_idx = c->client.leader_idx;
-  printf("smr: Client change_leader_to_any() from current leader %zu.\n",
-         c->client.leader_idx);
+// Return the session to the thread hosting a Raft group at a Raft server
+connection_t &get_group_conn(AppContext *c, size_t group_id,
+                             size_t server_idx) {
+  return c->conn_vec[server_idx * FLAGS_num_server_threads +
+                     get_thread_for_group(group_id)];
+}
+
+// Change a group's leader to a different Raft server that we are connected to
+void change_leader_to_any(AppContext *c, size_t group_id) {
+  size_t cur_leader_idx = c->client.leader_idx[group_id];
+  printf(
+      "smr: Client change_leader_to_any() for group %zu from current leader "
+      "%zu.\n",
+      group_id, cur_leader_idx);
 
   // Pick the next session to a Raft server that is not disconnected
   for (size_t i = 1; i < FLAGS_num_raft_servers; i++) {
     size_t next_leader_idx = (cur_leader_idx + i) % FLAGS_num_raft_servers;
-    if (!c->conn_vec[next_leader_idx].disconnected) {
-      c->client.leader_idx = next_leader_idx;
+    if (!get_group_conn(c, group_id, next_leader_idx).disconnected) {
+      c->client.leader_idx[group_id] = next_leader_idx;
 
-      printf("smr: Client changed leader view to %zu.\n", c->client.leader_idx);
+      printf("smr: Client changed leader view for group %zu to %zu.\n",
+             group_id, next_leader_idx);
       return;
     }
   }
@@ -27,15 +37,15 @@ void change_leader_to_any(AppContext *c) {
   exit(0);
 }
 
-// Change the leader to a server with the given Raft node ID
-bool change_leader_to_node(AppContext *c, int raft_node_id) {
+// Change a group's leader to a server with the given Raft node ID
+bool change_leader_to_node(AppContext *c, size_t group_id, int raft_node_id) {
   // Pick the next session to a Raft server that is not disconnected
   for (size_t i = 0; i < FLAGS_num_raft_servers; i++) {
     if (raft_node_id == get_raft_node_id_for_process(i)) {
       // Ignore if we're being redirected to a failed Raft server
-      if (c->conn_vec[i].disconnected) return false;
+      if (get_group_conn(c, group_id, i).disconnected) return false;
 
-      c->client.leader_idx = i;
+      c->client.leader_idx[group_id] = i;
       return true;
     }
   }
@@ -46,30 +56,54 @@ bool change_leader_to_node(AppContext *c, int raft_node_id) {
 
 void client_cont(void *, void *);  // Forward declaration
 
-void send_req_one(AppContext *c) {
-  c->client.chrono_timer.reset();
+// Send a request using the msgbufs for window slot \p slot_i
+void send_req_one(AppContext *c, size_t slot_i) {
+  c->client.chrono_timer[slot_i].reset();
 
-  // Format the client's PUT request. Key and value are identical.
-  auto *req = reinterpret_cast<client_req_t *>(c->client.req_msgbuf.buf_);
+  erpc::MsgBuffer &req_msgbuf = c->client.req_msgbuf[slot_i];
   size_t rand_key = c->fast_rand.next_u32() & (kAppNumKeys - 1);
-  req->key = rand_key;
-  req->value.v[0] = rand_key;
+  const size_t group_id = get_group_for_key(rand_key);
+  const size_t leader_idx = c->client.leader_idx[group_id];
+  const bool is_get = c->fast_rand.next_u32() % 100 < FLAGS_get_percent;
+  c->client.slot_is_get[slot_i] = is_get;
+
+  if (is_get) {
+    c->rpc->resize_msg_buffer(&req_msgbuf, sizeof(client_get_req_t));
+    auto *get_req = reinterpret_cast<client_get_req_t *>(req_msgbuf.buf_);
+    get_req->key = rand_key;
+  } else {
+    // Format the client's PUT request. Key and value are identical.
+    c->rpc->resize_msg_buffer(&req_msgbuf, sizeof(client_req_t));
+    auto *req = reinterpret_cast<client_req_t *>(req_msgbuf.buf_);
+    req->key = rand_key;
+    req->value.v[0] = rand_key;
 
-  if (kAppVerbose) {
-    printf("smr: Client sending request %s to leader index %zu [%s].\n",
-           req->to_string().c_str(), c->client.leader_idx,
-           erpc::get_formatted_time().c_str());
+    if (kAppVerbose) {
+      printf(
+          "smr: Client sending request %s to group %zu leader index %zu "
+          "[%s].\n",
+          req->to_string().c_str(), group_id, leader_idx,
+          erpc::get_formatted_time().c_str());
+    }
   }
 
-  connection_t &conn = c->conn_vec[c->client.leader_idx];
-  c->rpc->enqueue_request(
-      conn.session_num, static_cast<uint8_t>(ReqType::kClientReq),
-      &c->client.req_msgbuf, &c->client.resp_msgbuf, client_cont, nullptr);
+  c->client.slot_group[slot_i] = group_id;
+  c->client.slot_leader_idx[slot_i] = leader_idx;
+  connection_t &conn = get_group_conn(c, group_id, leader_idx);
+  const ReqType req_type = is_get ? ReqType::kClientGet : ReqType::kClientReq;
+  c->rpc->enqueue_request(conn.session_num, static_cast<uint8_t>(req_type),
+                          &req_msgbuf,
+                          &c->client.resp_msgbuf[slot_i], client_cont,
+                          reinterpret_cast<void *>(slot_i));
 }
 
-void client_cont(void *_context, void *) {
+void client_cont(void *_context, void *_tag) {
   auto *c = static_cast<AppContext *>(_context);
-  const double latency_us = c->client.chrono_timer.get_ns() / 1000.0;
+  const auto slot_i = reinterpret_cast<size_t>(_tag);
+  const erpc::MsgBuffer &resp_msgbuf = c->client.resp_msgbuf[slot_i];
+  const size_t group_id = c->client.slot_group[slot_i];
+
+  const double latency_us = c->client.chrono_timer[slot_i].get_ns() / 1000.0;
   c->client.lat_us_hdr_histogram.insert(latency_us);
   c->client.num_resps_this_measurement++;
   c->client.num_resps_total++;
@@ -81,14 +115,14 @@ void client_cont(void *_context, void *) {
     printf(
         "smr: Latency us = "
         "{%.2f 50, %.2f 99, %.2f 99.9, %.2f 99.99, %.2f 99.999, %.2f max}. "
-        "Cumulative num responses %zu, request window = %zu (best 1).\n",
+        "Cumulative num responses %zu, request window = %zu.\n",
         c->client.lat_us_hdr_histogram.percentile(50.0),
         c->client.lat_us_hdr_histogram.percentile(99),
         c->client.lat_us_hdr_histogram.percentile(99.9),
         c->client.lat_us_hdr_histogram.percentile(99.99),
         c->client.lat_us_hdr_histogram.percentile(99.999),
         c->client.lat_us_hdr_histogram.max(), c->client.num_resps_total,
-        erpc::kSessionReqWindow);
+        FLAGS_client_window);
 
     // Warmup for the first few epochs
     if (c->client.num_console_prints <= 4) {
@@ -97,10 +131,9 @@ void client_cont(void *_context, void *) {
     }
   }
 
-  if (likely(c->client.resp_msgbuf.get_data_size() > 0)) {
+  if (likely(resp_msgbuf.get_data_size() > 0)) {
     // The RPC was successful
-    auto *client_resp =
-        reinterpret_cast<client_resp_t *>(c->client.resp_msgbuf.buf_);
+    auto *client_resp = reinterpret_cast<client_resp_t *>(resp_msgbuf.buf_);
 
     if (kAppVerbose) {
       printf("smr: Client received resp %s [%s].\n",
@@ -110,23 +143,34 @@ void client_cont(void *_context, void *) {
 
     switch (client_resp->resp_type) {
       case ClientRespType::kSuccess: {
+        if (c->client.slot_is_get[slot_i]) {
+          // Keys and values are identical in all PUTs
+          auto *get_resp =
+              reinterpret_cast<client_get_resp_t *>(resp_msgbuf.buf_);
+          const auto *get_req = reinterpret_cast<client_get_req_t *>(
+              c->client.req_msgbuf[slot_i].buf_);
+          erpc::rt_assert(
+              !get_resp->found || get_resp->value.v[0] == get_req->key,
+              "GET returned an incorrect value");
+        }
         break;
       }
 
       case ClientRespType::kFailRedirect: {
         printf(
             "smr: Client request to server %zu failed with code = "
-            "redirect. Trying to change leader to %s.\n",
-            c->client.leader_idx,
+            "redirect. Trying to change group %zu leader to %s.\n",
+            c->client.slot_leader_idx[slot_i], group_id,
             node_id_to_name_map.at(client_resp->leader_node_id).c_str());
 
-        bool success = change_leader_to_node(c, client_resp->leader_node_id);
+        bool success =
+            change_leader_to_node(c, group_id, client_resp->leader_node_id);
         if (!success) {
           printf(
               "smr: Client failed to change leader to %s. "
               "Retrying to current leader %zu after 200 ms.\n",
               node_id_to_name_map.at(client_resp->leader_node_id).c_str(),
-              c->client.leader_idx);
+              c->client.leader_idx[group_id]);
         }
 
         std::this_thread::sleep_for(std::chrono::milliseconds(200));
@@ -137,7 +181,7 @@ void client_cont(void *_context, void *) {
         printf(
             "smr: Client request to server %zu failed with code = "
             "try again. Trying again after 200 ms.\n",
-            c->client.leader_idx);
+            c->client.slot_leader_idx[slot_i]);
         std::this_thread::sleep_for(std::chrono::milliseconds(200));
         break;
       }
@@ -145,36 +189,50 @@ void client_cont(void *_context, void *) {
   } else {
     // This is a continuation-with-failure
     printf("smr: Client RPC to server %zu failed to complete [%s].\n",
-           c->client.leader_idx, erpc::get_formatted_time().c_str());
-    change_leader_to_any(c);
+           c->client.slot_leader_idx[slot_i],
+           erpc::get_formatted_time().c_str());
+
+    // Other outstanding requests to the failed server fail too. Change the
+    // group's leader view only once.
+    if (c->client.slot_leader_idx[slot_i] == c->client.leader_idx[group_id]) {
+      change_leader_to_any(c, group_id);
+    }
   }
 
-  send_req_one(c);
+  send_req_one(c, slot_i);
 }
 
 void client_func(erpc::Nexus *nexus, AppContext *c) {
-  c->client.leader_idx = 0;  // Start with leader = 0
+  // Start with leader = 0 for all groups
+  c->client.leader_idx.assign(FLAGS_num_raft_groups, 0);
 
   c->rpc = new erpc::Rpc<erpc::CTransport>(
       nexus, static_cast<void *>(c), kAppClientRpcId, sm_handler, kAppPhyPort);
   c->rpc->retry_connect_on_invalid_rpc_id_ = true;
 
   // Pre-allocate MsgBuffers
-  c->client.req_msgbuf = c->rpc->alloc_msg_buffer_or_die(sizeof(client_req_t));
-  c->client.resp_msgbuf =
-      c->rpc->alloc_msg_buffer_or_die(sizeof(client_resp_t));
+  for (size_t i = 0; i < FLAGS_client_window; i++) {
+    c->client.req_msgbuf[i] =
+        c->rpc->alloc_msg_buffer_or_die(sizeof(client_req_t));
+    c->client.resp_msgbuf[i] = c->rpc->alloc_msg_buffer_or_die(
+        std::max(sizeof(client_resp_t), sizeof(client_get_resp_t)));
+  }
 
-  // Raft client: Create session to each Raft server
+  // Raft client: Create session to each thread of each Raft server
   for (size_t i = 0; i < FLAGS_num_raft_servers; i++) {
     std::string uri = erpc::get_uri_for_process(i);
-    printf("smr: Creating session to %s, index = %zu.\n", uri.c_str(), i);
-
-    c->conn_vec[i].session_idx = i;
-    c->conn_vec[i].session_num = c->rpc->create_session(uri, kAppServerRpcId);
-    assert(c->conn_vec[i].session_num >= 0);
+    for (size_t t = 0; t < FLAGS_num_server_threads; t++) {
+      printf("smr: Creating session to %s thread %zu.\n", uri.c_str(), t);
+
+      const size_t session_idx = i * FLAGS_num_server_threads + t;
+      connection_t &conn = c->conn_vec[session_idx];
+      conn.session_idx = session_idx;
+      conn.session_num = c->rpc->create_session(uri, kAppServerRpcId + t);
+      assert(conn.session_num >= 0);
+    }
   }
 
-  while (c->num_sm_resps != FLAGS_num_raft_servers) {
+  while (c->num_sm_resps != c->conn_vec.size()) {
     c->rpc->run_event_loop(200);  // 200 ms
     if (ctrl_c_pressed == 1) {
       delete c->rpc;
@@ -184,7 +242,7 @@ void client_func(erpc::Nexus *nexus, AppContext *c) {
 
   printf("smr: Client connected to all. Sending reqs.\n");
 
-  send_req_one(c);
+  for (size_t i = 0; i < FLAGS_client_window; i++) send_req_one(c, i);
   while (ctrl_c_pressed == 0) c->rpc->run_event_loop(200);
 
   delete c->rpc;
@@ -0,0 +1,214 @@
+/**
+ * @file file_log.h
+ * @brief Implementation of a log in a regular file, for machines without
+ * persistent memory
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "../apps_common.h"
+#include "common.h"
+#include "util/math_utils.h"
+
+extern "C" {
+#include <raft.h>
+}
+
+// A file-backed log that stores objects of type T, with PmemLog's interface.
+// Entries are stored circularly after a metadata block.
+//
+// The file is opened with O_DIRECT | O_DSYNC, so a write is durable when it
+// returns. Appends are staged in an aligned write buffer. flush() writes all
+// entries appended since the last flush with one write (group commit), and
+// then writes the metadata block, which makes them part of the log.
+template <class T>
+class FileLog {
+ private:
+  static constexpr size_t kBlockSize = 4096;  // O_DIRECT alignment
+  static constexpr size_t kWriteBufSize = MB(4);
+  static_assert(sizeof(T) <= kWriteBufSize - kBlockSize, "");
+
+  // The metadata block. Unlike PmemLog, which must shrink the term to commit
+  // the term and vote with one 8-byte write, the term and vote are written
+  // with one single-block write, which NVMe devices apply atomically.
+  struct meta_t {
+    raft_term_t term;          // The latest term the server has seen
+    raft_node_id_t voted_for;  // Node that received vote in current term
+    size_t num_entries;        // Number of durable log entries
+    size_t base_idx;           // Index of the first log entry
+  };
+  static_assert(sizeof(meta_t) <= kBlockSize, "");
+
+  int fd;
+  size_t capacity;  // Max entries in the log
+
+  // Volatile records
+  size_t num_entries = 0;  // Index of the next entry to append
+  size_t base_idx = 0;     // Index of the first entry in the log
+  bool dirty = false;      // True if the log changed since the last flush
+
+  meta_t *meta;  // Block-aligned buffer for the metadata block
+
+  // Block-aligned write buffer for appended entries. wbuf[0] is at file offset
+  // wbuf_off, which is block-aligned, and the staged bytes end at wbuf_end.
+  uint8_t *wbuf;
+  size_t wbuf_off = 0;
+  size_t wbuf_end = 0;
+
+  size_t get_entry_offset(size_t idx) const {
+    return kBlockSize + (idx % capacity) * sizeof(T);
+  }
+
+  void write_meta() {
+    ssize_t ret = pwrite(fd, meta, kBlockSize, 0);
+    erpc::rt_assert(ret == static_cast<ssize_t>(kBlockSize),
+                    "Raft log metadata write failed");
+  }
+
+  // Make the write buffer start staging appends at file offset \p off
+  void stage_at(size_t off) {
+    flush();
+
+    const size_t block_off = off / kBlockSize * kBlockSize;
+    if (block_off != wbuf_off || off > wbuf_end) {
+      // The bytes before off in its block may hold live entries, so read them.
+      // They are in the write buffer if off is in the last flushed block.
+      if (off != block_off) {
+        ssize_t ret =
+            pread(fd, wbuf, kBlockSize, static_cast<off_t>(block_off));
+        erpc::rt_assert(ret == static_cast<ssize_t>(kBlockSize),
+                        "Raft log read failed");
+      }
+      wbuf_off = block_off;
+    }
+    wbuf_end = off;
+  }
+
+ public:
+  FileLog(const std::string &path, size_t file_size) {
+    erpc::rt_assert(file_size >= kBlockSize + kWriteBufSize, "Log too short");
+    capacity = (file_size - kBlockSize) / sizeof(T);
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_DIRECT | O_DSYNC, 0666);
+    erpc::rt_assert(fd >= 0, "open() failed for " + path + ". " +
+                                 std::string(strerror(errno)));
+
+    // Allocate the file's blocks up front so that appends don't allocate.
+    // Round up for the last entry's partial block.
+    int ret = posix_fallocate(
+        fd, 0, static_cast<off_t>(erpc::round_up<kBlockSize>(file_size)));
+    erpc::rt_assert(ret == 0, "posix_fallocate() failed for " + path);
+
+    meta = static_cast<meta_t *>(aligned_alloc(kBlockSize, kBlockSize));
+    wbuf = static_cast<uint8_t *>(aligned_alloc(kBlockSize, kWriteBufSize));
+    erpc::rt_assert(meta != nullptr && wbuf != nullptr, "Allocation failed");
+
+    memset(static_cast<void *>(meta), 0, kBlockSize);
+    write_meta();
+
+    // Raft log entries start from index 1, so insert a garbage entry. This will
+    // never be accessed, so a garbage entry is fine.
+    append(T());
+    flush();
+  }
+
+  ~FileLog() {
+    flush();
+    close(fd);
+    free(meta);
+    free(wbuf);
+  }
+
+  // Truncate the log so that the new size is \p num_entries. This becomes
+  // durable at the next flush.
+  void truncate(size_t _num_entries) {
+    assert(_num_entries >= base_idx);
+    num_entries = _num_entries;
+    dirty = true;
+  }
+
+  void pop() {
+    assert(num_entries > base_idx);
+    truncate(num_entries - 1);
+  }
+
+  // Discard the entries before \p base_idx, e.g., after they are compacted
+  // into a snapshot
+  void truncate_prefix(size_t _base_idx) {
+    assert(_base_idx >= base_idx && _base_idx <= num_entries);
+    base_idx = _base_idx;
+    meta->base_idx = base_idx;
+    write_meta();
+  }
+
+  // Discard all entries, and make \p num_entries the index of the next entry.
+  // This is used when a snapshot replaces the whole log.
+  void reset(size_t _num_entries) {
+    num_entries = _num_entries;
+    base_idx = _num_entries;
+    wbuf_off = 0;
+    wbuf_end = 0;
+    dirty = false;
+
+    meta->num_entries = num_entries;
+    meta->base_idx = base_idx;
+    write_meta();
+  }
+
+  // Stage an entry. It becomes durable at the next flush.
+  void append(const T &entry) {
+    erpc::rt_assert(num_entries - base_idx < capacity,
+                    "Raft log full. Enable log compaction.");
+
+    const size_t off = get_entry_offset(num_entries);
+    if (off != wbuf_end || off + sizeof(T) > wbuf_off + kWriteBufSize) {
+      stage_at(off);
+    }
+
+    memcpy(&wbuf[off - wbuf_off], &entry, sizeof(T));
+    wbuf_end = off + sizeof(T);
+    num_entries++;
+    dirty = true;
+  }
+
+  // Make all staged changes durable: first the entries, then the metadata
+  void flush() {
+    if (!dirty) return;
+
+    if (wbuf_end > wbuf_off) {
+      const size_t len = erpc::round_up<kBlockSize>(wbuf_end - wbuf_off);
+      ssize_t ret = pwrite(fd, wbuf, len, static_cast<off_t>(wbuf_off));
+      erpc::rt_assert(ret == static_cast<ssize_t>(len),
+                      "Raft log write failed");
+
+      // Keep the last partial block, which the next flush rewrites
+      const size_t block_off = wbuf_end / kBlockSize * kBlockSize;
+      memmove(wbuf, &wbuf[block_off - wbuf_off], wbuf_end - block_off);
+      wbuf_off = block_off;
+    }
+
+    meta->num_entries = num_entries;
+    meta->base_idx = base_idx;
+    write_meta();
+    dirty = false;
+  }
+
+  size_t get_num_entries() const { return num_entries; }
+  size_t get_base_idx() const { return base_idx; }
+
+  void persist_vote(raft_node_id_t voted_for) {
+    meta->voted_for = voted_for;
+    write_meta();
+  }
+
+  void persist_term(raft_term_t term, raft_node_id_t voted_for) {
+    meta->term = term;
+    meta->voted_for = voted_for;
+    write_meta();
+  }
+};
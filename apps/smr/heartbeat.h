@@ -0,0 +1,105 @@
+/**
+ * @file heartbeat.h
+ * @brief Handlers for batched heartbeats of the Raft groups on a server thread
+ */
+
+#pragma once
+#include "appendentries.h"
+
+// kHeartbeatBatch request format: [app_heartbeat_t]. The response contains one
+// msg_appendentries_response_t per heartbeat, in the same order.
+void heartbeat_batch_handler(erpc::ReqHandle *req_handle, void *_context) {
+  auto *tc = static_cast<ServerThreadContext *>(_context);
+  const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  const size_t num_heartbeats =
+      req_msgbuf->get_data_size() / sizeof(app_heartbeat_t);
+  assert(num_heartbeats > 0 && req_msgbuf->get_data_size() ==
+                                    num_heartbeats * sizeof(app_heartbeat_t));
+  auto *heartbeat_arr = reinterpret_cast<app_heartbeat_t *>(req_msgbuf->buf_);
+
+  // Use the preallocated response if the responses fit in one packet
+  const size_t resp_size =
+      num_heartbeats * sizeof(msg_appendentries_response_t);
+  erpc::MsgBuffer *resp_msgbuf = &req_handle->pre_resp_msgbuf_;
+  if (resp_size <= erpc::Rpc<erpc::CTransport>::get_max_data_per_pkt()) {
+    erpc::Rpc<erpc::CTransport>::resize_msg_buffer(resp_msgbuf, resp_size);
+  } else {
+    resp_msgbuf = &req_handle->dyn_resp_msgbuf_;
+    *resp_msgbuf = tc->rpc->alloc_msg_buffer_or_die(resp_size);
+  }
+
+  auto *resp_arr =
+      reinterpret_cast<msg_appendentries_response_t *>(resp_msgbuf->buf_);
+  for (size_t i = 0; i < num_heartbeats; i++) {
+    app_heartbeat_t &heartbeat = heartbeat_arr[i];
+    assert(heartbeat.msg_ae.n_entries == 0);
+    AppContext *c = get_group_context(tc, heartbeat.group_id);
+    flush_raft_log(c);
+
+    int e = raft_recv_appendentries(
+        c->server.raft, raft_get_node(c->server.raft, heartbeat.node_id),
+        &heartbeat.msg_ae, &resp_arr[i]);
+    erpc::rt_assert(e == 0, "raft_recv_appendentries failed for heartbeat");
+  }
+
+  tc->rpc->enqueue_response(req_handle, resp_msgbuf);
+}
+
+void heartbeat_batch_cont(void *, void *);  // Fwd decl
+
+// Send the heartbeats queued by this thread's Raft groups in this event loop
+// iteration, with one request per Raft server
+void send_heartbeat_batches(ServerThreadContext *tc) {
+  for (size_t i = 0; i < FLAGS_num_raft_servers; i++) {
+    std::vector<app_heartbeat_t> &batch = tc->heartbeat_batch_vec[i];
+    if (batch.empty()) continue;
+
+    const size_t req_size = batch.size() * sizeof(app_heartbeat_t);
+    erpc::rt_assert(req_size <= tc->rpc->get_max_msg_size(),
+                    "send_heartbeat_batches: Message size too large");
+
+    heartbeat_batch_tag_t *hbt = tc->heartbeat_batch_tag_pool.alloc();
+    hbt->req_msgbuf = tc->rpc->alloc_msg_buffer_or_die(req_size);
+    hbt->resp_msgbuf = tc->rpc->alloc_msg_buffer_or_die(
+        batch.size() * sizeof(msg_appendentries_response_t));
+    hbt->peer_idx = i;
+    hbt->send_tsc = erpc::rdtsc();  // Lease acks are relative to this
+    memcpy(hbt->req_msgbuf.buf_, batch.data(), req_size);
+
+    tc->rpc->enqueue_request(tc->conn_vec[i].session_num,
+                             static_cast<uint8_t>(ReqType::kHeartbeatBatch),
+                             &hbt->req_msgbuf, &hbt->resp_msgbuf,
+                             heartbeat_batch_cont,
+                             reinterpret_cast<void *>(hbt));
+
+    tc->stat_heartbeat_batches++;
+    tc->stat_heartbeats += batch.size();
+    batch.clear();
+  }
+}
+
+void heartbeat_batch_cont(void *_context, void *_tag) {
+  auto *tc = static_cast<ServerThreadContext *>(_context);
+  auto *hbt = reinterpret_cast<heartbeat_batch_tag_t *>(_tag);
+  const auto *heartbeat_arr =
+      reinterpret_cast<app_heartbeat_t *>(hbt->req_msgbuf.buf_);
+  const size_t num_heartbeats =
+      hbt->req_msgbuf.get_data_size() / sizeof(app_heartbeat_t);
+
+  // Fail all heartbeats in the batch if the RPC failed
+  const bool success = hbt->resp_msgbuf.get_data_size() > 0;
+  auto *resp_arr =
+      reinterpret_cast<msg_appendentries_response_t *>(hbt->resp_msgbuf.buf_);
+
+  const int peer_node_id = get_raft_node_id_for_process(hbt->peer_idx);
+  for (size_t i = 0; i < num_heartbeats; i++) {
+    AppContext *c = get_group_context(tc, heartbeat_arr[i].group_id);
+    raft_node_t *node = raft_get_node(c->server.raft, peer_node_id);
+    process_appendentries_resp(c, node, hbt->send_tsc,
+                               success ? &resp_arr[i] : nullptr);
+  }
+
+  tc->rpc->free_msg_buffer(hbt->req_msgbuf);
+  tc->rpc->free_msg_buffer(hbt->resp_msgbuf);
+  tc->heartbeat_batch_tag_pool.free(hbt);
+}
@@ -6,21 +6,15 @@
 #pragma once
 #include "smr.h"
 
-static int smr_raft_send_snapshot_cb(raft_server_t *, void *, raft_node_t *) {
-  erpc::rt_assert(false, "Snapshots not supported");
-  return -1;
-}
-
 // Raft callback for setting the log entry at \p entry_idx to \p *ety
 static int smr_raft_log_offer_cb(raft_server_t *, void *udata,
                                  raft_entry_t *ety, raft_index_t entry_idx) {
   // We currently handle only application log entries
   assert(!raft_entry_is_cfg_change(ety));
   assert(ety->data.len == sizeof(client_req_t));
+  auto *c = static_cast<AppContext *>(udata);
 
   if (kUsePmem) {
-    auto *c = static_cast<AppContext *>(udata);
-
     // During failures, willemt/raft uses log_pop() to pop old entries instead
     // of directly overwriting them. This is also the behavior of LogCabin.
     erpc::rt_assert(static_cast<size_t>(entry_idx) ==
@@ -30,6 +24,15 @@ static int smr_raft_log_offer_cb(raft_server_t *, void *udata,
         *ety, *reinterpret_cast<client_req_t *>(ety->data.buf)));
   }
 
+  if (c->server.file_log != nullptr) {
+    // The entry is written when the log is flushed, with the other entries
+    // appended in this event loop iteration
+    erpc::rt_assert(static_cast<size_t>(entry_idx) ==
+                    c->server.file_log->get_num_entries());
+    c->server.file_log->append(pmem_ser_logentry_t(
+        *ety, *reinterpret_cast<client_req_t *>(ety->data.buf)));
+  }
+
   return 0;  // Unneeded for DRAM mode
 }
 
@@ -53,6 +56,7 @@ static int smr_raft_applylog_cb(raft_server_t *, void *udata, raft_entry_t *ety,
            erpc::get_formatted_time().c_str());
   }
 
+  if (unlikely(client_req->key == kAppNoopKey)) return 0;
   c->server.table.insert(
       std::pair<size_t, value_t>(client_req->key, client_req->value));
   return 0;
@@ -61,9 +65,10 @@ static int smr_raft_applylog_cb(raft_server_t *, void *udata, raft_entry_t *ety,
 // Raft callback for saving voted_for field to persistent storage.
 static int smr_raft_persist_vote_cb(raft_server_t *, void *udata,
                                     raft_node_id_t voted_for) {
-  if (kUsePmem) {
-    auto *c = static_cast<AppContext *>(udata);
-    c->server.pmem_log->persist_vote(voted_for);
+  auto *c = static_cast<AppContext *>(udata);
+  if (kUsePmem) c->server.pmem_log->persist_vote(voted_for);
+  if (c->server.file_log != nullptr) {
+    c->server.file_log->persist_vote(voted_for);
   }
 
   return 0;  // Unneeded for DRAM mode
@@ -73,20 +78,26 @@ static int smr_raft_persist_vote_cb(raft_server_t *, void *udata,
 static int smr_raft_persist_term_cb(raft_server_t *, void *udata,
                                     raft_term_t term,
                                     raft_node_id_t voted_for) {
-  erpc::rt_assert(term < INT32_MAX, "Term too large for atomic pmem append");
   if (kUsePmem) {
-    auto *c = static_cast<AppContext *>(udata);
-    c->server.pmem_log->persist_term(term, voted_for);
+    erpc::rt_assert(term < INT32_MAX, "Term too large for atomic pmem append");
+  }
+  auto *c = static_cast<AppContext *>(udata);
+  if (kUsePmem) c->server.pmem_log->persist_term(term, voted_for);
+  if (c->server.file_log != nullptr) {
+    c->server.file_log->persist_term(term, voted_for);
   }
   return 0;  // Unneeded for DRAM mode
 }
 
-// Raft callback for removing the first entry from the log. This is provided to
-// support log compaction in the future.
-static int smr_raft_log_poll_cb(raft_server_t *, void *, raft_entry_t *,
-                                raft_index_t) {
-  erpc::rt_assert(false, "Log compaction not supported");
-  return -1;
+// Raft callback for removing the first entry from the log after it has been
+// compacted into a snapshot. The pmem log is truncated once per snapshot.
+static int smr_raft_log_poll_cb(raft_server_t *, void *udata,
+                                raft_entry_t *ety, raft_index_t) {
+  auto *c = static_cast<AppContext *>(udata);
+  assert(ety->data.len == sizeof(client_req_t));
+  c->server.log_entry_appdata_pool.free(
+      static_cast<client_req_t *>(ety->data.buf));
+  return 0;
 }
 
 // Raft callback for deleting the most recent entry from the log. This happens
@@ -96,6 +107,7 @@ static int smr_raft_log_pop_cb(raft_server_t *, void *udata, raft_entry_t *ety,
                                raft_index_t) {
   auto *c = static_cast<AppContext *>(udata);
   if (kUsePmem) c->server.pmem_log->pop();
+  if (c->server.file_log != nullptr) c->server.file_log->pop();
 
   // We must the entry's application data buffer regardless of pmem
   if (likely(ety->data.len == sizeof(client_req_t))) {
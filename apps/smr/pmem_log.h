@@ -36,7 +36,8 @@ extern "C" {
 #include <raft.h>
 }
 
-// A persistent memory log that stores objects of type T
+// A persistent memory log that stores objects of type T. Entries are stored
+// circularly, so the log can be reused after its prefix is truncated.
 template <class T>
 class PmemLog {
  private:
@@ -50,7 +51,9 @@ class PmemLog {
   struct {
     uint8_t *buf;         // The start of the mapped file
     size_t mapped_len;    // Length of the mapped log file
-    size_t num_entries;   // Number of entries in the log
+    size_t num_entries;   // Index of the next entry to append
+    size_t base_idx;      // Index of the first entry in the log
+    size_t capacity;      // Max entries in the log
     T *log_entries_base;  // Log entries in the file
   } v;
 
@@ -65,6 +68,7 @@ class PmemLog {
     raft_node_id_t *voted_for;  // Node that received vote in current term
 
     size_t *num_entries;  // Record for number of log entries
+    size_t *base_idx;     // Record for the index of the first log entry
   } p;
 
  public:
@@ -88,6 +92,7 @@ class PmemLog {
     erpc::rt_assert(is_pmem == 1, "Raft log file is not pmem");
 
     v.num_entries = 0;
+    v.base_idx = 0;
 
     // Initialize persistent metadata pointers and reset them to zero
     uint8_t *cur = v.buf;
@@ -97,9 +102,12 @@ class PmemLog {
     cur += sizeof(raft_node_id_t);
     p.num_entries = reinterpret_cast<size_t *>(cur);
     cur += sizeof(size_t);
+    p.base_idx = reinterpret_cast<size_t *>(cur);
+    cur += sizeof(size_t);
     pmem_memset_persist(v.buf, 0, static_cast<size_t>(cur - v.buf));
 
     v.log_entries_base = reinterpret_cast<T *>(cur);
+    v.capacity = (v.mapped_len - static_cast<size_t>(cur - v.buf)) / sizeof(T);
 
     // Raft log entries start from index 1, so insert a garbage entry. This will
     // never be accessed, so a garbage entry is fine.
@@ -112,11 +120,33 @@ class PmemLog {
     pmem_memcpy_persist(p.num_entries, &v.num_entries, sizeof(v.num_entries));
   }
 
-  void pop() { truncate(v.num_entries - 1); }
+  void pop() {
+    assert(v.num_entries > v.base_idx);
+    truncate(v.num_entries - 1);
+  }
+
+  // Discard the entries before \p base_idx, e.g., after they are compacted
+  // into a snapshot
+  void truncate_prefix(size_t base_idx) {
+    assert(base_idx >= v.base_idx && base_idx <= v.num_entries);
+    v.base_idx = base_idx;
+    pmem_memcpy_persist(p.base_idx, &v.base_idx, sizeof(v.base_idx));
+  }
+
+  // Discard all entries, and make \p num_entries the index of the next entry.
+  // This is used when a snapshot replaces the whole log.
+  void reset(size_t num_entries) {
+    v.num_entries = num_entries;
+    pmem_memcpy_persist(p.num_entries, &v.num_entries, sizeof(v.num_entries));
+    truncate_prefix(num_entries);
+  }
 
   void append(const T &entry) {
+    erpc::rt_assert(v.num_entries - v.base_idx < v.capacity,
+                    "Raft log full. Enable log compaction.");
+
     // First, update data
-    T *p_log_entry_ptr = &v.log_entries_base[v.num_entries];
+    T *p_log_entry_ptr = &v.log_entries_base[v.num_entries % v.capacity];
     pmem_memcpy_persist(p_log_entry_ptr, &entry, sizeof(T));
 
     // Second, update tail
@@ -125,6 +155,7 @@ class PmemLog {
   }
 
   size_t get_num_entries() const { return v.num_entries; }
+  size_t get_base_idx() const { return v.base_idx; }
 
   void persist_vote(raft_node_id_t voted_for) {
     pmem_memcpy_persist(p.voted_for, &voted_for, sizeof(voted_for));
@@ -4,11 +4,13 @@
  */
 
 #pragma once
+#include "appendentries.h"
 #include "smr.h"
 
 // With eRPC, there is currently no way for an RPC server to access connection
 // data for a request, so the client's Raft node ID is included in the request.
 struct app_requestvote_t {
+  size_t group_id;
   int node_id;
   msg_requestvote_t msg_rv;
 };
@@ -33,11 +35,11 @@ static std::string msg_requestvote_response_string(
 }
 
 void requestvote_handler(erpc::ReqHandle *req_handle, void *_context) {
-  auto *c = static_cast<AppContext *>(_context);
   const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
   assert(req_msgbuf->get_data_size() == sizeof(app_requestvote_t));
 
   auto *rv_req = reinterpret_cast<app_requestvote_t *>(req_msgbuf->buf_);
+  AppContext *c = get_group_context(_context, rv_req->group_id);
   printf("smr: Received requestvote request from %s: %s [%s].\n",
          node_id_to_name_map[rv_req->node_id].c_str(),
          msg_requestvote_string(&rv_req->msg_rv).c_str(),
@@ -46,6 +48,9 @@ void requestvote_handler(erpc::ReqHandle *req_handle, void *_context) {
   erpc::MsgBuffer &resp_msgbuf = req_handle->pre_resp_msgbuf_;
   c->rpc->resize_msg_buffer(&resp_msgbuf, sizeof(msg_requestvote_response_t));
 
+  // The vote depends on our log, so it must be durable
+  flush_raft_log(c);
+
   auto *rv_resp =
       reinterpret_cast<msg_requestvote_response_t *>(resp_msgbuf.buf_);
 
@@ -88,6 +93,7 @@ static int smr_raft_send_requestvote_cb(raft_server_t *, void *,
   rrt->node = node;
 
   auto *rv_req = reinterpret_cast<app_requestvote_t *>(rrt->req_msgbuf.buf_);
+  rv_req->group_id = c->server.group_id;
   rv_req->node_id = c->server.node_id;
   rv_req->msg_rv = *msg_rv;
 
@@ -98,9 +104,10 @@ static int smr_raft_send_requestvote_cb(raft_server_t *, void *,
   return 0;
 }
 
-void requestvote_cont(void *_context, void *_tag) {
-  auto *c = static_cast<AppContext *>(_context);
+void requestvote_cont(void *, void *_tag) {
   auto *rrt = reinterpret_cast<raft_req_tag_t *>(_tag);
+  auto *conn = static_cast<connection_t *>(raft_node_get_udata(rrt->node));
+  AppContext *c = conn->c;
 
   auto *msg_rv_resp =
       reinterpret_cast<msg_requestvote_response_t *>(rrt->resp_msgbuf.buf_);
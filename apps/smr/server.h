@@ -6,9 +6,11 @@
 #pragma once
 
 #include "appendentries.h"
+#include "heartbeat.h"
 #include "log_callbacks.h"
 #include "requestvote.h"
 #include "smr.h"
+#include "snapshot.h"
 
 // Raft callback for displaying debugging information
 void smr_raft_console_log_cb(raft_server_t *, raft_node_t *, void *,
@@ -45,7 +47,8 @@ void init_raft(AppContext *c) {
   erpc::rt_assert(c->server.raft != nullptr, "Failed to init raft");
 
   c->server.node_id = get_raft_node_id_for_process(FLAGS_process_id);
-  printf("smr: Created Raft node with ID = %d.\n", c->server.node_id);
+  printf("smr: Created Raft node with ID = %d for group %zu.\n",
+         c->server.node_id, c->server.group_id);
 
   set_raft_callbacks(c);
   if (kUsePmem) {
@@ -53,6 +56,16 @@ void init_raft(AppContext *c) {
         new PmemLog<pmem_ser_logentry_t>(erpc::measure_rdtsc_freq());
   }
 
+  if (!FLAGS_raft_log_dir.empty()) {
+    // Processes may share a machine and a directory
+    const std::string path = FLAGS_raft_log_dir + "/smr_raft_log_p" +
+                             std::to_string(FLAGS_process_id) + "_g" +
+                             std::to_string(c->server.group_id);
+    printf("smr: Using file-backed Raft log %s.\n", path.c_str());
+    c->server.file_log = new FileLog<pmem_ser_logentry_t>(
+        path, FLAGS_raft_log_file_mb * MB(1));
+  }
+
   for (size_t i = 0; i < FLAGS_num_raft_servers; i++) {
     int raft_node_id = get_raft_node_id_for_process(i);
 
@@ -68,6 +81,9 @@ void init_raft(AppContext *c) {
 
   if (kAppTimeEnt) c->server.time_ents.reserve(1000000);
   c->server.cycles_per_msec = erpc::ms_to_cycles(1, erpc::measure_rdtsc_freq());
+  c->server.lease_cycles = static_cast<size_t>(
+      kAppRaftElectionTimeoutMsec * c->server.cycles_per_msec *
+      (1.0 - kAppMaxClockDrift));
   c->server.raft_periodic_tsc = erpc::rdtsc();
 }
 
@@ -89,18 +105,16 @@ void send_client_response(AppContext *c, erpc::ReqHandle *req_handle,
 }
 
 void client_req_handler(erpc::ReqHandle *req_handle, void *_context) {
-  auto *c = static_cast<AppContext *>(_context);
-
-  // We need leader_sav to start commit latency measurement, but we won't mark
-  // it in_use until checking that this node is the leader
-  leader_saveinfo_t &leader_sav = c->server.leader_saveinfo;
-
-  if (kAppMeasureCommitLatency) leader_sav.start_tsc = erpc::rdtsc();
-  if (kAppTimeEnt) c->server.time_ents.emplace_back(TimeEntType::kClientReq);
-
   const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
   assert(req_msgbuf->get_data_size() == sizeof(client_req_t));
   const auto *client_req = reinterpret_cast<client_req_t *>(req_msgbuf->buf_);
+  AppContext *c =
+      get_group_context(_context, get_group_for_key(client_req->key));
+
+  leader_saveinfo_t leader_sav;
+  leader_sav.req_handle = req_handle;
+  if (kAppMeasureCommitLatency) leader_sav.start_tsc = erpc::rdtsc();
+  if (kAppTimeEnt) c->server.time_ents.emplace_back(TimeEntType::kClientReq);
 
   // Check if it's OK to receive the client's request
   raft_node_t *leader = raft_get_current_leader_node(c->server.raft);
@@ -134,13 +148,22 @@ void client_req_handler(erpc::ReqHandle *req_handle, void *_context) {
            client_req->to_string().c_str(), erpc::get_formatted_time().c_str());
   }
 
-  assert(!leader_sav.in_use);
-  leader_sav.in_use = true;
-  leader_sav.req_handle = req_handle;
+  // We're the leader. The request is appended to the log with the rest of
+  // this event loop iteration's batch.
+  c->server.pending_batch.push_back(leader_sav);
+}
+
+// Append a no-op entry if we're a new leader. Reads are served only after it
+// commits, which ensures that we have applied all entries committed by earlier
+// leaders.
+void append_noop_if_new_leader(AppContext *c) {
+  if (!raft_is_leader(c->server.raft)) return;
+  const raft_term_t term = raft_get_current_term(c->server.raft);
+  if (c->server.noop_term == term) return;
 
-  // Receive a log entry. msg_entry can be stack-resident, but not its buf.
   client_req_t *log_entry_appdata = c->server.log_entry_appdata_pool.alloc();
-  *log_entry_appdata = *client_req;
+  log_entry_appdata->key = kAppNoopKey;
+  log_entry_appdata->value.v[0] = kAppNoopKey;
 
   msg_entry_t ent;
   ent.type = RAFT_LOGTYPE_NORMAL;
@@ -148,11 +171,285 @@ void client_req_handler(erpc::ReqHandle *req_handle, void *_context) {
   ent.data.buf = log_entry_appdata;
   ent.data.len = sizeof(client_req_t);
 
-  int e = raft_recv_entry(c->server.raft, &ent, &leader_sav.msg_entry_response);
-  erpc::rt_assert(e == 0, "client_req_handle: raft_recv_entry failed");
+  msg_entry_response_t msg_entry_response;
+  int e = raft_recv_entry(c->server.raft, &ent, &msg_entry_response);
+  erpc::rt_assert(e == 0, "raft_recv_entry failed for no-op");
+
+  c->server.noop_term = term;
+  c->server.noop_idx = msg_entry_response.idx;
+}
+
+// Return the send time of the latest appendentries round acknowledged by a
+// majority, counting ourselves. Return 0 if there is no such round in this
+// term.
+uint64_t get_majority_ack_tsc(AppContext *c) {
+  const raft_term_t term = raft_get_current_term(c->server.raft);
+  std::vector<uint64_t> ack_tsc_vec;
+  for (size_t i = 0; i < FLAGS_num_raft_servers; i++) {
+    if (i == FLAGS_process_id) continue;
+    const connection_t &conn = c->conn_vec[i];
+    ack_tsc_vec.push_back(conn.lease_ack_term == term ? conn.lease_ack_tsc : 0);
+  }
+
+  const size_t num_acks_needed = FLAGS_num_raft_servers / 2;
+  if (num_acks_needed == 0) return erpc::rdtsc();
+
+  std::sort(ack_tsc_vec.begin(), ack_tsc_vec.end(), std::greater<uint64_t>());
+  return ack_tsc_vec[num_acks_needed - 1];
+}
+
+// Return true if we can serve reads: We're the leader, and our no-op entry for
+// this term has committed
+bool can_serve_reads(AppContext *c) {
+  return raft_is_leader(c->server.raft) &&
+         c->server.noop_term == raft_get_current_term(c->server.raft) &&
+         raft_get_commit_idx(c->server.raft) >= c->server.noop_idx;
+}
+
+// Return true if we hold a valid leader lease
+bool lease_is_valid(AppContext *c) {
+  return can_serve_reads(c) &&
+         erpc::rdtsc() < get_majority_ack_tsc(c) + c->server.lease_cycles;
+}
+
+// Serve a GET from the local key-value table
+void serve_read(AppContext *c, erpc::ReqHandle *req_handle) {
+  raft_apply_all(c->server.raft);
+
+  const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  const auto *get_req = reinterpret_cast<client_get_req_t *>(req_msgbuf->buf_);
+
+  erpc::MsgBuffer &resp_msgbuf = req_handle->pre_resp_msgbuf_;
+  c->rpc->resize_msg_buffer(&resp_msgbuf, sizeof(client_get_resp_t));
+  auto *get_resp = reinterpret_cast<client_get_resp_t *>(resp_msgbuf.buf_);
+  get_resp->resp = client_resp_t(ClientRespType::kSuccess);
+
+  auto it = c->server.table.find(get_req->key);
+  get_resp->found = (it != c->server.table.end());
+  if (get_resp->found) get_resp->value = it->second;
+
+  c->rpc->enqueue_response(req_handle, &resp_msgbuf);
 }
 
-void init_erpc(AppContext *c, erpc::Nexus *nexus) {
+void client_get_handler(erpc::ReqHandle *req_handle, void *_context) {
+  const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  assert(req_msgbuf->get_data_size() == sizeof(client_get_req_t));
+  const auto *get_req = reinterpret_cast<client_get_req_t *>(req_msgbuf->buf_);
+  AppContext *c = get_group_context(_context, get_group_for_key(get_req->key));
+
+  raft_node_t *leader = raft_get_current_leader_node(c->server.raft);
+  if (unlikely(leader == nullptr)) {
+    client_resp_t err_resp(ClientRespType::kFailTryAgain);
+    send_client_response(c, req_handle, err_resp);
+    return;
+  }
+
+  int leader_node_id = raft_node_get_id(leader);
+  if (unlikely(leader_node_id != c->server.node_id)) {
+    client_resp_t err_resp(ClientRespType::kFailRedirect, leader_node_id);
+    send_client_response(c, req_handle, err_resp);
+    return;
+  }
+
+  if (likely(lease_is_valid(c))) {
+    c->server.stat_lease_reads++;
+    serve_read(c, req_handle);
+    return;
+  }
+
+  // Wait for the lease to be renewed, or for a ReadIndex round
+  pending_read_t pending_read;
+  pending_read.req_handle = req_handle;
+  pending_read.arrival_tsc = erpc::rdtsc();
+  pending_read.read_idx =
+      std::max(raft_get_commit_idx(c->server.raft), c->server.noop_idx);
+  c->server.pending_reads.push_back(pending_read);
+}
+
+// Serve the GETs that were waiting for the leader lease or ReadIndex
+void serve_pending_reads(AppContext *c) {
+  std::deque<pending_read_t> &pending_reads = c->server.pending_reads;
+  if (pending_reads.empty()) return;
+
+  if (!raft_is_leader(c->server.raft)) {
+    for (pending_read_t &pending_read : pending_reads) {
+      client_resp_t err_resp(ClientRespType::kFailTryAgain);
+      send_client_response(c, pending_read.req_handle, err_resp);
+    }
+    pending_reads.clear();
+    return;
+  }
+
+  if (lease_is_valid(c)) {
+    for (pending_read_t &pending_read : pending_reads) {
+      c->server.stat_lease_reads++;
+      serve_read(c, pending_read.req_handle);
+    }
+    pending_reads.clear();
+    return;
+  }
+
+  if (!FLAGS_read_index || !can_serve_reads(c)) return;
+
+  // ReadIndex: A read is linearizable once a majority has acknowledged a
+  // heartbeat sent after the read arrived, and its read index is committed
+  const uint64_t majority_ack_tsc = get_majority_ack_tsc(c);
+  while (!pending_reads.empty()) {
+    pending_read_t &pending_read = pending_reads.front();
+    if (pending_read.arrival_tsc > majority_ack_tsc ||
+        pending_read.read_idx > raft_get_commit_idx(c->server.raft)) {
+      break;
+    }
+
+    c->server.stat_read_index_reads++;
+    serve_read(c, pending_read.req_handle);
+    pending_reads.pop_front();
+  }
+
+  // Start a heartbeat round for the reads that arrived after the last round
+  if (!pending_reads.empty() &&
+      pending_reads.back().arrival_tsc > c->server.read_index_round_tsc) {
+    c->server.read_index_round_tsc = erpc::rdtsc();
+    c->server.force_ae_send = true;
+    raft_node_t *self = raft_get_my_node(c->server.raft);
+    for (int i = 0; i < raft_get_num_nodes(c->server.raft); i++) {
+      raft_node_t *node = raft_get_node_from_idx(c->server.raft, i);
+      if (node != self) raft_send_appendentries(c->server.raft, node);
+    }
+    c->server.force_ae_send = false;
+  }
+}
+
+// Append the batch of pending client requests to the Raft log, and send the
+// whole batch to each follower in one appendentries request
+void append_client_batch(AppContext *c) {
+  std::vector<leader_saveinfo_t> &batch = c->server.pending_batch;
+  if (batch.empty()) return;
+
+  c->server.defer_ae_send = true;
+  for (leader_saveinfo_t &leader_sav : batch) {
+    const erpc::MsgBuffer *req_msgbuf = leader_sav.req_handle->get_req_msgbuf();
+    const auto *client_req = reinterpret_cast<client_req_t *>(req_msgbuf->buf_);
+
+    // Receive a log entry. msg_entry can be stack-resident, but not its buf.
+    client_req_t *log_entry_appdata = c->server.log_entry_appdata_pool.alloc();
+    *log_entry_appdata = *client_req;
+
+    msg_entry_t ent;
+    ent.type = RAFT_LOGTYPE_NORMAL;
+    ent.id = FLAGS_process_id;
+    ent.data.buf = log_entry_appdata;
+    ent.data.len = sizeof(client_req_t);
+
+    int e = raft_recv_entry(c->server.raft, &ent,
+                            &leader_sav.msg_entry_response);
+    if (unlikely(e != 0)) {
+      // We lost leadership since the request was received
+      erpc::rt_assert(e == RAFT_ERR_NOT_LEADER, "raft_recv_entry failed");
+      c->server.log_entry_appdata_pool.free(log_entry_appdata);
+
+      client_resp_t err_resp(ClientRespType::kFailTryAgain);
+      send_client_response(c, leader_sav.req_handle, err_resp);
+      continue;
+    }
+
+    c->server.uncommitted_reqs.push_back(leader_sav);
+  }
+  c->server.defer_ae_send = false;
+
+  c->server.stat_num_batches++;
+  c->server.stat_num_batched_reqs += batch.size();
+  batch.clear();
+
+  if (!raft_is_leader(c->server.raft)) return;
+  raft_node_t *self = raft_get_my_node(c->server.raft);
+  for (int i = 0; i < raft_get_num_nodes(c->server.raft); i++) {
+    raft_node_t *node = raft_get_node_from_idx(c->server.raft, i);
+    if (node != self) raft_send_appendentries(c->server.raft, node);
+  }
+}
+
+// Respond to clients whose requests have committed. Entries commit in log
+// order, so stop at the first uncommitted request.
+void respond_committed_reqs(AppContext *c) {
+  std::deque<leader_saveinfo_t> &uncommitted_reqs = c->server.uncommitted_reqs;
+  bool applied = false;
+
+  while (!uncommitted_reqs.empty()) {
+    leader_saveinfo_t &leader_sav = uncommitted_reqs.front();
+    int commit_status = raft_msg_entry_response_committed(
+        c->server.raft, &leader_sav.msg_entry_response);
+    assert(commit_status == 0 || commit_status == 1 || commit_status == -1);
+    if (commit_status == 0) break;
+
+    if (commit_status == 1) {
+      // Committed: Send a response after applying all committed entries
+      if (!applied) {
+        raft_apply_all(c->server.raft);
+        applied = true;
+      }
+
+      if (kAppMeasureCommitLatency) {
+        size_t commit_cycles = erpc::rdtsc() - leader_sav.start_tsc;
+        double commit_usec =
+            erpc::to_usec(commit_cycles, c->rpc->get_freq_ghz());
+        c->server.commit_latency.update(commit_usec * 10);
+      }
+
+      if (kAppTimeEnt) {
+        c->server.time_ents.emplace_back(TimeEntType::kCommitted);
+      }
+
+      // XXX: Is this correct, or should we send response in _apply_log()
+      // callback? This doesn't adversely affect failure-free performance.
+      client_resp_t client_resp(ClientRespType::kSuccess);
+      send_client_response(c, leader_sav.req_handle, client_resp);
+    } else {
+      // An entry from a newer leader has replaced this request's entry
+      client_resp_t err_resp(ClientRespType::kFailTryAgain);
+      send_client_response(c, leader_sav.req_handle, err_resp);
+    }
+
+    uncommitted_reqs.pop_front();
+  }
+}
+
+// eRPC session management handler for server threads
+void server_sm_handler(int session_num, erpc::SmEventType sm_event_type,
+                       erpc::SmErrType sm_err_type, void *_context) {
+  auto *tc = static_cast<ServerThreadContext *>(_context);
+  tc->num_sm_resps++;
+
+  if (!(sm_event_type == erpc::SmEventType::kConnected ||
+        sm_event_type == erpc::SmEventType::kDisconnected)) {
+    throw std::runtime_error("Received unexpected SM event.");
+  }
+
+  size_t session_idx = tc->conn_vec.size();
+  for (size_t i = 0; i < tc->conn_vec.size(); i++) {
+    if (tc->conn_vec[i].session_num == session_num) session_idx = i;
+  }
+  erpc::rt_assert(session_idx < tc->conn_vec.size(), "Invalid session number");
+
+  if (sm_event_type == erpc::SmEventType::kDisconnected) {
+    tc->conn_vec[session_idx].disconnected = true;
+    for (AppContext *c : tc->groups) {
+      c->conn_vec[session_idx].disconnected = true;
+    }
+  }
+
+  fprintf(stderr,
+          "smr: Rpc %u: Session number %d (index %zu) %s. Error = %s. "
+          "Time elapsed = %.3f s.\n",
+          tc->rpc->get_rpc_id(), session_num, session_idx,
+          erpc::sm_event_type_str(sm_event_type).c_str(),
+          erpc::sm_err_type_str(sm_err_type).c_str(),
+          tc->rpc->sec_since_creation());
+}
+
+// Register the Raft server request handlers. This must be done before any
+// thread creates an Rpc.
+void register_server_req_funcs(erpc::Nexus *nexus) {
   nexus->register_req_func(static_cast<uint8_t>(ReqType::kRequestVote),
                            requestvote_handler);
 
@@ -162,31 +459,51 @@ void init_erpc(AppContext *c, erpc::Nexus *nexus) {
   nexus->register_req_func(static_cast<uint8_t>(ReqType::kClientReq),
                            client_req_handler);
 
-  c->rpc = new erpc::Rpc<erpc::CTransport>(
-      nexus, static_cast<void *>(c), kAppServerRpcId, sm_handler, kAppPhyPort);
+  nexus->register_req_func(static_cast<uint8_t>(ReqType::kSnapshotChunk),
+                           snapshot_chunk_handler);
+
+  nexus->register_req_func(static_cast<uint8_t>(ReqType::kClientGet),
+                           client_get_handler);
+
+  nexus->register_req_func(static_cast<uint8_t>(ReqType::kHeartbeatBatch),
+                           heartbeat_batch_handler);
+}
+
+void init_erpc(ServerThreadContext *tc, erpc::Nexus *nexus) {
+  const uint8_t rpc_id = kAppServerRpcId + tc->thread_id;
+  tc->rpc = new erpc::Rpc<erpc::CTransport>(
+      nexus, static_cast<void *>(tc), rpc_id, server_sm_handler, kAppPhyPort);
 
-  c->rpc->retry_connect_on_invalid_rpc_id_ = true;
+  tc->rpc->retry_connect_on_invalid_rpc_id_ = true;
+  for (AppContext *c : tc->groups) c->rpc = tc->rpc;
 
-  // Create a session to each Raft server, excluding self
+  // Create a session to each Raft server's thread with our thread ID,
+  // excluding self. The thread's Raft groups share the sessions.
   for (size_t i = 0; i < FLAGS_num_raft_servers; i++) {
     if (i == FLAGS_process_id) continue;
     std::string uri = erpc::get_uri_for_process(i);
-    printf("smr: Creating session to %s, index = %zu.\n", uri.c_str(), i);
+    printf("smr: Thread %zu creating session to %s, index = %zu.\n",
+           tc->thread_id, uri.c_str(), i);
 
-    c->conn_vec[i].session_idx = i;
-    c->conn_vec[i].session_num = c->rpc->create_session(uri, kAppServerRpcId);
-    assert(c->conn_vec[i].session_num >= 0);
+    tc->conn_vec[i].session_idx = i;
+    tc->conn_vec[i].session_num = tc->rpc->create_session(uri, rpc_id);
+    assert(tc->conn_vec[i].session_num >= 0);
+
+    for (AppContext *c : tc->groups) {
+      c->conn_vec[i].session_idx = i;
+      c->conn_vec[i].session_num = tc->conn_vec[i].session_num;
+    }
   }
 
-  while (c->num_sm_resps != FLAGS_num_raft_servers - 1) {
-    c->rpc->run_event_loop(200);  // 200 ms
+  while (tc->num_sm_resps != FLAGS_num_raft_servers - 1) {
+    tc->rpc->run_event_loop(200);  // 200 ms
     if (ctrl_c_pressed == 1) {
-      delete c->rpc;
+      delete tc->rpc;
       exit(0);
     }
   }
 
-  printf("smr: All sessions connected\n");
+  printf("smr: Thread %zu: All sessions connected\n", tc->thread_id);
 }
 
 inline void call_raft_periodic(AppContext *c) {
@@ -207,69 +524,97 @@ inline void call_raft_periodic(AppContext *c) {
   }
 }
 
-void server_func(erpc::Nexus *nexus, AppContext *c) {
-  // The Raft server must be initialized before running the eRPC event loop,
+// Compact the Raft log if enough entries have committed since the last
+// snapshot. Compact only after responding to committed requests, which needs
+// their log entries.
+void maybe_take_snapshot(AppContext *c) {
+  const size_t num_compactable_entries =
+      static_cast<size_t>(raft_get_commit_idx(c->server.raft) -
+                          raft_get_snapshot_last_idx(c->server.raft));
+  if (FLAGS_snapshot_log_entries > 0 &&
+      num_compactable_entries >= FLAGS_snapshot_log_entries) {
+    take_snapshot(c);
+  }
+}
+
+// Print the stats of a server thread's Raft groups, and reset them
+void print_server_stats(ServerThreadContext *tc) {
+  erpc::Latency commit_latency;
+  size_t num_led_groups = 0, num_log_entries = 0;
+  size_t num_batches = 0, num_batched_reqs = 0;
+  size_t lease_reads = 0, read_index_reads = 0;
+
+  for (AppContext *c : tc->groups) {
+    commit_latency += c->server.commit_latency;
+    if (raft_is_leader(c->server.raft)) num_led_groups++;
+    num_log_entries += static_cast<size_t>(raft_get_log_count(c->server.raft));
+    num_batches += c->server.stat_num_batches;
+    num_batched_reqs += c->server.stat_num_batched_reqs;
+    lease_reads += c->server.stat_lease_reads;
+    read_index_reads += c->server.stat_read_index_reads;
+
+    c->server.commit_latency.reset();
+    c->server.stat_num_batches = 0;
+    c->server.stat_num_batched_reqs = 0;
+    c->server.stat_lease_reads = 0;
+    c->server.stat_read_index_reads = 0;
+  }
+
+  printf(
+      "smr: Thread %zu: Leader of %zu/%zu groups. Leader commit latency (us) = "
+      "{%.2f median, %.2f 99%%}. Number of log entries = %zu. "
+      "Average batch size = %.2f. Reads: %zu lease, %zu ReadIndex. "
+      "Heartbeats per batch = %.2f.\n",
+      tc->thread_id, num_led_groups, tc->groups.size(),
+      kAppMeasureCommitLatency ? commit_latency.perc(.50) / 10.0 : -1.0,
+      kAppMeasureCommitLatency ? commit_latency.perc(.99) / 10.0 : -1.0,
+      num_log_entries, num_batched_reqs / (num_batches + 0.01), lease_reads,
+      read_index_reads,
+      tc->stat_heartbeats / (tc->stat_heartbeat_batches + 0.01));
+
+  tc->stat_heartbeat_batches = 0;
+  tc->stat_heartbeats = 0;
+}
+
+// The function run by each Raft server thread, which hosts the Raft groups in
+// tc->groups
+void server_func(erpc::Nexus *nexus, ServerThreadContext *tc) {
+  // The Raft groups must be initialized before running the eRPC event loop,
   // including running it for eRPC session management.
-  init_raft(c);
-  init_erpc(c, nexus);
-  c->server.table.reserve(kAppNumKeys * 2);  // Pre-allocate buckets with room
+  for (AppContext *c : tc->groups) {
+    init_raft(c);
+
+    // Pre-allocate buckets with room
+    c->server.table.reserve(kAppNumKeys * 2 / FLAGS_num_raft_groups);
+  }
+  init_erpc(tc, nexus);
 
   // The main loop
   size_t loop_tsc = erpc::rdtsc();
   while (ctrl_c_pressed == 0) {
     if (erpc::rdtsc() - loop_tsc > 3000000000ull) {
-      erpc::Latency &commit_latency = c->server.commit_latency;
-
-      printf(
-          "smr: Leader commit latency (us) = "
-          "{%.2f median, %.2f 99%%}. Number of log entries = %ld.\n",
-          kAppMeasureCommitLatency ? commit_latency.perc(.50) / 10.0 : -1.0,
-          kAppMeasureCommitLatency ? commit_latency.perc(.99) / 10.0 : -1.0,
-          raft_get_log_count(c->server.raft));
-
+      print_server_stats(tc);
       loop_tsc = erpc::rdtsc();
-      commit_latency.reset();
     }
 
-    call_raft_periodic(c);
-    c->rpc->run_event_loop_once();
+    for (AppContext *c : tc->groups) call_raft_periodic(c);
+    tc->rpc->run_event_loop_once();
 
-    leader_saveinfo_t &leader_sav = c->server.leader_saveinfo;
-    if (!leader_sav.in_use) {
-      // Either we are the leader and don't have an active request, or we
-      // are a follower
-      continue;
+    for (AppContext *c : tc->groups) {
+      append_noop_if_new_leader(c);
+      append_client_batch(c);
+      flush_raft_log(c);  // Before we respond to the leader or clients
+      respond_committed_reqs(c);
+      serve_pending_reads(c);
+      maybe_take_snapshot(c);
     }
 
-    int commit_status = raft_msg_entry_response_committed(
-        c->server.raft, &leader_sav.msg_entry_response);
-    assert(commit_status == 0 || commit_status == 1);
-
-    if (commit_status == 1) {
-      // Committed: Send a response
-      raft_apply_all(c->server.raft);
-
-      leader_sav.in_use = false;
-      if (kAppMeasureCommitLatency) {
-        size_t commit_cycles = erpc::rdtsc() - leader_sav.start_tsc;
-        double commit_usec =
-            erpc::to_usec(commit_cycles, c->rpc->get_freq_ghz());
-        c->server.commit_latency.update(commit_usec * 10);
-      }
-
-      if (kAppTimeEnt)
-        c->server.time_ents.emplace_back(TimeEntType::kCommitted);
-
-      // XXX: Is this correct, or should we send response in _apply_log()
-      // callback? This doesn't adversely affect failure-free performance.
-      client_resp_t client_resp(ClientRespType::kSuccess);
-
-      erpc::ReqHandle *req_handle = leader_sav.req_handle;
-      send_client_response(c, req_handle, client_resp);
-    }
+    // Heartbeats queued by all groups in this iteration
+    send_heartbeat_batches(tc);
   }
 
   // This is OK even when kAppTimeEnt = false
+  AppContext *c = tc->groups[0];
   printf("smr: Printing first 1000 of %zu time entries.\n",
          c->server.time_ents.size());
   const size_t num_print =
@@ -277,14 +622,17 @@ void server_func(erpc::Nexus *nexus, AppContext *c) {
 
   if (num_print > 0) {
     size_t base_tsc = c->server.time_ents[0].tsc;
-    double freq_ghz = c->rpc->get_freq_ghz();
+    double freq_ghz = tc->rpc->get_freq_ghz();
     for (size_t i = 0; i < num_print; i++) {
       printf("%s\n",
              c->server.time_ents[i].to_string(base_tsc, freq_ghz).c_str());
     }
   }
 
-  printf("smr: Final log size (including uncommitted entries) = %ld\n",
-         raft_get_log_count(c->server.raft));
-  delete c->rpc;
+  for (AppContext *group_c : tc->groups) {
+    printf("smr: Group %zu: Final log size (including uncommitted entries) = "
+           "%ld\n",
+           group_c->server.group_id, raft_get_log_count(group_c->server.raft));
+  }
+  delete tc->rpc;
 }
@@ -9,6 +9,21 @@ int main(int argc, char **argv) {
   signal(SIGINT, ctrl_c_handler);
   erpc::rt_assert(FLAGS_num_raft_servers > 0 &&
                   FLAGS_num_raft_servers % 2 == 1);
+  erpc::rt_assert(FLAGS_client_window >= 1 &&
+                      FLAGS_client_window <= kAppMaxClientWindow,
+                  "Invalid client window");
+  erpc::rt_assert(FLAGS_get_percent <= 100, "Invalid GET percentage");
+
+  erpc::rt_assert(FLAGS_num_server_threads >= 1 &&
+                      FLAGS_num_server_threads <= kAppMaxServerThreads,
+                  "Invalid number of server threads");
+  erpc::rt_assert(FLAGS_num_raft_groups >= FLAGS_num_server_threads &&
+                      FLAGS_num_raft_groups <= kAppNumKeys,
+                  "Each server thread needs at least one Raft group");
+  erpc::rt_assert(!kUsePmem || FLAGS_num_raft_groups == 1,
+                  "The pmem log supports only one Raft group");
+  erpc::rt_assert(!kUsePmem || FLAGS_raft_log_dir.empty(),
+                  "Use either the pmem log or the file-backed log");
 
   erpc::Nexus nexus(erpc::get_uri_for_process(FLAGS_process_id),
                     FLAGS_numa_node, 0);
@@ -18,39 +33,57 @@ int main(int argc, char **argv) {
         erpc::trim_hostname(erpc::get_uri_for_process(i));
   }
 
-  if (kColocateClientWithLastServer) {
-    AppContext server_context;
-    server_context.conn_vec.resize(FLAGS_num_raft_servers);
-    for (auto &peer_conn : server_context.conn_vec)
-      peer_conn.c = &server_context;
-
-    AppContext client_context;
-    client_context.conn_vec.resize(FLAGS_num_raft_servers);
-    for (auto &peer_conn : client_context.conn_vec)
-      peer_conn.c = &client_context;
-
-    // Run two threads on the last server because I have only three machines
-    if (FLAGS_process_id == FLAGS_num_raft_servers - 1) {
-      auto server_thread = std::thread(server_func, &nexus, &server_context);
-      auto client_thread = std::thread(client_func, &nexus, &client_context);
-
-      erpc::bind_to_core(server_thread, FLAGS_numa_node, 0);
-      erpc::bind_to_core(client_thread, FLAGS_numa_node, 1);
-      server_thread.join();
-      client_thread.join();
-    } else {
-      auto thread = std::thread(server_func, &nexus, &server_context);
-      erpc::bind_to_core(thread, FLAGS_numa_node, 0);
-      thread.join();
-    }
-  } else {
-    AppContext c;
-    c.conn_vec.resize(FLAGS_num_raft_servers);  // Both clients and servers
+  // Raft server contexts: one per Raft group, and one per server thread.
+  // Group g is hosted by server thread (g % FLAGS_num_server_threads).
+  std::vector<AppContext> group_contexts(FLAGS_num_raft_groups);
+  std::vector<ServerThreadContext> thread_contexts(FLAGS_num_server_threads);
+  for (size_t t = 0; t < FLAGS_num_server_threads; t++) {
+    ServerThreadContext &tc = thread_contexts[t];
+    tc.thread_id = t;
+    tc.conn_vec.resize(FLAGS_num_raft_servers);
+    tc.heartbeat_batch_vec.resize(FLAGS_num_raft_servers);
+  }
+
+  for (size_t g = 0; g < FLAGS_num_raft_groups; g++) {
+    AppContext &c = group_contexts[g];
+    c.server.group_id = g;
+    c.server.thread = &thread_contexts[get_thread_for_group(g)];
+    c.server.thread->groups.push_back(&c);
+
+    c.conn_vec.resize(FLAGS_num_raft_servers);
     for (auto &peer_conn : c.conn_vec) peer_conn.c = &c;
+  }
 
-    auto thread =
-        std::thread(is_raft_server() ? server_func : client_func, &nexus, &c);
-    erpc::bind_to_core(thread, FLAGS_numa_node, 2);
-    thread.join();
+  // Client context, with a session to each thread of each Raft server
+  AppContext client_context;
+  client_context.conn_vec.resize(FLAGS_num_raft_servers *
+                                 FLAGS_num_server_threads);
+  for (auto &peer_conn : client_context.conn_vec) peer_conn.c = &client_context;
+
+  const bool run_server = is_raft_server();
+  const bool run_client = !is_raft_server() ||
+                          (kColocateClientWithLastServer &&
+                           FLAGS_process_id == FLAGS_num_raft_servers - 1);
+
+  // Run the server threads on cores [base, base + num_server_threads), and the
+  // client on the next core. I have only three pmem machines, so the last
+  // server also runs a client.
+  const size_t base_core = kColocateClientWithLastServer ? 0 : 2;
+  std::vector<std::thread> threads;
+  if (run_server) {
+    register_server_req_funcs(&nexus);
+    for (size_t t = 0; t < FLAGS_num_server_threads; t++) {
+      threads.emplace_back(server_func, &nexus, &thread_contexts[t]);
+      erpc::bind_to_core(threads.back(), FLAGS_numa_node, base_core + t);
+    }
   }
+
+  if (run_client) {
+    threads.emplace_back(client_func, &nexus, &client_context);
+    erpc::bind_to_core(threads.back(), FLAGS_numa_node,
+                       run_server ? base_core + FLAGS_num_server_threads
+                                  : base_core);
+  }
+
+  for (auto &thread : threads) thread.join();
 }
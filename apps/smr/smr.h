@@ -9,10 +9,12 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <deque>
 #include <set>
 #include <unordered_map>
 
 #include "../apps_common.h"
+#include "file_log.h"
 #include "pmem_log.h"
 #include "time_entry.h"
 #include "util/autorun_helpers.h"
@@ -20,6 +22,12 @@
 
 extern "C" {
 #include <raft.h>
+
+// From willemt/raft's raft_private.h. raft_send_appendentries() sends an
+// appendentries request with all entries from the node's next index.
+int raft_send_appendentries(raft_server_t *me, raft_node_t *node);
+void raft_node_set_next_idx(raft_node_t *node, raft_index_t nextIdx);
+void raft_node_set_match_idx(raft_node_t *node, raft_index_t matchIdx);
 }
 
 static constexpr bool kUsePmem = false;
@@ -27,9 +35,13 @@ static constexpr bool kUsePmem = false;
 // We have only 3 pmem machines, so client runs on the third server machine
 static constexpr bool kColocateClientWithLastServer = kUsePmem;
 
-// We sometimes run a server and client on the same server
-static constexpr size_t kAppServerRpcId = 2;  // Rpc ID of all Raft servers
-static constexpr size_t kAppClientRpcId = 3;  // Rpc ID of the Raft client
+// Each Raft server process runs up to kAppMaxServerThreads threads. Server
+// thread i uses Rpc ID (kAppServerRpcId + i) in all server processes. We
+// sometimes run a server and client on the same server.
+static constexpr size_t kAppMaxServerThreads = 16;
+static constexpr size_t kAppServerRpcId = 2;  // Rpc ID of server thread 0
+static constexpr size_t kAppClientRpcId =
+    kAppServerRpcId + kAppMaxServerThreads;  // Rpc ID of the Raft client
 
 // Key-value configuration
 
@@ -50,6 +62,28 @@ static constexpr bool kAppEnableRaftConsoleLog = false;  // Non-null console log
 // willemt/raft uses a very large 1000 ms election timeout
 static constexpr size_t kAppRaftElectionTimeoutMsec = 1000;
 
+// Leader leases. A leader serves reads locally for kAppRaftElectionTimeoutMsec
+// after a majority acknowledged its appendentries, scaled down by the max
+// relative clock drift between servers. This relies on willemt/raft followers
+// rejecting other candidates for an election timeout after hearing from the
+// leader.
+static constexpr double kAppMaxClockDrift = 0.05;
+
+// Key of the no-op entry that a new leader commits before serving reads
+static constexpr size_t kAppNoopKey = SIZE_MAX;
+
+// Replication pipelining. The leader sends client requests received in one
+// event loop iteration as one batch of Raft entries, and keeps up to
+// kAppMaxAeInflight appendentries requests in flight to each follower.
+static constexpr size_t kAppMaxAeInflight = erpc::kSessionReqWindow;
+static constexpr int kAppMaxAeEntries = 256;  // Max entries per appendentries
+
+// Snapshots are sent to lagging followers in chunks of this size
+static constexpr size_t kAppSnapshotChunkSize = MB(1);
+
+// Max outstanding requests per client
+static constexpr size_t kAppMaxClientWindow = 16;
+
 // eRPC defines
 static constexpr size_t kAppPhyPort = 0;
 static constexpr size_t kAppNumaNode = 0;
@@ -57,15 +91,44 @@ static constexpr size_t kAppNumaNode = 0;
 // We run FLAGS_num_processes processes in the cluster, of which the first
 // FLAGS_num_raft_servers are Raft servers, and the remaining are Raft clients.
 DEFINE_uint64(num_raft_servers, 0, "Number of Raft servers");
+DEFINE_uint64(client_window, 1, "Outstanding requests per client");
+DEFINE_uint64(get_percent, 0, "Percentage of client requests that are GETs");
+DEFINE_bool(read_index, false,
+            "Serve reads with ReadIndex when the leader lease has expired");
+DEFINE_uint64(num_server_threads, 1, "Raft server threads per process");
+DEFINE_uint64(num_raft_groups, 1,
+              "Number of Raft groups. Each group owns a key range, and is "
+              "hosted by one thread in every server process.");
+DEFINE_string(raft_log_dir, "",
+              "Directory for file-backed Raft logs, e.g., on an NVMe SSD. "
+              "Empty keeps the log in DRAM, unless kUsePmem is set.");
+DEFINE_uint64(raft_log_file_mb, 4096, "Size of each file-backed Raft log");
+DEFINE_uint64(snapshot_log_entries, 0,
+              "Compact the Raft log after this many committed entries. "
+              "0 disables log compaction.");
 
 // Return true iff this machine is a Raft server (leader or follower)
 bool is_raft_server() { return FLAGS_process_id < FLAGS_num_raft_servers; }
 
+// Return the Raft group that owns a key. Groups own contiguous key ranges.
+size_t get_group_for_key(size_t key) {
+  assert(key < kAppNumKeys);
+  return key * FLAGS_num_raft_groups / kAppNumKeys;
+}
+
+// Return the server thread that hosts a Raft group in every server process
+size_t get_thread_for_group(size_t group_id) {
+  return group_id % FLAGS_num_server_threads;
+}
+
 /// The eRPC request types
 enum class ReqType : uint8_t {
   kRequestVote = 3,  // Raft requestvote RPC
   kAppendEntries,    // Raft appendentries RPC
-  kClientReq         // Client-to-server Rpc
+  kClientReq,        // Client-to-server Rpc
+  kSnapshotChunk,    // One chunk of a Raft snapshot sent to a follower
+  kClientGet,        // Client-to-server GET, which isn't replicated
+  kHeartbeatBatch    // Heartbeats for all Raft groups on a server thread
 };
 
 /// The value type for the key-value pairs
@@ -109,7 +172,20 @@ struct client_resp_t {
       : resp_type(resp_type), leader_node_id(leader_node_id) {}
 };
 
-class AppContext;  // Forward declaration
+// A client's GET request, and the response. Failed GETs have only the
+// client_resp_t.
+struct client_get_req_t {
+  size_t key;
+};
+
+struct client_get_resp_t {
+  client_resp_t resp;
+  bool found;
+  value_t value;
+};
+
+class AppContext;           // Forward declaration
+class ServerThreadContext;  // Forward declaration
 
 // Peer-peer or client-peer connection
 struct connection_t {
@@ -117,6 +193,19 @@ struct connection_t {
   int session_num = -1;       // eRPC session number
   size_t session_idx = std::numeric_limits<size_t>::max();  // Index in conn_vec
   AppContext *c;
+
+  // Leader-only appendentries pipeline state for the peer on this connection
+  raft_term_t ae_term = 0;            // Term in which ae_last_sent_idx is valid
+  raft_index_t ae_last_sent_idx = 0;  // Last entry sent, or 0 if unknown
+  size_t ae_num_inflight = 0;         // Outstanding appendentries requests
+
+  // Leader-only: True if a snapshot is being sent to the peer
+  bool snapshot_xfer_active = false;
+
+  // Leader-only: Send time of the latest appendentries request acknowledged by
+  // the peer, and the term of the acknowledgement
+  uint64_t lease_ack_tsc = 0;
+  raft_term_t lease_ack_term = 0;
 };
 
 // Tag for requests sent to Raft peers (both requestvote and appendentries)
@@ -124,17 +213,48 @@ struct raft_req_tag_t {
   erpc::MsgBuffer req_msgbuf;
   erpc::MsgBuffer resp_msgbuf;
   raft_node_t *node;  // The Raft node to which req was sent
+  uint64_t send_tsc;  // Time at which the request was sent
+};
+
+// A heartbeat, i.e., an appendentries request without entries, for one Raft
+// group. A server thread sends the heartbeats of all its groups to a Raft
+// server in one kHeartbeatBatch request.
+struct app_heartbeat_t {
+  size_t group_id;
+  int node_id;  // Node ID of the sender
+  msg_appendentries_t msg_ae;
+};
+
+// Tag for kHeartbeatBatch requests
+struct heartbeat_batch_tag_t {
+  erpc::MsgBuffer req_msgbuf;
+  erpc::MsgBuffer resp_msgbuf;
+  size_t peer_idx;    // Index of the Raft server to which req was sent
+  uint64_t send_tsc;  // Time at which the request was sent
 };
 
-// Info about client request(s) saved at a leader for the nested Rpc. Each
-// Raft server has one of these.
+// Info about a client request saved at a leader until its Raft entry commits
 struct leader_saveinfo_t {
-  bool in_use = false;          // Leader has an ongoing commit request
-  erpc::ReqHandle *req_handle;  // This could be a vector if we do batching
-  uint64_t start_tsc;           // Time at which client's request was received
+  erpc::ReqHandle *req_handle;
+  uint64_t start_tsc;  // Time at which client's request was received
   msg_entry_response_t msg_entry_response;  // Used to check commit status
 };
 
+// Header of a serialized snapshot of the key-value table. The header is
+// followed by num_pairs client_req_t structs, one per key.
+struct snapshot_hdr_t {
+  raft_index_t last_idx;  // Index of the last log entry in the snapshot
+  raft_term_t last_term;  // Term of the last log entry in the snapshot
+  size_t num_pairs;
+};
+
+// A GET waiting at the leader for its lease or a ReadIndex round
+struct pending_read_t {
+  erpc::ReqHandle *req_handle;
+  uint64_t arrival_tsc;   // A heartbeat round sent after this confirms the read
+  raft_index_t read_idx;  // Commit index when the read arrived
+};
+
 // A log entry serialized into persistent memory
 struct pmem_ser_logentry_t {
   raft_entry_t raft_entry;
@@ -145,20 +265,44 @@ struct pmem_ser_logentry_t {
       : raft_entry(r), client_req(c) {}
 };
 
-// Context for both servers and clients
+// Context for clients, and for one Raft group at servers. The Raft groups
+// hosted by a server thread share the thread's Rpc.
 class AppContext {
  public:
   // Raft server members
   struct {
     int node_id = -1;  // This server's Raft node ID
     raft_server_t *raft = nullptr;
+    size_t group_id = 0;                    // This Raft group's ID
+    ServerThreadContext *thread = nullptr;  // The thread hosting this group
 
     // Time since last invocation of raft_periodic() with a non-zero
     // msec_elapsed argument
     size_t raft_periodic_tsc;
     size_t cycles_per_msec;  // rdtsc cycles in one millisecond
 
-    leader_saveinfo_t leader_saveinfo;  // Info for the ongoing commit request
+    // Client requests received in this event loop iteration, to be appended
+    // to the Raft log as one batch
+    std::vector<leader_saveinfo_t> pending_batch;
+
+    // Client requests in the Raft log that are not yet committed, in log order
+    std::deque<leader_saveinfo_t> uncommitted_reqs;
+
+    // If set, the appendentries callback doesn't send requests. This is set
+    // while a batch is appended so that it's sent in one request per follower.
+    bool defer_ae_send = false;
+
+    // If set, the appendentries callback sends a heartbeat even if there are
+    // no entries to send. This is used for ReadIndex rounds.
+    bool force_ae_send = false;
+
+    // Leader lease and reads
+    size_t lease_cycles;              // Lease duration in rdtsc cycles
+    raft_term_t noop_term = 0;        // Term of our latest no-op entry
+    raft_index_t noop_idx = 0;        // Log index of our latest no-op entry
+    std::deque<pending_read_t> pending_reads;  // In arrival order
+    uint64_t read_index_round_tsc = 0;  // Start of the latest ReadIndex round
+
     std::vector<TimeEnt> time_ents;
 
     // An in-memory pool for application data for Raft log records. In DRAM
@@ -173,6 +317,23 @@ class AppContext {
     // allocated from log_entry_appdata_pool.
     PmemLog<pmem_ser_logentry_t> *pmem_log;
 
+    // The file-backed Raft log, used only if FLAGS_raft_log_dir is set. Like
+    // the pmem log, it holds copies of the entries in willemt/raft's log.
+    FileLog<pmem_ser_logentry_t> *file_log = nullptr;
+
+    // Appendentries responses that wait for the file-backed log to be flushed
+    // at the end of the event loop iteration
+    std::vector<erpc::ReqHandle *> unflushed_ae_resps;
+
+    // The latest snapshot of the key-value table, serialized. Empty if there
+    // is no snapshot yet. Leaders send this to followers that need entries
+    // that have been compacted.
+    std::vector<uint8_t> snapshot;
+
+    // A snapshot being received from the leader, and its last entry index
+    std::vector<uint8_t> snapshot_rx;
+    raft_index_t snapshot_rx_last_idx = 0;
+
     // Request tags used for RPCs exchanged among Raft servers
     AppMemPool<raft_req_tag_t> raft_req_tag_pool;
 
@@ -183,30 +344,75 @@ class AppContext {
     erpc::Latency commit_latency;            // Amplification factor = 10
     size_t stat_requestvote_enq_fail = 0;    // Failed to send requestvote req
     size_t stat_appendentries_enq_fail = 0;  // Failed to send appendentries req
+    size_t stat_num_batches = 0;             // Client request batches appended
+    size_t stat_num_batched_reqs = 0;        // Client requests in all batches
+    size_t stat_lease_reads = 0;             // GETs served under the lease
+    size_t stat_read_index_reads = 0;        // GETs served with ReadIndex
   } server;
 
   // SMR client members
   struct {
-    size_t leader_idx;  // Client's view of the leader node's index in conn_vec
+    // Client's view of each Raft group's leader, as the leader's Raft server
+    // index. The session to the group's thread at Raft server i is
+    // conn_vec[i * FLAGS_num_server_threads + thread].
+    std::vector<size_t> leader_idx;
 
     size_t num_resps_total = 0;
     size_t num_resps_this_measurement = 0;
     size_t num_console_prints = 0;
 
-    erpc::MsgBuffer req_msgbuf;   // Preallocated req msgbuf
-    erpc::MsgBuffer resp_msgbuf;  // Preallocated response msgbuf
+    // Preallocated request and response msgbufs for each outstanding request
+    erpc::MsgBuffer req_msgbuf[kAppMaxClientWindow];
+    erpc::MsgBuffer resp_msgbuf[kAppMaxClientWindow];
 
-    erpc::ChronoTimer chrono_timer;  // For latency measurement
+    // For latency measurement
+    erpc::ChronoTimer chrono_timer[kAppMaxClientWindow];
+
+    // The Raft group and leader index to which each outstanding request was
+    // sent
+    size_t slot_group[kAppMaxClientWindow];
+    size_t slot_leader_idx[kAppMaxClientWindow];
+    bool slot_is_get[kAppMaxClientWindow];  // True if the request is a GET
     LatencyUsHdrHistogram lat_us_hdr_histogram;
   } client;
 
-  // Common members
+  // Common members. At servers, conn_vec holds the group's per-peer state.
   std::vector<connection_t> conn_vec;
   erpc::Rpc<erpc::CTransport> *rpc = nullptr;
   erpc::FastRand fast_rand;
   size_t num_sm_resps = 0;
 };
 
+// Context for a Raft server thread
+class ServerThreadContext {
+ public:
+  size_t thread_id;
+  erpc::Rpc<erpc::CTransport> *rpc = nullptr;
+
+  // The Raft groups hosted by this thread. Group g is at index
+  // g / FLAGS_num_server_threads.
+  std::vector<AppContext *> groups;
+
+  // Sessions to this thread's peer threads at other Raft servers, indexed by
+  // Raft server index
+  std::vector<connection_t> conn_vec;
+  size_t num_sm_resps = 0;
+
+  // Heartbeats queued in this event loop iteration, per Raft server index
+  std::vector<std::vector<app_heartbeat_t>> heartbeat_batch_vec;
+  AppMemPool<heartbeat_batch_tag_t> heartbeat_batch_tag_pool;
+  size_t stat_heartbeat_batches = 0;  // kHeartbeatBatch requests sent
+  size_t stat_heartbeats = 0;         // Heartbeats in all batches
+};
+
+// Return the context of a Raft group hosted by a server thread
+static AppContext *get_group_context(void *_thread_context, size_t group_id) {
+  auto *tc = static_cast<ServerThreadContext *>(_thread_context);
+  assert(group_id < FLAGS_num_raft_groups);
+  assert(get_thread_for_group(group_id) == tc->thread_id);
+  return tc->groups[group_id / FLAGS_num_server_threads];
+}
+
 // Generate a deterministic, random-ish node ID for a process. Process IDs are
 // unique at the cluster level. XXX: This can collide!
 static int get_raft_node_id_for_process(size_t process_id) {
@@ -0,0 +1,253 @@
+/**
+ * @file snapshot.h
+ * @brief Log compaction, and handlers for the snapshot transfer RPC
+ */
+
+#pragma once
+#include "smr.h"
+
+// A chunk of a serialized snapshot, sent by the leader to a lagging follower.
+// The chunk's data follows this header in the request.
+struct app_snapshot_chunk_t {
+  size_t group_id;        // Raft group of the snapshot
+  int node_id;            // Node ID of the sender
+  raft_term_t term;       // Sender's current term
+  raft_index_t last_idx;  // Index of the last log entry in the snapshot
+  size_t offset;          // Offset of this chunk in the serialized snapshot
+  size_t total_size;      // Size of the serialized snapshot
+};
+
+struct app_snapshot_chunk_resp_t {
+  bool success;        // False if the sender is not a valid leader
+  size_t next_offset;  // Offset of the next chunk the follower expects
+};
+
+// Compact the Raft log into a snapshot of the key-value table
+void take_snapshot(AppContext *c) {
+  // This applies all committed entries
+  if (raft_begin_snapshot(c->server.raft, 0) != 0) return;
+
+  const auto &table = c->server.table;
+  std::vector<uint8_t> &snapshot = c->server.snapshot;
+  snapshot.resize(sizeof(snapshot_hdr_t) + table.size() * sizeof(client_req_t));
+
+  auto *hdr = reinterpret_cast<snapshot_hdr_t *>(snapshot.data());
+  hdr->last_idx = raft_get_snapshot_last_idx(c->server.raft);
+  hdr->last_term = raft_get_snapshot_last_term(c->server.raft);
+  hdr->num_pairs = table.size();
+
+  auto *pair_arr = reinterpret_cast<client_req_t *>(hdr + 1);
+  size_t i = 0;
+  for (const auto &kv : table) {
+    pair_arr[i].key = kv.first;
+    pair_arr[i].value = kv.second;
+    i++;
+  }
+
+  // This removes the compacted entries with the log_poll callback, and starts
+  // sending the snapshot to followers that need it
+  int e = raft_end_snapshot(c->server.raft);
+  erpc::rt_assert(e == 0, "raft_end_snapshot failed");
+  if (kUsePmem) {
+    c->server.pmem_log->truncate_prefix(static_cast<size_t>(hdr->last_idx) + 1);
+  }
+  if (c->server.file_log != nullptr) {
+    c->server.file_log->truncate_prefix(static_cast<size_t>(hdr->last_idx) + 1);
+  }
+
+  printf("smr: Took snapshot of %zu keys up to log index %ld [%s].\n",
+         hdr->num_pairs, static_cast<long>(hdr->last_idx),
+         erpc::get_formatted_time().c_str());
+}
+
+// Replace the log and the key-value table with a snapshot received from the
+// leader
+void load_snapshot(AppContext *c, std::vector<uint8_t> &snapshot) {
+  auto *hdr = reinterpret_cast<snapshot_hdr_t *>(snapshot.data());
+  assert(snapshot.size() ==
+         sizeof(snapshot_hdr_t) + hdr->num_pairs * sizeof(client_req_t));
+
+  // willemt/raft discards the log without callbacks, so save the entries'
+  // buffers to free them if the snapshot is loaded
+  std::vector<client_req_t *> appdata_vec;
+  for (raft_index_t i = raft_get_snapshot_last_idx(c->server.raft) + 1;
+       i <= raft_get_current_idx(c->server.raft); i++) {
+    raft_entry_t *ety = raft_get_entry_from_idx(c->server.raft, i);
+    appdata_vec.push_back(static_cast<client_req_t *>(ety->data.buf));
+  }
+
+  int e = raft_begin_load_snapshot(c->server.raft, hdr->last_term,
+                                   hdr->last_idx);
+  if (e != 0) {
+    printf("smr: Ignoring unneeded snapshot up to log index %ld.\n",
+           static_cast<long>(hdr->last_idx));
+    return;
+  }
+
+  for (client_req_t *appdata : appdata_vec) {
+    c->server.log_entry_appdata_pool.free(appdata);
+  }
+  if (kUsePmem) {
+    c->server.pmem_log->reset(static_cast<size_t>(hdr->last_idx) + 1);
+  }
+  if (c->server.file_log != nullptr) {
+    c->server.file_log->reset(static_cast<size_t>(hdr->last_idx) + 1);
+  }
+
+  c->server.table.clear();
+  const auto *pair_arr = reinterpret_cast<client_req_t *>(hdr + 1);
+  for (size_t i = 0; i < hdr->num_pairs; i++) {
+    c->server.table[pair_arr[i].key] = pair_arr[i].value;
+  }
+
+  // Loading a snapshot removes all nodes except self. The cluster
+  // configuration is static, so add the peers back.
+  for (size_t i = 0; i < FLAGS_num_raft_servers; i++) {
+    if (i == FLAGS_process_id) continue;
+    raft_add_node(c->server.raft, static_cast<void *>(&c->conn_vec[i]),
+                  get_raft_node_id_for_process(i), 0);
+  }
+  raft_end_load_snapshot(c->server.raft);
+
+  printf("smr: Loaded snapshot of %zu keys up to log index %ld [%s].\n",
+         hdr->num_pairs, static_cast<long>(hdr->last_idx),
+         erpc::get_formatted_time().c_str());
+
+  // Keep the snapshot to send it to followers if we become the leader
+  c->server.snapshot = std::move(snapshot);
+}
+
+void snapshot_chunk_handler(erpc::ReqHandle *req_handle, void *_context) {
+  const erpc::MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  auto *chunk = reinterpret_cast<app_snapshot_chunk_t *>(req_msgbuf->buf_);
+  AppContext *c = get_group_context(_context, chunk->group_id);
+  const size_t chunk_size =
+      req_msgbuf->get_data_size() - sizeof(app_snapshot_chunk_t);
+
+  erpc::MsgBuffer &resp_msgbuf = req_handle->pre_resp_msgbuf_;
+  c->rpc->resize_msg_buffer(&resp_msgbuf, sizeof(app_snapshot_chunk_resp_t));
+  auto *resp = reinterpret_cast<app_snapshot_chunk_resp_t *>(resp_msgbuf.buf_);
+  resp->success = chunk->term >= raft_get_current_term(c->server.raft);
+  resp->next_offset = 0;
+
+  if (resp->success) {
+    std::vector<uint8_t> &snapshot_rx = c->server.snapshot_rx;
+    if (chunk->offset == 0) {
+      c->server.snapshot_rx_last_idx = chunk->last_idx;
+      snapshot_rx.clear();
+      snapshot_rx.reserve(chunk->total_size);
+    }
+
+    // Ignore chunks of other snapshots and out-of-order chunks. The leader
+    // resends from next_offset.
+    if (chunk->last_idx == c->server.snapshot_rx_last_idx &&
+        chunk->offset == snapshot_rx.size()) {
+      const uint8_t *data = reinterpret_cast<uint8_t *>(chunk + 1);
+      snapshot_rx.insert(snapshot_rx.end(), data, data + chunk_size);
+      resp->next_offset = snapshot_rx.size();
+
+      if (snapshot_rx.size() == chunk->total_size) {
+        load_snapshot(c, snapshot_rx);
+        snapshot_rx.clear();
+      }
+    }
+  }
+
+  c->rpc->enqueue_response(req_handle, &resp_msgbuf);
+}
+
+void snapshot_chunk_cont(void *, void *);  // Fwd decl
+
+// Send the chunk of the leader's snapshot at \p offset to a follower
+void send_snapshot_chunk(AppContext *c, raft_node_t *node, size_t offset) {
+  auto *conn = static_cast<connection_t *>(raft_node_get_udata(node));
+  const std::vector<uint8_t> &snapshot = c->server.snapshot;
+  assert(offset < snapshot.size());
+  const size_t chunk_size =
+      std::min(kAppSnapshotChunkSize, snapshot.size() - offset);
+
+  raft_req_tag_t *rrt = c->server.raft_req_tag_pool.alloc();
+  rrt->req_msgbuf = c->rpc->alloc_msg_buffer_or_die(
+      sizeof(app_snapshot_chunk_t) + chunk_size);
+  rrt->resp_msgbuf =
+      c->rpc->alloc_msg_buffer_or_die(sizeof(app_snapshot_chunk_resp_t));
+  rrt->node = node;
+
+  auto *chunk = reinterpret_cast<app_snapshot_chunk_t *>(rrt->req_msgbuf.buf_);
+  chunk->group_id = c->server.group_id;
+  chunk->node_id = c->server.node_id;
+  chunk->term = raft_get_current_term(c->server.raft);
+  chunk->last_idx =
+      reinterpret_cast<const snapshot_hdr_t *>(snapshot.data())->last_idx;
+  chunk->offset = offset;
+  chunk->total_size = snapshot.size();
+  memcpy(chunk + 1, snapshot.data() + offset, chunk_size);
+
+  c->rpc->enqueue_request(conn->session_num,
+                          static_cast<uint8_t>(ReqType::kSnapshotChunk),
+                          &rrt->req_msgbuf, &rrt->resp_msgbuf,
+                          snapshot_chunk_cont, reinterpret_cast<void *>(rrt));
+}
+
+void snapshot_chunk_cont(void *, void *_tag) {
+  auto *rrt = reinterpret_cast<raft_req_tag_t *>(_tag);
+  auto *conn = static_cast<connection_t *>(raft_node_get_udata(rrt->node));
+  AppContext *c = conn->c;
+  const auto *chunk =
+      reinterpret_cast<app_snapshot_chunk_t *>(rrt->req_msgbuf.buf_);
+  const auto *resp =
+      reinterpret_cast<app_snapshot_chunk_resp_t *>(rrt->resp_msgbuf.buf_);
+
+  // Stop on failure, or if we're not the leader anymore. The next heartbeat
+  // to the follower restarts the transfer if it's still needed.
+  bool xfer_active = rrt->resp_msgbuf.get_data_size() > 0 && resp->success &&
+                     raft_is_leader(c->server.raft) &&
+                     chunk->term == raft_get_current_term(c->server.raft);
+
+  if (xfer_active) {
+    const auto *hdr =
+        reinterpret_cast<snapshot_hdr_t *>(c->server.snapshot.data());
+
+    if (chunk->last_idx != hdr->last_idx) {
+      // We took a newer snapshot during the transfer, so send that instead
+      send_snapshot_chunk(c, rrt->node, 0);
+    } else if (resp->next_offset == chunk->total_size) {
+      // The follower loaded the snapshot. Continue with appendentries.
+      xfer_active = false;
+      raft_node_set_next_idx(rrt->node, hdr->last_idx + 1);
+      raft_node_set_match_idx(rrt->node, hdr->last_idx);
+      conn->ae_last_sent_idx = 0;
+      raft_send_appendentries(c->server.raft, rrt->node);
+    } else {
+      send_snapshot_chunk(c, rrt->node, resp->next_offset);
+    }
+  }
+
+  conn->snapshot_xfer_active = xfer_active;
+
+  c->rpc->free_msg_buffer(rrt->req_msgbuf);
+  c->rpc->free_msg_buffer(rrt->resp_msgbuf);
+  c->server.raft_req_tag_pool.free(rrt);
+}
+
+// Raft callback for sending a snapshot to a follower whose next log entry has
+// been compacted
+static int smr_raft_send_snapshot_cb(raft_server_t *, void *udata,
+                                     raft_node_t *node) {
+  auto *c = static_cast<AppContext *>(udata);
+  auto *conn = static_cast<connection_t *>(raft_node_get_udata(node));
+  if (conn->snapshot_xfer_active) return 0;
+  if (!c->rpc->is_connected(conn->session_num)) return 0;
+
+  printf("smr: Sending snapshot to node %s [%s].\n",
+         node_id_to_name_map[raft_node_get_id(node)].c_str(),
+         erpc::get_formatted_time().c_str());
+
+  // Loading the snapshot makes the follower forget us as the leader, so its
+  // earlier acknowledgements can't extend our lease
+  conn->lease_ack_tsc = 0;
+
+  conn->snapshot_xfer_active = true;
+  send_snapshot_chunk(c, node, 0);
+  return 0;
+}
@@ -25,9 +25,15 @@
 
 namespace erpc {
 
+/// The largest MTU among the compiled transports
+#define ERPC_COMMA_MTU(TTr) , TTr::kMTU
+static constexpr size_t kWheelMaxMTU =
+    const_max(static_cast<size_t>(0) ERPC_TRANSPORT_LIST(ERPC_COMMA_MTU));
+#undef ERPC_COMMA_MTU
+
 static constexpr double kWheelSlotWidthUs = .5;  ///< Duration per wheel slot
 static constexpr double kWheelHorizonUs =
-    1000000 * (kSessionCredits * CTransport::kMTU) / Timely::kMinRate;
+    1000000 * (kSessionCredits * kWheelMaxMTU) / Timely::kMinRate;
 
 // This ensures that packets for an sslot undergoing retransmission are rarely
 // in the wheel. This is recommended but not required.
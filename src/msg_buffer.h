@@ -26,8 +26,12 @@ class Rpc;
  * A message buffer is invalid if its #buf pointer is null.
  */
 class MsgBuffer {
-  friend class CTransport;
-  friend class Rpc<CTransport>;
+  friend class IBTransport;
+  friend class RawTransport;
+  friend class DpdkTransport;
+  friend class FakeTransport;
+  template <typename T>
+  friend class Rpc;
   friend class Session;
 
  private:
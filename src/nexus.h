@@ -1,5 +1,7 @@
 #pragma once
 
+#include <unistd.h>
+#include <atomic>
 #include <unordered_map>
 #include "common.h"
 #include "heartbeat_mgr.h"
@@ -19,7 +21,8 @@ class Rpc;
  * @brief A per-process library object used for initializing eRPC
  */
 class Nexus {
-  friend class Rpc<CTransport>;
+  template <typename T>
+  friend class Rpc;
 
   /**
    * @brief Initialize eRPC for this process
@@ -59,6 +62,78 @@ class Nexus {
   int register_req_func(uint8_t req_type, erpc_req_func_t req_func,
                         ReqFuncType req_func_type = ReqFuncType::kForeground);
 
+  /**
+   * @brief Enable at-most-once execution for a registered request type. This
+   * must be done before any Rpc registers a hook with the Nexus.
+   *
+   * Requests of this type must start with an amo_hdr_t. Each server Rpc keeps
+   * a table of the (client ID, sequence number) pairs it has received, and the
+   * responses to the completed ones. A duplicate of a completed request gets
+   * a copy of the saved response without running the request handler. A
+   * duplicate of a request whose handler is still running gets the same
+   * response when the handler enqueues it. This makes retries on a new
+   * session after a session reset safe for non-idempotent requests.
+   *
+   * @param max_entries The maximum number of saved responses per Rpc. The
+   * oldest responses are evicted first.
+   *
+   * @param expiry_ms The time for which a response is saved. A duplicate that
+   * arrives later is executed again.
+   *
+   * @return 0 on success, negative errno on failure.
+   */
+  int enable_at_most_once(uint8_t req_type, size_t max_entries,
+                          size_t expiry_ms);
+
+  /**
+   * @brief Enable response caching for a registered request type. This must be
+   * done before any Rpc registers a hook with the Nexus.
+   *
+   * This is for idempotent, read-mostly request types whose response depends
+   * only on the request data, e.g., lookups of hot keys. Each server Rpc
+   * caches responses keyed by a hash of the request data. A request whose
+   * data matches a cached response is answered by the event loop with a copy
+   * of that response, without running the request handler. Request handlers
+   * that modify the data behind cached responses must invalidate them with
+   * Rpc::invalidate_resp_cache().
+   *
+   * @param max_entries The maximum number of cached responses per Rpc. The
+   * oldest responses are evicted first.
+   *
+   * @param ttl_ms The time for which a response is cached
+   *
+   * @return 0 on success, negative errno on failure.
+   */
+  int enable_resp_cache(uint8_t req_type, size_t max_entries, size_t ttl_ms);
+
+  /**
+   * @brief Enable earliest-deadline-first scheduling for a registered
+   * background request type. This must be done before any Rpc registers a hook
+   * with the Nexus.
+   *
+   * Requests of this type must start with a deadline_hdr_t. Each background
+   * thread runs queued requests with deadlines before other work items, in
+   * order of deadline. A request that is dequeued after its deadline is shed:
+   * its handler is not run, and the client receives a response with zero data
+   * bytes. At-most-once and response-cached request types cannot be
+   * deadline-scheduled, since their saved response would be the empty one.
+   *
+   * @return 0 on success, negative errno on failure.
+   */
+  int enable_deadline_sched(uint8_t req_type);
+
+  /**
+   * @brief Select the transport that dispatch_transport() runs application
+   * code with. Any transport compiled into the library can be selected. The
+   * default is the transport chosen at build time (CTransport).
+   *
+   * @return 0 on success, negative errno if the transport is not compiled in
+   */
+  int set_transport(TransportType transport_type);
+
+  /// Return the transport selected with set_transport()
+  TransportType get_transport() const { return transport_type_; }
+
  private:
   enum class BgWorkItemType : bool { kReq, kResp };
 
@@ -75,6 +150,16 @@ class Nexus {
       return ret;
     }
 
+    static inline BgWorkItem make_deadline_req_item(
+        void *context, SSlot *sslot, void *rpc,
+        void (*shed_func)(void *rpc, SSlot *sslot), size_t deadline_tsc) {
+      BgWorkItem ret = make_req_item(context, sslot);
+      ret.rpc_ = rpc;
+      ret.shed_func_ = shed_func;
+      ret.deadline_tsc_ = deadline_tsc;
+      return ret;
+    }
+
     static inline BgWorkItem make_resp_item(void *context,
                                             erpc_cont_func_t cont_func,
                                             void *tag) {
@@ -93,14 +178,31 @@ class Nexus {
     // ownership of the request slot, so we can hold it until enqueue_response.
     SSlot *sslot_;
 
+    // Fields for deadline-scheduled requests. The Rpc is needed to shed the
+    // request if its deadline has passed. The Rpc's transport type is erased,
+    // so the Rpc provides the shedding function.
+    void *rpc_;
+    void (*shed_func_)(void *rpc, SSlot *sslot);
+    size_t deadline_tsc_;
+
     // Fields for continuations. For continuations, we have lost ownership of
     // the request slot, so the work item contains all needed info by value.
     erpc_cont_func_t cont_func_;
     void *tag_;
 
     bool is_req() const { return wi_type_ == BgWorkItemType::kReq; }
+
+    /// Comparator for earliest-deadline-first priority queues
+    struct LaterDeadline {
+      bool operator()(const BgWorkItem &a, const BgWorkItem &b) const {
+        return a.deadline_tsc_ > b.deadline_tsc_;
+      }
+    };
   };
 
+  /// An earliest-deadline-first queue of background requests
+  typedef MtPriorityQueue<BgWorkItem, BgWorkItem::LaterDeadline> BgEdfQueue;
+
   /// A hook created by an Rpc thread, and shared with the Nexus
   class Hook {
    public:
@@ -109,9 +211,38 @@ class Nexus {
     /// Background thread request queues, installed by the Nexus
     MtQueue<BgWorkItem> *bg_req_queue_arr_[kMaxBgThreads] = {nullptr};
 
+    /// Background thread queues for deadline-scheduled requests, installed by
+    /// the Nexus
+    BgEdfQueue *bg_edf_queue_arr_[kMaxBgThreads] = {nullptr};
+
     /// The Rpc thread's session management RX queue, installed by the Rpc.
     /// Work items from the SM thread for this Rpc are queued here.
     MtQueue<SmWorkItem> sm_rx_queue_;
+
+    /// True while the Rpc thread is blocked in an idle event loop iteration
+    std::atomic<bool> ev_loop_blocked_{false};
+
+    /// An eventfd that wakes up a blocked Rpc thread, installed by the Rpc if
+    /// idle backoff is enabled
+    int wakeup_fd_ = -1;
+
+    /// Wake up the Rpc thread if it's blocked. Other threads call this after
+    /// queueing work for the Rpc thread.
+    inline void wakeup() {
+      // Order the caller's queue push before the load. The Rpc thread orders
+      // its store before re-checking its queues.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (likely(!ev_loop_blocked_.load(std::memory_order_relaxed))) return;
+      notify();
+    }
+
+    /// Make the Rpc thread's current or next blocking wait return
+    inline void notify() {
+      if (wakeup_fd_ == -1) return;
+      const uint64_t one = 1;
+      ssize_t ret = write(wakeup_fd_, &one, sizeof(one));
+      _unused(ret);
+    }
   };
 
   /// Check if a hook with for rpc_id exists in this Nexus. The caller must not
@@ -138,6 +269,7 @@ class Nexus {
     TlsRegistry *tls_registry_;          ///< The Nexus's thread-local registry
     size_t bg_thread_index_;             ///< Index of this background thread
     MtQueue<BgWorkItem> *bg_req_queue_;  ///< Background thread request queue
+    BgEdfQueue *bg_edf_queue_;  ///< Deadline-scheduled request queue
   };
 
   /// Session management thread context
@@ -164,12 +296,13 @@ class Nexus {
   static void sm_thread_func(SmThreadCtx ctx);
 
   /// Read-mostly members exposed to Rpc threads
-  const double freq_ghz_;        ///< TSC frequncy
-  const std::string hostname_;   ///< The local host
-  const uint16_t sm_udp_port_;   ///< UDP port for session management
-  const size_t numa_node_;       ///< The NUMA node for this process
-  const size_t num_bg_threads_;  ///< Background threads to process Rpc reqs
-  TlsRegistry tls_registry_;     ///< A thread-local registry
+  const double freq_ghz_;         ///< TSC frequncy
+  const std::string hostname_;    ///< The local host
+  const uint16_t sm_udp_port_;    ///< UDP port for session management
+  const size_t numa_node_;        ///< The NUMA node for this process
+  const size_t num_bg_threads_;   ///< Background threads to process Rpc reqs
+  TransportType transport_type_;  ///< See set_transport()
+  TlsRegistry tls_registry_;      ///< A thread-local registry
 
   /// The ground truth for registered request functions
   std::array<ReqFunc, kReqTypeArraySize> req_func_arr_;
@@ -188,6 +321,7 @@ class Nexus {
 
   std::thread sm_thread_;  ///< The session management thread
   MtQueue<BgWorkItem> bg_req_queue_[kMaxBgThreads];  ///< Background req queues
+  BgEdfQueue bg_edf_queue_[kMaxBgThreads];  ///< Deadline-scheduled req queues
   std::thread bg_thread_arr_[kMaxBgThreads];  ///< Background thread context
 };
 }  // namespace erpc
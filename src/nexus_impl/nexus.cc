@@ -15,6 +15,7 @@ Nexus::Nexus(std::string local_uri, size_t numa_node, size_t num_bg_threads)
       sm_udp_port_(extract_udp_port_from_uri(local_uri)),
       numa_node_(numa_node),
       num_bg_threads_(num_bg_threads),
+      transport_type_(CTransport::kTransportType),
       heartbeat_mgr_(hostname_, sm_udp_port_, freq_ghz_,
                      kMachineFailureTimeoutMs) {
   if (kTesting) {
@@ -40,6 +41,7 @@ Nexus::Nexus(std::string local_uri, size_t numa_node, size_t num_bg_threads)
     bg_thread_ctx.tls_registry_ = &tls_registry_;
     bg_thread_ctx.bg_thread_index_ = i;
     bg_thread_ctx.bg_req_queue_ = &bg_req_queue_[i];
+    bg_thread_ctx.bg_edf_queue_ = &bg_edf_queue_[i];
 
     bg_thread_arr_[i] = std::thread(bg_thread_func, bg_thread_ctx);
 
@@ -124,6 +126,7 @@ void Nexus::register_hook(Hook *hook) {
   // Install background request submission lists
   for (size_t i = 0; i < num_bg_threads_; i++) {
     hook->bg_req_queue_arr_[i] = &bg_req_queue_[i];
+    hook->bg_edf_queue_arr_[i] = &bg_edf_queue_[i];
   }
 
   reg_hooks_lock_.unlock();
@@ -173,4 +176,134 @@ int Nexus::register_req_func(uint8_t req_type, erpc_req_func_t req_func,
   arr_req_func = ReqFunc(req_func, req_func_type);
   return 0;
 }
+
+int Nexus::enable_at_most_once(uint8_t req_type, size_t max_entries,
+                               size_t expiry_ms) {
+  char issue_msg[kMaxIssueMsgLen];  // The basic issue message
+  sprintf(issue_msg,
+          "eRPC Nexus: Failed to enable at-most-once for request type %u. "
+          "Issue",
+          req_type);
+
+  if (!req_func_registration_allowed_) {
+    ERPC_WARN("%s: Registration not allowed anymore.\n", issue_msg);
+    return -EPERM;
+  }
+
+  ReqFunc &arr_req_func = req_func_arr_[req_type];
+  if (!arr_req_func.is_registered()) {
+    ERPC_WARN("%s: No handler for this request type.\n", issue_msg);
+    return -ENOENT;
+  }
+
+  if (arr_req_func.resp_cache_max_entries_ > 0) {
+    ERPC_WARN("%s: Request type has a response cache.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  if (arr_req_func.deadline_sched_) {
+    ERPC_WARN("%s: Request type is deadline-scheduled.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  if (max_entries == 0 || expiry_ms == 0) {
+    ERPC_WARN("%s: Invalid table size or expiry.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  arr_req_func.amo_max_entries_ = max_entries;
+  arr_req_func.amo_expiry_ms_ = expiry_ms;
+  return 0;
+}
+
+int Nexus::enable_resp_cache(uint8_t req_type, size_t max_entries,
+                             size_t ttl_ms) {
+  char issue_msg[kMaxIssueMsgLen];  // The basic issue message
+  sprintf(issue_msg,
+          "eRPC Nexus: Failed to enable response cache for request type %u. "
+          "Issue",
+          req_type);
+
+  if (!req_func_registration_allowed_) {
+    ERPC_WARN("%s: Registration not allowed anymore.\n", issue_msg);
+    return -EPERM;
+  }
+
+  ReqFunc &arr_req_func = req_func_arr_[req_type];
+  if (!arr_req_func.is_registered()) {
+    ERPC_WARN("%s: No handler for this request type.\n", issue_msg);
+    return -ENOENT;
+  }
+
+  if (arr_req_func.amo_max_entries_ > 0) {
+    ERPC_WARN("%s: Request type is at-most-once.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  if (arr_req_func.deadline_sched_) {
+    ERPC_WARN("%s: Request type is deadline-scheduled.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  if (max_entries == 0 || ttl_ms == 0) {
+    ERPC_WARN("%s: Invalid cache size or TTL.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  arr_req_func.resp_cache_max_entries_ = max_entries;
+  arr_req_func.resp_cache_ttl_ms_ = ttl_ms;
+  return 0;
+}
+
+int Nexus::enable_deadline_sched(uint8_t req_type) {
+  char issue_msg[kMaxIssueMsgLen];  // The basic issue message
+  sprintf(issue_msg,
+          "eRPC Nexus: Failed to enable deadline scheduling for request type "
+          "%u. Issue",
+          req_type);
+
+  if (!req_func_registration_allowed_) {
+    ERPC_WARN("%s: Registration not allowed anymore.\n", issue_msg);
+    return -EPERM;
+  }
+
+  ReqFunc &arr_req_func = req_func_arr_[req_type];
+  if (!arr_req_func.is_registered()) {
+    ERPC_WARN("%s: No handler for this request type.\n", issue_msg);
+    return -ENOENT;
+  }
+
+  // Foreground handlers run as soon as the request is received
+  if (!arr_req_func.is_background()) {
+    ERPC_WARN("%s: Handler is not a background handler.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  // A shed request's empty response would be saved as the response to all
+  // of the request's duplicates
+  if (arr_req_func.saves_resps()) {
+    ERPC_WARN("%s: Request type is at-most-once or cached.\n", issue_msg);
+    return -EINVAL;
+  }
+
+  arr_req_func.deadline_sched_ = true;
+  return 0;
+}
+
+int Nexus::set_transport(TransportType transport_type) {
+#define ERPC_TRANSPORT_MATCHES(TTr) || transport_type == TTr::kTransportType
+  const bool compiled = false ERPC_TRANSPORT_LIST(ERPC_TRANSPORT_MATCHES);
+#undef ERPC_TRANSPORT_MATCHES
+
+  if (!compiled) {
+    ERPC_WARN(
+        "eRPC Nexus: Failed to select transport %s. Issue: Transport not "
+        "compiled in.\n",
+        Transport::get_name(transport_type).c_str());
+    return -EINVAL;
+  }
+
+  transport_type_ = transport_type;
+  return 0;
+}
 }  // namespace erpc
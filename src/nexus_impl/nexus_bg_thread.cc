@@ -4,6 +4,7 @@
 #include "session.h"
 #include "util/mt_queue.h"
 #include "req_handle.h"
+#include "rpc.h"
 
 namespace erpc {
 
@@ -17,12 +18,29 @@ void Nexus::bg_thread_func(BgThreadCtx ctx) {
             ctx.bg_thread_index_, ctx.tls_registry_->get_etid());
 
   while (*ctx.kill_switch_ == false) {
-    if (ctx.bg_req_queue_->size_ == 0) {
+    if (ctx.bg_req_queue_->size_ == 0 && ctx.bg_edf_queue_->size_ == 0) {
       // TODO: Put bg thread to sleep if it's idle for a long time
       continue;
     }
 
-    while (ctx.bg_req_queue_->size_ > 0) {
+    // Run deadline-scheduled requests first, earliest deadline first. Shed
+    // requests whose deadline has passed with an empty response.
+    while (ctx.bg_edf_queue_->size_ > 0) {
+      BgWorkItem wi = ctx.bg_edf_queue_->unlocked_pop();
+      SSlot *s = wi.sslot_;
+
+      if (unlikely(rdtsc() > wi.deadline_tsc_)) {
+        wi.shed_func_(wi.rpc_, s);
+        continue;
+      }
+
+      uint8_t req_type = s->server_info_.req_type_;
+      const ReqFunc &req_func = ctx.req_func_arr_->at(req_type);
+      req_func.req_func_(static_cast<ReqHandle *>(s), wi.context_);
+    }
+
+    // Run one other work item, then check for deadline-scheduled requests
+    if (ctx.bg_req_queue_->size_ > 0) {
       BgWorkItem wi = ctx.bg_req_queue_->unlocked_pop();
 
       if (wi.is_req()) {
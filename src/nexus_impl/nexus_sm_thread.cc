@@ -38,6 +38,7 @@ void Nexus::sm_thread_func(SmThreadCtx ctx) {
     if (target_hook != nullptr) {
       target_hook->sm_rx_queue_.unlocked_push(
           SmWorkItem(target_rpc_id, sm_pkt));
+      target_hook->wakeup();
     } else {
       // We don't have an Rpc object for the target Rpc. Send an error
       // response iff it's a request packet.
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <map>
+#include <queue>
 #include <set>
+#include <unordered_map>
 #include "cc/timing_wheel.h"
 #include "common.h"
 #include "msg_buffer.h"
@@ -81,6 +83,30 @@ class Rpc {
   /// Timeout for a session management request in milliseconds
   static constexpr size_t kSMTimeoutMs = kTesting ? 10 : 100;
 
+  /// Consecutive TX coalescing deadline expiries after which the load is
+  /// considered low, and small TX batches are transmitted without holding
+  static constexpr size_t kTxCoalesceMaxTimeouts = 8;
+
+  /// Datapath state for one physical port used by this Rpc
+  struct port_t {
+    TTr *transport_ = nullptr;  ///< The unreliable transport for this port
+
+    /// Current number of ring buffers available to use for sessions
+    size_t ring_entries_available_ = TTr::kNumRxRingEntries;
+
+    Transport::tx_burst_item_t tx_burst_arr_[TTr::kPostlist];  ///< Tx batch
+    size_t tx_batch_i_ = 0;         ///< The batch index for TX burst array
+    size_t tx_hold_start_tsc_ = 0;  ///< When TX coalescing began holding
+
+    /// On calling rx_burst(), Transport fills-in packet buffer pointers into
+    /// the RX ring. Some transports such as InfiniBand and Raw reuse RX ring
+    /// packet buffers in a circular order, so the ring's pointers remain
+    /// unchanged after initialization. Other transports (e.g., DPDK) update
+    /// rx_ring on every successful rx_burst.
+    uint8_t *rx_ring_[TTr::kNumRxRingEntries];
+    size_t rx_ring_head_ = 0;  ///< Current unused RX ring buffer
+  };
+
  public:
   /// Max request or response *data* size, i.e., excluding packet headers
   static constexpr size_t kMaxMsgSize =
@@ -111,7 +137,26 @@ class Rpc {
    * @throw runtime_error if construction fails
    */
   Rpc(Nexus *nexus, void *context, uint8_t rpc_id, sm_handler_t sm_handler,
-      uint8_t phy_port = 0);
+      uint8_t phy_port = 0)
+      : Rpc(nexus, context, rpc_id, sm_handler,
+            std::vector<uint8_t>{phy_port}) {}
+
+  /**
+   * @brief Construct an Rpc object that uses several ports. Each session uses
+   * one port, chosen when the session is created as the port with the most
+   * free RX ring entries, so sessions are spread evenly across ports. Each
+   * port has its own RX ring, TX batch, and RX ring entries for sessions.
+   *
+   * Using more than one port requires a transport whose memory registration
+   * does not depend on the port, i.e., the DPDK transport.
+   *
+   * @param phy_ports The distinct physical ports to use, with at most
+   * kMaxPhyPorts entries. The first port is the Rpc's primary port.
+   *
+   * See the single-port constructor for the other parameters.
+   */
+  Rpc(Nexus *nexus, void *context, uint8_t rpc_id, sm_handler_t sm_handler,
+      const std::vector<uint8_t> &phy_ports);
 
   /// Destroy the Rpc from a foreground thread
   ~Rpc();
@@ -258,6 +303,23 @@ class Rpc {
                        MsgBuffer *resp_msgbuf, erpc_cont_func_t cont_func,
                        void *tag, size_t cont_etid = kInvalidBgETid);
 
+  /**
+   * @brief Enqueue a batch of requests for transmission. This is equivalent
+   * to calling enqueue_request() for each request in order, but it checks the
+   * calling thread once, and transmits the batch's packets before returning,
+   * in as few transport bursts as the TX batch size allows. From background
+   * threads, it queues the batch for the foreground thread under one lock
+   * acquisition per chunk. This function is safe to call from background
+   * threads (TS).
+   *
+   * @param req_args_arr The requests' enqueue_request() arguments. The
+   * cont_etid_ fields are ignored.
+   *
+   * @param num_reqs The number of requests in \p req_args_arr
+   */
+  void enqueue_request_batch(const enq_req_args_t *req_args_arr,
+                             size_t num_reqs);
+
   /**
    * @brief Enqueue a response for transmission at the server. This must
    * be either the request handle's preallocated response buffer or its
@@ -284,6 +346,49 @@ class Rpc {
    */
   void enqueue_response(ReqHandle *req_handle, MsgBuffer *resp_msgbuf);
 
+  /**
+   * @brief Forward a received request to another server, and send that
+   * server's response as the response to the received request. This is
+   * equivalent to issuing a new request with the received request's data
+   * and calling enqueue_response() with a copy of its response in the
+   * continuation, but avoids both copies. This function is safe to call from
+   * background threads (TS).
+   *
+   * The request MsgBuffer is transmitted downstream in place if it is
+   * dynamic, i.e., if the request is multi-packet or if the request handler
+   * runs in the background. A single-packet request received into the RX ring
+   * is first copied into a dynamic MsgBuffer, since RX ring entries are
+   * reused. The downstream response is received directly into the request
+   * handle's preallocated response MsgBuffer, or into its dynamic response
+   * MsgBuffer allocated at the first response packet if the response is
+   * multi-packet.
+   *
+   * On calling this, the application loses ownership of the request handle,
+   * as with enqueue_response(). If the downstream request fails, the response
+   * to the received request has zero data bytes.
+   *
+   * @param req_handle The handle passed to the request handler by eRPC. For
+   * foreground request handlers, this must be called before the request
+   * handler returns.
+   *
+   * @param session_num The session number to forward the request on. This
+   * session must be connected.
+   *
+   * @param req_type The type of the forwarded request
+   *
+   * @param cont_func An optional continuation that is invoked in the
+   * foreground thread after the downstream response is enqueued as the
+   * response to the received request, e.g., to track per-server load. It
+   * cannot access either MsgBuffer. If the downstream session is reset, this
+   * runs before the session management handler, and is_connected() for
+   * \p session_num returns false.
+   *
+   * @param tag A tag for \p cont_func
+   */
+  void forward_request(ReqHandle *req_handle, int session_num,
+                       uint8_t req_type, erpc_cont_func_t cont_func = nullptr,
+                       void *tag = nullptr);
+
   /// Run the event loop for some milliseconds. See Rpc::run_event_loop_once()
   /// for more on eRPC's event loop.
   inline void run_event_loop(size_t timeout_ms) {
@@ -302,9 +407,60 @@ class Rpc {
    * -# Scheduling and transmitting datapath packets, and retransmitting lost
    *  packets
    *
-   * This call returns immediately when there is no work to be done.
+   * This call returns immediately when there is no work to be done, unless
+   * idle backoff is enabled. See Rpc::set_idle_backoff().
+   */
+  inline void run_event_loop_once() {
+    run_event_loop_do_one_st();
+    if (unlikely(idle_iters_ >= idle_iters_thresh_)) {
+      idle_backoff_st(idle_max_block_us_);
+    }
+  }
+
+  /**
+   * @brief Let the event loop back off when this Rpc is idle, instead of
+   * spinning. An event loop iteration is idle if it receives no packets and
+   * this Rpc has no active requests or requests stalled for credits.
+   *
+   * After \p idle_iters consecutive idle iterations, each iteration pauses the
+   * CPU briefly. After 2 * \p idle_iters, the thread blocks until a packet
+   * arrives, another thread queues work for this Rpc, or \p max_block_us
+   * elapses. Transports that cannot notify received packets wake up only on
+   * the timeout, so \p max_block_us bounds the added latency for them.
+   *
+   * Blocking does not delay timers such as the packet loss scan by more than
+   * \p max_block_us. This must be called from the creator thread.
+   *
+   * @param idle_iters The number of idle iterations before backing off. Zero
+   * disables idle backoff, which is the default.
+   * @param max_block_us The maximum duration of one blocking wait
+   */
+  void set_idle_backoff(size_t idle_iters,
+                        size_t max_block_us = kDefaultIdleMaxBlockUs);
+
+  /// Wake up this Rpc's event loop if it's blocked with idle backoff. If it's
+  /// not blocked yet, its next blocking wait returns immediately, so that it
+  /// notices conditions set before this call. This can be called from any
+  /// thread.
+  inline void wakeup() { nexus_hook_.notify(); }
+
+  /**
+   * @brief Let the event loop hold a small TX batch for up to \p max_delay_us
+   * instead of transmitting it at the end of each iteration, so that packets
+   * from later iterations share its transport burst. The batch is transmitted
+   * when it reaches \p min_burst packets or the deadline expires.
+   *
+   * Coalescing switches off automatically at low load: after
+   * kTxCoalesceMaxTimeouts consecutive deadline expiries, small batches are
+   * transmitted immediately until a transmitted batch has at least
+   * \p min_burst packets. This must be called from the creator thread.
+   *
+   * @param min_burst The TX batch size that is transmitted without holding,
+   * at most the transport's TX batch size. Zero disables coalescing, which is
+   * the default.
+   * @param max_delay_us The maximum time for which a packet is held
    */
-  inline void run_event_loop_once() { run_event_loop_do_one_st(); }
+  void set_tx_coalescing(size_t min_burst, size_t max_delay_us);
 
   /// Identical to alloc_msg_buffer(), but throws an exception on failure
   inline MsgBuffer alloc_msg_buffer_or_die(size_t max_data_size) {
@@ -332,6 +488,12 @@ class Rpc {
     return session->client_info_.num_re_tx_;
   }
 
+  /// Return the physical port used by a session
+  uint8_t get_session_phy_port(int session_num) const {
+    Session *session = session_vec_[static_cast<size_t>(session_num)];
+    return ports_[session->port_i_].transport_->phy_port_;
+  }
+
   /// Reset the number of retransmissions for a connected session
   void reset_num_re_tx(int session_num) {
     Session *session = session_vec_[static_cast<size_t>(session_num)];
@@ -396,6 +558,26 @@ class Rpc {
   /// Return the ID of this Rpc object
   inline uint8_t get_rpc_id() const { return rpc_id_; }
 
+  /**
+   * @brief Remove all cached responses of a request type. See
+   * Nexus::enable_resp_cache(). This must be called from the foreground
+   * thread, e.g., in a foreground request handler that modifies the data
+   * behind the cached responses.
+   *
+   * Responses to requests that are executing when this is called are not
+   * cached, since they may have been computed from the old data.
+   */
+  void invalidate_resp_cache(uint8_t req_type);
+
+  /// Remove the cached response to requests of a type with this data, if any.
+  /// See invalidate_resp_cache(uint8_t).
+  void invalidate_resp_cache(uint8_t req_type, const uint8_t *req_data,
+                             size_t req_size);
+
+  /// Return this Rpc's client ID for at-most-once requests. This is random, so
+  /// it is unique among clients with high probability.
+  inline uint64_t get_amo_client_id() const { return amo_client_id_; }
+
   /// Return true iff the caller is running in a background thread
   inline bool in_background() const { return !in_dispatch(); }
 
@@ -405,6 +587,16 @@ class Rpc {
   /// Return RDTSC frequency in GHz
   inline double get_freq_ghz() const { return freq_ghz_; }
 
+  /// Return the number of requests in a client session's backlog, i.e.,
+  /// requests enqueued while the session's request window was full. This
+  /// function can be called only from the creator thread.
+  inline size_t get_backlog_depth(int session_num) const {
+    assert(in_dispatch());
+    const Session *session = session_vec_.at(static_cast<size_t>(session_num));
+    assert(session != nullptr && session->is_client());
+    return session->client_info_.enq_req_backlog_.size();
+  }
+
   /// Return the number of seconds elapsed since this Rpc was created
   double sec_since_creation() {
     return to_sec(rdtsc() - creation_tsc_, freq_ghz_);
@@ -527,25 +719,109 @@ class Rpc {
     req_msgbuf.buf_ = nullptr;
   }
 
+  /// Enqueue the downstream response to a forwarded request as the response
+  /// to the request being forwarded, whose sslot is \p fwd_sslot
+  inline void enqueue_fwd_response_st(SSlot *fwd_sslot,
+                                      MsgBuffer *resp_msgbuf) {
+    const erpc_cont_func_t cont_func = fwd_sslot->server_info_.fwd_cont_func_;
+    void *tag = fwd_sslot->server_info_.fwd_tag_;
+
+    enqueue_response(static_cast<ReqHandle *>(fwd_sslot), resp_msgbuf);
+    if (cont_func != nullptr) cont_func(context_, tag);
+  }
+
+  //
+  // At-most-once execution (rpc_amo.cc)
+  //
+
+  /**
+   * @brief Check if a received at-most-once request is a duplicate. If it is,
+   * respond to it with the saved response, or queue it for the response of the
+   * request that is still being executed.
+   *
+   * @param sslot The request's sslot, with a complete request MsgBuffer and a
+   * valid request type
+   *
+   * @return True iff the request is a duplicate and must not be executed
+   */
+  bool amo_handle_dup_st(SSlot *sslot);
+
+  /// Save the response to the first copy of an at-most-once request, and
+  /// respond to the duplicates that arrived while it was being executed
+  void amo_save_resp_st(SSlot *sslot, const MsgBuffer *resp_msgbuf);
+
+  //
+  // Response cache (rpc_resp_cache.cc)
+  //
+
+  struct resp_cache_t;  // Defined with the members below
+
+  /**
+   * @brief Look up a received request in its type's response cache. On a hit,
+   * respond with the cached response. On a miss, mark the request so that its
+   * response is cached.
+   *
+   * @param sslot The request's sslot, with a complete request MsgBuffer and a
+   * valid request type
+   *
+   * @return True iff the request was answered from the cache
+   */
+  bool resp_cache_lookup_st(SSlot *sslot);
+
+  /// Cache the response to a request that missed in the response cache
+  void resp_cache_save_st(SSlot *sslot, const MsgBuffer *resp_msgbuf);
+
+  /// Remove the oldest entry of a response cache, if it wasn't removed already
+  void resp_cache_pop_st(resp_cache_t *cache);
+
+  /**
+   * @brief Check if a received request can be answered with a saved response,
+   * for request types whose responses are saved. This is called instead of
+   * running the request handler if it returns true.
+   */
+  inline bool handle_saved_resp_st(SSlot *sslot, const ReqFunc &req_func) {
+    if (req_func.amo_max_entries_ > 0) return amo_handle_dup_st(sslot);
+    return resp_cache_lookup_st(sslot);
+  }
+
+  /// Enqueue a copy of a saved response (e.g., for an at-most-once duplicate
+  /// or a response cache hit) as the response to a request
+  void enqueue_saved_resp_st(SSlot *sslot, const MsgBuffer &saved);
+
   //
   // Handle available ring entries
   //
 
+  /// Return the index of the port for a new session, i.e., the port with the
+  /// most ring entries available
+  size_t pick_port_st() const {
+    size_t port_i = 0;
+    for (size_t i = 1; i < num_ports_; i++) {
+      if (ports_[i].ring_entries_available_ >
+          ports_[port_i].ring_entries_available_) {
+        port_i = i;
+      }
+    }
+    return port_i;
+  }
+
   /// Return true iff there are sufficient ring entries available for a session
-  bool have_ring_entries() const {
-    return ring_entries_available_ >= kSessionCredits;
+  /// on a port
+  bool have_ring_entries(size_t port_i) const {
+    return ports_[port_i].ring_entries_available_ >= kSessionCredits;
   }
 
-  /// Allocate ring entries for one session
-  void alloc_ring_entries() {
-    assert(have_ring_entries());
-    ring_entries_available_ -= kSessionCredits;
+  /// Allocate ring entries for one session on a port
+  void alloc_ring_entries(size_t port_i) {
+    assert(have_ring_entries(port_i));
+    ports_[port_i].ring_entries_available_ -= kSessionCredits;
   }
 
-  /// Free ring entries allocated for one session
-  void free_ring_entries() {
-    ring_entries_available_ += kSessionCredits;
-    assert(ring_entries_available_ <= Transport::kNumRxRingEntries);
+  /// Free ring entries allocated for one session on a port
+  void free_ring_entries(size_t port_i) {
+    ports_[port_i].ring_entries_available_ += kSessionCredits;
+    assert(ports_[port_i].ring_entries_available_ <=
+           Transport::kNumRxRingEntries);
   }
 
   //
@@ -558,14 +834,19 @@ class Rpc {
     return pkt_num - (num_req_pkts - 1);
   }
 
-  /// Return true iff a packet received by a client is in order. This must be
+  /// Return true iff a packet received by a client is new and within the
+  /// window of packets in flight, i.e., in order or reordered. This must be
   /// only a few instructions.
-  inline size_t in_order_client(const SSlot *sslot, const pkthdr_t *pkthdr) {
+  inline bool in_window_client(const SSlot *sslot, const pkthdr_t *pkthdr) {
     // Counters for pkthdr's request number are valid only if req numbers match
     if (unlikely(pkthdr->req_num_ != sslot->cur_req_num_)) return false;
 
     const auto &ci = sslot->client_info_;
-    if (unlikely(pkthdr->pkt_num_ != ci.num_rx_)) return false;
+    if (unlikely(pkthdr->pkt_num_ != ci.num_rx_)) {
+      // Accept a reordered packet that we haven't received yet
+      if (pkthdr->pkt_num_ < ci.num_rx_) return false;
+      if (ci.rx_bitmap_.test(pkthdr->pkt_num_)) return false;
+    }
 
     // Ignore spurious packets received as a consequence of rollback:
     // 1. We've only sent pkts up to (ci.num_tx - 1). Ignore later packets.
@@ -617,11 +898,20 @@ class Rpc {
     return false;
   }
 
-  /// Complete transmission for all packets in the Rpc's TX batch and the
-  /// transport's DMA queue
+  /// Complete transmission for all packets in the Rpc's TX batches and the
+  /// transports' DMA queues
   void drain_tx_batch_and_dma_queue() {
-    if (tx_batch_i_ > 0) do_tx_burst_st();
-    transport_->tx_flush();
+    for (size_t i = 0; i < num_ports_; i++) {
+      if (ports_[i].tx_batch_i_ > 0) do_tx_burst_st(ports_[i]);
+      ports_[i].transport_->tx_flush();
+    }
+  }
+
+  /// Transmit the packets in all ports' TX batches
+  void flush_tx_batches_st() {
+    for (size_t i = 0; i < num_ports_; i++) {
+      if (ports_[i].tx_batch_i_ > 0) do_tx_burst_st(ports_[i]);
+    }
   }
 
   /// Add an RPC slot to the list of active RPCs
@@ -645,12 +935,30 @@ class Rpc {
   // Datapath processing
   //
 
+  /// Implementation of enqueue_request() in the foreground thread
+  void enqueue_request_st(int session_num, uint8_t req_type,
+                          MsgBuffer *req_msgbuf, MsgBuffer *resp_msgbuf,
+                          erpc_cont_func_t cont_func, void *tag,
+                          size_t cont_etid);
+
   /// Implementation of the run_event_loop(timeout) API function
   void run_event_loop_timeout_st(size_t timeout_ms);
 
   /// Actually run one iteration of the event loop
   void run_event_loop_do_one_st();
 
+  /// Return true iff TX coalescing should hold a port's non-empty TX batch
+  /// past this event loop iteration
+  bool tx_coalesce_hold_st(port_t &port);
+
+  /**
+   * @brief Back off after idle event loop iterations: pause, or block on the
+   * wakeup eventfd and the transport's RX notification fd
+   *
+   * @param max_block_us The maximum duration to block for
+   */
+  void idle_backoff_st(size_t max_block_us);
+
   /// Enqueue client packets for a sslot that has at least one credit and
   /// request packets to send. Packets may be added to the timing wheel or the
   /// TX burst; credits are used in both cases.
@@ -674,6 +982,10 @@ class Rpc {
    */
   void process_resp_one_st(SSlot *, const pkthdr_t *, size_t rx_tsc);
 
+  /// Finish a request whose complete response has been received: free the
+  /// sslot and invoke the continuation
+  void complete_resp_st(SSlot *);
+
   /**
    * @brief Enqueue an explicit credit return
    *
@@ -712,7 +1024,8 @@ class Rpc {
     assert(in_dispatch());
     const MsgBuffer *tx_msgbuf = sslot->tx_msgbuf_;
 
-    Transport::tx_burst_item_t &item = tx_burst_arr_[tx_batch_i_];
+    port_t &port = ports_[sslot->session_->port_i_];
+    Transport::tx_burst_item_t &item = port.tx_burst_arr_[port.tx_batch_i_];
     item.routing_info_ = sslot->session_->remote_routing_info_;
     item.msg_buffer_ = const_cast<MsgBuffer *>(tx_msgbuf);
     item.pkt_idx_ = pkt_idx;
@@ -729,8 +1042,8 @@ class Rpc {
                tx_msgbuf->get_pkthdr_str(pkt_idx).c_str(),
                sslot->progress_str().c_str(), item.drop_ ? " Drop." : "");
 
-    tx_batch_i_++;
-    if (tx_batch_i_ == TTr::kPostlist) do_tx_burst_st();
+    port.tx_batch_i_++;
+    if (port.tx_batch_i_ == TTr::kPostlist) do_tx_burst_st(port);
   }
 
   /// Enqueue a control packet for tx_burst. ctrl_msgbuf can be reused after
@@ -739,7 +1052,8 @@ class Rpc {
                                       size_t *tx_ts) {
     assert(in_dispatch());
 
-    Transport::tx_burst_item_t &item = tx_burst_arr_[tx_batch_i_];
+    port_t &port = ports_[sslot->session_->port_i_];
+    Transport::tx_burst_item_t &item = port.tx_burst_arr_[port.tx_batch_i_];
     item.routing_info_ = sslot->session_->remote_routing_info_;
     item.msg_buffer_ = ctrl_msgbuf;
     item.pkt_idx_ = 0;
@@ -756,8 +1070,8 @@ class Rpc {
                ctrl_msgbuf->get_pkthdr_str(0).c_str(),
                sslot->progress_str().c_str(), item.drop_ ? " Drop." : "");
 
-    tx_batch_i_++;
-    if (tx_batch_i_ == TTr::kPostlist) do_tx_burst_st();
+    port.tx_batch_i_++;
+    if (port.tx_batch_i_ == TTr::kPostlist) do_tx_burst_st(port);
   }
 
   /// Enqueue a request packet to the timing wheel
@@ -796,28 +1110,37 @@ class Rpc {
     sslot->client_info_.wheel_count_++;
   }
 
-  /// Transmit packets in the TX batch
-  inline void do_tx_burst_st() {
+  /// Transmit packets in a port's TX batch
+  inline void do_tx_burst_st(port_t &port) {
     assert(in_dispatch());
-    assert(tx_batch_i_ > 0);
+    assert(port.tx_batch_i_ > 0);
 
     // Measure TX burst size
     dpath_stat_inc(dpath_stats_.tx_burst_calls_, 1);
-    dpath_stat_inc(dpath_stats_.pkts_tx_, tx_batch_i_);
+    dpath_stat_inc(dpath_stats_.pkts_tx_, port.tx_batch_i_);
+
+    // A batch that reaches min_burst, including a full batch transmitted
+    // while enqueueing, means that the load is high enough to coalesce again
+    if (unlikely(tx_coalesce_.min_burst_ > 0) &&
+        port.tx_batch_i_ >= tx_coalesce_.min_burst_) {
+      tx_coalesce_.num_timeouts_ = 0;
+    }
 
     if (kCcRTT) {
       size_t batch_tsc = 0;
       if (kCcOptBatchTsc) batch_tsc = dpath_rdtsc();
 
-      for (size_t i = 0; i < tx_batch_i_; i++) {
-        if (tx_burst_arr_[i].tx_ts_ != nullptr) {
-          *tx_burst_arr_[i].tx_ts_ = kCcOptBatchTsc ? batch_tsc : dpath_rdtsc();
+      for (size_t i = 0; i < port.tx_batch_i_; i++) {
+        Transport::tx_burst_item_t &item = port.tx_burst_arr_[i];
+        if (item.tx_ts_ != nullptr) {
+          *item.tx_ts_ = kCcOptBatchTsc ? batch_tsc : dpath_rdtsc();
         }
       }
     }
 
-    transport_->tx_burst(tx_burst_arr_, tx_batch_i_);
-    tx_batch_i_ = 0;
+    port.transport_->tx_burst(port.tx_burst_arr_, port.tx_batch_i_);
+    port.tx_batch_i_ = 0;
+    port.tx_hold_start_tsc_ = 0;
   }
 
   /// Return a credit to this session
@@ -844,8 +1167,29 @@ class Rpc {
    * NIC until we send at least one response/CR packet back, we do not control
    * the order or time at which these packets are sent, due to constraints like
    * session credits and packet pacing.
+   *
+   * @return The number of packets received on all ports
    */
-  void process_comps_st();
+  size_t process_comps_st();
+
+  /// Process received packets on one port. See process_comps_st().
+  size_t process_port_comps_st(port_t &port);
+
+  /// Prefetch the session and sslot of the packet in an RX ring entry. This
+  /// reads the packet's header, which should have been prefetched earlier.
+  inline void prefetch_rx_sslot_st(const port_t &port, size_t ring_i) const {
+    const auto *pkthdr =
+        reinterpret_cast<const pkthdr_t *>(port.rx_ring_[ring_i]);
+    const size_t session_num = pkthdr->dest_session_num_;
+    if (unlikely(session_num >= session_vec_.size())) return;
+
+    const Session *session = session_vec_[session_num];
+    if (unlikely(session == nullptr)) return;
+
+    const size_t sslot_i = pkthdr->req_num_ % kSessionReqWindow;
+    __builtin_prefetch(session, 0, 3);
+    __builtin_prefetch(&session->sslot_arr_[sslot_i], 1, 3);
+  }
 
   /**
    * @brief Submit a request work item to a random background thread
@@ -855,6 +1199,15 @@ class Rpc {
    */
   void submit_bg_req_st(SSlot *sslot);
 
+  /// Respond to a deadline-scheduled request whose deadline has passed with
+  /// an empty response, without running its handler. Background threads call
+  /// this through the request's work item.
+  static void shed_deadline_req(void *rpc, SSlot *sslot) {
+    resize_msg_buffer(&sslot->pre_resp_msgbuf_, 0);
+    static_cast<Rpc *>(rpc)->enqueue_response(static_cast<ReqHandle *>(sslot),
+                                              &sslot->pre_resp_msgbuf_);
+  }
+
   /**
    * @brief Submit a response work item to a specific background thread
    *
@@ -984,26 +1337,30 @@ class Rpc {
   std::vector<Session *> session_vec_;
 
   // Transport
-  TTr *transport_ = nullptr;  ///< The unreliable transport
 
-  /// Current number of ring buffers available to use for sessions
-  size_t ring_entries_available_ = TTr::kNumRxRingEntries;
+  /// The primary port's transport, which registers memory for the hugepage
+  /// allocator and answers transport-wide queries
+  TTr *transport_ = nullptr;
 
-  Transport::tx_burst_item_t tx_burst_arr_[TTr::kPostlist];  ///< Tx batch info
-  size_t tx_batch_i_ = 0;  ///< The batch index for TX burst array
+  size_t num_ports_;            ///< Number of ports used by this Rpc
+  port_t ports_[kMaxPhyPorts];  ///< Per-port datapath state
 
-  /// On calling rx_burst(), Transport fills-in packet buffer pointers into the
-  /// RX ring. Some transports such as InfiniBand and Raw reuse RX ring packet
-  /// buffers in a circular order, so the ring's pointers remain unchanged
-  /// after initialization. Other transports (e.g., DPDK) update rx_ring on
-  /// every successful rx_burst.
-  uint8_t *rx_ring_[TTr::kNumRxRingEntries];
-  size_t rx_ring_head_ = 0;  ///< Current unused RX ring buffer
+  /// TX burst coalescing state. See set_tx_coalescing().
+  struct {
+    size_t min_burst_ = 0;  ///< Zero if coalescing is disabled
+    size_t max_delay_cycles_ = 0;
+    size_t num_timeouts_ = 0;  ///< Consecutive deadline expiries
+  } tx_coalesce_;
 
   std::vector<SSlot *> stallq_;  ///< Request sslots stalled for credits
 
   size_t ev_loop_tsc_;  ///< TSC taken at each iteration of the ev loop
 
+  // Idle backoff, disabled by a SIZE_MAX threshold
+  size_t idle_iters_thresh_ = SIZE_MAX;  ///< Idle iterations before backoff
+  size_t idle_max_block_us_ = kDefaultIdleMaxBlockUs;
+  size_t idle_iters_ = 0;  ///< Number of consecutive idle iterations
+
   // Packet loss
   size_t pkt_loss_scan_tsc_;  ///< Timestamp of the previous scan for lost pkts
 
@@ -1051,6 +1408,72 @@ class Rpc {
   /// Sessions for which a session management request is outstanding
   std::set<uint16_t> sm_pending_reqs_;
 
+  /// At-most-once execution state for one request type. Requests are keyed by
+  /// their (client ID, sequence number).
+  struct amo_table_t {
+    typedef std::pair<uint64_t, uint64_t> key_t;
+
+    struct key_hash_t {
+      size_t operator()(const key_t &k) const {
+        return std::hash<uint64_t>()(k.first ^ (k.second * 0x9e3779b97f4a7c15));
+      }
+    };
+
+    struct entry_t {
+      bool done_;  ///< True iff the request's response is saved
+      MsgBuffer resp_msgbuf_;  ///< A copy of the response, if done
+      size_t expiry_tsc_;      ///< The saved response's expiry time, if done
+
+      /// The sslots of duplicates received while the request was executing
+      std::vector<SSlot *> waiters_;
+    };
+
+    size_t max_entries_;    ///< Maximum number of saved responses
+    size_t expiry_cycles_;  ///< Lifetime of a saved response
+    std::unordered_map<key_t, entry_t, key_hash_t> map_;
+
+    /// Keys of done entries and their expiry times, oldest first. Responses
+    /// have the same lifetime, so this is also the order of expiry.
+    std::queue<std::pair<key_t, size_t>> done_queue_;
+  };
+
+  /// At-most-once tables, indexed by request type. Null for request types that
+  /// are not at-most-once.
+  std::array<amo_table_t *, kReqTypeArraySize> amo_tables_;
+  uint64_t amo_client_id_;  ///< This Rpc's client ID for at-most-once requests
+
+  /// A response cache for one request type. Responses are keyed by a hash of
+  /// the request data, and the entry keeps a copy of the data to check for
+  /// hash collisions.
+  struct resp_cache_t {
+    struct entry_t {
+      bool done_;  ///< True iff the response is cached
+      std::string req_data_;   ///< A copy of the request data
+      MsgBuffer resp_msgbuf_;  ///< A copy of the response, if done
+      size_t gen_;  ///< Unique for each entry, to detect stale references
+    };
+
+    /// An entry's key and generation, and its expiry time
+    struct queue_item_t {
+      uint64_t hash_;
+      size_t gen_;
+      size_t expiry_tsc_;
+    };
+
+    size_t max_entries_;  ///< Maximum number of entries
+    size_t ttl_cycles_;   ///< Lifetime of an entry
+    size_t next_gen_ = 1;
+    std::unordered_map<uint64_t, entry_t> map_;
+
+    /// Entries in order of insertion, which is also the order of expiry.
+    /// Items for removed entries are skipped using the generation.
+    std::queue<queue_item_t> queue_;
+  };
+
+  /// Response caches, indexed by request type. Null for request types without
+  /// a response cache.
+  std::array<resp_cache_t *, kReqTypeArraySize> resp_caches_;
+
   /// All the faults that can be injected into eRPC for testing
   struct {
     bool fail_resolve_rinfo_ = false;  ///< Fail routing info resolution
@@ -1088,12 +1511,79 @@ class Rpc {
     size_t still_in_wheel_during_retx_ = 0;
   } pkt_loss_stats_;
 
+  struct {
+    size_t num_hits_ = 0;    ///< Requests answered from a response cache
+    size_t num_misses_ = 0;  ///< Requests that missed in a response cache
+  } resp_cache_stats_;
+
+  struct {
+    /// Requests queued to a session backlog because the session's request
+    /// window was full
+    size_t num_backlogged_ = 0;
+
+    /// The largest number of requests in one session's backlog
+    size_t max_depth_ = 0;
+  } backlog_stats_;
+
+  struct {
+    size_t num_pauses_ = 0;  ///< Idle iterations that paused the CPU
+    size_t num_blocks_ = 0;  ///< Idle iterations that blocked the thread
+    size_t num_wakeups_ = 0;  ///< Blocks that ended before the timeout
+  } idle_stats_;
+
   /// Size of the preallocated response buffer. This is one packet by default,
   /// but some applications might benefit from a larger preallocated buffer,
   /// at the expense of increased memory utilization.
   size_t pre_resp_msgbuf_size_ = TTr::kMaxDataPerPkt;
 };
 
+/// A tag that passes a transport type to a dispatch_transport() functor
+template <class TTr>
+struct transport_tag_t {
+  typedef TTr type;
+};
+
+/**
+ * @brief Run application code with the transport selected at runtime with
+ * Nexus::set_transport()
+ *
+ * The functor's templated call operator is instantiated for every transport
+ * compiled into the library, and the instantiation for the selected transport
+ * is called once. The code inside it uses Rpc<TTr> with a concrete transport,
+ * so the datapath stays devirtualized. For example:
+ *
+ *   struct ThreadFunc {
+ *     template <class TTr>
+ *     void operator()(transport_tag_t<TTr>) {
+ *       Rpc<TTr> rpc(nexus, context, rpc_id, sm_handler);
+ *       rpc.run_event_loop(1000);
+ *     }
+ *   };
+ *
+ *   dispatch_transport(nexus, ThreadFunc());
+ *
+ * @throw runtime_error if the selected transport is not compiled in
+ */
+template <class F>
+void dispatch_transport(const Nexus *nexus, F &&f) {
+#define ERPC_DISPATCH_CASE(TTr) \
+  case TTr::kTransportType:     \
+    f(transport_tag_t<TTr>());  \
+    return;
+
+  switch (nexus->get_transport()) {
+    ERPC_TRANSPORT_LIST(ERPC_DISPATCH_CASE)
+    default: break;
+  }
+#undef ERPC_DISPATCH_CASE
+
+  throw std::runtime_error("eRPC: Transport " +
+                           Transport::get_name(nexus->get_transport()) +
+                           " is not compiled in");
+}
+
 // This goes at the end of every Rpc implementation file to force compilation
-#define FORCE_COMPILE_TRANSPORTS template class Rpc<CTransport>;
+// for every compiled transport
+#define ERPC_INSTANTIATE_RPC(TTr) template class Rpc<TTr>;
+#define FORCE_COMPILE_TRANSPORTS ERPC_TRANSPORT_LIST(ERPC_INSTANTIATE_RPC)
 }  // namespace erpc
@@ -51,6 +51,13 @@ namespace erpc
    */
   static constexpr size_t kMaxPhyPorts = 2;
 
+  /**
+   * @relates Rpc
+   * @brief Default maximum duration for which an idle Rpc blocks in one event
+   * loop iteration. See Rpc::set_idle_backoff().
+   */
+  static constexpr size_t kDefaultIdleMaxBlockUs = 1000;
+
   /**
    * @relates Rpc
    *
@@ -12,12 +12,12 @@ namespace erpc {
 
 template <class TTr>
 Rpc<TTr>::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
-              sm_handler_t sm_handler, uint8_t phy_port)
+              sm_handler_t sm_handler, const std::vector<uint8_t> &phy_ports)
     : nexus_(nexus),
       context_(context),
       rpc_id_(rpc_id),
       sm_handler_(sm_handler),
-      phy_port_(phy_port),
+      phy_port_(phy_ports.at(0)),
       numa_node_(nexus->numa_node_),
       creation_tsc_(rdtsc()),
       multi_threaded_(nexus->num_bg_threads_ > 0),
@@ -30,7 +30,15 @@ Rpc<TTr>::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
 #endif
   rt_assert(rpc_id != kInvalidRpcId, "Invalid Rpc ID");
   rt_assert(!nexus->rpc_id_exists(rpc_id), "Rpc ID already exists");
-  rt_assert(phy_port < kMaxPhyPorts, "Invalid physical port");
+  rt_assert(phy_ports.size() <= kMaxPhyPorts, "Too many physical ports");
+  for (size_t i = 0; i < phy_ports.size(); i++) {
+    rt_assert(phy_ports[i] < kMaxPhyPorts, "Invalid physical port");
+    for (size_t j = 0; j < i; j++) {
+      rt_assert(phy_ports[j] != phy_ports[i], "Duplicate physical port");
+    }
+  }
+  rt_assert(phy_ports.size() == 1 || TTr::kPortIndependentMemReg,
+            "Transport does not support multiple ports per Rpc");
   rt_assert(numa_node_ < kMaxNumaNodes, "Invalid NUMA node");
 
   tls_registry_ = &nexus->tls_registry_;
@@ -48,18 +56,25 @@ Rpc<TTr>::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
     }
   }
 
-  // Partially initialize the transport without using hugepages. This
-  // initializes the transport's memory registration functions required for
-  // the hugepage allocator.
-  transport_ =
-      new TTr(nexus->sm_udp_port_, rpc_id, phy_port, numa_node_, trace_file_);
+  // Partially initialize the transports without using hugepages. This
+  // initializes the memory registration functions required for the hugepage
+  // allocator. Only the primary transport registers memory.
+  num_ports_ = phy_ports.size();
+  for (size_t i = 0; i < num_ports_; i++) {
+    ports_[i].transport_ = new TTr(nexus->sm_udp_port_, rpc_id, phy_ports[i],
+                                   numa_node_, trace_file_);
+  }
+  transport_ = ports_[0].transport_;
 
   huge_alloc_ =
       new HugeAlloc(kInitialHugeAllocSize, numa_node_, transport_->reg_mr_func_,
                     transport_->dereg_mr_func_);
 
   // Complete transport initialization using the hugepage allocator
-  transport_->init_hugepage_structures(huge_alloc_, rx_ring_);
+  for (size_t i = 0; i < num_ports_; i++) {
+    ports_[i].transport_->init_hugepage_structures(huge_alloc_,
+                                                   ports_[i].rx_ring_);
+  }
 
   wheel_ = nullptr;
   if (kCcPacing) {
@@ -81,6 +96,31 @@ Rpc<TTr>::Rpc(Nexus *nexus, void *context, uint8_t rpc_id,
     }
   }
 
+  // Create tables for at-most-once request types
+  amo_client_id_ = slow_rand_.next_u64();
+  for (size_t i = 0; i < kReqTypeArraySize; i++) {
+    amo_tables_[i] = nullptr;
+    const ReqFunc &req_func = req_func_arr_[i];
+    if (req_func.amo_max_entries_ == 0) continue;
+
+    amo_tables_[i] = new amo_table_t();
+    amo_tables_[i]->max_entries_ = req_func.amo_max_entries_;
+    amo_tables_[i]->expiry_cycles_ =
+        ms_to_cycles(req_func.amo_expiry_ms_, freq_ghz_);
+  }
+
+  // Create response caches
+  for (size_t i = 0; i < kReqTypeArraySize; i++) {
+    resp_caches_[i] = nullptr;
+    const ReqFunc &req_func = req_func_arr_[i];
+    if (req_func.resp_cache_max_entries_ == 0) continue;
+
+    resp_caches_[i] = new resp_cache_t();
+    resp_caches_[i]->max_entries_ = req_func.resp_cache_max_entries_;
+    resp_caches_[i]->ttl_cycles_ =
+        ms_to_cycles(req_func.resp_cache_ttl_ms_, freq_ghz_);
+  }
+
   // Register the hook with the Nexus. This installs SM and bg command queues.
   nexus_hook_.rpc_id_ = rpc_id;
   nexus->register_hook(&nexus_hook_);
@@ -101,6 +141,9 @@ template <class TTr>
 Rpc<TTr>::~Rpc() {
   assert(in_dispatch());
 
+  // Held TX packets reference sessions and MsgBuffers
+  flush_tx_batches_st();
+
   // XXX: Check if all sessions are disconnected
   for (Session *session : session_vec_) {
     if (session != nullptr) delete session;
@@ -108,15 +151,33 @@ Rpc<TTr>::~Rpc() {
 
   ERPC_INFO("Destroying Rpc %u.\n", rpc_id_);
 
+  // Saved responses are in hugepage memory, so free them first
+  for (amo_table_t *amo_table : amo_tables_) {
+    if (amo_table == nullptr) continue;
+    for (auto &kv : amo_table->map_) {
+      if (kv.second.done_) free_msg_buffer(kv.second.resp_msgbuf_);
+    }
+    delete amo_table;
+  }
+
+  for (resp_cache_t *resp_cache : resp_caches_) {
+    if (resp_cache == nullptr) continue;
+    for (auto &kv : resp_cache->map_) {
+      if (kv.second.done_) free_msg_buffer(kv.second.resp_msgbuf_);
+    }
+    delete resp_cache;
+  }
+
   // First delete the hugepage allocator. This deregisters and deletes the
   // SHM regions. Deregistration is done using \p transport's deregistration
   // function, so \p transport is deleted later.
   delete huge_alloc_;
 
-  // Allow \p transport to clean up non-hugepage structures
-  delete transport_;
+  // Allow the transports to clean up non-hugepage structures
+  for (size_t i = 0; i < num_ports_; i++) delete ports_[i].transport_;
 
   nexus_->unregister_hook(&nexus_hook_);
+  if (nexus_hook_.wakeup_fd_ != -1) close(nexus_hook_.wakeup_fd_);
 
   if (ERPC_LOG_LEVEL >= ERPC_LOG_LEVEL_REORDER) fclose(trace_file_);
 }
@@ -0,0 +1,102 @@
+/**
+ * @file rpc_amo.cc
+ * @brief At-most-once execution of requests across session resets
+ */
+#include "rpc.h"
+
+namespace erpc {
+
+template <class TTr>
+bool Rpc<TTr>::amo_handle_dup_st(SSlot *sslot) {
+  assert(in_dispatch());
+  auto &si = sslot->server_info_;
+  amo_table_t *amo_table = amo_tables_[si.req_type_];
+  assert(amo_table != nullptr);
+
+  // Requests without a header are executed normally
+  const MsgBuffer &req_msgbuf = si.req_msgbuf_;
+  if (unlikely(req_msgbuf.get_data_size() < sizeof(amo_hdr_t))) {
+    ERPC_WARN("Rpc %u: At-most-once request without a header.\n", rpc_id_);
+    return false;
+  }
+
+  // Evict expired responses, oldest first
+  while (!amo_table->done_queue_.empty() &&
+         amo_table->done_queue_.front().second <= ev_loop_tsc_) {
+    auto it = amo_table->map_.find(amo_table->done_queue_.front().first);
+    assert(it != amo_table->map_.end() && it->second.done_);
+    free_msg_buffer(it->second.resp_msgbuf_);
+    amo_table->map_.erase(it);
+    amo_table->done_queue_.pop();
+  }
+
+  amo_hdr_t amo_hdr;
+  memcpy(&amo_hdr, req_msgbuf.buf_, sizeof(amo_hdr_t));
+  const auto key = std::make_pair(amo_hdr.client_id_, amo_hdr.seq_);
+
+  auto it = amo_table->map_.find(key);
+  if (likely(it == amo_table->map_.end())) {
+    // This is the first copy. Execute it, and save the response later.
+    auto &entry = amo_table->map_[key];
+    entry.done_ = false;
+    si.amo_pending_ = true;
+    si.amo_hdr_ = amo_hdr;
+    return false;
+  }
+
+  auto &entry = it->second;
+  ERPC_INFO("Rpc %u, lsn %u: Duplicate at-most-once request (%zu, %zu). %s.\n",
+            rpc_id_, sslot->session_->local_session_num_, amo_hdr.client_id_,
+            amo_hdr.seq_,
+            entry.done_ ? "Sending saved response" : "Waiting for response");
+
+  if (entry.done_) {
+    enqueue_saved_resp_st(sslot, entry.resp_msgbuf_);
+  } else {
+    entry.waiters_.push_back(sslot);
+  }
+  return true;
+}
+
+template <class TTr>
+void Rpc<TTr>::amo_save_resp_st(SSlot *sslot, const MsgBuffer *resp_msgbuf) {
+  assert(in_dispatch());
+  auto &si = sslot->server_info_;
+  amo_table_t *amo_table = amo_tables_[si.req_type_];
+  si.amo_pending_ = false;
+
+  const auto key = std::make_pair(si.amo_hdr_.client_id_, si.amo_hdr_.seq_);
+  auto &entry = amo_table->map_.at(key);
+  assert(!entry.done_);
+
+  // The saved response is copied again for each duplicate, so it doesn't need
+  // packet headers of its own. alloc_msg_buffer() requires size > 0.
+  const size_t resp_size = resp_msgbuf->get_data_size();
+  entry.resp_msgbuf_ =
+      alloc_msg_buffer_or_die((std::max)(resp_size, static_cast<size_t>(1)));
+  resize_msg_buffer(&entry.resp_msgbuf_, resp_size);
+  memcpy(entry.resp_msgbuf_.buf_, resp_msgbuf->buf_, resp_size);
+
+  entry.done_ = true;
+  entry.expiry_tsc_ = ev_loop_tsc_ + amo_table->expiry_cycles_;
+  amo_table->done_queue_.push(std::make_pair(key, entry.expiry_tsc_));
+
+  std::vector<SSlot *> waiters;
+  waiters.swap(entry.waiters_);
+  for (SSlot *waiter : waiters) {
+    enqueue_saved_resp_st(waiter, entry.resp_msgbuf_);
+  }
+
+  // Evict the oldest responses if the table is full. This may evict the new
+  // response only if the table holds one response.
+  while (amo_table->done_queue_.size() > amo_table->max_entries_) {
+    auto it = amo_table->map_.find(amo_table->done_queue_.front().first);
+    free_msg_buffer(it->second.resp_msgbuf_);
+    amo_table->map_.erase(it);
+    amo_table->done_queue_.pop();
+  }
+}
+
+FORCE_COMPILE_TRANSPORTS
+
+}  // namespace erpc
@@ -49,7 +49,9 @@ void Rpc<TTr>::handle_connect_req_st(const SmPkt &sm_pkt) {
   }
 
   // Check if we are allowed to create another session
-  if (!have_ring_entries()) {
+  const size_t port_i = pick_port_st();
+  TTr *port_transport = ports_[port_i].transport_;
+  if (!have_ring_entries(port_i)) {
     ERPC_WARN("%s: Ring buffers exhausted. Sending response.\n", issue_msg);
     sm_pkt_udp_tx_st(sm_construct_resp(sm_pkt, SmErrType::kRingExhausted));
     return;
@@ -62,7 +64,8 @@ void Rpc<TTr>::handle_connect_req_st(const SmPkt &sm_pkt) {
   if (kTesting && faults_.fail_resolve_rinfo_) {
     resolve_success = false;
   } else {
-    resolve_success = transport_->resolve_remote_routing_info(&client_rinfo);
+    resolve_success =
+        port_transport->resolve_remote_routing_info(&client_rinfo);
   }
 
   if (!resolve_success) {
@@ -78,6 +81,7 @@ void Rpc<TTr>::handle_connect_req_st(const SmPkt &sm_pkt) {
   auto *session = new Session(Session::Role::kServer, sm_pkt.uniq_token_,
                               get_freq_ghz(), transport_->get_bandwidth());
   session->state_ = SessionState::kConnected;
+  session->port_i_ = port_i;
 
   for (size_t i = 0; i < kSessionReqWindow; i++) {
     MsgBuffer &msgbuf_i = session->sslot_arr_[i].pre_resp_msgbuf_;
@@ -101,7 +105,7 @@ void Rpc<TTr>::handle_connect_req_st(const SmPkt &sm_pkt) {
   // Fill-in the server endpoint
   session->server_ = sm_pkt.server_;
   session->server_.session_num_ = session_vec_.size();
-  transport_->fill_local_routing_info(&session->server_.routing_info_);
+  port_transport->fill_local_routing_info(&session->server_.routing_info_);
   conn_req_token_map_[session->uniq_token_] = session->server_.session_num_;
 
   // Fill-in the client endpoint
@@ -111,7 +115,7 @@ void Rpc<TTr>::handle_connect_req_st(const SmPkt &sm_pkt) {
   session->local_session_num_ = session->server_.session_num_;
   session->remote_session_num_ = session->client_.session_num_;
 
-  alloc_ring_entries();
+  alloc_ring_entries(port_i);
   session_vec_.push_back(session);  // Add to list of all sessions
 
   // Add server endpoint info created above to resp. No need to add client info.
@@ -169,7 +173,8 @@ void Rpc<TTr>::handle_connect_resp_st(const SmPkt &sm_pkt) {
     ERPC_WARN("%s: Error %s.\n", issue_msg,
               sm_err_type_str(sm_pkt.err_type_).c_str());
 
-    free_ring_entries();  // Free before callback to allow creating new session
+    // Free before callback to allow creating new session
+    free_ring_entries(session->port_i_);
     sm_handler_(session->local_session_num_, SmEventType::kConnectFailed,
                 sm_pkt.err_type_, context_);
     bury_session_st(session);
@@ -186,7 +191,8 @@ void Rpc<TTr>::handle_connect_resp_st(const SmPkt &sm_pkt) {
     resolve_success = false;  // Inject fault
   } else {
     resolve_success =
-        transport_->resolve_remote_routing_info(&srv_routing_info);
+        ports_[session->port_i_].transport_->resolve_remote_routing_info(
+            &srv_routing_info);
   }
 
   if (!resolve_success) {
@@ -29,10 +29,10 @@ void Rpc<TTr>::process_expl_cr_st(SSlot *sslot, const pkthdr_t *pkthdr,
   assert(in_dispatch());
   assert(pkthdr->req_num_ <= sslot->cur_req_num_);
 
-  // Handle reordering
-  if (unlikely(!in_order_client(sslot, pkthdr))) {
+  // Handle reordering. Packets that are new and in the window are accepted.
+  if (unlikely(!in_window_client(sslot, pkthdr))) {
     ERPC_REORDER(
-        "Rpc %u, lsn %u (%s): Received out-of-order CR. "
+        "Rpc %u, lsn %u (%s): Received out-of-window CR. "
         "Packet %zu/%zu, sslot: %zu/%s. Dropping.\n",
         rpc_id_, sslot->session_->local_session_num_,
         sslot->session_->get_remote_hostname().c_str(), pkthdr->req_num_,
@@ -42,12 +42,26 @@ void Rpc<TTr>::process_expl_cr_st(SSlot *sslot, const pkthdr_t *pkthdr,
 
   // Update client tracking metadata
   if (kCcRateComp) update_timely_rate(sslot, pkthdr->pkt_num_, rx_tsc);
+  auto &ci = sslot->client_info_;
   bump_credits(sslot->session_);
-  sslot->client_info_.num_rx_++;
-  sslot->client_info_.progress_tsc_ = ev_loop_tsc_;
+  ci.rx_bitmap_.mark_rx(&ci.num_rx_, pkthdr->pkt_num_);
+  ci.progress_tsc_ = ev_loop_tsc_;
 
   // If we've transmitted all request pkts, there's nothing more to TX yet
-  if (req_pkts_pending(sslot)) kick_req_st(sslot);  // credits >= 1
+  if (req_pkts_pending(sslot)) {
+    kick_req_st(sslot);  // credits >= 1
+    return;
+  }
+
+  // This CR may have filled the last hole before a reordered response packet
+  MsgBuffer *req_msgbuf = sslot->tx_msgbuf_;
+  if (unlikely(ci.num_rx_ >= req_msgbuf->num_pkts_)) {
+    if (ci.num_rx_ == wire_pkts(req_msgbuf, ci.resp_msgbuf_)) {
+      complete_resp_st(sslot);
+    } else {
+      kick_rfr_st(sslot);  // credits >= 1
+    }
+  }
 }
 
 FORCE_COMPILE_TRANSPORTS
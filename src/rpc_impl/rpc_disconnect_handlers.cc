@@ -48,7 +48,7 @@ void Rpc<TTr>::handle_disconnect_req_st(const SmPkt &sm_pkt) {
     }
   }
 
-  free_ring_entries();
+  free_ring_entries(session->port_i_);
 
   ERPC_INFO("%s. None. Sending response.\n", issue_msg);
   sm_pkt_udp_tx_st(sm_construct_resp(sm_pkt, SmErrType::kNoError));
@@ -87,7 +87,8 @@ void Rpc<TTr>::handle_disconnect_resp_st(const SmPkt &sm_pkt) {
   assert(session->server_ == sm_pkt.server_);
 
   ERPC_INFO("%s: None. Session disconnected.\n", issue_msg);
-  free_ring_entries();  // Free before callback to allow creating a new session
+  // Free before callback to allow creating a new session
+  free_ring_entries(session->port_i_);
   sm_handler_(session->local_session_num_, SmEventType::kDisconnected,
               SmErrType::kNoError, context_);
   bury_session_st(session);
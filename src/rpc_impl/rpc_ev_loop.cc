@@ -1,3 +1,6 @@
+#include <poll.h>
+#include <sys/eventfd.h>
+
 #include "rpc.h"
 
 namespace erpc
@@ -16,15 +19,25 @@ namespace erpc
     // The packet RX code uses ev_loop_tsc as the RX timestamp, so it must be
     // next to ev_loop_tsc stamping.
     ev_loop_tsc_ = dpath_rdtsc();
-    process_comps_st(); // RX
+    const size_t num_pkts = process_comps_st(); // RX
 
     process_credit_stall_queue_st(); // TX
     if (kCcPacing)
       process_wheel_st(); // TX
 
-    // Drain all packets
-    if (tx_batch_i_ > 0)
-      do_tx_burst_st();
+    // Drain all packets, unless TX coalescing holds a small batch
+    bool tx_batches_empty = true;
+    for (size_t i = 0; i < num_ports_; i++)
+    {
+      port_t &port = ports_[i];
+      if (port.tx_batch_i_ == 0)
+        continue;
+
+      if (unlikely(tx_coalesce_.min_burst_ > 0) && tx_coalesce_hold_st(port))
+        tx_batches_empty = false;
+      else
+        do_tx_burst_st(port);
+    }
 
     if (unlikely(multi_threaded_))
     {
@@ -40,6 +53,136 @@ namespace erpc
       pkt_loss_scan_tsc_ = ev_loop_tsc_;
       pkt_loss_scan_st();
     }
+
+    // Count idle iterations for idle backoff. Pending timers belong to active
+    // RPCs, and the packet loss scan tolerates a bounded block.
+    if (unlikely(idle_iters_thresh_ != SIZE_MAX))
+    {
+      const bool idle = num_pkts == 0 && tx_batches_empty && stallq_.empty() &&
+                        active_rpcs_root_sentinel_.client_info_.next_ ==
+                            &active_rpcs_tail_sentinel_;
+      idle_iters_ = idle ? idle_iters_ + 1 : 0;
+    }
+  }
+
+  template <class TTr>
+  bool Rpc<TTr>::tx_coalesce_hold_st(port_t &port)
+  {
+    assert(port.tx_batch_i_ > 0);
+    auto &tc = tx_coalesce_;
+
+    // A batch that fills up in one iteration is transmitted. This also
+    // switches coalescing back on; see do_tx_burst_st().
+    if (port.tx_batch_i_ >= tc.min_burst_)
+      return false;
+
+    if (tc.num_timeouts_ >= kTxCoalesceMaxTimeouts)
+      return false; // Low load
+
+    if (port.tx_hold_start_tsc_ == 0)
+    {
+      port.tx_hold_start_tsc_ = ev_loop_tsc_;
+      return true;
+    }
+
+    if (ev_loop_tsc_ - port.tx_hold_start_tsc_ < tc.max_delay_cycles_)
+      return true;
+
+    tc.num_timeouts_++;
+    return false;
+  }
+
+  template <class TTr>
+  void Rpc<TTr>::set_tx_coalescing(size_t min_burst, size_t max_delay_us)
+  {
+    rt_assert(in_dispatch(), "TX coalescing configured from background");
+    rt_assert(min_burst <= TTr::kPostlist, "TX coalescing burst too large");
+
+    flush_tx_batches_st();
+    tx_coalesce_.min_burst_ = min_burst;
+    tx_coalesce_.max_delay_cycles_ = us_to_cycles(max_delay_us, freq_ghz_);
+    tx_coalesce_.num_timeouts_ = 0;
+  }
+
+  template <class TTr>
+  void Rpc<TTr>::idle_backoff_st(size_t max_block_us)
+  {
+    assert(in_dispatch());
+    assert(idle_iters_ >= idle_iters_thresh_);
+
+    if (idle_iters_ - idle_iters_thresh_ < idle_iters_thresh_)
+    {
+      // A short pause frees pipeline resources for a hyperthread sibling
+      static constexpr size_t kIdlePauses = 16;
+      idle_stats_.num_pauses_++;
+      for (size_t i = 0; i < kIdlePauses; i++)
+        pause();
+      return;
+    }
+
+    // Arm the RX notification and announce that we're blocked before a final
+    // event loop iteration. Packets and work queued after that iteration's
+    // checks generate an event on one of the fds.
+    for (size_t i = 0; i < num_ports_; i++)
+      ports_[i].transport_->arm_rx_notify();
+    nexus_hook_.ev_loop_blocked_.store(true);
+    run_event_loop_do_one_st();
+
+    if (idle_iters_ > 0)
+    {
+      struct pollfd pfds[1 + kMaxPhyPorts];
+      pfds[0].fd = nexus_hook_.wakeup_fd_;
+      pfds[0].events = POLLIN;
+      nfds_t nfds = 1;
+      for (size_t i = 0; i < num_ports_; i++)
+      {
+        const int fd = ports_[i].transport_->get_rx_notify_fd();
+        if (fd < 0)
+          continue;
+        pfds[nfds].fd = fd;
+        pfds[nfds].events = POLLIN;
+        nfds++;
+      }
+
+      struct timespec timeout;
+      timeout.tv_sec = static_cast<time_t>(max_block_us / 1000000);
+      timeout.tv_nsec = static_cast<long>((max_block_us % 1000000) * 1000);
+
+      idle_stats_.num_blocks_++;
+      if (ppoll(pfds, nfds, &timeout, nullptr) > 0)
+        idle_stats_.num_wakeups_++;
+    }
+
+    nexus_hook_.ev_loop_blocked_.store(false);
+
+    // Consume the wakeups. The next iteration handles the new work.
+    uint64_t counter;
+    ssize_t ret = read(nexus_hook_.wakeup_fd_, &counter, sizeof(counter));
+    _unused(ret);
+    for (size_t i = 0; i < num_ports_; i++)
+      ports_[i].transport_->ack_rx_notify();
+  }
+
+  template <class TTr>
+  void Rpc<TTr>::set_idle_backoff(size_t idle_iters, size_t max_block_us)
+  {
+    rt_assert(in_dispatch(), "Idle backoff configured from background");
+    idle_iters_ = 0;
+
+    if (idle_iters == 0)
+    {
+      idle_iters_thresh_ = SIZE_MAX;
+      return;
+    }
+
+    if (nexus_hook_.wakeup_fd_ == -1)
+    {
+      nexus_hook_.wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      rt_assert(nexus_hook_.wakeup_fd_ >= 0, "Failed to create eventfd");
+    }
+
+    idle_iters_thresh_ = idle_iters;
+    idle_max_block_us_ = max_block_us;
   }
 
   template <class TTr>
@@ -56,8 +199,13 @@ namespace erpc
     {
       run_event_loop_do_one_st(); // Run at least once even if timeout_ms is 0
       clock_gettime(CLOCK_MONOTONIC, &now);
-      if (unlikely(now.tv_sec * 1e9 + now.tv_nsec > end))
+      const size_t now_ns = now.tv_sec * 1e9 + now.tv_nsec;
+      if (unlikely(now_ns > end))
         break;
+
+      // Don't block past the timeout
+      if (unlikely(idle_iters_ >= idle_iters_thresh_))
+        idle_backoff_st((std::min)(idle_max_block_us_, (end - now_ns) / 1000));
     }
   }
 
@@ -9,11 +9,20 @@ void Rpc<TTr>::kick_req_st(SSlot *sslot) {
   assert(credits > 0);  // Precondition
 
   auto &ci = sslot->client_info_;
-  size_t sending =
-      (std::min)(credits, sslot->tx_msgbuf_->num_pkts_ - ci.num_tx_);
+  const size_t num_pkts = sslot->tx_msgbuf_->num_pkts_;
   bool bypass = can_bypass_wheel(sslot);
 
-  for (size_t x = 0; x < sending; x++) {
+  // Packets received out of order don't hold credits, so the credit limit
+  // alone doesn't bound the window that rx_bitmap_ covers
+  while (credits > 0 && ci.num_tx_ < num_pkts &&
+         ci.num_tx_ < ci.num_rx_ + kSessionCredits) {
+    // After a rollback, skip packets whose credit return was received out of
+    // order. Skipped packets don't use credits.
+    if (unlikely(ci.rx_bitmap_.count_ > 0) && ci.rx_bitmap_.test(ci.num_tx_)) {
+      ci.num_tx_++;
+      continue;
+    }
+
     if (bypass) {
       enqueue_pkt_tx_burst_st(sslot, ci.num_tx_ /* pkt_idx */,
                               &ci.tx_ts_[ci.num_tx_ % kSessionCredits]);
@@ -40,9 +49,15 @@ void Rpc<TTr>::kick_rfr_st(SSlot *sslot) {
   assert(ci.num_rx_ < wire_pkts(sslot->tx_msgbuf_, ci.resp_msgbuf_));
 
   // TODO: Pace RFRs
-  size_t rfr_pndng = wire_pkts(sslot->tx_msgbuf_, ci.resp_msgbuf_) - ci.num_tx_;
-  size_t sending = (std::min)(credits, rfr_pndng);  // > 0
-  for (size_t x = 0; x < sending; x++) {
+  const size_t total_pkts = wire_pkts(sslot->tx_msgbuf_, ci.resp_msgbuf_);
+  while (credits > 0 && ci.num_tx_ < total_pkts &&
+         ci.num_tx_ < ci.num_rx_ + kSessionCredits) {
+    // After a rollback, skip RFRs whose response was received out of order
+    if (unlikely(ci.rx_bitmap_.count_ > 0) && ci.rx_bitmap_.test(ci.num_tx_)) {
+      ci.num_tx_++;
+      continue;
+    }
+
     enqueue_rfr_st(sslot, ci.resp_msgbuf_->get_pkthdr_0());
     ci.num_tx_++;
     credits--;
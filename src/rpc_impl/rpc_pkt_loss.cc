@@ -95,8 +95,11 @@ void Rpc<TTr>::pkt_loss_retransmit_st(SSlot *sslot) {
           sslot->session_->get_remote_hostname().c_str(),
           req_msgbuf->get_pkthdr_0()->req_num_, sslot->progress_str().c_str());
 
+  // Packets in [num_rx, num_tx) that were received out of order already
+  // returned their credits
   const size_t delta = ci.num_tx_ - ci.num_rx_;
-  assert(credits + delta <= kSessionCredits);
+  const size_t num_holes = delta - ci.rx_bitmap_.count_;
+  assert(credits + num_holes <= kSessionCredits);
 
   if (unlikely(delta == 0)) {
     ERPC_REORDER("%s: False positive. Ignoring.\n", issue_msg);
@@ -114,13 +117,14 @@ void Rpc<TTr>::pkt_loss_retransmit_st(SSlot *sslot) {
     return;
   }
 
-  // If we're here, we will roll back and retransmit
+  // If we're here, we will roll back and retransmit. Packets received out of
+  // order are skipped, so only the holes are retransmitted.
   pkt_loss_stats_.num_re_tx_++;
   sslot->session_->client_info_.num_re_tx_++;
 
   ERPC_REORDER("%s: Retransmitting %s.\n", issue_msg,
                ci.num_rx_ < req_msgbuf->num_pkts_ ? "requests" : "RFRs");
-  credits += delta;
+  credits += num_holes;
   ci.num_tx_ = ci.num_rx_;
   ci.progress_tsc_ = ev_loop_tsc_;
 
@@ -16,18 +16,66 @@ void Rpc<TTr>::enqueue_request(int session_num, uint8_t req_type,
     auto req_args = enq_req_args_t(session_num, req_type, req_msgbuf,
                                    resp_msgbuf, cont_func, tag, get_etid());
     bg_queues_.enqueue_request_.unlocked_push(req_args);
+    nexus_hook_.wakeup();
     return;
   }
 
-  // If we're here, we're in the dispatch thread
+  enqueue_request_st(session_num, req_type, req_msgbuf, resp_msgbuf, cont_func,
+                     tag, cont_etid);
+}
+
+template <class TTr>
+void Rpc<TTr>::enqueue_request_batch(const enq_req_args_t *req_args_arr,
+                                     size_t num_reqs) {
+  if (unlikely(!in_dispatch())) {
+    // Continuations run on this background thread
+    static constexpr size_t kBgChunkSize = 16;
+    enq_req_args_t chunk[kBgChunkSize];
+    const size_t etid = get_etid();
+
+    for (size_t i = 0; i < num_reqs; i += kBgChunkSize) {
+      const size_t chunk_size = (std::min)(kBgChunkSize, num_reqs - i);
+      for (size_t j = 0; j < chunk_size; j++) {
+        chunk[j] = req_args_arr[i + j];
+        chunk[j].cont_etid_ = etid;
+      }
+      bg_queues_.enqueue_request_.unlocked_push_batch(chunk, chunk_size);
+    }
+
+    nexus_hook_.wakeup();
+    return;
+  }
+
+  for (size_t i = 0; i < num_reqs; i++) {
+    const enq_req_args_t &args = req_args_arr[i];
+    enqueue_request_st(args.session_num_, args.req_type_, args.req_msgbuf_,
+                       args.resp_msgbuf_, args.cont_func_, args.tag_,
+                       kInvalidBgETid);
+  }
+
+  // Full TX batches were transmitted while kicking. Transmit the rest now
+  // instead of in the next event loop iteration.
+  flush_tx_batches_st();
+}
+
+template <class TTr>
+void Rpc<TTr>::enqueue_request_st(int session_num, uint8_t req_type,
+                                  MsgBuffer *req_msgbuf, MsgBuffer *resp_msgbuf,
+                                  erpc_cont_func_t cont_func, void *tag,
+                                  size_t cont_etid) {
+  assert(in_dispatch());
   Session *session = session_vec_[static_cast<size_t>(session_num)];
   assert(session->is_connected());  // User is notified before we disconnect
 
   // If a free sslot is unavailable, save to session backlog
   if (unlikely(session->client_info_.sslot_free_vec_.size() == 0)) {
-    session->client_info_.enq_req_backlog_.emplace(session_num, req_type,
-                                                   req_msgbuf, resp_msgbuf,
-                                                   cont_func, tag, cont_etid);
+    auto &backlog = session->client_info_.enq_req_backlog_;
+    backlog.push(enq_req_args_t(session_num, req_type, req_msgbuf, resp_msgbuf,
+                                cont_func, tag, cont_etid));
+
+    backlog_stats_.num_backlogged_++;
+    backlog_stats_.max_depth_ =
+        (std::max)(backlog_stats_.max_depth_, backlog.size());
     return;
   }
 
@@ -74,6 +122,34 @@ void Rpc<TTr>::enqueue_request(int session_num, uint8_t req_type,
   }
 }
 
+template <class TTr>
+void Rpc<TTr>::forward_request(ReqHandle *req_handle, int session_num,
+                               uint8_t req_type, erpc_cont_func_t cont_func,
+                               void *tag) {
+  SSlot *sslot = static_cast<SSlot *>(req_handle);
+  sslot->server_info_.fwd_cont_func_ = cont_func;
+  sslot->server_info_.fwd_tag_ = tag;
+  MsgBuffer &req_msgbuf = sslot->server_info_.req_msgbuf_;
+
+  // A fake request MsgBuffer points into the RX ring, which is reused after
+  // the request handler returns. The dynamic copy is buried as usual in
+  // enqueue_response().
+  if (!req_msgbuf.is_dynamic()) {
+    const size_t req_size = req_msgbuf.get_data_size();
+    MsgBuffer dyn_req_msgbuf =
+        alloc_msg_buffer_or_die((std::max)(req_size, static_cast<size_t>(1)));
+    resize_msg_buffer(&dyn_req_msgbuf, req_size);
+    memcpy(dyn_req_msgbuf.buf_, req_msgbuf.buf_, req_size);
+    req_msgbuf = dyn_req_msgbuf;
+  }
+
+  // A null continuation marks a forwarded request, whose tag is the sslot of
+  // the request being forwarded. The response is received into that sslot's
+  // response MsgBuffers, and enqueued as its response on completion.
+  enqueue_request(session_num, req_type, &req_msgbuf, &sslot->pre_resp_msgbuf_,
+                  nullptr, static_cast<void *>(sslot));
+}
+
 template <class TTr>
 void Rpc<TTr>::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
   assert(in_dispatch());
@@ -120,6 +196,7 @@ void Rpc<TTr>::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
   // Update sslot tracking
   sslot->cur_req_num_ = pkthdr->req_num_;
   sslot->server_info_.num_rx_ = 1;
+  sslot->server_info_.rx_bitmap_.reset();
 
   const ReqFunc &req_func = req_func_arr_[pkthdr->req_type_];
 
@@ -140,12 +217,22 @@ void Rpc<TTr>::process_small_req_st(SSlot *sslot, pkthdr_t *pkthdr) {
       req_msgbuf = alloc_msg_buffer(pkthdr->msg_size_);
       memcpy(req_msgbuf.buf_, pkthdr + 1, pkthdr->msg_size_);  // Omit header
     }
+
+    if (unlikely(req_func.saves_resps()) &&
+        handle_saved_resp_st(sslot, req_func)) {
+      return;
+    }
     req_func.req_func_(static_cast<ReqHandle *>(sslot), context_);
     return;
   } else {
     // Background request handlers need an RX ring--independent request copy
     req_msgbuf = alloc_msg_buffer(pkthdr->msg_size_);
     memcpy(req_msgbuf.buf_, pkthdr + 1, pkthdr->msg_size_);  // Omit header
+
+    if (unlikely(req_func.saves_resps()) &&
+        handle_saved_resp_st(sslot, req_func)) {
+      return;
+    }
     submit_bg_req_st(sslot);
     return;
   }
@@ -156,27 +243,33 @@ void Rpc<TTr>::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
   assert(in_dispatch());
 
   // Handle reordering
-  bool is_next_pkt_same_req =  // Is this the next packet in this request?
-      (pkthdr->req_num_ == sslot->cur_req_num_) &&
-      (pkthdr->pkt_num_ == sslot->server_info_.num_rx_);
-  bool is_first_pkt_next_req =  // Is this the first packet in the next request?
-      (pkthdr->req_num_ == sslot->cur_req_num_ + kSessionReqWindow) &&
-      (pkthdr->pkt_num_ == 0);
-
-  bool in_order = is_next_pkt_same_req || is_first_pkt_next_req;
-  if (unlikely(!in_order)) {
+  auto &si = sslot->server_info_;
+  bool is_same_req = (pkthdr->req_num_ == sslot->cur_req_num_);
+  bool is_past_pkt =  // Have we already received this packet?
+      (pkthdr->pkt_num_ < si.num_rx_) ||
+      (pkthdr->pkt_num_ < si.num_rx_ + kSessionCredits &&
+       si.rx_bitmap_.test(pkthdr->pkt_num_));
+  bool is_next_req =
+      (pkthdr->req_num_ == sslot->cur_req_num_ + kSessionReqWindow);
+
+  // Accept new packets of this request within the window of packets in flight,
+  // and any packet of the next request
+  bool in_window =
+      (is_same_req && !is_past_pkt &&
+       pkthdr->pkt_num_ < si.num_rx_ + kSessionCredits) ||
+      is_next_req;
+  if (unlikely(!in_window)) {
     char issue_msg[kMaxIssueMsgLen];
     // XXX: The static_cast for pkt_num_ is a hack for compiling with clang
     sprintf(issue_msg,
-            "Rpc %u, lsn %u: Received out-of-order request. "
+            "Rpc %u, lsn %u: Received out-of-window request. "
             "Req/pkt numbers: %zu/%zu (pkt), %zu/%zu (sslot). Action",
             rpc_id_, sslot->session_->local_session_num_, pkthdr->req_num_,
             static_cast<size_t>(pkthdr->pkt_num_), sslot->cur_req_num_,
-            sslot->server_info_.num_rx_);
+            si.num_rx_);
 
     // Only past packets belonging to this request are not dropped
-    if (pkthdr->req_num_ != sslot->cur_req_num_ ||
-        pkthdr->pkt_num_ > sslot->server_info_.num_rx_) {
+    if (!is_same_req || !is_past_pkt) {
       ERPC_REORDER("%s: Dropping.\n", issue_msg);
       return;
     }
@@ -205,11 +298,12 @@ void Rpc<TTr>::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
     return;
   }
 
-  MsgBuffer &req_msgbuf = sslot->server_info_.req_msgbuf_;
+  MsgBuffer &req_msgbuf = si.req_msgbuf_;
 
   // Allocate or locate the request MsgBuffer
-  if (pkthdr->pkt_num_ == 0) {
-    // This is the first packet received for this request
+  if (is_next_req) {
+    // This is the first packet received for this request, but not necessarily
+    // packet zero
     assert(req_msgbuf.is_buried());  // Buried on prev req's enqueue_response()
 
     // Bury the previous, possibly dynamic response. This marks the response for
@@ -221,12 +315,12 @@ void Rpc<TTr>::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
 
     // Update sslot tracking
     sslot->cur_req_num_ = pkthdr->req_num_;
-    sslot->server_info_.num_rx_ = 1;
-  } else {
-    // This is not the first packet for this request
-    sslot->server_info_.num_rx_++;
+    si.num_rx_ = 0;
+    si.rx_bitmap_.reset();
   }
 
+  si.rx_bitmap_.mark_rx(&si.num_rx_, pkthdr->pkt_num_);
+
   // Send a credit return for every request packet except the last in sequence
   if (pkthdr->pkt_num_ != req_msgbuf.num_pkts_ - 1) {
     enqueue_cr_st(sslot, pkthdr);
@@ -235,7 +329,7 @@ void Rpc<TTr>::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
   copy_data_to_msgbuf(&req_msgbuf, pkthdr->pkt_num_, pkthdr);  // Omits header
 
   // Invoke the request handler iff we have all the request packets
-  if (sslot->server_info_.num_rx_ != req_msgbuf.num_pkts_) return;
+  if (si.num_rx_ != req_msgbuf.num_pkts_) return;
 
   const ReqFunc &req_func = req_func_arr_[pkthdr->req_type_];
 
@@ -246,6 +340,11 @@ void Rpc<TTr>::process_large_req_one_st(SSlot *sslot, const pkthdr_t *pkthdr) {
   sslot->server_info_.req_type_ = pkthdr->req_type_;
   sslot->server_info_.req_func_type_ = req_func.req_func_type_;
 
+  if (unlikely(req_func.saves_resps()) &&
+      handle_saved_resp_st(sslot, req_func)) {
+    return;
+  }
+
   // req_msgbuf here is independent of the RX ring, so don't make another copy
   if (likely(!req_func.is_background())) {
     req_func.req_func_(static_cast<ReqHandle *>(sslot), context_);
@@ -16,33 +16,46 @@ bool Rpc<TTr>::handle_reset_client_st(Session *session) {
           rpc_id_, session->local_session_num_,
           session_state_str(session->state_).c_str());
 
+  // TX coalescing may hold packets that reference the session's routing info
+  // and request MsgBuffers, which failure continuations may free
+  flush_tx_batches_st();
+
   // Erase session slots from credit stall queue
   for (const SSlot &sslot : session->sslot_arr_) {
     stallq_.erase(std::remove(stallq_.begin(), stallq_.end(), &sslot),
                   stallq_.end());
   }
 
+  // Change state before failure continuations, so that they can check if the
+  // session is still connected
+  session->state_ = SessionState::kDisconnectInProgress;
+
   // Invoke continuation-with-failure for all active requests
   for (SSlot &sslot : session->sslot_arr_) {
-    if (sslot.tx_msgbuf_ == nullptr) {
+    if (sslot.tx_msgbuf_ != nullptr) {
       sslot.tx_msgbuf_ = nullptr;
       delete_from_active_rpc_list(sslot);
       session->client_info_.sslot_free_vec_.push_back(sslot.index_);
 
       MsgBuffer *resp_msgbuf = sslot.client_info_.resp_msgbuf_;
       resize_msg_buffer(resp_msgbuf, 0);  // 0 response size marks the error
-      sslot.client_info_.cont_func_(context_, sslot.client_info_.tag_);
+
+      if (sslot.client_info_.cont_func_ == nullptr) {
+        // Fail the forwarded request upstream with the empty response
+        enqueue_fwd_response_st(static_cast<SSlot *>(sslot.client_info_.tag_),
+                                resp_msgbuf);
+      } else {
+        sslot.client_info_.cont_func_(context_, sslot.client_info_.tag_);
+      }
     }
   }
 
   assert(session->client_info_.sslot_free_vec_.size() == kSessionReqWindow);
 
-  // Change state before failure continuations
-  session->state_ = SessionState::kDisconnectInProgress;
-
   // Act similar to handling a disconnect response
   ERPC_INFO("%s: None. Session resetted.\n", issue_msg);
-  free_ring_entries();  // Free before callback to allow creating new session
+  // Free before callback to allow creating new session
+  free_ring_entries(session->port_i_);
   sm_handler_(session->local_session_num_, SmEventType::kDisconnected,
               SmErrType::kSrvDisconnected, context_);
   bury_session_st(session);
@@ -71,7 +84,7 @@ bool Rpc<TTr>::handle_reset_server_st(Session *session) {
   if (pending_enqueue_resps == 0) {
     // Act similar to handling a disconnect request, but don't send SM response
     ERPC_INFO("%s: None. Session resetted.\n", issue_msg);
-    free_ring_entries();
+    free_ring_entries(session->port_i_);
     bury_session_st(session);
     return true;
   } else {
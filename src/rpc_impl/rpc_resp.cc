@@ -13,11 +13,18 @@ void Rpc<TTr>::enqueue_response(ReqHandle *req_handle, MsgBuffer *resp_msgbuf) {
   if (unlikely(!in_dispatch())) {
     bg_queues_.enqueue_response_.unlocked_push(
         enq_resp_args_t(req_handle, resp_msgbuf));
+    nexus_hook_.wakeup();
     return;
   }
 
   // If we're here, we're in the dispatch thread
   SSlot *sslot = static_cast<SSlot *>(req_handle);
+  if (unlikely(sslot->server_info_.amo_pending_)) {
+    amo_save_resp_st(sslot, resp_msgbuf);
+  } else if (unlikely(sslot->server_info_.resp_cache_pending_)) {
+    resp_cache_save_st(sslot, resp_msgbuf);
+  }
+
   sslot->server_info_.sav_num_req_pkts_ =
       sslot->server_info_.req_msgbuf_.num_pkts_;
   bury_req_msgbuf_server_st(sslot);  // Bury the possibly-dynamic req MsgBuffer
@@ -69,16 +76,33 @@ void Rpc<TTr>::enqueue_response(ReqHandle *req_handle, MsgBuffer *resp_msgbuf) {
   enqueue_pkt_tx_burst_st(sslot, 0, nullptr);  // 0 = packet index, not pkt_num
 }
 
+template <class TTr>
+void Rpc<TTr>::enqueue_saved_resp_st(SSlot *sslot, const MsgBuffer &saved) {
+  const size_t resp_size = saved.get_data_size();
+
+  MsgBuffer *resp_msgbuf;
+  if (resp_size <= sslot->pre_resp_msgbuf_.max_data_size_) {
+    resp_msgbuf = &sslot->pre_resp_msgbuf_;
+    resize_msg_buffer(resp_msgbuf, resp_size);
+  } else {
+    sslot->dyn_resp_msgbuf_ = alloc_msg_buffer_or_die(resp_size);
+    resp_msgbuf = &sslot->dyn_resp_msgbuf_;
+  }
+
+  memcpy(resp_msgbuf->buf_, saved.buf_, resp_size);
+  enqueue_response(static_cast<ReqHandle *>(sslot), resp_msgbuf);
+}
+
 template <class TTr>
 void Rpc<TTr>::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
                                    size_t rx_tsc) {
   assert(in_dispatch());
   assert(pkthdr->req_num_ <= sslot->cur_req_num_);
 
-  // Handle reordering
-  if (unlikely(!in_order_client(sslot, pkthdr))) {
+  // Handle reordering. Packets that are new and in the window are accepted.
+  if (unlikely(!in_window_client(sslot, pkthdr))) {
     ERPC_REORDER(
-        "Rpc %u, lsn %u (%s): Received out-of-order response. "
+        "Rpc %u, lsn %u (%s): Received out-of-window response. "
         "Packet %zu/%zu, sslot %zu/%s. Dropping.\n",
         rpc_id_, sslot->session_->local_session_num_,
         sslot->session_->get_remote_hostname().c_str(), pkthdr->req_num_,
@@ -92,9 +116,12 @@ void Rpc<TTr>::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
   // Update client tracking metadata
   if (kCcRateComp) update_timely_rate(sslot, pkthdr->pkt_num_, rx_tsc);
   bump_credits(sslot->session_);
-  ci.num_rx_++;
+  ci.rx_bitmap_.mark_rx(&ci.num_rx_, pkthdr->pkt_num_);
   ci.progress_tsc_ = ev_loop_tsc_;
 
+  // This is a new response packet. So, we still have the request.
+  MsgBuffer *req_msgbuf = sslot->tx_msgbuf_;
+
   // Special handling for single-packet responses
   if (likely(pkthdr->msg_size_ <= TTr::kMaxDataPerPkt)) {
     resize_msg_buffer(resp_msgbuf, pkthdr->msg_size_);
@@ -105,20 +132,33 @@ void Rpc<TTr>::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
     memcpy(resp_msgbuf->get_pkthdr_0()->ehdrptr(), pkthdr->ehdrptr(),
            pkthdr->msg_size_ + sizeof(pkthdr_t) - kHeadroom);
 
-    // Fall through to invoke continuation
+    // The response may overtake credit returns for the request
+    if (unlikely(ci.num_rx_ != req_msgbuf->num_pkts_)) return;
+    // Else fall through to invoke continuation
   } else {
-    // This is an in-order response packet. So, we still have the request.
-    MsgBuffer *req_msgbuf = sslot->tx_msgbuf_;
-
     if (pkthdr->pkt_num_ == req_msgbuf->num_pkts_ - 1) {
       // This is the first response packet. Size the response and copy header.
+      if (unlikely(ci.cont_func_ == nullptr)) {
+        // A forwarded request's multi-packet response is received into the
+        // dynamic response MsgBuffer of the request being forwarded
+        auto *fwd_sslot = static_cast<SSlot *>(ci.tag_);
+        fwd_sslot->dyn_resp_msgbuf_ =
+            alloc_msg_buffer_or_die(pkthdr->msg_size_);
+        ci.resp_msgbuf_ = &fwd_sslot->dyn_resp_msgbuf_;
+        resp_msgbuf = ci.resp_msgbuf_;
+      }
+
       resize_msg_buffer(resp_msgbuf, pkthdr->msg_size_);
       memcpy(resp_msgbuf->get_pkthdr_0()->ehdrptr(), pkthdr->ehdrptr(),
              sizeof(pkthdr_t) - kHeadroom);
     }
 
-    // Transmit remaining RFRs before response memcpy. We have credits.
-    if (ci.num_tx_ != wire_pkts(req_msgbuf, resp_msgbuf)) kick_rfr_st(sslot);
+    // Transmit remaining RFRs before response memcpy. We have credits. RFRs
+    // can be sent only after all credit returns are received.
+    if (ci.num_rx_ >= req_msgbuf->num_pkts_ &&
+        ci.num_tx_ != wire_pkts(req_msgbuf, resp_msgbuf)) {
+      kick_rfr_st(sslot);
+    }
 
     // Hdr 0 was copied earlier, other headers are unneeded, so copy just data.
     const size_t pkt_idx = resp_ntoi(pkthdr->pkt_num_, req_msgbuf->num_pkts_);
@@ -128,6 +168,15 @@ void Rpc<TTr>::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
     // Else fall through to invoke continuation
   }
 
+  complete_resp_st(sslot);
+}
+
+template <class TTr>
+void Rpc<TTr>::complete_resp_st(SSlot *sslot) {
+  assert(in_dispatch());
+  auto &ci = sslot->client_info_;
+  MsgBuffer *resp_msgbuf = ci.resp_msgbuf_;
+
   // Here, the complete response has been received. All references to sslot must
   // have been removed previously, before invalidating the sslot (done next).
   // 1. The TX batch or DMA queue cannot contain a reference because we drain
@@ -161,7 +210,10 @@ void Rpc<TTr>::process_resp_one_st(SSlot *sslot, const pkthdr_t *pkthdr,
     session->client_info_.enq_req_backlog_.pop();
   }
 
-  if (likely(cont_etid == kInvalidBgETid)) {
+  if (unlikely(cont_func == nullptr)) {
+    // This is a forwarded request, so send the response upstream
+    enqueue_fwd_response_st(static_cast<SSlot *>(tag), resp_msgbuf);
+  } else if (likely(cont_etid == kInvalidBgETid)) {
     cont_func(context_, tag);
   } else {
     submit_bg_resp_st(cont_func, tag, cont_etid);
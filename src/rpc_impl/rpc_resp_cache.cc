@@ -0,0 +1,149 @@
+/**
+ * @file rpc_resp_cache.cc
+ * @brief Server-side response caches for idempotent request types
+ */
+#include "rpc.h"
+
+namespace erpc {
+
+/// Hash request data eight bytes at a time
+static uint64_t hash_req_data(const uint8_t *data, size_t size) {
+  uint64_t h = size * 0x9e3779b97f4a7c15ull;
+  for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+    uint64_t w = 0;
+    memcpy(&w, &data[i], (std::min)(sizeof(uint64_t), size - i));
+    h = (h ^ w) * 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+  }
+
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+template <class TTr>
+void Rpc<TTr>::resp_cache_pop_st(resp_cache_t *cache) {
+  const auto &item = cache->queue_.front();
+  auto it = cache->map_.find(item.hash_);
+  if (it != cache->map_.end() && it->second.gen_ == item.gen_) {
+    if (it->second.done_) free_msg_buffer(it->second.resp_msgbuf_);
+    cache->map_.erase(it);
+  }
+
+  cache->queue_.pop();
+}
+
+template <class TTr>
+bool Rpc<TTr>::resp_cache_lookup_st(SSlot *sslot) {
+  assert(in_dispatch());
+  auto &si = sslot->server_info_;
+  resp_cache_t *cache = resp_caches_[si.req_type_];
+  assert(cache != nullptr);
+
+  // Evict expired entries, oldest first
+  while (!cache->queue_.empty() &&
+         cache->queue_.front().expiry_tsc_ <= ev_loop_tsc_) {
+    resp_cache_pop_st(cache);
+  }
+
+  const MsgBuffer &req_msgbuf = si.req_msgbuf_;
+  const size_t req_size = req_msgbuf.get_data_size();
+  const uint64_t hash = hash_req_data(req_msgbuf.buf_, req_size);
+
+  auto it = cache->map_.find(hash);
+  if (it != cache->map_.end()) {
+    const auto &entry = it->second;
+    const bool hit = entry.done_ && entry.req_data_.size() == req_size &&
+                     memcmp(entry.req_data_.data(), req_msgbuf.buf_,
+                            req_size) == 0;
+    if (likely(hit)) {
+      resp_cache_stats_.num_hits_++;
+      enqueue_saved_resp_st(sslot, entry.resp_msgbuf_);
+      return true;
+    }
+
+    // The response is being computed for another request, or this is a hash
+    // collision. Run the request handler without caching its response.
+    resp_cache_stats_.num_misses_++;
+    return false;
+  }
+
+  // Insert an entry to be filled in enqueue_response()
+  resp_cache_stats_.num_misses_++;
+  auto &entry = cache->map_[hash];
+  entry.done_ = false;
+  entry.req_data_.assign(reinterpret_cast<const char *>(req_msgbuf.buf_),
+                         req_size);
+  entry.gen_ = cache->next_gen_++;
+
+  typename resp_cache_t::queue_item_t item;
+  item.hash_ = hash;
+  item.gen_ = entry.gen_;
+  item.expiry_tsc_ = ev_loop_tsc_ + cache->ttl_cycles_;
+  cache->queue_.push(item);
+
+  si.resp_cache_pending_ = true;
+  si.resp_cache_hash_ = hash;
+  si.resp_cache_gen_ = entry.gen_;
+
+  // Evict the oldest entries if the cache is full
+  while (cache->map_.size() > cache->max_entries_) {
+    resp_cache_pop_st(cache);
+  }
+
+  return false;
+}
+
+template <class TTr>
+void Rpc<TTr>::resp_cache_save_st(SSlot *sslot, const MsgBuffer *resp_msgbuf) {
+  assert(in_dispatch());
+  auto &si = sslot->server_info_;
+  resp_cache_t *cache = resp_caches_[si.req_type_];
+  si.resp_cache_pending_ = false;
+
+  // The entry may have been evicted or invalidated during request execution
+  auto it = cache->map_.find(si.resp_cache_hash_);
+  if (it == cache->map_.end() || it->second.gen_ != si.resp_cache_gen_) return;
+
+  // alloc_msg_buffer() requires size > 0
+  auto &entry = it->second;
+  const size_t resp_size = resp_msgbuf->get_data_size();
+  entry.resp_msgbuf_ =
+      alloc_msg_buffer_or_die((std::max)(resp_size, static_cast<size_t>(1)));
+  resize_msg_buffer(&entry.resp_msgbuf_, resp_size);
+  memcpy(entry.resp_msgbuf_.buf_, resp_msgbuf->buf_, resp_size);
+  entry.done_ = true;
+}
+
+template <class TTr>
+void Rpc<TTr>::invalidate_resp_cache(uint8_t req_type) {
+  rt_assert(in_dispatch(), "Response cache invalidated from background");
+  resp_cache_t *cache = resp_caches_[req_type];
+  rt_assert(cache != nullptr, "Request type has no response cache");
+
+  for (auto &kv : cache->map_) {
+    if (kv.second.done_) free_msg_buffer(kv.second.resp_msgbuf_);
+  }
+  cache->map_.clear();
+
+  std::queue<typename resp_cache_t::queue_item_t> empty;
+  std::swap(cache->queue_, empty);
+}
+
+template <class TTr>
+void Rpc<TTr>::invalidate_resp_cache(uint8_t req_type, const uint8_t *req_data,
+                                     size_t req_size) {
+  rt_assert(in_dispatch(), "Response cache invalidated from background");
+  resp_cache_t *cache = resp_caches_[req_type];
+  rt_assert(cache != nullptr, "Request type has no response cache");
+
+  // The entry's queue item is skipped when it reaches the front
+  auto it = cache->map_.find(hash_req_data(req_data, req_size));
+  if (it == cache->map_.end()) return;
+  if (it->second.done_) free_msg_buffer(it->second.resp_msgbuf_);
+  cache->map_.erase(it);
+}
+
+FORCE_COMPILE_TRANSPORTS
+
+}  // namespace erpc
@@ -32,23 +32,27 @@ void Rpc<TTr>::process_rfr_st(SSlot *sslot, const pkthdr_t *pkthdr) {
   auto &si = sslot->server_info_;
 
   // Handle reordering. If request numbers match, then we have not reset num_rx.
+  // Accept new RFRs within the window of packets in flight.
   assert(pkthdr->req_num_ <= sslot->cur_req_num_);
-  bool in_order = (pkthdr->req_num_ == sslot->cur_req_num_) &&
-                  (pkthdr->pkt_num_ == si.num_rx_);
-  if (unlikely(!in_order)) {
+  bool is_past_pkt =  // Have we already received this RFR?
+      (pkthdr->pkt_num_ < si.num_rx_) ||
+      (pkthdr->pkt_num_ < si.num_rx_ + kSessionCredits &&
+       si.rx_bitmap_.test(pkthdr->pkt_num_));
+  bool in_window = (pkthdr->req_num_ == sslot->cur_req_num_) && !is_past_pkt &&
+                   (pkthdr->pkt_num_ < si.num_rx_ + kSessionCredits);
+  if (unlikely(!in_window)) {
     char issue_msg[kMaxIssueMsgLen];
     // The static_cast for pkt_num_ is a hack for compiling with clang
     sprintf(issue_msg,
-            "Rpc %u, lsn %u (%s): Received out-of-order RFR. "
+            "Rpc %u, lsn %u (%s): Received out-of-window RFR. "
             "Pkt = %zu/%zu. cur_req_num = %zu, num_rx = %zu. Action",
             rpc_id_, sslot->session_->local_session_num_,
             sslot->session_->get_remote_hostname().c_str(), pkthdr->req_num_,
             static_cast<size_t>(pkthdr->pkt_num_), sslot->cur_req_num_,
             si.num_rx_);
 
-    if (pkthdr->req_num_ < sslot->cur_req_num_ ||
-        pkthdr->pkt_num_ > si.num_rx_) {
-      // Reject RFR for old requests or future packets in this request
+    if (pkthdr->req_num_ < sslot->cur_req_num_ || !is_past_pkt) {
+      // Reject RFR for old requests or far-future packets in this request
       ERPC_REORDER("%s: Dropping.\n", issue_msg);
       return;
     }
@@ -62,7 +66,7 @@ void Rpc<TTr>::process_rfr_st(SSlot *sslot, const pkthdr_t *pkthdr) {
     return;
   }
 
-  sslot->server_info_.num_rx_++;
+  si.rx_bitmap_.mark_rx(&si.num_rx_, pkthdr->pkt_num_);
   enqueue_pkt_tx_burst_st(
       sslot, resp_ntoi(pkthdr->pkt_num_, si.sav_num_req_pkts_), nullptr);
 }
@@ -3,10 +3,19 @@
 namespace erpc {
 
 template <class TTr>
-void Rpc<TTr>::process_comps_st() {
+size_t Rpc<TTr>::process_comps_st() {
+  size_t num_pkts = 0;
+  for (size_t i = 0; i < num_ports_; i++) {
+    num_pkts += process_port_comps_st(ports_[i]);
+  }
+  return num_pkts;
+}
+
+template <class TTr>
+size_t Rpc<TTr>::process_port_comps_st(port_t &port) {
   assert(in_dispatch());
-  const size_t num_pkts = transport_->rx_burst();
-  if (num_pkts == 0) return;
+  const size_t num_pkts = port.transport_->rx_burst();
+  if (num_pkts == 0) return 0;
 
   // Measure RX burst size
   dpath_stat_inc(dpath_stats_.rx_burst_calls_, 1);
@@ -15,9 +24,31 @@ void Rpc<TTr>::process_comps_st() {
   // ev_loop_tsc was taken just before calling the packet RX code
   const size_t &batch_rx_tsc = ev_loop_tsc_;
 
+  // Packet i + d is at RX ring entry rx_ring_head_ + d while processing
+  // packet i. Prefetch the first headers; the loop prefetches the rest.
+  static constexpr size_t kSSlotPrefetchDist = kRxPrefetchDist / 2;
+  static constexpr size_t kRingMask = Transport::kNumRxRingEntries - 1;
+  for (size_t i = 0; i < (std::min)(kRxPrefetchDist, num_pkts); i++) {
+    __builtin_prefetch(port.rx_ring_[(port.rx_ring_head_ + i) & kRingMask], 0,
+                       3);
+  }
+
   for (size_t i = 0; i < num_pkts; i++) {
-    auto *pkthdr = reinterpret_cast<pkthdr_t *>(rx_ring_[rx_ring_head_]);
-    rx_ring_head_ = (rx_ring_head_ + 1) % Transport::kNumRxRingEntries;
+    if (kRxPrefetchDist > 0) {
+      if (i + kRxPrefetchDist < num_pkts) {
+        __builtin_prefetch(
+            port.rx_ring_[(port.rx_ring_head_ + kRxPrefetchDist) & kRingMask],
+            0, 3);
+      }
+      if (i + kSSlotPrefetchDist < num_pkts) {
+        prefetch_rx_sslot_st(
+            port, (port.rx_ring_head_ + kSSlotPrefetchDist) & kRingMask);
+      }
+    }
+
+    auto *pkthdr =
+        reinterpret_cast<pkthdr_t *>(port.rx_ring_[port.rx_ring_head_]);
+    port.rx_ring_head_ = (port.rx_ring_head_ + 1) & kRingMask;
 
     // XXX: This acts as a stopgap function to filter non-eRPC packets, like
     // broadcast/ARP packets.
@@ -87,7 +118,8 @@ void Rpc<TTr>::process_comps_st() {
 
   // Technically, these RECVs can be posted immediately after rx_burst(), or
   // even in the rx_burst() code.
-  transport_->post_recvs(num_pkts);
+  port.transport_->post_recvs(num_pkts);
+  return num_pkts;
 }
 
 template <class TTr>
@@ -96,8 +128,24 @@ void Rpc<TTr>::submit_bg_req_st(SSlot *sslot) {
   assert(nexus_->num_bg_threads_ > 0);
 
   const size_t bg_etid = fast_rand_.next_u32() % nexus_->num_bg_threads_;
-  auto *req_queue = nexus_hook_.bg_req_queue_arr_[bg_etid];
+  const auto &si = sslot->server_info_;
+
+  // The deadline is relative to when the request was received. Requests
+  // without a header are scheduled normally.
+  if (unlikely(nexus_->req_func_arr_[si.req_type_].deadline_sched_) &&
+      likely(si.req_msgbuf_.get_data_size() >= sizeof(deadline_hdr_t))) {
+    deadline_hdr_t deadline_hdr;
+    memcpy(&deadline_hdr, si.req_msgbuf_.buf_, sizeof(deadline_hdr_t));
+    const size_t deadline_tsc =
+        ev_loop_tsc_ + us_to_cycles(deadline_hdr.deadline_us_, freq_ghz_);
+
+    auto *edf_queue = nexus_hook_.bg_edf_queue_arr_[bg_etid];
+    edf_queue->unlocked_push(Nexus::BgWorkItem::make_deadline_req_item(
+        context_, sslot, this, shed_deadline_req, deadline_tsc));
+    return;
+  }
 
+  auto *req_queue = nexus_hook_.bg_req_queue_arr_[bg_etid];
   req_queue->unlocked_push(Nexus::BgWorkItem::make_req_item(context_, sslot));
 }
 
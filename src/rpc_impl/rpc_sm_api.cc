@@ -42,7 +42,8 @@ int Rpc<TTr>::create_session_st(std::string remote_uri, uint8_t rem_rpc_id) {
   }
 
   // Ensure that we have ring buffers for this session
-  if (!have_ring_entries()) {
+  const size_t port_i = pick_port_st();
+  if (!have_ring_entries(port_i)) {
     ERPC_WARN("%s: Ring buffers exhausted.\n", issue_msg);
     return -ENOMEM;
   }
@@ -51,6 +52,7 @@ int Rpc<TTr>::create_session_st(std::string remote_uri, uint8_t rem_rpc_id) {
                               get_freq_ghz(), transport_->get_bandwidth());
   session->state_ = SessionState::kConnectInProgress;
   session->local_session_num_ = session_vec_.size();
+  session->port_i_ = port_i;
 
   // Fill in client and server endpoint metadata. Commented server fields will
   // be filled when the connect response is received.
@@ -60,7 +62,8 @@ int Rpc<TTr>::create_session_st(std::string remote_uri, uint8_t rem_rpc_id) {
   client_endpoint.sm_udp_port_ = nexus_->sm_udp_port_;
   client_endpoint.rpc_id_ = rpc_id_;
   client_endpoint.session_num_ = session->local_session_num_;
-  transport_->fill_local_routing_info(&client_endpoint.routing_info_);
+  ports_[port_i].transport_->fill_local_routing_info(
+      &client_endpoint.routing_info_);
 
   SessionEndpoint &server_endpoint = session->server_;
   server_endpoint.transport_type_ = transport_->transport_type_;
@@ -70,7 +73,7 @@ int Rpc<TTr>::create_session_st(std::string remote_uri, uint8_t rem_rpc_id) {
   // server_endpoint.session_num = ??
   // server_endpoint.routing_info = ??
 
-  alloc_ring_entries();
+  alloc_ring_entries(port_i);
   session_vec_.push_back(session);  // Add to list of all sessions
 
   send_sm_req_st(session);
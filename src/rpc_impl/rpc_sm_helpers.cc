@@ -11,6 +11,10 @@ void Rpc<TTr>::handle_sm_rx_st() {
   assert(in_dispatch());
   MtQueue<SmWorkItem> &queue = nexus_hook_.sm_rx_queue_;
 
+  // Session management may free sessions and MsgBuffers referenced by packets
+  // that TX coalescing holds from the previous event loop iteration
+  flush_tx_batches_st();
+
   while (queue.size_ > 0) {
     const SmWorkItem wi = queue.unlocked_pop();
     assert(!wi.is_reset());
@@ -42,6 +46,9 @@ template <class TTr>
 void Rpc<TTr>::bury_session_st(Session *session) {
   assert(in_dispatch());
 
+  // Held TX packets reference the session's routing info
+  flush_tx_batches_st();
+
   // Free session resources
   //
   // XXX: Which other MsgBuffers do we need to free? Which MsgBuffers are
@@ -56,6 +56,38 @@ typedef void (*erpc_cont_func_t)(void *context, void *tag);
  */
 enum class ReqFuncType : uint8_t { kForeground, kBackground };
 
+/**
+ * @relates Rpc
+ *
+ * @brief The header at the start of requests of at-most-once request types.
+ * See Nexus::enable_at_most_once().
+ *
+ * The server executes a request type's requests with the same client ID and
+ * sequence number at most once, including retries sent on a new session after
+ * a session reset. The server's request handlers see this header as part of
+ * the request data.
+ */
+struct amo_hdr_t {
+  uint64_t client_id_;  ///< Unique per client, e.g., Rpc::get_amo_client_id()
+  uint64_t seq_;        ///< Unique per operation at this client
+};
+
+/**
+ * @relates Rpc
+ *
+ * @brief The header at the start of requests of deadline-scheduled request
+ * types. See Nexus::enable_deadline_sched().
+ *
+ * Clients can map SLO classes to deadlines, e.g., tens of microseconds for
+ * latency-critical requests, and milliseconds for bulk requests. The server's
+ * request handlers see this header as part of the request data.
+ */
+struct deadline_hdr_t {
+  /// The time in microseconds, from when the server receives the complete
+  /// request, within which the request handler must start running
+  uint64_t deadline_us_;
+};
+
 /**
  * @relates Rpc
  * @brief The request handler registered by applications
@@ -65,6 +97,20 @@ class ReqFunc {
   erpc_req_func_t req_func_;   ///< The handler function
   ReqFuncType req_func_type_;  ///< The handlers's mode (foreground/background)
 
+  /// The maximum number of completed requests remembered for at-most-once
+  /// execution, or zero if this request type is not at-most-once
+  size_t amo_max_entries_ = 0;
+  size_t amo_expiry_ms_ = 0;  ///< Lifetime of a remembered response
+
+  /// The maximum number of cached responses for this request type, or zero if
+  /// its responses are not cached
+  size_t resp_cache_max_entries_ = 0;
+  size_t resp_cache_ttl_ms_ = 0;  ///< Lifetime of a cached response
+
+  /// True iff background requests of this type are scheduled earliest
+  /// deadline first
+  bool deadline_sched_ = false;
+
   inline bool is_background() const {
     return req_func_type_ == ReqFuncType::kBackground;
   }
@@ -78,5 +124,11 @@ class ReqFunc {
 
   /// Check if this request handler is registered
   inline bool is_registered() const { return req_func_ != nullptr; }
+
+  /// Check if the server saves responses to this request type, either for
+  /// at-most-once execution or as a response cache
+  inline bool saves_resps() const {
+    return amo_max_entries_ > 0 || resp_cache_max_entries_ > 0;
+  }
 };
 }  // namespace erpc
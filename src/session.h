@@ -13,6 +13,7 @@
 #include "sslot.h"
 #include "util/buffer.h"
 #include "util/fixed_vector.h"
+#include "util/ring_queue.h"
 
 namespace erpc {
 
@@ -55,7 +56,8 @@ class Rpc;
 
 /// A one-to-one session class for all transports
 class Session {
-  friend class Rpc<CTransport>;
+  template <typename T>
+  friend class Rpc;
   friend class ReqHandle;
 
  public:
@@ -71,8 +73,10 @@ class Session {
     remote_routing_info_ =
         is_client() ? &server_.routing_info_ : &client_.routing_info_;
 
-    if (is_client())
+    if (is_client()) {
       client_info_.cc_.timely_ = Timely(freq_ghz, link_bandwidth);
+      client_info_.enq_req_backlog_.reserve(kSessionReqWindow);
+    }
 
     // Arrange the free slot vector so that slots are popped in order
     for (size_t i = 0; i < kSessionReqWindow; i++) {
@@ -150,6 +154,7 @@ class Session {
   Transport::routing_info_t *remote_routing_info_;
   uint16_t local_session_num_;
   uint16_t remote_session_num_;
+  size_t port_i_ = 0;  ///< Index of the Rpc port used by this session
   ///@}
 
   /// Information that is required only at the client endpoint
@@ -160,8 +165,10 @@ class Session {
     /// in request number calculation.
     FixedVector<size_t, kSessionReqWindow> sslot_free_vec_;
 
-    /// Requests that spill over kSessionReqWindow are queued here
-    std::queue<enq_req_args_t> enq_req_backlog_;
+    /// Requests that spill over kSessionReqWindow are queued here. Client
+    /// sessions preallocate room for kSessionReqWindow backlogged requests,
+    /// and the backlog grows if more are queued.
+    RingQueue<enq_req_args_t> enq_req_backlog_;
 
     size_t num_re_tx_ = 0;  ///< Number of retransmissions for this session
 
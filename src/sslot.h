@@ -13,11 +13,69 @@ class Nexus;
 template <typename T>
 class Rpc;
 
+/**
+ * @brief A bitmap of packets that an sslot received out of order, i.e., after
+ * the first missing packet num_rx. The bit for packet number n is at index
+ * (n % kSessionCredits). This is unambiguous because an sslot never has more
+ * than kSessionCredits packets in flight.
+ *
+ * This has no constructor so that it can live in the sslot's union.
+ */
+class ReorderBitmap {
+ public:
+  static constexpr size_t kNumWords = kSessionCredits / 64;
+  static_assert(kSessionCredits % 64 == 0, "");
+
+  inline bool test(size_t pkt_num) const {
+    const size_t i = pkt_num % kSessionCredits;
+    return (words_[i / 64] >> (i % 64)) & 1;
+  }
+
+  /**
+   * @brief Record the receipt of packet pkt_num, which must be at or after
+   * num_rx and not yet received. If pkt_num is num_rx, advance num_rx past
+   * all packets received so far.
+   */
+  inline void mark_rx(size_t *num_rx, size_t pkt_num) {
+    assert(pkt_num >= *num_rx && !test(pkt_num));
+    if (likely(pkt_num == *num_rx)) {
+      (*num_rx)++;
+      while (unlikely(count_ > 0) && test(*num_rx)) {
+        flip(*num_rx);
+        count_--;
+        (*num_rx)++;
+      }
+    } else {
+      flip(pkt_num);
+      count_++;
+    }
+  }
+
+  /// Clear all bits
+  inline void reset() {
+    if (unlikely(count_ > 0)) {
+      words_.fill(0);
+      count_ = 0;
+    }
+  }
+
+  size_t count_;  ///< Number of packets received out of order
+
+ private:
+  inline void flip(size_t pkt_num) {
+    const size_t i = pkt_num % kSessionCredits;
+    words_[i / 64] ^= (1ull << (i % 64));
+  }
+
+  std::array<uint64_t, kNumWords> words_;
+};
+
 /// Session slot metadata maintained for an RPC by both client and server
 class SSlot {
   friend class Session;
   friend class Nexus;
-  friend class Rpc<CTransport>;
+  template <typename T>
+  friend class Rpc;
   friend class ReqHandle;
 
  public:
@@ -58,11 +116,15 @@ class SSlot {
       /// Number of packets sent. Packets up to (num_tx - 1) have been sent.
       size_t num_tx_;
 
-      /// Number of pkts received. Pkts up to (num_tx - 1) have been received.
+      /// Number of pkts received in order. Pkts up to (num_rx - 1) have been
+      /// received. Later packets may have been received out of order.
       size_t num_rx_;
 
-      /// TSC at which we last sent or retransmitted a packet, or received an
-      /// in-order packet for this request
+      /// Packets in [num_rx, num_tx) received out of order
+      ReorderBitmap rx_bitmap_;
+
+      /// TSC at which we last sent or retransmitted a packet, or received a
+      /// new packet for this request
       size_t progress_tsc_;
 
       size_t cont_etid_;  ///< eRPC thread ID to run the continuation on
@@ -96,12 +158,33 @@ class SSlot {
       uint8_t req_type_;
       ReqFuncType req_func_type_;  ///< The req handler type (e.g., background)
 
-      /// Number of pkts received. Pkts up to (num_rx - 1) have been received.
+      /// Number of pkts received in order. Pkts up to (num_rx - 1) have been
+      /// received. Later packets may have been received out of order.
       size_t num_rx_;
 
+      /// Packets after num_rx received out of order
+      ReorderBitmap rx_bitmap_;
+
       /// The server remembers the number of packets in the request after
       /// burying the request in enqueue_response().
       size_t sav_num_req_pkts_;
+
+      /// The user's continuation and tag for a forwarded request. See
+      /// Rpc::forward_request().
+      erpc_cont_func_t fwd_cont_func_;
+      void *fwd_tag_;
+
+      /// True iff this is the first copy of an at-most-once request, whose
+      /// response is saved in enqueue_response(). See
+      /// Nexus::enable_at_most_once().
+      bool amo_pending_;
+      amo_hdr_t amo_hdr_;  ///< The at-most-once header of the request
+
+      /// True iff the response to this request is saved in the response cache
+      /// in enqueue_response(). See Nexus::enable_resp_cache().
+      bool resp_cache_pending_;
+      uint64_t resp_cache_hash_;  ///< Hash of the request data
+      size_t resp_cache_gen_;     ///< Generation of the request's cache entry
     } server_info_;
   };
 
@@ -111,9 +194,11 @@ class SSlot {
     std::ostringstream ret;
     if (is_client_) {
       ret << "[num_tx " << client_info_.num_tx_ << ", num_rx "
-          << client_info_.num_rx_ << "]";
+          << client_info_.num_rx_ << ", num_rx_ooo "
+          << client_info_.rx_bitmap_.count_ << "]";
     } else {
-      ret << "[num_rx " << server_info_.num_rx_ << "]";
+      ret << "[num_rx " << server_info_.num_rx_ << ", num_rx_ooo "
+          << server_info_.rx_bitmap_.count_ << "]";
     }
     return ret.str();
   }
@@ -38,6 +38,11 @@ namespace erpc
     static constexpr size_t kMaxRoutingInfoSize = 48; ///< Space for routing info
     static constexpr size_t kMaxMemRegInfoSize = 64;  ///< Space for mem reg info
 
+    /// True iff memory registered by one instance of the transport can be
+    /// used by other instances on other ports. An Rpc can use multiple ports
+    /// only with such transports, since it has one hugepage allocator.
+    static constexpr bool kPortIndependentMemReg = false;
+
     /**
      * @brief Generic struct to store routing info for any transport.
      *
@@ -152,6 +157,20 @@ namespace erpc
      */
     void post_recvs(size_t num_recvs);
 
+    /**
+     * @brief Return a file descriptor that becomes readable when a packet is
+     * received after arm_rx_notify(), or -1 if the transport does not support
+     * RX notifications. Idle Rpcs block on this descriptor.
+     */
+    int get_rx_notify_fd() const { return -1; }
+
+    /// Request a notification on the RX notification descriptor for the next
+    /// received packet
+    void arm_rx_notify() {}
+
+    /// Consume a pending RX notification, if any. This must not block.
+    void ack_rx_notify() {}
+
     /// Fill-in local routing information
     void fill_local_routing_info(routing_info_t *routing_info) const;
 
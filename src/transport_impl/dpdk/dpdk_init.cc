@@ -65,8 +65,19 @@ void DpdkTransport::setup_phy_port(uint16_t phy_port, size_t numa_node,
   eth_conf.txmode.mq_mode = ETH_MQ_TX_NONE;
   eth_conf.txmode.offloads = kOffloads;
 
+  // RX queue interrupts let idle Rpcs block instead of polling. They are armed
+  // only by idle Rpcs, so they don't cost anything on the datapath.
+  eth_conf.intr_conf.rxq = kIsWindows ? 0 : 1;
+
   int ret = rte_eth_dev_configure(phy_port, kMaxQueuesPerPort,
                                   kMaxQueuesPerPort, &eth_conf);
+  if (ret != 0 && eth_conf.intr_conf.rxq == 1) {
+    ERPC_WARN("Port %u does not support RX queue interrupts (%s).\n",
+              phy_port, strerror(-1 * ret));
+    eth_conf.intr_conf.rxq = 0;
+    ret = rte_eth_dev_configure(phy_port, kMaxQueuesPerPort, kMaxQueuesPerPort,
+                                &eth_conf);
+  }
   rt_assert(ret == 0, "Ethdev configuration error: ", strerror(-1 * ret));
 
   // Set up all RX and TX queues and start the device. This can't be done later
@@ -135,6 +135,16 @@ DpdkTransport::DpdkTransport(uint16_t sm_udp_port, uint8_t rpc_id,
           std::string("Failed to find self's mempool ") + mempool_name.c_str());
     }
 
+    if (dpdk_proc_type_ == DpdkProcType::kPrimary && !kIsWindows) {
+      const int fd = rte_eth_dev_rx_intr_ctl_q_get_fd(phy_port, qp_id_);
+      if (fd >= 0) {
+        rx_intr_fd_ = fd;
+      } else {
+        ERPC_INFO("DPDK transport for Rpc %u: No RX interrupts for queue %zu\n",
+                  rpc_id, qp_id_);
+      }
+    }
+
     g_dpdk_lock.unlock();
   }
 
@@ -215,6 +215,7 @@ namespace erpc
     // Transport-specific constants
     static constexpr TransportType kTransportType = TransportType::kDPDK;
     static constexpr size_t kMTU = 1500;
+    static constexpr bool kPortIndependentMemReg = true;  // No registration
 
     static constexpr size_t kNumTxRingDesc = 1024;
     static constexpr size_t kPostlist = 128;
@@ -344,6 +345,11 @@ namespace erpc
     size_t rx_burst();
     void post_recvs(size_t num_recvs);
 
+    // RX notifications use the RX queue's interrupt, if the device supports it
+    int get_rx_notify_fd() const { return rx_intr_fd_; }
+    void arm_rx_notify();
+    void ack_rx_notify();
+
     /// Do DPDK initialization for \p phy_port as a primary or secondary DPDK
     /// process type. \p phy_port must not have been already initialized.
     static void setup_phy_port(uint16_t phy_port, size_t numa_node,
@@ -380,6 +386,10 @@ namespace erpc
     uint16_t rx_flow_udp_port_ = 0; ///< The UDP port this transport listens on
     size_t qp_id_ = kInvalidQpId;   ///< The RX/TX queue pair for this Transport
 
+    /// The RX queue's interrupt fd, or -1 if RX interrupts are unavailable.
+    /// Interrupts work only in the DPDK process that set up the port.
+    int rx_intr_fd_ = -1;
+
     // We don't use DPDK's lcore threads, so a shared mempool with per-lcore
     // cache won't work. Instead, we use per-thread pools with zero cached mbufs.
     rte_mempool *mempool_;
@@ -159,6 +159,24 @@ namespace erpc
     return nb_rx_new;
   }
 
+  void DpdkTransport::arm_rx_notify()
+  {
+    if (rx_intr_fd_ < 0)
+      return;
+    int ret = rte_eth_dev_rx_intr_enable(phy_port_, qp_id_);
+    rt_assert(ret == 0, "Failed to enable RX queue interrupt");
+  }
+
+  void DpdkTransport::ack_rx_notify()
+  {
+    // For mlx4/mlx5, disabling the interrupt consumes and acks the pending
+    // completion event, so the fd is not readable until the next arm
+    if (rx_intr_fd_ < 0)
+      return;
+    int ret = rte_eth_dev_rx_intr_disable(phy_port_, qp_id_);
+    _unused(ret); // -EAGAIN if no event is pending
+  }
+
   void DpdkTransport::post_recvs(size_t num_recvs)
   {
     for (size_t i = 0; i < num_recvs; i++)
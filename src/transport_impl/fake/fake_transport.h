@@ -15,6 +15,7 @@ class FakeTransport : public Transport {
  public:
   static constexpr TransportType kTransportType = TransportType::kFake;
   static constexpr size_t kMTU = 1024;
+  static constexpr bool kPortIndependentMemReg = true;
   static constexpr size_t kPostlist = 16;
   static constexpr size_t kUnsigBatch = 64;
   static constexpr size_t kMaxDataPerPkt = (kMTU - sizeof(pkthdr_t));
@@ -1,5 +1,6 @@
 #ifdef ERPC_INFINIBAND
 
+#include <fcntl.h>
 #include <iomanip>
 #include <stdexcept>
 
@@ -59,7 +60,12 @@ IBTransport::~IBTransport() {
   // Destroy QPs and CQs. QPs must be destroyed before CQs.
   exit_assert(ibv_destroy_qp(qp) == 0, "Failed to destroy send QP");
   exit_assert(ibv_destroy_cq(send_cq) == 0, "Failed to destroy send CQ");
+
+  // Destroying a CQ waits for all its events to be acked
+  ack_rx_notify();
   exit_assert(ibv_destroy_cq(recv_cq) == 0, "Failed to destroy recv CQ");
+  exit_assert(ibv_destroy_comp_channel(recv_comp_channel) == 0,
+              "Failed to destroy completion channel");
 
   exit_assert(ibv_destroy_ah(self_ah) == 0, "Failed to destroy self AH");
   for (auto *_ah : ah_to_free_vec) {
@@ -134,7 +140,17 @@ void IBTransport::init_verbs_structs() {
   send_cq = ibv_create_cq(resolve.ib_ctx, kSQDepth, nullptr, nullptr, 0);
   rt_assert(send_cq != nullptr, "Failed to create SEND CQ. Forgot hugepages?");
 
-  recv_cq = ibv_create_cq(resolve.ib_ctx, kRQDepth, nullptr, nullptr, 0);
+  // Creating a completion channel is cheap, and the RECV CQ generates events
+  // only after arm_rx_notify()
+  recv_comp_channel = ibv_create_comp_channel(resolve.ib_ctx);
+  rt_assert(recv_comp_channel != nullptr,
+            "Failed to create completion channel");
+  int flags = fcntl(recv_comp_channel->fd, F_GETFL);
+  rt_assert(fcntl(recv_comp_channel->fd, F_SETFL, flags | O_NONBLOCK) == 0,
+            "Failed to make completion channel non-blocking");
+
+  recv_cq = ibv_create_cq(resolve.ib_ctx, kRQDepth, nullptr, recv_comp_channel,
+                          0);
   rt_assert(recv_cq != nullptr, "Failed to create SEND CQ");
 
   // Initialize QP creation attributes
@@ -100,6 +100,11 @@ class IBTransport : public Transport {
   size_t rx_burst();
   void post_recvs(size_t num_recvs);
 
+  // RX notifications use the RECV CQ's completion channel
+  int get_rx_notify_fd() const { return recv_comp_channel->fd; }
+  void arm_rx_notify();
+  void ack_rx_notify();
+
   /// Get the current SEND signaling flag, and poll the send CQ if we need to
   inline bool get_signaled_flag() {
     // If kUnsigBatch is 4, the sequence of signaling and polling looks like so:
@@ -154,6 +159,10 @@ class IBTransport : public Transport {
 
   struct ibv_pd *pd = nullptr;
   struct ibv_cq *send_cq = nullptr, *recv_cq = nullptr;
+
+  /// Completion channel for RECV CQ events, used only by idle Rpcs. Its fd is
+  /// non-blocking.
+  struct ibv_comp_channel *recv_comp_channel = nullptr;
   struct ibv_qp *qp = nullptr;
 
   /// An address handle for this endpoint's port. Used for tx_flush().
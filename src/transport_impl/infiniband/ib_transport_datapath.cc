@@ -122,6 +122,19 @@ size_t IBTransport::rx_burst() {
   return static_cast<size_t>(ret);
 }
 
+void IBTransport::arm_rx_notify() {
+  int ret = ibv_req_notify_cq(recv_cq, 0);
+  rt_assert(ret == 0, "Failed to arm RECV CQ");
+}
+
+void IBTransport::ack_rx_notify() {
+  struct ibv_cq *ev_cq;
+  void *ev_ctx;
+  while (ibv_get_cq_event(recv_comp_channel, &ev_cq, &ev_ctx) == 0) {
+    ibv_ack_cq_events(ev_cq, 1);
+  }
+}
+
 void IBTransport::post_recvs(size_t num_recvs) {
   assert(!fast_recv_used);        // Not supported yet
   assert(num_recvs <= kRQDepth);  // num_recvs can be 0
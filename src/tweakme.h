@@ -38,5 +38,10 @@ namespace erpc
     /// of the request handler.
     static constexpr bool kZeroCopyRX = true;
 
+    /// Distance in packets at which RX processing prefetches packet headers
+    /// from the RX ring. The session and sslot of a packet are prefetched at
+    /// half this distance. Zero disables RX prefetching.
+    static constexpr size_t kRxPrefetchDist = 4;
+
     static constexpr bool kDatapathStats = false;
 } // namespace erpc
@@ -1,13 +1,12 @@
 #pragma once
 
 #include <assert.h>
-#include <queue>
 #include "common.h"
 
 namespace erpc {
 
 /**
- * @brief A *slow* static-sized queue that supports push and pop. When the queue
+ * @brief A static-sized ring queue that supports push and pop. When the queue
  * is full, old packets are removed in FIFO order.
  *
  * @tparam T The type of elements stored in the queue
@@ -20,31 +19,39 @@ class FixedQueue {
   ~FixedQueue() {}
 
   inline void push(T t) {
-    if (queue_.size() == N) queue_.pop();
-    queue_.push(t);
+    if (size_ == N) pop_front();
+    arr_[(head_ + size_) % N] = t;
+    size_++;
   }
 
   inline T pop() {
-    rt_assert(queue_.size() != 0, "Cannot pop empty queue");
-    T ret = queue_.front();
-    queue_.pop();
+    rt_assert(size_ != 0, "Cannot pop empty queue");
+    T ret = arr_[head_];
+    pop_front();
     return ret;
   }
 
   /// Clear the queue
   inline void clear() {
-    std::queue<T> empty;
-    std::swap(queue_, empty);
+    head_ = 0;
+    size_ = 0;
   }
 
   /// Return the number of elements currently in the queue
-  inline size_t size() { return queue_.size(); }
+  inline size_t size() { return size_; }
 
   /// Return the maximum capacity of the FixedQueue
   inline size_t capacity() { return N; }
 
  private:
-  std::queue<T> queue_;
+  inline void pop_front() {
+    head_ = (head_ + 1) % N;
+    size_--;
+  }
+
+  T arr_[N];         ///< The ring
+  size_t head_ = 0;  ///< Index of the oldest element
+  size_t size_ = 0;  ///< Number of elements in the queue
 };
 
 }  // namespace erpc
@@ -46,6 +46,17 @@ static constexpr size_t ceil(double num) {
              : static_cast<size_t>(num) + ((num > 0) ? 1 : 0);
 }
 
+/// C++11 constexpr max of one or more values
+template <typename T>
+static constexpr T const_max(T x) {
+  return x;
+}
+
+template <typename T, typename... Ts>
+static constexpr T const_max(T x, T y, Ts... rest) {
+  return const_max(x > y ? x : y, rest...);
+}
+
 /// Compute the standard deviation of a vector
 static double stddev(std::vector<double> v) {
   if (unlikely(v.empty())) return 0;
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 #include "util/barrier.h"
 
@@ -25,6 +26,16 @@ class MtQueue {
     unlock();
   }
 
+  /// Add several elements to the queue with one lock acquisition. Caller need
+  /// not grab the lock.
+  void unlocked_push_batch(const T *t_arr, size_t num_t) {
+    lock();
+    for (size_t i = 0; i < num_t; i++) queue_.push(t_arr[i]);
+    memory_barrier();
+    size_ += num_t;
+    unlock();
+  }
+
   /// Get the first element from the queue. Caller need not grab the lock.
   T unlocked_pop() {
     lock();
@@ -48,4 +59,45 @@ class MtQueue {
   std::mutex lock_;
 };
 
+/// A simple multi-threaded priority queue. Pops return the element that
+/// compares highest under Compare, as in std::priority_queue.
+template <class T, class Compare>
+class MtPriorityQueue {
+ public:
+  MtPriorityQueue() : size_(0) {}
+  std::priority_queue<T, std::vector<T>, Compare> queue_;
+
+  /// Add an element to the queue. Caller need not grab the lock.
+  void unlocked_push(T t) {
+    lock();
+    queue_.push(t);
+    memory_barrier();
+    size_++;
+    unlock();
+  }
+
+  /// Get the highest-priority element from the queue. Caller need not grab the
+  /// lock.
+  T unlocked_pop() {
+    lock();
+    T t = queue_.top();
+    queue_.pop();
+    memory_barrier();
+    size_--;
+    unlock();
+
+    return t;
+  }
+
+ private:
+  void lock() { return lock_.lock(); }
+  void unlock() { return lock_.unlock(); }
+
+ public:
+  volatile size_t size_;
+
+ private:
+  std::mutex lock_;
+};
+
 }  // namespace erpc
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <assert.h>
+#include <vector>
+#include "common.h"
+
+namespace erpc {
+
+/**
+ * @brief A single-threaded FIFO queue on a power-of-two ring buffer. Push and
+ * pop do not allocate memory, except that pushing to a full queue doubles its
+ * capacity. The queue never shrinks, so a queue that absorbed one burst
+ * absorbs the next one without allocating.
+ *
+ * @tparam T The type of elements stored in the queue
+ */
+template <typename T>
+class RingQueue {
+ public:
+  RingQueue() {}
+  ~RingQueue() {}
+
+  /// Preallocate space for at least \p capacity elements
+  void reserve(size_t capacity) {
+    if (capacity > arr_.size()) resize(capacity);
+  }
+
+  inline void push(const T &t) {
+    if (unlikely(size_ == arr_.size())) {
+      resize(size_ * 2);
+      num_grows_++;
+    }
+    arr_[(head_ + size_) & (arr_.size() - 1)] = t;
+    size_++;
+  }
+
+  /// Return the oldest element
+  inline T &front() {
+    assert(size_ > 0);
+    return arr_[head_];
+  }
+
+  /// Remove the oldest element
+  inline void pop() {
+    assert(size_ > 0);
+    head_ = (head_ + 1) & (arr_.size() - 1);
+    size_--;
+  }
+
+  /// Return the number of elements currently in the queue
+  inline size_t size() const { return size_; }
+
+  inline bool empty() const { return size_ == 0; }
+
+  /// Return the number of elements that fit without growing the queue
+  inline size_t capacity() const { return arr_.size(); }
+
+  /// Return the number of times that the queue has grown because it was full
+  inline size_t num_grows() const { return num_grows_; }
+
+ private:
+  /// Move the elements to a new ring with at least \p min_capacity elements
+  void resize(size_t min_capacity) {
+    size_t new_capacity = 1;
+    while (new_capacity < min_capacity) new_capacity *= 2;
+
+    std::vector<T> new_arr(new_capacity);
+    for (size_t i = 0; i < size_; i++) {
+      new_arr[i] = arr_[(head_ + i) & (arr_.size() - 1)];
+    }
+
+    arr_.swap(new_arr);
+    head_ = 0;
+  }
+
+  std::vector<T> arr_;  ///< The ring. Its size is zero or a power of two.
+  size_t head_ = 0;     ///< Index of the oldest element
+  size_t size_ = 0;     ///< Number of elements in the queue
+  size_t num_grows_ = 0;
+};
+
+}  // namespace erpc
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include "common.h"
+
+namespace erpc {
+
+/**
+ * @brief Maps keys to sessions using a consistent-hash ring with virtual nodes
+ * and per-server weights.
+ *
+ * Routing doesn't search the ring. The 64-bit hash space is split into
+ * 2^table_bits equal buckets, and a flat table stores the server that owns
+ * each bucket, i.e., the server of the first virtual node at or after the
+ * bucket's start. route() is one hash, one table load, and one load from the
+ * small server array.
+ *
+ * Membership changes update the ring and the table incrementally: adding or
+ * removing a virtual node rewrites only the buckets in its arc, so a change
+ * costs time proportional to the keys that move, not to the table size. As
+ * with any consistent hash, only keys in the changed arcs change servers.
+ *
+ * This class is not thread-safe. Membership changes are control-path
+ * operations and should be done by the thread that owns the Rpc.
+ */
+class SessionRouter {
+ public:
+  /**
+   * @brief Construct an empty router
+   *
+   * @param vnodes_per_weight The number of virtual nodes on the ring for each
+   * unit of server weight. More virtual nodes give a more even split of keys.
+   *
+   * @param table_bits Log2 of the number of buckets in the lookup table. Each
+   * bucket takes two bytes, so the default table fits in the L2 cache.
+   */
+  explicit SessionRouter(size_t vnodes_per_weight = 100, size_t table_bits = 16)
+      : vnodes_per_weight_(vnodes_per_weight),
+        table_shift_(64 - table_bits),
+        table_(1ull << table_bits, uint16_t{kInvalidIdx}) {
+    rt_assert(vnodes_per_weight > 0, "Invalid vnodes per weight");
+    rt_assert(table_bits >= 1 && table_bits <= 24, "Invalid table bits");
+  }
+
+  /**
+   * @brief Add a server to the ring
+   *
+   * @param server_id A stable identifier for the server, e.g., its index in
+   * the app's server list. Virtual node positions depend only on the ID and
+   * the weight, so all clients with the same membership route identically.
+   *
+   * @param session_num The session to the server
+   * @param weight The server's share of keys relative to other servers
+   */
+  void add_server(size_t server_id, int session_num, size_t weight = 1) {
+    rt_assert(id_to_idx_.count(server_id) == 0, "Server already added");
+    rt_assert(weight > 0, "Server weight must be positive");
+
+    uint16_t idx;
+    if (!free_idx_.empty()) {
+      idx = free_idx_.back();
+      free_idx_.pop_back();
+    } else {
+      rt_assert(servers_.size() < kInvalidIdx, "Too many servers");
+      idx = static_cast<uint16_t>(servers_.size());
+      servers_.emplace_back();
+    }
+
+    servers_[idx].server_id_ = server_id;
+    servers_[idx].session_num_ = session_num;
+    servers_[idx].weight_ = 0;
+    id_to_idx_[server_id] = idx;
+    num_servers_++;
+
+    add_vnodes(idx, 0, weight * vnodes_per_weight_);
+    servers_[idx].weight_ = weight;
+  }
+
+  /// Remove a server from the ring. Its keys move to the remaining servers.
+  void remove_server(size_t server_id) {
+    const uint16_t idx = get_idx(server_id);
+    remove_vnodes(idx, 0);
+
+    id_to_idx_.erase(server_id);
+    servers_[idx].session_num_ = -1;
+    free_idx_.push_back(idx);
+    num_servers_--;
+  }
+
+  /// Change a server's weight. Only the keys in the added or removed virtual
+  /// nodes move.
+  void set_weight(size_t server_id, size_t weight) {
+    rt_assert(weight > 0, "Server weight must be positive");
+    const uint16_t idx = get_idx(server_id);
+    const size_t old_vnodes = servers_[idx].weight_ * vnodes_per_weight_;
+    const size_t new_vnodes = weight * vnodes_per_weight_;
+
+    if (new_vnodes > old_vnodes) add_vnodes(idx, old_vnodes, new_vnodes);
+    if (new_vnodes < old_vnodes) remove_vnodes(idx, new_vnodes);
+    servers_[idx].weight_ = weight;
+  }
+
+  /// Change the session used for a server, e.g., after reconnecting. No keys
+  /// move.
+  void set_session_num(size_t server_id, int session_num) {
+    servers_[get_idx(server_id)].session_num_ = session_num;
+  }
+
+  /// Return the session for a key. The router must have at least one server.
+  inline int route(uint64_t key) const { return route_hash(hash(key)); }
+
+  /// Return the session for a key that the caller has already hashed well,
+  /// e.g., with a hash also used for the server-side index
+  inline int route_hash(uint64_t key_hash) const {
+    assert(num_servers_ > 0);
+    return servers_[table_[key_hash >> table_shift_]].session_num_;
+  }
+
+  /// Return the ID of the server that owns a key
+  inline size_t route_server_id(uint64_t key) const {
+    assert(num_servers_ > 0);
+    return servers_[table_[hash(key) >> table_shift_]].server_id_;
+  }
+
+  /// Return the number of servers on the ring
+  inline size_t num_servers() const { return num_servers_; }
+
+  /// Return the number of virtual nodes on the ring
+  inline size_t num_vnodes() const { return ring_.size(); }
+
+  /// Return the number of buckets in the lookup table
+  inline size_t table_size() const { return table_.size(); }
+
+  /// The 64-bit finalizer from MurmurHash3. Keys are often small integers,
+  /// so they must be mixed before picking a bucket.
+  static inline uint64_t hash(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+  }
+
+ private:
+  static constexpr uint16_t kInvalidIdx = UINT16_MAX;
+
+  /// A virtual node on the ring. The ring is sorted by (pos_, server_idx_).
+  struct vnode_t {
+    uint64_t pos_;
+    uint16_t server_idx_;
+
+    bool operator<(const vnode_t &o) const {
+      return pos_ != o.pos_ ? pos_ < o.pos_ : server_idx_ < o.server_idx_;
+    }
+  };
+
+  struct server_t {
+    size_t server_id_;
+    int session_num_;
+    size_t weight_;
+  };
+
+  /// Return the ring position of the virtual node vnode_i of a server
+  static inline uint64_t vnode_pos(size_t server_id, size_t vnode_i) {
+    return hash(hash(server_id) ^ (vnode_i * 0x9e3779b97f4a7c15ull));
+  }
+
+  uint16_t get_idx(size_t server_id) const {
+    auto it = id_to_idx_.find(server_id);
+    rt_assert(it != id_to_idx_.end(), "Server not found");
+    return it->second;
+  }
+
+  /// Return the index in ring_ of the first virtual node at or after pos,
+  /// wrapping around to the first virtual node
+  size_t successor(uint64_t pos) const {
+    auto it = std::lower_bound(ring_.begin(), ring_.end(), vnode_t{pos, 0});
+    return it == ring_.end() ? 0 : static_cast<size_t>(it - ring_.begin());
+  }
+
+  /**
+   * @brief Assign the buckets whose start lies in the ring arc (lo, hi] to a
+   * server. If lo >= hi, the arc wraps around zero, and lo == hi is the full
+   * ring.
+   */
+  void assign_arc(uint64_t lo, uint64_t hi, uint16_t server_idx) {
+    // Bucket b starts at (b << table_shift_). The first bucket starting after
+    // lo is (lo >> table_shift_) + 1, which may be past the table's end.
+    const size_t first = (lo >> table_shift_) + 1;
+    const size_t last = hi >> table_shift_;
+
+    if (lo < hi) {
+      for (size_t b = first; b <= last; b++) table_[b] = server_idx;
+    } else {
+      for (size_t b = first; b < table_.size(); b++) table_[b] = server_idx;
+      for (size_t b = 0; b <= last; b++) table_[b] = server_idx;
+    }
+  }
+
+  /// Add virtual nodes [from, to) of a server, and give their arcs to it
+  void add_vnodes(uint16_t idx, size_t from, size_t to) {
+    std::vector<vnode_t> added;
+    added.reserve(to - from);
+    for (size_t i = from; i < to; i++) {
+      added.push_back(vnode_t{vnode_pos(servers_[idx].server_id_, i), idx});
+    }
+    std::sort(added.begin(), added.end());
+
+    // Merge instead of re-sorting the whole ring
+    const size_t old_size = ring_.size();
+    ring_.insert(ring_.end(), added.begin(), added.end());
+    std::inplace_merge(ring_.begin(),
+                       ring_.begin() + static_cast<ssize_t>(old_size),
+                       ring_.end());
+
+    // A new virtual node owns the arc from its predecessor to itself. If its
+    // predecessor is also new, the arc goes to the same server anyway.
+    for (const vnode_t &v : added) {
+      const size_t i = successor(v.pos_);
+      const size_t pred = (i == 0 ? ring_.size() : i) - 1;
+      assign_arc(ring_[pred].pos_, v.pos_, idx);
+    }
+  }
+
+  /// Remove the virtual nodes of a server with index from or higher, and give
+  /// their arcs to the virtual nodes that now follow them
+  void remove_vnodes(uint16_t idx, size_t from) {
+    std::vector<uint64_t> removed;
+    const size_t to = servers_[idx].weight_ * vnodes_per_weight_;
+    for (size_t i = from; i < to; i++) {
+      removed.push_back(vnode_pos(servers_[idx].server_id_, i));
+    }
+    std::sort(removed.begin(), removed.end());
+
+    // Record each removed node's arc before erasing. The predecessor may be
+    // removed too, in which case the arcs are handled in sequence.
+    std::vector<uint64_t> arc_lo(removed.size());
+    for (size_t j = 0; j < removed.size(); j++) {
+      const size_t i = successor(removed[j]);
+      arc_lo[j] = ring_[(i == 0 ? ring_.size() : i) - 1].pos_;
+    }
+
+    ring_.erase(std::remove_if(ring_.begin(), ring_.end(),
+                               [idx, &removed](const vnode_t &v) {
+                                 return v.server_idx_ == idx &&
+                                        std::binary_search(removed.begin(),
+                                                           removed.end(),
+                                                           v.pos_);
+                               }),
+                ring_.end());
+
+    if (ring_.empty()) {
+      std::fill(table_.begin(), table_.end(), uint16_t{kInvalidIdx});
+      return;
+    }
+
+    for (size_t j = 0; j < removed.size(); j++) {
+      const uint16_t new_owner = ring_[successor(removed[j])].server_idx_;
+      assign_arc(arc_lo[j], removed[j], new_owner);
+    }
+  }
+
+  const size_t vnodes_per_weight_;
+  const size_t table_shift_;  ///< Right-shift to get a hash's bucket
+
+  std::vector<uint16_t> table_;  ///< Server index for each hash bucket
+  std::vector<server_t> servers_;
+  std::vector<vnode_t> ring_;  ///< Sorted virtual nodes
+
+  std::unordered_map<size_t, uint16_t> id_to_idx_;
+  std::vector<uint16_t> free_idx_;  ///< Indices in servers_ of removed servers
+  size_t num_servers_ = 0;
+};
+
+}  // namespace erpc
@@ -0,0 +1,171 @@
+/**
+ * @file at_most_once_test.cc
+ * @brief Test at-most-once request types. The client sends each request on two
+ * sessions to the same server Rpc, like a retry after a session reset, and
+ * checks that the server executes it once and sends the same response to all
+ * copies.
+ */
+#include "client_tests.h"
+
+static constexpr size_t kTestNumReqs = 40;
+static constexpr size_t kTestAmoMaxEntries = 1000;
+
+/// Number of times the server has executed a request handler
+std::atomic<size_t> num_executions;
+
+/// Extended context for client
+class AppContext : public BasicAppContext {
+ public:
+  FastRand fast_rand_;
+};
+
+///
+/// Server-side code
+///
+
+/// Respond with the request followed by an execution number, so that
+/// re-executed requests get different responses
+void req_handler(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  const MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  const size_t req_size = req_msgbuf->get_data_size();
+  const size_t exec_num = num_executions++;
+
+  // Slow background handlers let duplicates arrive during execution
+  if (c->rpc_->in_background()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // eRPC will free dyn_resp_msgbuf
+  req_handle->dyn_resp_msgbuf_ =
+      c->rpc_->alloc_msg_buffer_or_die(req_size + sizeof(size_t));
+  memcpy(req_handle->dyn_resp_msgbuf_.buf_, req_msgbuf->buf_, req_size);
+  memcpy(&req_handle->dyn_resp_msgbuf_.buf_[req_size], &exec_num,
+         sizeof(size_t));
+
+  c->rpc_->enqueue_response(req_handle, &req_handle->dyn_resp_msgbuf_);
+}
+
+///
+/// Client-side code
+///
+void cont_func(void *_c, void *) {
+  auto *c = static_cast<AppContext *>(_c);
+  assert(c->is_client_);
+  c->num_rpc_resps_++;
+}
+
+/// Send request i on a session, into response MsgBuffer (3 * i + copy)
+void send_copy(AppContext &c, int session_num, size_t i, size_t copy) {
+  c.rpc_->enqueue_request(session_num, kTestReqType, &c.req_msgbufs_[i],
+                          &c.resp_msgbufs_[3 * i + copy], cont_func, nullptr);
+}
+
+void client_thread(Nexus *nexus, size_t num_sessions) {
+  // Create the Rpc and connect the session, and a second session to the same
+  // server Rpc on which requests are retried
+  AppContext c;
+  client_connect_sessions(nexus, c, num_sessions, basic_sm_handler);
+  Rpc<CTransport> *rpc = c.rpc_;
+
+  int retry_session_num =
+      rpc->create_session("127.0.0.1:31850", kTestServerRpcId);
+  ASSERT_GE(retry_session_num, 0);
+  wait_for_sm_resps_or_timeout(c, 2);
+  ASSERT_EQ(c.num_sm_resps_, 2);
+
+  // Create requests with unique sequence numbers
+  c.req_msgbufs_.resize(kTestNumReqs);
+  c.resp_msgbufs_.resize(3 * kTestNumReqs);
+  for (size_t i = 0; i < kTestNumReqs; i++) {
+    const size_t req_size = (std::min)(
+        get_rand_msg_size(&c.fast_rand_, rpc, sizeof(amo_hdr_t)),
+        rpc->get_max_msg_size() - sizeof(size_t));
+
+    c.req_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(req_size);
+    for (size_t j = 0; j < req_size; j++) {
+      c.req_msgbufs_[i].buf_[j] = static_cast<uint8_t>(i + j);
+    }
+
+    amo_hdr_t amo_hdr;
+    amo_hdr.client_id_ = rpc->get_amo_client_id();
+    amo_hdr.seq_ = i;
+    memcpy(c.req_msgbufs_[i].buf_, &amo_hdr, sizeof(amo_hdr_t));
+
+    for (size_t copy = 0; copy < 3; copy++) {
+      c.resp_msgbufs_[3 * i + copy] =
+          rpc->alloc_msg_buffer_or_die(req_size + sizeof(size_t));
+    }
+  }
+
+  // Send each request on both sessions at once. The second copy may arrive
+  // while the first is executing, or after its response is saved.
+  for (size_t i = 0; i < kTestNumReqs; i++) {
+    send_copy(c, c.session_num_arr_[0], i, 0);
+    send_copy(c, retry_session_num, i, 1);
+  }
+  wait_for_rpc_resps_or_timeout(c, 2 * kTestNumReqs);
+  ASSERT_EQ(c.num_rpc_resps_, 2 * kTestNumReqs);
+
+  // Retry each request after its response is saved
+  for (size_t i = 0; i < kTestNumReqs; i++) {
+    send_copy(c, retry_session_num, i, 2);
+  }
+  wait_for_rpc_resps_or_timeout(c, 3 * kTestNumReqs);
+  ASSERT_EQ(c.num_rpc_resps_, 3 * kTestNumReqs);
+
+  ASSERT_EQ(num_executions, kTestNumReqs);
+  for (size_t i = 0; i < kTestNumReqs; i++) {
+    const MsgBuffer &resp_0 = c.resp_msgbufs_[3 * i];
+    const size_t req_size = c.req_msgbufs_[i].get_data_size();
+    ASSERT_EQ(resp_0.get_data_size(), req_size + sizeof(size_t));
+    ASSERT_EQ(memcmp(resp_0.buf_, c.req_msgbufs_[i].buf_, req_size), 0);
+
+    for (size_t copy = 1; copy < 3; copy++) {
+      const MsgBuffer &resp = c.resp_msgbufs_[3 * i + copy];
+      ASSERT_EQ(resp.get_data_size(), resp_0.get_data_size());
+      ASSERT_EQ(memcmp(resp.buf_, resp_0.buf_, resp.get_data_size()), 0);
+    }
+  }
+
+  for (auto &mb : c.req_msgbufs_) rpc->free_msg_buffer(mb);
+  for (auto &mb : c.resp_msgbufs_) rpc->free_msg_buffer(mb);
+
+  // Disconnect the sessions
+  c.num_sm_resps_ = 0;
+  rpc->destroy_session(c.session_num_arr_[0]);
+  rpc->destroy_session(retry_session_num);
+  wait_for_sm_resps_or_timeout(c, 2);
+  assert(rpc->num_active_sessions() == 0);
+
+  // Free resources
+  delete rpc;
+  client_done = true;
+}
+
+TEST(AtMostOnce, Foreground) {
+  num_executions = 0;
+  auto reg_info_vec = {ReqFuncRegInfo(kTestReqType, req_handler,
+                                      ReqFuncType::kForeground,
+                                      kTestAmoMaxEntries)};
+
+  // 1 client session (=> 1 server thread), 0 background threads
+  launch_server_client_threads(1, 0, client_thread, reg_info_vec,
+                               ConnectServers::kFalse, 0.0);
+}
+
+TEST(AtMostOnce, Background) {
+  num_executions = 0;
+  auto reg_info_vec = {ReqFuncRegInfo(kTestReqType, req_handler,
+                                      ReqFuncType::kBackground,
+                                      kTestAmoMaxEntries)};
+
+  // 1 client session (=> 1 server thread), 2 background threads
+  launch_server_client_threads(1, 2, client_thread, reg_info_vec,
+                               ConnectServers::kFalse, 0.0);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -53,11 +53,25 @@ class ReqFuncRegInfo {
   const erpc_req_func_t req_func_;
   const ReqFuncType req_func_type_;
 
+  /// If non-zero, the request type is at-most-once with this many entries
+  const size_t amo_max_entries_;
+
+  /// If non-zero, the request type has a response cache with this many entries
+  const size_t resp_cache_max_entries_;
+
+  /// True iff background requests of this type are deadline-scheduled
+  const bool deadline_sched_;
+
   ReqFuncRegInfo(uint8_t req_type, erpc_req_func_t req_func,
-                 ReqFuncType req_func_type)
+                 ReqFuncType req_func_type, size_t amo_max_entries = 0,
+                 size_t resp_cache_max_entries = 0,
+                 bool deadline_sched = false)
       : req_type_(req_type),
         req_func_(req_func),
-        req_func_type_(req_func_type) {}
+        req_func_type_(req_func_type),
+        amo_max_entries_(amo_max_entries),
+        resp_cache_max_entries_(resp_cache_max_entries),
+        deadline_sched_(deadline_sched) {}
 };
 
 enum class ConnectServers : bool { kTrue, kFalse };
@@ -247,6 +261,15 @@ void launch_server_client_threads(
   for (ReqFuncRegInfo &info : req_func_reg_info_vec) {
     nexus.register_req_func(info.req_type_, info.req_func_,
                             info.req_func_type_);
+    if (info.amo_max_entries_ > 0) {
+      nexus.enable_at_most_once(info.req_type_, info.amo_max_entries_,
+                                kTestMaxEventLoopMs);
+    }
+    if (info.resp_cache_max_entries_ > 0) {
+      nexus.enable_resp_cache(info.req_type_, info.resp_cache_max_entries_,
+                              kTestMaxEventLoopMs);
+    }
+    if (info.deadline_sched_) nexus.enable_deadline_sched(info.req_type_);
   }
 
   num_servers_up = 0;
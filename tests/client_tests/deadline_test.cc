@@ -0,0 +1,162 @@
+/**
+ * @file deadline_test.cc
+ * @brief Test deadline-scheduled background request types. The server runs
+ * queued requests in order of deadline, ahead of other background work, and
+ * sheds requests whose deadline has passed with an empty response.
+ */
+#include "client_tests.h"
+
+static constexpr size_t kTestNumReqs = 6;
+static constexpr size_t kTestBlockerMs = 20;  // Execution time of the blocker
+static constexpr size_t kTestLongDeadlineUs = 10 * 1000 * 1000;
+
+/// Request type for deadline-scheduled requests
+static constexpr uint8_t kTestReqTypeEdf = kTestReqType;
+
+/// Request type for a slow request that keeps the background thread busy
+static constexpr uint8_t kTestReqTypeBlocker = kTestReqType + 1;
+
+/// The request indices in the order that the server executed them
+std::vector<size_t> exec_order;
+
+///
+/// Server-side code
+///
+
+/// Record the request index following the deadline header
+void req_handler_edf(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  const MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  exec_order.push_back(req_msgbuf->buf_[sizeof(deadline_hdr_t)]);
+
+  Rpc<CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_, 1);
+  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+}
+
+void req_handler_blocker(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  std::this_thread::sleep_for(std::chrono::milliseconds(kTestBlockerMs));
+
+  Rpc<CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_, 1);
+  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+}
+
+///
+/// Client-side code
+///
+void cont_func(void *_c, void *) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  assert(c->is_client_);
+  c->num_rpc_resps_++;
+}
+
+/// Fill request i with a deadline header and the request index
+void init_req(BasicAppContext &c, size_t i, size_t deadline_us) {
+  deadline_hdr_t deadline_hdr;
+  deadline_hdr.deadline_us_ = deadline_us;
+  memcpy(c.req_msgbufs_[i].buf_, &deadline_hdr, sizeof(deadline_hdr_t));
+  c.req_msgbufs_[i].buf_[sizeof(deadline_hdr_t)] = static_cast<uint8_t>(i);
+}
+
+void client_thread(Nexus *nexus, size_t num_sessions) {
+  // Create the Rpc and connect the session
+  BasicAppContext c;
+  client_connect_sessions(nexus, c, num_sessions, basic_sm_handler);
+  Rpc<CTransport> *rpc = c.rpc_;
+  const int session_num = c.session_num_arr_[0];
+
+  c.req_msgbufs_.resize(kTestNumReqs + 1);
+  c.resp_msgbufs_.resize(kTestNumReqs + 1);
+  for (size_t i = 0; i <= kTestNumReqs; i++) {
+    c.req_msgbufs_[i] =
+        rpc->alloc_msg_buffer_or_die(sizeof(deadline_hdr_t) + 1);
+    c.resp_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(1);
+  }
+
+  // Requests with a zero deadline are shed
+  for (size_t i = 0; i < kTestNumReqs; i++) {
+    init_req(c, i, 0);
+    rpc->enqueue_request(session_num, kTestReqTypeEdf, &c.req_msgbufs_[i],
+                         &c.resp_msgbufs_[i], cont_func, nullptr);
+  }
+  wait_for_rpc_resps_or_timeout(c, kTestNumReqs);
+  ASSERT_EQ(c.num_rpc_resps_, kTestNumReqs);
+  for (size_t i = 0; i < kTestNumReqs; i++) {
+    ASSERT_EQ(c.resp_msgbufs_[i].get_data_size(), 0);
+  }
+  ASSERT_TRUE(exec_order.empty());
+
+  // Keep the background thread busy with a blocker while requests with
+  // decreasing deadlines queue up. They run in order of deadline.
+  c.num_rpc_resps_ = 0;
+  rpc->enqueue_request(session_num, kTestReqTypeBlocker,
+                       &c.req_msgbufs_[kTestNumReqs],
+                       &c.resp_msgbufs_[kTestNumReqs], cont_func, nullptr);
+  rpc->run_event_loop(kTestBlockerMs / 4);  // Let the blocker start running
+
+  for (size_t i = 0; i < kTestNumReqs; i++) {
+    init_req(c, i, kTestLongDeadlineUs - i);
+    rpc->enqueue_request(session_num, kTestReqTypeEdf, &c.req_msgbufs_[i],
+                         &c.resp_msgbufs_[i], cont_func, nullptr);
+  }
+  wait_for_rpc_resps_or_timeout(c, kTestNumReqs + 1);
+  ASSERT_EQ(c.num_rpc_resps_, kTestNumReqs + 1);
+
+  ASSERT_EQ(exec_order.size(), kTestNumReqs);
+  for (size_t i = 0; i < kTestNumReqs; i++) {
+    ASSERT_EQ(c.resp_msgbufs_[i].get_data_size(), 1);
+    ASSERT_EQ(exec_order[i], kTestNumReqs - 1 - i);
+  }
+
+  for (auto &mb : c.req_msgbufs_) rpc->free_msg_buffer(mb);
+  for (auto &mb : c.resp_msgbufs_) rpc->free_msg_buffer(mb);
+
+  // Disconnect the session
+  c.num_sm_resps_ = 0;
+  rpc->destroy_session(session_num);
+  wait_for_sm_resps_or_timeout(c, 1);
+  assert(rpc->num_active_sessions() == 0);
+
+  // Free resources
+  delete rpc;
+  client_done = true;
+}
+
+TEST(Deadline, Base) {
+  exec_order.clear();
+
+  auto reg_info_vec = {
+      ReqFuncRegInfo(kTestReqTypeEdf, req_handler_edf,
+                     ReqFuncType::kBackground, 0, 0, true),
+      ReqFuncRegInfo(kTestReqTypeBlocker, req_handler_blocker,
+                     ReqFuncType::kBackground)};
+
+  // 1 client session (=> 1 server thread), 1 background thread
+  launch_server_client_threads(1, 1, client_thread, reg_info_vec,
+                               ConnectServers::kFalse, 0.0);
+}
+
+// Shedding would save an empty response for at-most-once or cached requests,
+// so deadline scheduling excludes them in either order of enabling
+TEST(Deadline, SavedRespsRejected) {
+  Nexus nexus("127.0.0.1:31850", kTestNumaNode, 1);
+  ASSERT_EQ(nexus.register_req_func(kTestReqTypeEdf, req_handler_edf,
+                                    ReqFuncType::kBackground),
+            0);
+  ASSERT_EQ(nexus.register_req_func(kTestReqTypeBlocker, req_handler_blocker,
+                                    ReqFuncType::kBackground),
+            0);
+
+  ASSERT_EQ(nexus.enable_at_most_once(kTestReqTypeEdf, 16, 1000), 0);
+  ASSERT_EQ(nexus.enable_deadline_sched(kTestReqTypeEdf), -EINVAL);
+
+  ASSERT_EQ(nexus.enable_deadline_sched(kTestReqTypeBlocker), 0);
+  ASSERT_EQ(nexus.enable_resp_cache(kTestReqTypeBlocker, 16, 1000), -EINVAL);
+  ASSERT_EQ(nexus.enable_at_most_once(kTestReqTypeBlocker, 16, 1000),
+            -EINVAL);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,205 @@
+/**
+ * @file forward_request_test.cc
+ * @brief Test Rpc::forward_request(). This uses a primary-backup setup, where
+ * the client sends requests to the primary, which forwards them to a backup.
+ * The backup's response is relayed to the client as the primary's response.
+ */
+#include "client_tests.h"
+
+// Set to true if the request handler at the primary or backup should run in
+// the background.
+bool primary_bg, backup_bg;
+
+static constexpr uint8_t kTestDataByte = 10;
+static constexpr size_t kTestNumReqs = kSessionReqWindow + 1;
+static_assert(kTestNumReqs > kSessionReqWindow, "");
+
+/// Request type used for client to primary
+static constexpr uint8_t kTestReqTypeCP = kTestReqType + 1;
+
+/// Request type used for primary to backup
+static constexpr uint8_t kTestReqTypePB = kTestReqType + 2;
+
+/// Extended context for client
+class AppContext : public BasicAppContext {
+ public:
+  FastRand fast_rand_;
+  size_t num_reqs_sent_ = 0;
+  std::vector<size_t> req_size_vec_;  ///< Request size for each MsgBuffer
+};
+
+///
+/// Server-side code
+///
+
+/// The primary's request handler for client-to-primary requests. Forwards the
+/// received request to the backup.
+void req_handler_cp(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  assert(!c->is_client_);
+  ASSERT_EQ(c->rpc_->in_background(), primary_bg);
+
+  test_printf("Primary [Rpc %u]: Forwarding request of length %zu\n",
+              c->rpc_->get_rpc_id(),
+              req_handle->get_req_msgbuf()->get_data_size());
+
+  // Backup is server thread #1
+  c->rpc_->forward_request(req_handle, c->session_num_arr_[1], kTestReqTypePB);
+}
+
+/// The backup's request handler for primary-to-backup requests. Responds with
+/// the received request + 1.
+void req_handler_pb(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  assert(!c->is_client_);
+  ASSERT_EQ(c->rpc_->in_background(), backup_bg);
+
+  const MsgBuffer *req_msgbuf_pb = req_handle->get_req_msgbuf();
+  size_t req_size = req_msgbuf_pb->get_data_size();
+
+  test_printf("Backup [Rpc %u]: Received request of length %zu.\n",
+              c->rpc_->get_rpc_id(), req_size);
+
+  // eRPC will free dyn_resp_msgbuf
+  req_handle->dyn_resp_msgbuf_ = c->rpc_->alloc_msg_buffer_or_die(req_size);
+  for (size_t i = 0; i < req_size; i++) {
+    req_handle->dyn_resp_msgbuf_.buf_[i] = req_msgbuf_pb->buf_[i] + 1;
+  }
+
+  c->rpc_->enqueue_response(req_handle, &req_handle->dyn_resp_msgbuf_);
+}
+
+///
+/// Client-side code
+///
+void client_cont_func(void *, void *);  // Forward declaration
+
+/// Enqueue a request to server 0 using the request MsgBuffer index msgbuf_i
+void client_request_helper(AppContext *c, size_t msgbuf_i) {
+  assert(msgbuf_i < kSessionReqWindow);
+
+  size_t req_size = get_rand_msg_size(&c->fast_rand_, c->rpc_);
+  c->rpc_->resize_msg_buffer(&c->req_msgbufs_[msgbuf_i], req_size);
+  c->req_size_vec_[msgbuf_i] = req_size;
+
+  for (size_t i = 0; i < req_size; i++) {
+    c->req_msgbufs_[msgbuf_i].buf_[i] = kTestDataByte;
+  }
+
+  test_printf("Client [Rpc %u]: Sending request %zu of size %zu\n",
+              c->rpc_->get_rpc_id(), c->num_reqs_sent_, req_size);
+
+  c->rpc_->enqueue_request(c->session_num_arr_[0], kTestReqTypeCP,
+                           &c->req_msgbufs_[msgbuf_i],
+                           &c->resp_msgbufs_[msgbuf_i], client_cont_func,
+                           reinterpret_cast<void *>(msgbuf_i));
+
+  c->num_reqs_sent_++;
+}
+
+void client_cont_func(void *_c, void *_tag) {
+  auto *c = static_cast<AppContext *>(_c);
+  assert(c->is_client_);
+  size_t msgbuf_i = reinterpret_cast<size_t>(_tag);
+
+  const MsgBuffer &resp_msgbuf = c->resp_msgbufs_[msgbuf_i];
+  test_printf("Client [Rpc %u]: Received response of length %zu.\n",
+              c->rpc_->get_rpc_id(), resp_msgbuf.get_data_size());
+
+  // The primary relays the backup's response unmodified
+  ASSERT_EQ(resp_msgbuf.get_data_size(), c->req_size_vec_[msgbuf_i]);
+  for (size_t i = 0; i < resp_msgbuf.get_data_size(); i++) {
+    ASSERT_EQ(resp_msgbuf.buf_[i], kTestDataByte + 1);
+  }
+
+  c->num_rpc_resps_++;
+
+  if (c->num_reqs_sent_ < kTestNumReqs) {
+    client_request_helper(c, msgbuf_i);
+  }
+}
+
+void client_thread(Nexus *nexus, size_t num_sessions) {
+  // Create the Rpc and connect the sessions
+  AppContext c;
+  client_connect_sessions(nexus, c, num_sessions, basic_sm_handler);
+
+  Rpc<CTransport> *rpc = c.rpc_;
+
+  // Start by filling the request window
+  c.req_msgbufs_.resize(erpc::kSessionReqWindow);
+  c.resp_msgbufs_.resize(erpc::kSessionReqWindow);
+  c.req_size_vec_.resize(erpc::kSessionReqWindow);
+  for (size_t i = 0; i < erpc::kSessionReqWindow; i++) {
+    const size_t sz = rpc->get_max_msg_size();
+    c.req_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(sz);
+    c.resp_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(sz);
+
+    client_request_helper(&c, i);
+  }
+
+  wait_for_rpc_resps_or_timeout(c, kTestNumReqs);
+  assert(c.num_rpc_resps_ == kTestNumReqs);
+
+  for (auto &mb : c.req_msgbufs_) rpc->free_msg_buffer(mb);
+  for (auto &mb : c.resp_msgbufs_) rpc->free_msg_buffer(mb);
+
+  // Disconnect the sessions
+  c.num_sm_resps_ = 0;
+  for (size_t i = 0; i < num_sessions; i++) {
+    rpc->destroy_session(c.session_num_arr_[i]);
+  }
+  wait_for_sm_resps_or_timeout(c, num_sessions);
+  assert(rpc->num_active_sessions() == 0);
+
+  // Free resources
+  delete rpc;
+  client_done = true;
+}
+
+/// 1 primary, 1 backup, both in foreground
+TEST(Base, BothInForeground) {
+  primary_bg = false;
+  backup_bg = false;
+
+  auto reg_info_vec = {
+      ReqFuncRegInfo(kTestReqTypeCP, req_handler_cp, ReqFuncType::kForeground),
+      ReqFuncRegInfo(kTestReqTypePB, req_handler_pb, ReqFuncType::kForeground)};
+
+  // 2 client sessions (=> 2 server threads), 0 background threads
+  launch_server_client_threads(2, 0, client_thread, reg_info_vec,
+                               ConnectServers::kTrue, 0.0);
+}
+
+/// 1 primary, 1 backup, primary in background
+TEST(Base, PrimaryInBackground) {
+  primary_bg = true;
+  backup_bg = false;
+
+  auto reg_info_vec = {
+      ReqFuncRegInfo(kTestReqTypeCP, req_handler_cp, ReqFuncType::kBackground),
+      ReqFuncRegInfo(kTestReqTypePB, req_handler_pb, ReqFuncType::kForeground)};
+
+  // 2 client sessions (=> 2 server threads), 1 background thread
+  launch_server_client_threads(2, 1, client_thread, reg_info_vec,
+                               ConnectServers::kTrue, 0.0);
+}
+
+/// 1 primary, 1 backup, both in background
+TEST(Base, BothInBackground) {
+  primary_bg = true;
+  backup_bg = true;
+
+  auto reg_info_vec = {
+      ReqFuncRegInfo(kTestReqTypeCP, req_handler_cp, ReqFuncType::kBackground),
+      ReqFuncRegInfo(kTestReqTypePB, req_handler_pb, ReqFuncType::kBackground)};
+
+  // 2 client sessions (=> 2 server threads), 3 background threads
+  launch_server_client_threads(2, 3, client_thread, reg_info_vec,
+                               ConnectServers::kTrue, 0.0);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
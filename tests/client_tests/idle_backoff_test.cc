@@ -0,0 +1,165 @@
+/**
+ * @file idle_backoff_test.cc
+ * @brief Test idle backoff. An idle server Rpc blocks, and received packets,
+ * session management packets, and responses enqueued by background threads
+ * wake it up well before the blocking timeout.
+ */
+
+// private <- public breaks gtest, so include it first. This overrides the
+// gtest.h include in client_tests.h
+#include <gtest/gtest.h>
+#define private public
+
+#include "client_tests.h"
+
+static constexpr size_t kTestIdleIters = 10;
+static constexpr size_t kTestMaxBlockUs = 5 * 1000 * 1000;  // 5 seconds
+static constexpr size_t kTestIdleMs = 50;  // Time for the server to block
+
+/// A request that wakes up the server completes well before a blocking wait
+/// would time out
+static constexpr double kTestMaxLatencyMs = kTestMaxBlockUs / 1000.0 / 5;
+
+/// Execution time of background requests. This is shorter than the client's
+/// retransmission timeout, so the response, not a retransmitted request
+/// packet, must wake up the server.
+static constexpr size_t kTestBgWorkUs = kRpcRTOUs / 5;
+
+static constexpr uint8_t kTestReqTypeFg = kTestReqType;
+static constexpr uint8_t kTestReqTypeBg = kTestReqType + 1;
+
+Rpc<CTransport> *server_rpc;  ///< Valid until the client's final wakeup
+bool server_has_rx_notify;    ///< True iff the server's transport notifies RX
+std::atomic<bool> client_wakeup_sent;
+
+/// The server's idle stats after its event loop ends
+size_t server_num_blocks, server_num_wakeups;
+
+///
+/// Server-side code
+///
+void req_handler_fg(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  Rpc<CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_, 1);
+  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+}
+
+/// The foreground thread blocks while this runs
+void req_handler_bg(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  std::this_thread::sleep_for(std::chrono::microseconds(kTestBgWorkUs));
+
+  Rpc<CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_, 1);
+  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+}
+
+void server_thread_func(Nexus *nexus) {
+  BasicAppContext c;
+  c.is_client_ = false;
+
+  Rpc<CTransport> rpc(nexus, static_cast<void *>(&c), kTestServerRpcId,
+                      basic_empty_sm_handler, kTestServerPhyPort);
+  rpc.set_idle_backoff(kTestIdleIters, kTestMaxBlockUs);
+  c.rpc_ = &rpc;
+
+  server_has_rx_notify = rpc.transport_->get_rx_notify_fd() >= 0;
+  server_rpc = &rpc;
+  all_servers_ready = true;
+
+  // A blocking wait here ends only on an event, or after kTestMaxBlockUs
+  while (!client_done) rpc.run_event_loop_once();
+
+  // The client still uses server_rpc to wake us up
+  while (!client_wakeup_sent) {
+    std::this_thread::sleep_for(std::chrono::microseconds(1));
+  }
+
+  server_num_blocks = rpc.idle_stats_.num_blocks_;
+  server_num_wakeups = rpc.idle_stats_.num_wakeups_;
+}
+
+///
+/// Client-side code
+///
+double resp_latency_ms;
+
+void cont_func(void *_c, void *_tag) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  resp_latency_ms = static_cast<ChronoTimer *>(_tag)->get_ms();
+  c->num_rpc_resps_++;
+}
+
+void client_thread(Nexus *nexus, size_t num_sessions) {
+  // The session management packets wake up the blocked server
+  BasicAppContext c;
+  client_connect_sessions(nexus, c, num_sessions, basic_sm_handler);
+  Rpc<CTransport> *rpc = c.rpc_;
+  const int session_num = c.session_num_arr_[0];
+
+  if (server_has_rx_notify) {
+    MsgBuffer req = rpc->alloc_msg_buffer_or_die(1);
+    MsgBuffer resp = rpc->alloc_msg_buffer_or_die(1);
+
+    for (uint8_t req_type : {kTestReqTypeFg, kTestReqTypeBg}) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kTestIdleMs));
+
+      c.num_rpc_resps_ = 0;
+      ChronoTimer timer;
+      rpc->enqueue_request(session_num, req_type, &req, &resp, cont_func,
+                           &timer);
+      wait_for_rpc_resps_or_timeout(c, 1);
+      EXPECT_EQ(c.num_rpc_resps_, 1);
+      EXPECT_LT(resp_latency_ms, kTestMaxLatencyMs);
+    }
+
+    rpc->free_msg_buffer(req);
+    rpc->free_msg_buffer(resp);
+  } else {
+    test_printf("test: Server transport lacks RX notifications. Skipping.\n");
+  }
+
+  // Disconnect the session
+  c.num_sm_resps_ = 0;
+  rpc->destroy_session(session_num);
+  wait_for_sm_resps_or_timeout(c, 1);
+  assert(rpc->num_active_sessions() == 0);
+
+  // An application flag set before wakeup() must not be missed
+  client_done = true;
+  server_rpc->wakeup();
+  client_wakeup_sent = true;
+
+  delete rpc;
+}
+
+TEST(IdleBackoffTest, WakeupBeforeTimeout) {
+  Nexus nexus("127.0.0.1:31850", kTestNumaNode, 1 /* bg thread */);
+  nexus.register_req_func(kTestReqTypeFg, req_handler_fg,
+                          ReqFuncType::kForeground);
+  nexus.register_req_func(kTestReqTypeBg, req_handler_bg,
+                          ReqFuncType::kBackground);
+
+  all_servers_ready = false;
+  client_done = false;
+  client_wakeup_sent = false;
+
+  std::thread server_thread(server_thread_func, &nexus);
+  while (!all_servers_ready) {
+    std::this_thread::sleep_for(std::chrono::microseconds(1));
+  }
+
+  std::thread client(client_thread, &nexus, 1);
+  client.join();
+  server_thread.join();
+
+  // The server blocked at least while the client slept, and every blocking
+  // wait ended on an event instead of the timeout
+  ASSERT_GE(server_num_blocks, server_has_rx_notify ? 2 : 1);
+  ASSERT_EQ(server_num_wakeups, server_num_blocks);
+  if (!server_has_rx_notify) GTEST_SKIP();
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,122 @@
+/**
+ * @file multi_port_test.cc
+ * @brief Test an Rpc that uses more than one physical port. The client Rpc
+ * uses two ports, and its sessions must be spread across both of them.
+ */
+#include "client_tests.h"
+
+static constexpr size_t kTestNumSessions = 4;
+
+void req_handler(ReqHandle *, void *);  // Forward declaration
+auto reg_info_vec = {
+    ReqFuncRegInfo(kTestReqType, req_handler, ReqFuncType::kForeground)};
+
+/// The ports used by the client Rpc
+const std::vector<uint8_t> client_phy_ports = {kTestClientPhyPort,
+                                               kTestClientPhyPort + 1};
+
+/// Per-thread application context
+class AppContext : public BasicAppContext {};
+
+/// Copy the request message to the response
+void req_handler(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<AppContext *>(_c);
+  const MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  size_t resp_size = req_msgbuf->get_data_size();
+  Rpc<CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_, resp_size);
+  memcpy(req_handle->pre_resp_msgbuf_.buf_, req_msgbuf->buf_, resp_size);
+  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+}
+
+/// Check that the response matches the request, whose contents are the tag
+void cont_func(void *_c, void *_tag) {
+  auto *c = static_cast<AppContext *>(_c);
+  size_t tag = reinterpret_cast<size_t>(_tag);
+  ASSERT_EQ(c->resp_msgbufs_[tag].get_data_size(), sizeof(size_t));
+  ASSERT_EQ(*reinterpret_cast<size_t *>(c->resp_msgbufs_[tag].buf_), tag);
+  c->num_rpc_resps_++;
+}
+
+void multi_port_test_func(Nexus *nexus, size_t) {
+  while (!all_servers_ready) {  // Wait for all server threads to start
+    std::this_thread::sleep_for(std::chrono::microseconds(1));
+  }
+
+  AppContext c;
+  c.is_client_ = true;
+  c.rpc_ = new Rpc<CTransport>(nexus, static_cast<void *>(&c), kTestClientRpcId,
+                               basic_sm_handler, client_phy_ports);
+  Rpc<CTransport> *rpc = c.rpc_;
+
+  int session_num_arr[kTestNumSessions];
+  for (size_t i = 0; i < kTestNumSessions; i++) {
+    session_num_arr[i] = rpc->create_session(
+        "127.0.0.1:31850", kTestServerRpcId + static_cast<uint8_t>(i));
+    ASSERT_GE(session_num_arr[i], 0);
+  }
+
+  wait_for_sm_resps_or_timeout(c, kTestNumSessions);
+  ASSERT_EQ(c.num_sm_resps_, kTestNumSessions);
+
+  // Sessions are spread evenly across the ports
+  std::map<uint8_t, size_t> sessions_per_port;
+  for (int session_num : session_num_arr) {
+    sessions_per_port[rpc->get_session_phy_port(session_num)]++;
+  }
+  ASSERT_EQ(sessions_per_port.size(), client_phy_ports.size());
+  for (uint8_t phy_port : client_phy_ports) {
+    ASSERT_EQ(sessions_per_port[phy_port],
+              kTestNumSessions / client_phy_ports.size());
+  }
+
+  // Complete one RPC on each session, i.e., RPCs on every port
+  c.req_msgbufs_.resize(kTestNumSessions);
+  c.resp_msgbufs_.resize(kTestNumSessions);
+  for (size_t i = 0; i < kTestNumSessions; i++) {
+    c.req_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(sizeof(size_t));
+    c.resp_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(sizeof(size_t));
+    *reinterpret_cast<size_t *>(c.req_msgbufs_[i].buf_) = i;
+
+    rpc->enqueue_request(session_num_arr[i], kTestReqType, &c.req_msgbufs_[i],
+                         &c.resp_msgbufs_[i], cont_func,
+                         reinterpret_cast<void *>(i));
+  }
+
+  wait_for_rpc_resps_or_timeout(c, kTestNumSessions);
+  ASSERT_EQ(c.num_rpc_resps_, kTestNumSessions);
+
+  for (auto &mb : c.req_msgbufs_) rpc->free_msg_buffer(mb);
+  for (auto &mb : c.resp_msgbufs_) rpc->free_msg_buffer(mb);
+
+  c.num_sm_resps_ = 0;
+  for (int session_num : session_num_arr) rpc->destroy_session(session_num);
+  wait_for_sm_resps_or_timeout(c, kTestNumSessions);
+  ASSERT_EQ(rpc->num_active_sessions(), 0);
+
+  delete rpc;
+  client_done = true;
+}
+
+TEST(MultiPort, SessionsSpreadAcrossPorts) {
+  if (!CTransport::kPortIndependentMemReg) {
+    test_printf("test: Transport does not support multiple ports. Skipping.\n");
+    return;
+  }
+
+  launch_server_client_threads(kTestNumSessions, 0, multi_port_test_func,
+                               reg_info_vec, ConnectServers::kFalse, 0.0);
+}
+
+TEST(MultiPort, DuplicatePortsRejected) {
+  Nexus nexus("127.0.0.1:31850", kTestNumaNode, 0);
+  const std::vector<uint8_t> dup_phy_ports = {kTestClientPhyPort,
+                                              kTestClientPhyPort};
+  ASSERT_THROW(Rpc<CTransport>(&nexus, nullptr, kTestClientRpcId,
+                               basic_sm_handler, dup_phy_ports),
+               std::runtime_error);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
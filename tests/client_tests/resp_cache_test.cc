@@ -0,0 +1,172 @@
+/**
+ * @file resp_cache_test.cc
+ * @brief Test server-side response caches. The client repeatedly reads a set
+ * of keys with a cached request type, and checks that the server runs the
+ * read handler only on cache misses and after invalidations.
+ */
+#include "client_tests.h"
+
+static constexpr size_t kTestNumKeys = 20;
+static constexpr size_t kTestReadsPerKey = 4;
+static constexpr size_t kTestCacheMaxEntries = 1000;
+
+/// Request type for reads, whose responses are cached
+static constexpr uint8_t kTestReqTypeRead = kTestReqType;
+
+/// Request type for writes, which invalidate cached reads. A write request
+/// with a key's data invalidates that key, and a one-byte write request
+/// invalidates all keys.
+static constexpr uint8_t kTestReqTypeWrite = kTestReqType + 1;
+
+/// Number of times the server has executed the read handler
+size_t num_read_executions;
+
+/// The version of the server's data, bumped by writes
+size_t data_version;
+
+///
+/// Server-side code
+///
+
+/// Respond with the request followed by the data version
+void req_handler_read(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  const MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  const size_t req_size = req_msgbuf->get_data_size();
+  num_read_executions++;
+
+  req_handle->dyn_resp_msgbuf_ =
+      c->rpc_->alloc_msg_buffer_or_die(req_size + sizeof(size_t));
+  memcpy(req_handle->dyn_resp_msgbuf_.buf_, req_msgbuf->buf_, req_size);
+  memcpy(&req_handle->dyn_resp_msgbuf_.buf_[req_size], &data_version,
+         sizeof(size_t));
+
+  c->rpc_->enqueue_response(req_handle, &req_handle->dyn_resp_msgbuf_);
+}
+
+void req_handler_write(ReqHandle *req_handle, void *_c) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  const MsgBuffer *req_msgbuf = req_handle->get_req_msgbuf();
+  data_version++;
+
+  if (req_msgbuf->get_data_size() == 1) {
+    c->rpc_->invalidate_resp_cache(kTestReqTypeRead);
+  } else {
+    c->rpc_->invalidate_resp_cache(kTestReqTypeRead, req_msgbuf->buf_,
+                                   req_msgbuf->get_data_size());
+  }
+
+  Rpc<CTransport>::resize_msg_buffer(&req_handle->pre_resp_msgbuf_, 1);
+  c->rpc_->enqueue_response(req_handle, &req_handle->pre_resp_msgbuf_);
+}
+
+///
+/// Client-side code
+///
+void cont_func(void *_c, void *) {
+  auto *c = static_cast<BasicAppContext *>(_c);
+  assert(c->is_client_);
+  c->num_rpc_resps_++;
+}
+
+/// Send a request and wait for its response
+void send_and_wait(BasicAppContext &c, uint8_t req_type, MsgBuffer *req_msgbuf,
+                   MsgBuffer *resp_msgbuf) {
+  const size_t num_rpc_resps = c.num_rpc_resps_;
+  c.rpc_->enqueue_request(c.session_num_arr_[0], req_type, req_msgbuf,
+                          resp_msgbuf, cont_func, nullptr);
+  wait_for_rpc_resps_or_timeout(c, num_rpc_resps + 1);
+  ASSERT_EQ(c.num_rpc_resps_, num_rpc_resps + 1);
+}
+
+/// Read key i and check the data version in the response
+void read_and_check(BasicAppContext &c, size_t i, size_t expected_version) {
+  MsgBuffer &resp_msgbuf = c.resp_msgbufs_[i];
+  send_and_wait(c, kTestReqTypeRead, &c.req_msgbufs_[i], &resp_msgbuf);
+
+  const size_t key_size = c.req_msgbufs_[i].get_data_size();
+  ASSERT_EQ(resp_msgbuf.get_data_size(), key_size + sizeof(size_t));
+  ASSERT_EQ(memcmp(resp_msgbuf.buf_, c.req_msgbufs_[i].buf_, key_size), 0);
+
+  size_t version;
+  memcpy(&version, &resp_msgbuf.buf_[key_size], sizeof(size_t));
+  ASSERT_EQ(version, expected_version);
+}
+
+void client_thread(Nexus *nexus, size_t num_sessions) {
+  // Create the Rpc and connect the session
+  BasicAppContext c;
+  client_connect_sessions(nexus, c, num_sessions, basic_sm_handler);
+  Rpc<CTransport> *rpc = c.rpc_;
+
+  // Keys have different sizes, some larger than one packet. Keys are at least
+  // two bytes long, since one-byte writes invalidate all keys.
+  c.req_msgbufs_.resize(kTestNumKeys);
+  c.resp_msgbufs_.resize(kTestNumKeys);
+  for (size_t i = 0; i < kTestNumKeys; i++) {
+    const size_t key_size = 2 + i * rpc->get_max_data_per_pkt() / 4;
+    c.req_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(key_size);
+    for (size_t j = 0; j < key_size; j++) {
+      c.req_msgbufs_[i].buf_[j] = static_cast<uint8_t>(i + j);
+    }
+    c.resp_msgbufs_[i] =
+        rpc->alloc_msg_buffer_or_die(key_size + sizeof(size_t));
+  }
+
+  MsgBuffer write_resp_msgbuf = rpc->alloc_msg_buffer_or_die(1);
+
+  // Only the first read of each key runs the read handler
+  for (size_t r = 0; r < kTestReadsPerKey; r++) {
+    for (size_t i = 0; i < kTestNumKeys; i++) read_and_check(c, i, 0);
+  }
+  ASSERT_EQ(num_read_executions, kTestNumKeys);
+
+  // Invalidate key 0. Only key 0 sees the new version.
+  send_and_wait(c, kTestReqTypeWrite, &c.req_msgbufs_[0], &write_resp_msgbuf);
+  for (size_t i = 0; i < kTestNumKeys; i++) read_and_check(c, i, i == 0);
+  ASSERT_EQ(num_read_executions, kTestNumKeys + 1);
+
+  // Invalidate all keys
+  MsgBuffer write_all_msgbuf = rpc->alloc_msg_buffer_or_die(1);
+  write_all_msgbuf.buf_[0] = 0xff;
+  send_and_wait(c, kTestReqTypeWrite, &write_all_msgbuf, &write_resp_msgbuf);
+  for (size_t r = 0; r < kTestReadsPerKey; r++) {
+    for (size_t i = 0; i < kTestNumKeys; i++) read_and_check(c, i, 2);
+  }
+  ASSERT_EQ(num_read_executions, 2 * kTestNumKeys + 1);
+
+  for (auto &mb : c.req_msgbufs_) rpc->free_msg_buffer(mb);
+  for (auto &mb : c.resp_msgbufs_) rpc->free_msg_buffer(mb);
+  rpc->free_msg_buffer(write_resp_msgbuf);
+  rpc->free_msg_buffer(write_all_msgbuf);
+
+  // Disconnect the session
+  c.num_sm_resps_ = 0;
+  rpc->destroy_session(c.session_num_arr_[0]);
+  wait_for_sm_resps_or_timeout(c, 1);
+  assert(rpc->num_active_sessions() == 0);
+
+  // Free resources
+  delete rpc;
+  client_done = true;
+}
+
+TEST(RespCache, Base) {
+  num_read_executions = 0;
+  data_version = 0;
+
+  auto reg_info_vec = {
+      ReqFuncRegInfo(kTestReqTypeRead, req_handler_read,
+                     ReqFuncType::kForeground, 0, kTestCacheMaxEntries),
+      ReqFuncRegInfo(kTestReqTypeWrite, req_handler_write,
+                     ReqFuncType::kForeground)};
+
+  // 1 client session (=> 1 server thread), 0 background threads
+  launch_server_client_threads(1, 0, client_thread, reg_info_vec,
+                               ConnectServers::kFalse, 0.0);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -11,13 +11,19 @@ auto reg_info_vec_bg = {
     ReqFuncRegInfo(kTestReqType, req_handler, ReqFuncType::kBackground)};
 
 /// Per-thread application context
-class AppContext : public BasicAppContext {};
+class AppContext : public BasicAppContext {
+ public:
+  MsgBuffer kick_req_msgbuf_;   ///< Request that starts a background batch
+  MsgBuffer kick_resp_msgbuf_;  ///< Response for kick_req_msgbuf_
+};
 
 /// Configuration for controlling the test
 size_t config_num_sessions;      ///< Number of sessions created by client
 size_t config_num_bg_threads;    ///< Number of background threads
 size_t config_rpcs_per_session;  ///< Number of Rpcs per session per iteration
 size_t config_msg_size;  ///< The size of the request and response messages
+bool config_use_batch;  ///< Enqueue each iteration's requests as one batch
+bool config_tx_coalesce;  ///< Enable TX coalescing at the client
 
 /// The common request handler for all subtests. Copies the request message to
 /// the response.
@@ -52,6 +58,17 @@ void cont_func(void *_c, void *_tag) {
   c->num_rpc_resps_++;
 }
 
+/// Continuation for a request that the client enqueues only to get onto a
+/// background thread. This enqueues the iteration's batch from there, so the
+/// batch goes to the foreground thread in chunks.
+void kick_cont_func(void *_c, void *_tag) {
+  auto *c = static_cast<AppContext *>(_c);
+  assert(c->rpc_->in_background());
+
+  auto *req_args_vec = static_cast<std::vector<enq_req_args_t> *>(_tag);
+  c->rpc_->enqueue_request_batch(req_args_vec->data(), req_args_vec->size());
+}
+
 /// The generic test function that issues \p config_rpcs_per_session Rpcs
 /// on each of \p config_num_sessions sessions, for multiple iterations.
 ///
@@ -64,6 +81,7 @@ void generic_test_func(Nexus *nexus, size_t) {
 
   Rpc<CTransport> *rpc = c.rpc_;
   int *session_num_arr = c.session_num_arr_;
+  if (config_tx_coalesce) rpc->set_tx_coalescing(CTransport::kPostlist, 10);
 
   // Pre-create MsgBuffers so we can test reuse and resizing
   size_t tot_reqs_per_iter = config_num_sessions * config_rpcs_per_session;
@@ -74,10 +92,15 @@ void generic_test_func(Nexus *nexus, size_t) {
     c.req_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(max_data_pkt);
     c.resp_msgbufs_[i] = rpc->alloc_msg_buffer_or_die(max_data_pkt);
   }
+  c.kick_req_msgbuf_ = rpc->alloc_msg_buffer_or_die(1);
+  c.kick_resp_msgbuf_ = rpc->alloc_msg_buffer_or_die(1);
+
+  std::vector<enq_req_args_t> req_args_vec;
 
   // The main request-issuing loop
   for (size_t iter = 0; iter < 2; iter++) {
     c.num_rpc_resps_ = 0;
+    req_args_vec.clear();
 
     test_printf("Client: Iteration %zu.\n", iter);
     size_t iter_req_i = 0;  // Request MsgBuffer index in an iteration
@@ -92,14 +115,32 @@ void generic_test_func(Nexus *nexus, size_t) {
           cur_req_msgbuf.buf_[i] = static_cast<uint8_t>(iter_req_i);
         }
 
-        rpc->enqueue_request(session_num_arr[sess_i], kTestReqType,
-                             &cur_req_msgbuf, &c.resp_msgbufs_[iter_req_i],
-                             cont_func, reinterpret_cast<void *>(iter_req_i));
+        if (config_use_batch) {
+          req_args_vec.emplace_back(
+              session_num_arr[sess_i], kTestReqType, &cur_req_msgbuf,
+              &c.resp_msgbufs_[iter_req_i], cont_func,
+              reinterpret_cast<void *>(iter_req_i), kInvalidBgETid);
+        } else {
+          rpc->enqueue_request(session_num_arr[sess_i], kTestReqType,
+                               &cur_req_msgbuf, &c.resp_msgbufs_[iter_req_i],
+                               cont_func, reinterpret_cast<void *>(iter_req_i));
+        }
 
         iter_req_i++;
       }
     }
 
+    if (config_use_batch) {
+      if (config_num_bg_threads == 0) {
+        rpc->enqueue_request_batch(req_args_vec.data(), req_args_vec.size());
+      } else {
+        // Run the kick request's continuation on background thread 0
+        rpc->enqueue_request(session_num_arr[0], kTestReqType,
+                             &c.kick_req_msgbuf_, &c.kick_resp_msgbuf_,
+                             kick_cont_func, &req_args_vec, 0);
+      }
+    }
+
     wait_for_rpc_resps_or_timeout(c, tot_reqs_per_iter);
     assert(c.num_rpc_resps_ == tot_reqs_per_iter);
   }
@@ -107,6 +148,8 @@ void generic_test_func(Nexus *nexus, size_t) {
   // Free the MsgBuffers
   for (auto &mb : c.req_msgbufs_) rpc->free_msg_buffer(mb);
   for (auto &mb : c.resp_msgbufs_) rpc->free_msg_buffer(mb);
+  rpc->free_msg_buffer(c.kick_req_msgbuf_);
+  rpc->free_msg_buffer(c.kick_resp_msgbuf_);
 
   // Disconnect the sessions
   for (size_t sess_i = 0; sess_i < config_num_sessions; sess_i++) {
@@ -130,6 +173,8 @@ void launch_helper() {
 
 TEST(OneSmallRpc, Foreground) {
   config_num_sessions = 1;
+  config_use_batch = false;
+  config_tx_coalesce = false;
   config_num_bg_threads = 0;
   config_rpcs_per_session = 1;
   config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
@@ -138,6 +183,8 @@ TEST(OneSmallRpc, Foreground) {
 
 TEST(OneSmallRpc, Background) {
   config_num_sessions = 1;
+  config_use_batch = false;
+  config_tx_coalesce = false;
   config_num_bg_threads = 1;
   config_rpcs_per_session = 1;
   config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
@@ -146,6 +193,8 @@ TEST(OneSmallRpc, Background) {
 
 TEST(MultiSmallRpcOneSession, Foreground) {
   config_num_sessions = 1;
+  config_use_batch = false;
+  config_tx_coalesce = false;
   config_num_bg_threads = 0;
   config_rpcs_per_session = kSessionReqWindow;
   config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
@@ -154,6 +203,8 @@ TEST(MultiSmallRpcOneSession, Foreground) {
 
 TEST(MultiSmallRpcOneSession, Background) {
   config_num_sessions = 1;
+  config_use_batch = false;
+  config_tx_coalesce = false;
   config_num_bg_threads = 2;
   config_rpcs_per_session = kSessionReqWindow;
   config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
@@ -162,6 +213,8 @@ TEST(MultiSmallRpcOneSession, Background) {
 
 TEST(MultiSmallRpcMultiSession, Foreground) {
   config_num_sessions = 4;
+  config_use_batch = false;
+  config_tx_coalesce = false;
   config_num_bg_threads = 0;
   config_rpcs_per_session = kSessionReqWindow;
   config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
@@ -170,12 +223,50 @@ TEST(MultiSmallRpcMultiSession, Foreground) {
 
 TEST(MultiSmallRpcMultiSession, Background) {
   config_num_sessions = 4;
+  config_use_batch = false;
+  config_tx_coalesce = false;
   config_num_bg_threads = 3;
   config_rpcs_per_session = kSessionReqWindow;
   config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
   launch_helper();
 }
 
+// Each iteration's requests exceed the session request window, so some of the
+// batch goes to the session backlogs
+TEST(MultiSmallRpcBatch, Foreground) {
+  config_num_sessions = 4;
+  config_use_batch = true;
+  config_tx_coalesce = false;
+  config_num_bg_threads = 0;
+  config_rpcs_per_session = 2 * kSessionReqWindow;
+  config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
+  launch_helper();
+}
+
+// As above, but the client enqueues each batch from a background thread, so
+// every session's requests span several chunks
+TEST(MultiSmallRpcBatch, Background) {
+  config_num_sessions = 4;
+  config_use_batch = true;
+  config_tx_coalesce = false;
+  config_num_bg_threads = 2;
+  config_rpcs_per_session = 2 * kSessionReqWindow;
+  config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
+  launch_helper();
+}
+
+// The client holds small TX batches, and stops holding them after the load
+// drops at the end of each iteration
+TEST(MultiSmallRpcTxCoalesce, Foreground) {
+  config_num_sessions = 4;
+  config_use_batch = false;
+  config_tx_coalesce = true;
+  config_num_bg_threads = 0;
+  config_rpcs_per_session = kSessionReqWindow;
+  config_msg_size = Rpc<CTransport>::get_max_data_per_pkt();
+  launch_helper();
+}
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
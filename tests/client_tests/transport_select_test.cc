@@ -0,0 +1,48 @@
+/**
+ * @file transport_select_test.cc
+ * @brief Test runtime transport selection. The test selects each transport
+ * compiled into the library with Nexus::set_transport(), and checks that
+ * dispatch_transport() creates an Rpc with that transport.
+ */
+#include "client_tests.h"
+
+/// Create an Rpc with the dispatched transport and record the transport type
+struct RpcCreator {
+  Nexus *nexus_;
+  TransportType *transport_type_;
+
+  template <class TTr>
+  void operator()(transport_tag_t<TTr>) {
+    Rpc<TTr> rpc(nexus_, nullptr, kTestClientRpcId, basic_sm_handler,
+                 kTestClientPhyPort);
+    ASSERT_TRUE(rpc.get_max_data_per_pkt() == TTr::kMaxDataPerPkt);
+    *transport_type_ = TTr::kTransportType;
+  }
+};
+
+TEST(TransportSelect, Base) {
+  Nexus nexus("127.0.0.1:31850", kTestNumaNode, 0);
+  ASSERT_TRUE(nexus.get_transport() == CTransport::kTransportType);
+
+  // Transports that are not compiled in cannot be selected
+  ASSERT_EQ(nexus.set_transport(TransportType::kInvalid), -EINVAL);
+  ASSERT_TRUE(nexus.get_transport() == CTransport::kTransportType);
+
+#define TEST_TRANSPORT_TYPE(TTr) TTr::kTransportType,
+  const std::vector<TransportType> transport_types = {
+      ERPC_TRANSPORT_LIST(TEST_TRANSPORT_TYPE)};
+#undef TEST_TRANSPORT_TYPE
+
+  for (TransportType transport_type : transport_types) {
+    ASSERT_EQ(nexus.set_transport(transport_type), 0);
+
+    TransportType dispatched_type = TransportType::kInvalid;
+    dispatch_transport(&nexus, RpcCreator{&nexus, &dispatched_type});
+    ASSERT_EQ(dispatched_type, transport_type);
+  }
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
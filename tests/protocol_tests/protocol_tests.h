@@ -23,7 +23,10 @@ static constexpr size_t kTestRpcId = 0;  // ID of the fixture's Rpc
 static constexpr size_t kTestReqType = 1;
 static constexpr void *kTestTag = nullptr;
 static constexpr size_t kTestSmallMsgSize = 32;
-static constexpr size_t kTestLargeMsgSize = KB(128);
+/// Large enough to need more packets than one credit window
+static constexpr size_t kTestLargeMsgSize =
+    2 * kSessionCredits * CTransport::kMTU;
+static_assert(kTestLargeMsgSize <= Rpc<CTransport>::kMaxMsgSize, "");
 static constexpr double kTestLinkBandwidth = 56.0 * 1000 * 1000 * 1000 / 8;
 
 static void req_handler(ReqHandle *, void *);  // Defined in each test.cc
@@ -92,7 +95,7 @@ class RpcTest : public ::testing::Test {
     session->server_ = server;
     session->server_.session_num_ = kInvalidSessionNum;
 
-    rpc_->ring_entries_available_ -= kSessionCredits;
+    rpc_->ports_[0].ring_entries_available_ -= kSessionCredits;
     rpc_->session_vec_.push_back(session);
 
     return session;
@@ -137,7 +140,7 @@ class RpcTest : public ::testing::Test {
     session->local_session_num_ = session->server_.session_num_;
     session->remote_session_num_ = session->client_.session_num_;
 
-    rpc_->ring_entries_available_ -= kSessionCredits;
+    rpc_->ports_[0].ring_entries_available_ -= kSessionCredits;
     rpc_->session_vec_.push_back(session);
     return session;
   }
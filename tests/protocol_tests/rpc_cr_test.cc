@@ -57,11 +57,38 @@ TEST_F(RpcTest, process_expl_cr_st) {
   ASSERT_EQ(clt_session->client_info_.credits_, 0);
   ASSERT_TRUE(pkthdr_tx_queue_->pop().matches(PktType::kReq, kSessionCredits));
 
-  // Receive explicit credit return for a future pkt in this request (roll-back)
-  // Expect: It's dropped
+  // Receive explicit credit return for a future pkt in this request (reorder)
+  // Expect: num_rx is not bumped. No request packet is sent because the
+  // window of packets in flight is full.
   expl_cr.pkt_num_ = 2;  // Future
   rpc_->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
   ASSERT_EQ(sslot_0->client_info_.num_rx_, 1);
+  ASSERT_EQ(clt_session->client_info_.credits_, 1);
+  ASSERT_EQ(pkthdr_tx_queue_->size(), 0);
+
+  // Receive the same explicit credit return again (past)
+  // Expect: It's dropped
+  rpc_->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
+  ASSERT_EQ(sslot_0->client_info_.num_rx_, 1);
+  ASSERT_EQ(clt_session->client_info_.credits_, 1);
+  ASSERT_EQ(pkthdr_tx_queue_->size(), 0);
+
+  // Receive explicit credit return for the missing pkt (in-order)
+  // Expect: num_rx skips the reordered pkt; two request packets are sent
+  expl_cr.pkt_num_ = 1;
+  rpc_->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
+  ASSERT_EQ(sslot_0->client_info_.num_rx_, 3);
+  ASSERT_EQ(clt_session->client_info_.credits_, 0);
+  ASSERT_TRUE(
+      pkthdr_tx_queue_->pop().matches(PktType::kReq, kSessionCredits + 1));
+  ASSERT_TRUE(
+      pkthdr_tx_queue_->pop().matches(PktType::kReq, kSessionCredits + 2));
+
+  // Receive explicit credit return for an unsent pkt (roll-back)
+  // Expect: It's dropped
+  expl_cr.pkt_num_ = sslot_0->client_info_.num_tx_;
+  rpc_->process_expl_cr_st(sslot_0, &expl_cr, batch_rx_tsc);
+  ASSERT_EQ(sslot_0->client_info_.num_rx_, 3);
   ASSERT_EQ(pkthdr_tx_queue_->size(), 0);
   expl_cr.pkt_num_ = 0;
 }
@@ -0,0 +1,110 @@
+#include "protocol_tests.h"
+
+namespace erpc {
+
+static constexpr size_t kTestNumPkts = 4;  // Packets in the multi-packet msg
+static constexpr size_t kTestMultiPktMsgSize =
+    kTestNumPkts * CTransport::kMaxDataPerPkt;
+
+/// Common setup code for client packet loss tests
+class RpcPktLossTest : public RpcTest {
+ public:
+  SessionEndpoint client_, server_;
+  Session *clt_session_;
+  SSlot *sslot_0_;
+
+  RpcPktLossTest() {
+    client_ = get_local_endpoint();
+    server_ = get_remote_endpoint();
+    clt_session_ = create_client_session_connected(client_, server_);
+    sslot_0_ = &clt_session_->sslot_arr_[0];
+    rpc_->faults_.hard_wheel_bypass_ = true;  // Don't place pkts in the wheel
+  }
+
+  /// Check that the next packet transmitted matches the type and number
+  void check_tx(PktType pkt_type, size_t pkt_num) {
+    ASSERT_GT(pkthdr_tx_queue_->size(), 0);
+    ASSERT_TRUE(pkthdr_tx_queue_->pop().matches(pkt_type, pkt_num));
+  }
+};
+
+/// After a rollback, only the holes in the request are retransmitted, and only
+/// their credits are returned
+TEST_F(RpcPktLossTest, retransmit_req_holes) {
+  MsgBuffer req = rpc_->alloc_msg_buffer(kTestMultiPktMsgSize);
+  MsgBuffer resp = rpc_->alloc_msg_buffer(kTestSmallMsgSize);
+  auto &ci = sslot_0_->client_info_;
+  const size_t &credits = clt_session_->client_info_.credits_;
+
+  rpc_->enqueue_request(0, kTestReqType, &req, &resp, cont_func, kTestTag);
+  ASSERT_EQ(ci.num_tx_, kTestNumPkts);
+  ASSERT_EQ(credits, kSessionCredits - kTestNumPkts);
+
+  // Receive the CR for packet 1 before the CR for packet 0
+  pkthdr_t cr;
+  cr.format(kTestReqType, 0 /* msg_size */, client_.session_num_,
+            PktType::kExplCR, 1 /* pkt_num */, sslot_0_->cur_req_num_);
+  rpc_->process_expl_cr_st(sslot_0_, &cr, rdtsc());
+  ASSERT_EQ(ci.num_rx_, 0);
+  ASSERT_EQ(ci.rx_bitmap_.count_, 1);
+  ASSERT_EQ(credits, kSessionCredits - kTestNumPkts + 1);
+
+  // Packets 0, 2, and 3 are lost. Packet 1 must not be retransmitted, and its
+  // credit must not be returned twice.
+  pkthdr_tx_queue_->clear();
+  rpc_->pkt_loss_retransmit_st(sslot_0_);
+  ASSERT_EQ(ci.num_tx_, kTestNumPkts);
+  ASSERT_EQ(credits, kSessionCredits - (kTestNumPkts - 1));
+
+  check_tx(PktType::kReq, 0);
+  check_tx(PktType::kReq, 2);
+  check_tx(PktType::kReq, 3);
+  ASSERT_EQ(pkthdr_tx_queue_->size(), 0);
+}
+
+/// After a rollback, RFRs are not resent for response packets received out of
+/// order
+TEST_F(RpcPktLossTest, retransmit_rfr_holes) {
+  MsgBuffer req = rpc_->alloc_msg_buffer(kTestSmallMsgSize);
+  MsgBuffer resp = rpc_->alloc_msg_buffer(kTestMultiPktMsgSize);
+  auto &ci = sslot_0_->client_info_;
+  const size_t &credits = clt_session_->client_info_.credits_;
+
+  rpc_->enqueue_request(0, kTestReqType, &req, &resp, cont_func, kTestTag);
+  ASSERT_EQ(ci.num_tx_, 1);
+
+  uint8_t remote_resp[sizeof(pkthdr_t) + CTransport::kMaxDataPerPkt];
+  auto *resp_pkthdr = reinterpret_cast<pkthdr_t *>(remote_resp);
+
+  // The first response packet makes the client send RFRs for packets 1--3
+  resp_pkthdr->format(kTestReqType, kTestMultiPktMsgSize, client_.session_num_,
+                      PktType::kResp, 0 /* pkt_num */, sslot_0_->cur_req_num_);
+  rpc_->process_resp_one_st(sslot_0_, resp_pkthdr, rdtsc());
+  ASSERT_EQ(ci.num_rx_, 1);
+  ASSERT_EQ(ci.num_tx_, kTestNumPkts);
+
+  // Receive response packet 2 before response packet 1
+  resp_pkthdr->pkt_num_ = 2;
+  rpc_->process_resp_one_st(sslot_0_, resp_pkthdr, rdtsc());
+  ASSERT_EQ(ci.num_rx_, 1);
+  ASSERT_EQ(ci.rx_bitmap_.count_, 1);
+  ASSERT_EQ(credits, kSessionCredits - 2);
+
+  // Roll back. Only RFRs 1 and 3 are retransmitted.
+  pkthdr_tx_queue_->clear();
+  rpc_->pkt_loss_retransmit_st(sslot_0_);
+  ASSERT_EQ(ci.num_tx_, kTestNumPkts);
+  ASSERT_EQ(credits, kSessionCredits - 2);
+
+  check_tx(PktType::kRFR, 1);
+  check_tx(PktType::kRFR, 3);
+  ASSERT_EQ(pkthdr_tx_queue_->size(), 0);
+  ASSERT_EQ(num_cont_func_calls_, 0);
+}
+
+}  // namespace erpc
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
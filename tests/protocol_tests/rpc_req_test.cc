@@ -96,13 +96,33 @@ TEST_F(RpcTest, process_large_req_one_st) {
   ASSERT_EQ(sslot_0->server_info_.num_rx_, 2);
   ASSERT_EQ(rpc_->transport_->testing_.tx_flush_count_, 0);
 
-  // Receive a future packet for this request (future)
-  // Expect: It's dropped
+  // Receive a future packet for this request (reordered)
+  // Expect: Credit return is sent, but num_rx is not bumped
   pkthdr_0->pkt_num_ += 2u;
   rpc_->process_large_req_one_st(sslot_0, pkthdr_0);
-  ASSERT_EQ(pkthdr_tx_queue_->size(), 0);
+  ASSERT_TRUE(pkthdr_tx_queue_->pop().matches(PktType::kExplCR, 3));
+  ASSERT_EQ(sslot_0->server_info_.num_rx_, 2);
+
+  // Receive the same future packet again (past)
+  // Expect: Credit return is re-sent
+  rpc_->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_TRUE(pkthdr_tx_queue_->pop().matches(PktType::kExplCR, 3));
   ASSERT_EQ(sslot_0->server_info_.num_rx_, 2);
-  pkthdr_0->pkt_num_ -= 2u;
+
+  // Receive the missing packet (in-order)
+  // Expect: Credit return is sent, and num_rx skips the reordered packet
+  pkthdr_0->pkt_num_ -= 1u;
+  rpc_->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_TRUE(pkthdr_tx_queue_->pop().matches(PktType::kExplCR, 2));
+  ASSERT_EQ(sslot_0->server_info_.num_rx_, 4);
+  ASSERT_EQ(sslot_0->server_info_.rx_bitmap_.count_, 0);
+
+  // Receive a packet beyond the window of packets in flight (future)
+  // Expect: It's dropped
+  pkthdr_0->pkt_num_ = 4 + kSessionCredits;
+  rpc_->process_large_req_one_st(sslot_0, pkthdr_0);
+  ASSERT_EQ(pkthdr_tx_queue_->size(), 0);
+  ASSERT_EQ(sslot_0->server_info_.num_rx_, 4);
 
   // Receive the last packet of this request (in-order)
   // Expect: First response packet is sent, and request is buried
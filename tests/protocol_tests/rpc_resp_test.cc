@@ -56,6 +56,60 @@ TEST_F(RpcTest, process_resp_one_SMALL_st) {
   ASSERT_EQ(num_cont_func_calls_, 0);
 }
 
+/// Send a two-packet request, and receive its single-packet response before
+/// the credit return for request packet 0. Return the client sslot.
+SSlot *recv_resp_before_cr(RpcTest *t, MsgBuffer *req, MsgBuffer *resp) {
+  Rpc<CTransport> *rpc = t->rpc_;
+  const auto client = t->get_local_endpoint();
+  Session *clt_session =
+      t->create_client_session_connected(client, t->get_remote_endpoint());
+  SSlot *sslot_0 = &clt_session->sslot_arr_[0];
+
+  *req = rpc->alloc_msg_buffer(2 * CTransport::kMaxDataPerPkt);
+  *resp = rpc->alloc_msg_buffer(kTestSmallMsgSize);
+  rpc->faults_.hard_wheel_bypass_ = true;  // Don't place request pkts in wheel
+  rpc->enqueue_request(0, kTestReqType, req, resp, cont_func, kTestTag);
+  assert(sslot_0->client_info_.num_tx_ == 2);
+
+  uint8_t remote_resp[sizeof(pkthdr_t) + kTestSmallMsgSize];
+  auto *resp_pkthdr = reinterpret_cast<pkthdr_t *>(remote_resp);
+  resp_pkthdr->format(kTestReqType, kTestSmallMsgSize, client.session_num_,
+                      PktType::kResp, 1 /* pkt_num */, sslot_0->cur_req_num_);
+  rpc->process_resp_one_st(sslot_0, resp_pkthdr, rdtsc());
+  return sslot_0;
+}
+
+// Receive a response before the credit return for an earlier request packet
+// Expect: The response is saved, but the continuation waits for the CR
+TEST_F(RpcTest, process_resp_one_before_cr_st) {
+  MsgBuffer req, resp;
+  SSlot *sslot_0 = recv_resp_before_cr(this, &req, &resp);
+
+  ASSERT_EQ(num_cont_func_calls_, 0);
+  ASSERT_EQ(sslot_0->tx_msgbuf_, &req);  // Response not complete
+  ASSERT_EQ(sslot_0->client_info_.num_rx_, 0);
+  ASSERT_EQ(sslot_0->client_info_.rx_bitmap_.count_, 1);
+  ASSERT_EQ(resp.get_data_size(), kTestSmallMsgSize);
+}
+
+// Receive the late CR that fills the last hole before the response
+// Expect: The CR completes the response and invokes the continuation
+TEST_F(RpcTest, process_expl_cr_completes_resp_st) {
+  MsgBuffer req, resp;
+  SSlot *sslot_0 = recv_resp_before_cr(this, &req, &resp);
+  ASSERT_EQ(num_cont_func_calls_, 0);
+
+  pkthdr_t cr;
+  cr.format(kTestReqType, 0 /* msg_size */, get_local_endpoint().session_num_,
+            PktType::kExplCR, 0 /* pkt_num */, sslot_0->cur_req_num_);
+  rpc_->process_expl_cr_st(sslot_0, &cr, rdtsc());
+
+  ASSERT_EQ(num_cont_func_calls_, 1);
+  ASSERT_EQ(sslot_0->tx_msgbuf_, nullptr);  // Response received
+  ASSERT_EQ(sslot_0->client_info_.num_rx_, 2);
+  ASSERT_EQ(sslot_0->client_info_.rx_bitmap_.count_, 0);
+}
+
 TEST_F(RpcTest, process_resp_one_LARGE_st) {
   // TODO
 }
@@ -59,13 +59,22 @@ TEST_F(RpcTest, process_rfr_st) {
   ASSERT_EQ(sslot_0->server_info_.num_rx_, k_num_req_pkts + 1);
   ASSERT_EQ(rpc_->transport_->testing_.tx_flush_count_, 1);  // Unchanged
 
-  // Receive a future RFR packet for this request (future)
-  // Expect: It's dropped
+  // Receive a future RFR packet for this request (reordered)
+  // Expect: Response packet is sent, but num_rx is not bumped
   rfr.pkt_num_ += 2u;
   rpc_->process_rfr_st(sslot_0, &rfr);
+  ASSERT_TRUE(
+      pkthdr_tx_queue_->pop().matches(PktType::kResp, k_num_req_pkts + 2));
   ASSERT_EQ(sslot_0->server_info_.num_rx_, k_num_req_pkts + 1);
-  ASSERT_TRUE(pkthdr_tx_queue_->size() == 0);
-  rfr.pkt_num_ -= 2u;
+
+  // Receive the missing RFR packet (in-order)
+  // Expect: Response packet is sent, and num_rx skips the reordered RFR
+  rfr.pkt_num_ -= 1u;
+  rpc_->process_rfr_st(sslot_0, &rfr);
+  ASSERT_TRUE(
+      pkthdr_tx_queue_->pop().matches(PktType::kResp, k_num_req_pkts + 1));
+  ASSERT_EQ(sslot_0->server_info_.num_rx_, k_num_req_pkts + 3);
+  ASSERT_EQ(rpc_->transport_->testing_.tx_flush_count_, 1);  // Unchanged
 }
 
 }  // namespace erpc
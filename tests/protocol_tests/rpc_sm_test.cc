@@ -72,17 +72,18 @@ TEST_F(RpcSmTest, handle_connect_req_st_errors) {
   common_check(0, SmPktType::kConnectResp, SmErrType::kInvalidTransport);
 
   // Ring entries exhausted
-  const size_t initial_ring_entries_available = rpc_->ring_entries_available_;
-  rpc_->ring_entries_available_ = kSessionCredits - 1;
+  const size_t initial_ring_entries_available =
+      rpc_->ports_[0].ring_entries_available_;
+  rpc_->ports_[0].ring_entries_available_ = kSessionCredits - 1;
   rpc_->handle_connect_req_st(conn_req);
   common_check(0, SmPktType::kConnectResp, SmErrType::kRingExhausted);
-  rpc_->ring_entries_available_ = initial_ring_entries_available;  // Restore
+  rpc_->ports_[0].ring_entries_available_ = initial_ring_entries_available;
 
   // Ring entries exhausted
-  rpc_->ring_entries_available_ = 0;
+  rpc_->ports_[0].ring_entries_available_ = 0;
   rpc_->handle_connect_req_st(conn_req);
   common_check(0, SmPktType::kConnectResp, SmErrType::kRingExhausted);
-  rpc_->ring_entries_available_ = initial_ring_entries_available;
+  rpc_->ports_[0].ring_entries_available_ = initial_ring_entries_available;
 
   // Client routing info resolution fails
   rpc_->fault_inject_fail_resolve_rinfo_st();
@@ -176,7 +177,7 @@ TEST_F(RpcSmTest, handle_connect_resp_st_response_error) {
   // Process response with error. Session is destroyed and ring buffers released
   rpc_->handle_connect_resp_st(conn_resp);
   ASSERT_EQ(rpc_->session_vec_[0], nullptr);
-  ASSERT_TRUE(rpc_->ring_entries_available_ ==
+  ASSERT_TRUE(rpc_->ports_[0].ring_entries_available_ ==
               rpc_->transport_->kNumRxRingEntries);
   // No more tests here because session is destroyed
 }
@@ -200,7 +201,7 @@ TEST_F(RpcSmTest, handle_disconnect_req_st) {
   common_check(1, SmPktType::kDisconnectResp, SmErrType::kNoError);
   ASSERT_EQ(rpc_->session_vec_[0], nullptr);
   ASSERT_LT(rpc_->huge_alloc_->get_stat_user_alloc_tot(), initial_alloc);
-  ASSERT_TRUE(rpc_->ring_entries_available_ ==
+  ASSERT_TRUE(rpc_->ports_[0].ring_entries_available_ ==
               rpc_->transport_->kNumRxRingEntries);
 
   // Process disconnect request again. Response is re-sent.
@@ -225,13 +226,42 @@ TEST_F(RpcSmTest, handle_disconnect_resp_st) {
   // Process first disconnect response
   rpc_->handle_disconnect_resp_st(disc_resp);
   ASSERT_EQ(rpc_->session_vec_[0], nullptr);
-  ASSERT_TRUE(rpc_->ring_entries_available_ ==
+  ASSERT_TRUE(rpc_->ports_[0].ring_entries_available_ ==
               rpc_->transport_->kNumRxRingEntries);
 
   // Process disconnect request again. This gets ignored.
   rpc_->handle_disconnect_resp_st(disc_resp);
 }
 
+//
+// handle_reset_client_st()
+//
+TEST_F(RpcSmTest, handle_reset_client_st) {
+  const auto client = get_local_endpoint();
+  const auto server = get_remote_endpoint();
+  Session *clt_session = create_client_session_connected(client, server);
+  rpc_->faults_.hard_wheel_bypass_ = true;  // Don't place request pkts in wheel
+
+  // Make a few sslots active. The other sslots stay idle.
+  static constexpr size_t kNumReqs = 3;
+  MsgBuffer req[kNumReqs], resp[kNumReqs];
+  for (size_t i = 0; i < kNumReqs; i++) {
+    req[i] = rpc_->alloc_msg_buffer(kTestSmallMsgSize);
+    resp[i] = rpc_->alloc_msg_buffer(kTestSmallMsgSize);
+    rpc_->enqueue_request(0, kTestReqType, &req[i], &resp[i], cont_func,
+                          kTestTag);
+  }
+
+  // Reset the session
+  // Expect: Only the active requests fail, with zero-size responses
+  rpc_->handle_reset_client_st(clt_session);
+  ASSERT_EQ(num_cont_func_calls_, kNumReqs);
+  for (size_t i = 0; i < kNumReqs; i++) {
+    ASSERT_EQ(resp[i].get_data_size(), 0);
+  }
+  ASSERT_EQ(rpc_->session_vec_[0], nullptr);
+}
+
 //
 // create_session_st()
 //
@@ -0,0 +1,54 @@
+#include "protocol_tests.h"
+
+namespace erpc {
+
+static constexpr size_t kTestMaxTimeouts =
+    Rpc<CTransport>::kTxCoalesceMaxTimeouts;
+
+/// Coalescing switches off after consecutive deadline expiries, and back on
+/// after a full batch, even if min_burst is the transport's TX batch size
+TEST_F(RpcTest, tx_coalesce_reenable) {
+  const auto server = get_local_endpoint();
+  const auto client = get_remote_endpoint();
+  Session *srv_session = create_server_session_init(client, server);
+  SSlot *sslot_0 = &srv_session->sslot_arr_[0];
+  MsgBuffer *ctrl_msgbuf = &sslot_0->pre_resp_msgbuf_;
+
+  auto &port = rpc_->ports_[0];
+  const auto &tc = rpc_->tx_coalesce_;
+  rpc_->set_tx_coalescing(CTransport::kPostlist, 1 /* max_delay_us */);
+  rpc_->ev_loop_tsc_ = rdtsc();
+
+  // Small batches are held until their deadline expires
+  for (size_t i = 0; i < kTestMaxTimeouts; i++) {
+    rpc_->enqueue_hdr_tx_burst_st(sslot_0, ctrl_msgbuf, nullptr);
+    ASSERT_TRUE(rpc_->tx_coalesce_hold_st(port));
+    rpc_->ev_loop_tsc_ += tc.max_delay_cycles_;
+    ASSERT_FALSE(rpc_->tx_coalesce_hold_st(port));
+    rpc_->do_tx_burst_st(port);
+  }
+  ASSERT_EQ(tc.num_timeouts_, kTestMaxTimeouts);
+
+  // Coalescing is off, so small batches are not held
+  rpc_->enqueue_hdr_tx_burst_st(sslot_0, ctrl_msgbuf, nullptr);
+  ASSERT_FALSE(rpc_->tx_coalesce_hold_st(port));
+  rpc_->do_tx_burst_st(port);
+
+  // A full batch is transmitted while enqueueing, and coalescing turns on
+  for (size_t i = 0; i < CTransport::kPostlist; i++) {
+    rpc_->enqueue_hdr_tx_burst_st(sslot_0, ctrl_msgbuf, nullptr);
+  }
+  ASSERT_EQ(port.tx_batch_i_, 0);
+  ASSERT_EQ(tc.num_timeouts_, 0);
+
+  rpc_->enqueue_hdr_tx_burst_st(sslot_0, ctrl_msgbuf, nullptr);
+  ASSERT_TRUE(rpc_->tx_coalesce_hold_st(port));
+  rpc_->do_tx_burst_st(port);
+}
+
+}  // namespace erpc
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
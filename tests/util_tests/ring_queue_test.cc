@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "util/fixed_queue.h"
+#include "util/ring_queue.h"
+
+TEST(RingQueueTest, PushPop) {
+  erpc::RingQueue<size_t> rq;
+  rq.reserve(4);
+  ASSERT_EQ(rq.capacity(), 4);
+  ASSERT_TRUE(rq.empty());
+
+  // Wrap around the ring without growing
+  for (size_t i = 0; i < 10; i++) {
+    rq.push(i);
+    rq.push(i + 100);
+    ASSERT_EQ(rq.front(), i);
+    rq.pop();
+    ASSERT_EQ(rq.front(), i + 100);
+    rq.pop();
+  }
+  ASSERT_EQ(rq.size(), 0);
+  ASSERT_EQ(rq.num_grows(), 0);
+}
+
+TEST(RingQueueTest, Grow) {
+  erpc::RingQueue<size_t> rq;
+  rq.reserve(3);
+  ASSERT_EQ(rq.capacity(), 4);
+
+  // Move the head so that growing must unwrap the ring
+  rq.push(0);
+  rq.push(1);
+  rq.pop();
+  rq.pop();
+
+  for (size_t i = 0; i < 9; i++) rq.push(i);
+  ASSERT_EQ(rq.size(), 9);
+  ASSERT_EQ(rq.capacity(), 16);
+  ASSERT_EQ(rq.num_grows(), 2);
+
+  for (size_t i = 0; i < 9; i++) {
+    ASSERT_EQ(rq.front(), i);
+    rq.pop();
+  }
+  ASSERT_TRUE(rq.empty());
+}
+
+TEST(FixedQueueTest, DropOldest) {
+  erpc::FixedQueue<size_t, 4> fq;
+  for (size_t i = 0; i < 6; i++) fq.push(i);
+  ASSERT_EQ(fq.size(), 4);
+
+  for (size_t i = 2; i < 6; i++) ASSERT_EQ(fq.pop(), i);
+  ASSERT_EQ(fq.size(), 0);
+
+  fq.push(7);
+  fq.clear();
+  ASSERT_EQ(fq.size(), 0);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <map>
+
+#include "util/session_router.h"
+#include "util/test_printf.h"
+
+static constexpr size_t kNumKeys = 1000000;
+
+/// Return the session for each key in [0, kNumKeys)
+static std::vector<int> route_all(const erpc::SessionRouter &router) {
+  std::vector<int> ret(kNumKeys);
+  for (size_t k = 0; k < kNumKeys; k++) ret[k] = router.route(k);
+  return ret;
+}
+
+/// Return the fraction of keys routed to each session
+static std::map<int, double> get_shares(const std::vector<int> &routes) {
+  std::map<int, double> ret;
+  for (int s : routes) ret[s] += 1.0 / routes.size();
+  return ret;
+}
+
+TEST(SessionRouterTest, Weights) {
+  erpc::SessionRouter router;
+  router.add_server(0, 100, 1);
+  router.add_server(1, 101, 1);
+  router.add_server(2, 102, 2);
+  ASSERT_EQ(router.num_servers(), 3);
+  ASSERT_EQ(router.num_vnodes(), 400);
+
+  auto shares = get_shares(route_all(router));
+  ASSERT_EQ(shares.size(), 3);
+  test_printf("Shares: %.3f %.3f %.3f\n", shares[100], shares[101],
+              shares[102]);
+  ASSERT_NEAR(shares[100], 0.25, 0.05);
+  ASSERT_NEAR(shares[101], 0.25, 0.05);
+  ASSERT_NEAR(shares[102], 0.50, 0.05);
+}
+
+TEST(SessionRouterTest, AddRemove) {
+  erpc::SessionRouter router;
+  for (size_t i = 0; i < 8; i++) router.add_server(i, static_cast<int>(i));
+  const std::vector<int> before = route_all(router);
+
+  // Keys that move after adding a server must move to the new server
+  router.add_server(8, 8);
+  const std::vector<int> after_add = route_all(router);
+  size_t num_moved = 0;
+  for (size_t k = 0; k < kNumKeys; k++) {
+    if (after_add[k] != before[k]) {
+      ASSERT_EQ(after_add[k], 8);
+      num_moved++;
+    }
+  }
+  ASSERT_NEAR(num_moved * 1.0 / kNumKeys, 1.0 / 9, 0.03);
+
+  // Removing the server restores the original mapping
+  router.remove_server(8);
+  ASSERT_EQ(route_all(router), before);
+
+  // Keys that move after removing a server are only those it owned
+  router.remove_server(3);
+  const std::vector<int> after_remove = route_all(router);
+  for (size_t k = 0; k < kNumKeys; k++) {
+    if (before[k] == 3) {
+      ASSERT_NE(after_remove[k], 3);
+    } else {
+      ASSERT_EQ(after_remove[k], before[k]);
+    }
+  }
+}
+
+TEST(SessionRouterTest, IncrementalMatchesRebuild) {
+  // Apply a sequence of changes to one router, then build the final
+  // membership from scratch in another. The mappings must be identical.
+  erpc::SessionRouter incr;
+  for (size_t i = 0; i < 6; i++) incr.add_server(i, static_cast<int>(i));
+  incr.remove_server(2);
+  incr.set_weight(4, 3);
+  incr.add_server(6, 6, 2);
+  incr.remove_server(0);
+  incr.set_weight(4, 2);
+  incr.add_server(2, 20);
+  incr.set_session_num(5, 50);
+
+  erpc::SessionRouter full;
+  full.add_server(1, 1);
+  full.add_server(2, 20);
+  full.add_server(3, 3);
+  full.add_server(4, 4, 2);
+  full.add_server(5, 50);
+  full.add_server(6, 6, 2);
+
+  ASSERT_EQ(incr.num_servers(), full.num_servers());
+  ASSERT_EQ(incr.num_vnodes(), full.num_vnodes());
+  ASSERT_EQ(route_all(incr), route_all(full));
+}
+
+TEST(SessionRouterTest, SingleServer) {
+  erpc::SessionRouter router(1 /* vnodes_per_weight */);
+  router.add_server(7, 42);
+  for (size_t k = 0; k < kNumKeys; k++) ASSERT_EQ(router.route(k), 42);
+
+  router.add_server(8, 43);
+  router.remove_server(7);
+  for (size_t k = 0; k < kNumKeys; k++) ASSERT_EQ(router.route(k), 43);
+  ASSERT_EQ(router.route_server_id(0), 8);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}